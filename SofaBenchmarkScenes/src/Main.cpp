@@ -1,3 +1,23 @@
 #include <benchmark/benchmark.h>
 
-BENCHMARK_MAIN();
+#include <utils/ThreadAffinity.h>
+
+int main(int argc, char** argv)
+{
+    char arg0_default[]="benchmark";
+    char* args_default=arg0_default;
+    if(!argv)
+    {
+        argc=1;
+        argv=&args_default;
+    }
+    ::benchmark::Initialize(&argc, argv);
+    if(::benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+
+    ::benchmark::AddCustomContext("cpu_topology", CpuTopology::get().toString());
+    ::benchmark::AddCustomContext("affinity", toString(affinityPolicyFromEnvironment()));
+
+    ::benchmark::RunSpecifiedBenchmarks();
+    ::benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,233 @@
+#include <SofaBenchmarkScenes/BeamSceneBuilder.h>
+
+#include <sofa/simpleapi/SimpleApi.h>
+#include <sofa/simulation/graph/DAGNode.h>
+
+#include <map>
+#include <sstream>
+
+BeamSceneParameters BeamSceneParameters::fromState(const benchmark::State& state)
+{
+    BeamSceneParameters parameters;
+    const auto nbArgs = state.range_size();
+    if (nbArgs > 0) parameters.resolution = static_cast<int>(state.range(0));
+    if (nbArgs > 1) parameters.forceField = static_cast<ForceFieldType>(state.range(1));
+    if (nbArgs > 2) parameters.mass = static_cast<MassType>(state.range(2));
+    if (nbArgs > 3) parameters.odeSolver = static_cast<OdeSolverType>(state.range(3));
+    if (nbArgs > 4) parameters.linearSolver = static_cast<LinearSolverType>(state.range(4));
+    if (nbArgs > 5) parameters.preconditioner = static_cast<PreconditionerType>(state.range(5));
+    if (nbArgs > 6) parameters.refactorizationInterval = static_cast<int>(state.range(6));
+    return parameters;
+}
+
+const std::vector<std::string>& BeamSceneParameters::argNames()
+{
+    static const std::vector<std::string> names { "resolution", "forcefield", "mass", "odesolver", "linearsolver" };
+    return names;
+}
+
+const std::vector<std::string>& BeamSceneParameters::preconditionerArgNames()
+{
+    static const std::vector<std::string> names { "resolution", "forcefield", "mass", "odesolver", "linearsolver", "preconditioner", "interval" };
+    return names;
+}
+
+std::size_t BeamSceneParameters::getNbNodes() const
+{
+    return static_cast<std::size_t>(resolution) * resolution * 4 * resolution;
+}
+
+std::size_t BeamSceneParameters::getNbDofs() const
+{
+    return 3 * getNbNodes();
+}
+
+std::string BeamSceneParameters::toString() const
+{
+    static const char* forceFieldNames[] = { "TetrahedronFEMForceField", "TetrahedralCorotationalFEMForceField", "FastTetrahedralCorotationalForceField", "HexahedronFEMForceField" };
+    static const char* massNames[] = { "UniformMass", "DiagonalMass", "MeshMatrixMass" };
+    static const char* odeSolverNames[] = { "EulerImplicitSolver", "StaticSolver", "NewmarkImplicitSolver" };
+    static const char* linearSolverNames[] = { "CGLinearSolver<GraphScattered>", "CGLinearSolver<CRSMat3x3d>", "SparseLDLSolver", "SparseLUSolver", "SupernodalLDLSolver", "ShewchukPCGLinearSolver" };
+
+    std::string linearSolverName = linearSolverNames[static_cast<int>(linearSolver)];
+    if (linearSolver == LinearSolverType::PCG)
+    {
+        linearSolverName += std::string("<") + ::toString(preconditioner) + ",interval=" + std::to_string(refactorizationInterval) + ">";
+    }
+
+    return std::string(forceFieldNames[static_cast<int>(forceField)]) + "/"
+        + massNames[static_cast<int>(mass)] + "/"
+        + odeSolverNames[static_cast<int>(odeSolver)] + "/"
+        + linearSolverName + "/"
+        + std::to_string(getNbDofs()) + "dofs";
+}
+
+const char* toString(PreconditionerType preconditioner)
+{
+    static const char* names[] = { "None", "Jacobi", "BlockJacobi", "IncompleteCholesky", "LDL" };
+    return names[static_cast<int>(preconditioner)];
+}
+
+const std::vector<int64_t>& beamResolutionRange()
+{
+    // number of dofs = 12 * resolution^3
+    static const std::vector<int64_t> range { 4, 6, 10, 16, 26, 44 };
+    return range;
+}
+
+namespace
+{
+
+void addOdeSolver(const sofa::simulation::Node::SPtr& node, OdeSolverType type)
+{
+    sofa::simpleapi::importPlugin("Sofa.Component.ODESolver.Backward");
+    switch (type)
+    {
+        case OdeSolverType::EulerImplicit:
+            sofa::simpleapi::createObject(node, "EulerImplicitSolver", {{"rayleighStiffness", "0.1"}, {"rayleighMass", "0.1"}});
+            break;
+        case OdeSolverType::Static:
+            sofa::simpleapi::createObject(node, "StaticSolver", {{"newton_iterations", "1"}});
+            break;
+        case OdeSolverType::NewmarkImplicit:
+            sofa::simpleapi::createObject(node, "NewmarkImplicitSolver", {{"rayleighStiffness", "0.1"}, {"rayleighMass", "0.1"}});
+            break;
+    }
+}
+
+void addLinearSolver(const sofa::simulation::Node::SPtr& node, const BeamSceneParameters& parameters)
+{
+    const auto iterations = std::to_string(parameters.cgMaxIterations);
+    std::ostringstream tolerance;
+    tolerance << parameters.cgTolerance;
+    switch (parameters.linearSolver)
+    {
+        case LinearSolverType::CGMatrixFree:
+            sofa::simpleapi::importPlugin("Sofa.Component.LinearSolver.Iterative");
+            sofa::simpleapi::createObject(node, "CGLinearSolver", {{"template", "GraphScattered"}, {"iterations", iterations}, {"tolerance", tolerance.str()}, {"threshold", "1e-9"}});
+            break;
+        case LinearSolverType::CGAssembled:
+            sofa::simpleapi::importPlugin("Sofa.Component.LinearSolver.Iterative");
+            sofa::simpleapi::createObject(node, "CGLinearSolver", {{"template", "CompressedRowSparseMatrixMat3x3d"}, {"iterations", iterations}, {"tolerance", tolerance.str()}, {"threshold", "1e-9"}});
+            break;
+        case LinearSolverType::SparseLDL:
+            sofa::simpleapi::importPlugin("Sofa.Component.LinearSolver.Direct");
+            sofa::simpleapi::createObject(node, "SparseLDLSolver", {{"template", "CompressedRowSparseMatrixMat3x3d"}});
+            break;
+        case LinearSolverType::SparseLU:
+            sofa::simpleapi::importPlugin("Sofa.Component.LinearSolver.Direct");
+            sofa::simpleapi::createObject(node, "SparseLUSolver", {{"template", "CompressedRowSparseMatrixMat3x3d"}});
+            break;
+        case LinearSolverType::SupernodalLDL:
+            // registered in the factory by linearsolver/SupernodalLDLSolver.cpp
+            sofa::simpleapi::createObject(node, "SupernodalLDLSolver", {{"template", "CompressedRowSparseMatrixMat3x3d"}});
+            break;
+        case LinearSolverType::PCG:
+        {
+            sofa::simpleapi::importPlugin("Sofa.Component.LinearSolver.Iterative");
+            const bool usePreconditioner = parameters.preconditioner != PreconditionerType::None;
+            std::map<std::string, std::string> pcgParameters {{"name", "pcg"}, {"template", "GraphScattered"}, {"iterations", iterations}, {"tolerance", tolerance.str()},
+                {"use_precond", usePreconditioner ? "true" : "false"}};
+            if (usePreconditioner)
+            {
+                pcgParameters["preconditioner"] = "@preconditioner";
+                pcgParameters["build_precond"] = "true";
+                pcgParameters["update_step"] = std::to_string(parameters.refactorizationInterval);
+            }
+            sofa::simpleapi::createObject(node, "ShewchukPCGLinearSolver", pcgParameters);
+            if (usePreconditioner)
+            {
+                // registered in the factory by linearsolver/PreconditionedCG.cpp
+                sofa::simpleapi::createObject(node, "BenchmarkPreconditioner", {{"name", "preconditioner"}, {"template", "CompressedRowSparseMatrixMat3x3d"},
+                    {"method", toString(parameters.preconditioner)}});
+            }
+            break;
+        }
+    }
+}
+
+void addMass(const sofa::simulation::Node::SPtr& node, MassType type)
+{
+    sofa::simpleapi::importPlugin("Sofa.Component.Mass");
+    switch (type)
+    {
+        case MassType::Uniform:
+            sofa::simpleapi::createObject(node, "UniformMass", {{"totalMass", "320"}});
+            break;
+        case MassType::Diagonal:
+            sofa::simpleapi::createObject(node, "DiagonalMass", {{"massDensity", "0.2"}});
+            break;
+        case MassType::MeshMatrix:
+            sofa::simpleapi::createObject(node, "MeshMatrixMass", {{"massDensity", "0.2"}});
+            break;
+    }
+}
+
+void addForceField(const sofa::simulation::Node::SPtr& node, ForceFieldType type)
+{
+    sofa::simpleapi::importPlugin("Sofa.Component.SolidMechanics.FEM.Elastic");
+    switch (type)
+    {
+        case ForceFieldType::TetrahedronFEM:
+            sofa::simpleapi::createObject(node, "TetrahedronFEMForceField", {{"youngModulus", "1000"}, {"poissonRatio", "0.4"}, {"method", "large"}});
+            break;
+        case ForceFieldType::TetrahedralCorotationalFEM:
+            sofa::simpleapi::createObject(node, "TetrahedralCorotationalFEMForceField", {{"youngModulus", "1000"}, {"poissonRatio", "0.4"}, {"method", "large"}});
+            break;
+        case ForceFieldType::FastTetrahedralCorotational:
+            sofa::simpleapi::createObject(node, "FastTetrahedralCorotationalForceField", {{"youngModulus", "1000"}, {"poissonRatio", "0.4"}, {"method", "large"}});
+            break;
+        case ForceFieldType::HexahedronFEM:
+            sofa::simpleapi::createObject(node, "HexahedronFEMForceField", {{"youngModulus", "1000"}, {"poissonRatio", "0.4"}, {"method", "large"}});
+            break;
+    }
+}
+
+}
+
+sofa::simulation::Node::SPtr createBeamScene(const BeamSceneParameters& parameters)
+{
+    const sofa::simulation::NodeSPtr root = sofa::core::objectmodel::New<sofa::simulation::graph::DAGNode>();
+    root->setName("root");
+    root->setGravity({0, -9, 0});
+    root->setDt(parameters.dt);
+
+    sofa::simpleapi::importPlugin("Sofa.Component.AnimationLoop");
+    sofa::simpleapi::createObject(root, "DefaultAnimationLoop");
+
+    const auto beam = sofa::simpleapi::createChild(root, "Beam");
+
+    addOdeSolver(beam, parameters.odeSolver);
+    addLinearSolver(beam, parameters);
+
+    const auto n = std::to_string(parameters.resolution);
+    const auto nz = std::to_string(4 * parameters.resolution);
+
+    sofa::simpleapi::importPlugin("Sofa.Component.Topology.Container.Grid");
+    sofa::simpleapi::createObject(beam, "RegularGridTopology", {{"name", "grid"}, {"min", "0 0 0"}, {"max", "10 10 40"}, {"n", n + " " + n + " " + nz}});
+
+    sofa::simpleapi::importPlugin("Sofa.Component.StateContainer");
+    sofa::simpleapi::createObject(beam, "MechanicalObject", {{"name", "dofs"}, {"template", "Vec3d"}});
+
+    if (parameters.forceField != ForceFieldType::HexahedronFEM)
+    {
+        sofa::simpleapi::importPlugin("Sofa.Component.Topology.Container.Dynamic");
+        sofa::simpleapi::createObject(beam, "TetrahedronSetTopologyContainer", {{"name", "tetra_topo"}});
+        sofa::simpleapi::createObject(beam, "TetrahedronSetTopologyModifier");
+        sofa::simpleapi::createObject(beam, "TetrahedronSetGeometryAlgorithms", {{"template", "Vec3d"}});
+
+        sofa::simpleapi::importPlugin("Sofa.Component.Topology.Mapping");
+        sofa::simpleapi::createObject(beam, "Hexa2TetraTopologicalMapping", {{"input", "@grid"}, {"output", "@tetra_topo"}});
+    }
+
+    addMass(beam, parameters.mass);
+    addForceField(beam, parameters.forceField);
+
+    sofa::simpleapi::importPlugin("Sofa.Component.Engine.Select");
+    sofa::simpleapi::createObject(beam, "BoxROI", {{"name", "box_roi"}, {"box", "-1 -1 -0.1 11 11 0.1"}});
+
+    sofa::simpleapi::importPlugin("Sofa.Component.Constraint.Projective");
+    sofa::simpleapi::createObject(beam, "FixedConstraint", {{"indices", "@box_roi.indices"}});
+
+    return root;
+}
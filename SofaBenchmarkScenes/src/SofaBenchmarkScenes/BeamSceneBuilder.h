@@ -0,0 +1,104 @@
+#pragma once
+
+#include <benchmark/benchmark.h>
+#include <sofa/simulation/Node.h>
+
+#include <string>
+#include <vector>
+
+// Parametric cantilever beam scene, created in C++ instead of a fixed XML string, so that the number of
+// degrees of freedom, the element type and the solvers can be benchmark arguments.
+
+enum class ForceFieldType : int
+{
+    TetrahedronFEM = 0,
+    TetrahedralCorotationalFEM,
+    FastTetrahedralCorotational,
+    HexahedronFEM
+};
+
+enum class MassType : int
+{
+    Uniform = 0,
+    Diagonal,
+    MeshMatrix
+};
+
+enum class OdeSolverType : int
+{
+    EulerImplicit = 0,
+    Static,
+    NewmarkImplicit
+};
+
+enum class LinearSolverType : int
+{
+    CGMatrixFree = 0,
+    CGAssembled,
+    SparseLDL,
+    SparseLU,
+    SupernodalLDL,
+    PCG
+};
+
+/// Preconditioner of the ShewchukPCGLinearSolver (LinearSolverType::PCG)
+enum class PreconditionerType : int
+{
+    None = 0,
+    Jacobi,
+    BlockJacobi,
+    IncompleteCholesky,
+    LDL
+};
+
+struct BeamSceneParameters
+{
+    /// The beam is a regular grid of resolution x resolution x (4 * resolution) nodes
+    int resolution { 5 };
+    ForceFieldType forceField { ForceFieldType::TetrahedronFEM };
+    MassType mass { MassType::Diagonal };
+    OdeSolverType odeSolver { OdeSolverType::EulerImplicit };
+    LinearSolverType linearSolver { LinearSolverType::CGMatrixFree };
+
+    SReal dt { 0.01 };
+
+    /// Maximum number of iterations and tolerance of the CGLinearSolver
+    int cgMaxIterations { 25 };
+    SReal cgTolerance { 1e-9 };
+
+    /// Preconditioner of the PCG, and number of time steps between two computations of the preconditioner
+    PreconditionerType preconditioner { PreconditionerType::None };
+    int refactorizationInterval { 1 };
+
+    /// Read the parameters from the benchmark arguments, in this order:
+    /// resolution, force field, mass, ODE solver, linear solver, preconditioner, refactorization interval
+    /// Arguments not provided keep their default value.
+    static BeamSceneParameters fromState(const benchmark::State& state);
+
+    /// Names of the 5 first benchmark arguments read in fromState
+    static const std::vector<std::string>& argNames();
+
+    /// Names of all the benchmark arguments read in fromState, preconditioner included
+    static const std::vector<std::string>& preconditionerArgNames();
+
+    std::size_t getNbNodes() const;
+    std::size_t getNbDofs() const;
+
+    /// Human-readable description of the parameters, to be used as a benchmark label
+    std::string toString() const;
+};
+
+/// Create the scene graph of a cantilever beam. The returned scene is not initialized.
+sofa::simulation::Node::SPtr createBeamScene(const BeamSceneParameters& parameters);
+
+const char* toString(PreconditionerType preconditioner);
+
+/// Benchmark arguments sweeping the number of degrees of freedom from ~1k to ~1M
+const std::vector<int64_t>& beamResolutionRange();
+
+/// Value of an enumeration (ForceFieldType, MassType...) as a benchmark argument
+template<class TEnum>
+constexpr int64_t arg(TEnum e)
+{
+    return static_cast<int64_t>(e);
+}
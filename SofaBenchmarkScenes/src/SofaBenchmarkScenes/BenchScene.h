@@ -11,9 +11,200 @@
 #include <sofa/simulation/graph/init.h>
 #include <sofa/component/init.h>
 #include <sofa/helper/AdvancedTimer.h>
+#include <sofa/simulation/MainTaskSchedulerFactory.h>
+#include <sofa/simulation/ParallelForEach.h>
+#include <sofa/core/behavior/LinearSolver.h>
+#include <sofa/helper/NameDecoder.h>
+
+#include <SofaBenchmarkScenes/LatencyHistogram.h>
+#include <SofaBenchmarkScenes/SceneSnapshot.h>
+
+#include <utils/MatrixIO.h>
+#include <utils/ThreadAffinity.h>
 
 #include <boost/intrusive_ptr.hpp>
 
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <typeinfo>
+#include <vector>
+
+// Pin the threads running the simulation with the policy given in the environment variable SOFABENCHMARK_AFFINITY.
+// The threads of the main task scheduler are pinned if it is running, otherwise only the current thread.
+// Called before loading a scene, so that its memory is first touched by a pinned thread.
+// The threads stay pinned as long as the returned object lives, i.e. until the end of the benchmark.
+[[nodiscard]] inline std::unique_ptr<ScopedThreadAffinity> applyAffinityFromEnvironment()
+{
+    const auto policy = affinityPolicyFromEnvironment();
+    if (policy == AffinityPolicy::None)
+        return std::make_unique<ScopedThreadAffinity>();
+
+    auto* taskScheduler = sofa::simulation::MainTaskSchedulerFactory::createInRegistry();
+    auto affinity = std::make_unique<ScopedThreadAffinity>(taskScheduler);
+    if (taskScheduler != nullptr && taskScheduler->getThreadCount() > 1)
+    {
+        pinTaskSchedulerThreads(*taskScheduler, policy);
+    }
+    else
+    {
+        const auto order = CpuTopology::get().getOrder(policy);
+        if (!order.empty())
+            pinCurrentThread(order.front());
+    }
+    return affinity;
+}
+
+// Write the system matrices of the linear solvers of the scene in the directory given in the environment variable
+// SOFABENCHMARK_DUMP_MATRICES, in Matrix Market (default) or in binary CSR if SOFABENCHMARK_DUMP_FORMAT is "csr".
+// The files are named <sceneName>_<solverName> and can be benchmarked with SOFABENCHMARK_MATRIX_DIR.
+// Only the matrices stored as CompressedRowSparseMatrix (scalar or 3x3 blocks) are written.
+inline void dumpSystemMatricesFromEnvironment(sofa::simulation::Node* root, const std::string& sceneName)
+{
+    const char* directory = std::getenv("SOFABENCHMARK_DUMP_MATRICES");
+    if (directory == nullptr || *directory == '\0')
+        return;
+
+    const char* format = std::getenv("SOFABENCHMARK_DUMP_FORMAT");
+    const std::string extension = (format != nullptr && std::string(format) == "csr") ? ".csr" : ".mtx";
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+
+    std::vector<sofa::core::behavior::LinearSolver*> solvers;
+    root->getTreeObjects<sofa::core::behavior::LinearSolver>(&solvers);
+    for (auto* solver : solvers)
+    {
+        const auto* systemMatrix = solver->getSystemBaseMatrix();
+
+        matrixio::Matrix matrix;
+        if (const auto* crs = dynamic_cast<const sofa::linearalgebra::CompressedRowSparseMatrix<SReal>*>(systemMatrix))
+            matrix = matrixio::toEigen(*crs);
+        else if (const auto* crs3x3 = dynamic_cast<const sofa::linearalgebra::CompressedRowSparseMatrix<sofa::type::Mat<3, 3, SReal> >*>(systemMatrix))
+            matrix = matrixio::toEigen(*crs3x3);
+        else
+            continue;
+
+        const auto filename = (std::filesystem::path(directory) / (sceneName + "_" + solver->getName() + extension)).string();
+        if (!matrixio::writeMatrix(filename, matrix))
+            std::cerr << "Cannot write the system matrix in " << filename << std::endl;
+    }
+}
+
+// Residuals of the last solve of an iterative linear solver (CGLinearSolver, ShewchukPCGLinearSolver), stored in
+// its Data "graph": the initial residual, then one value per iteration. nullptr if not available.
+inline const sofa::type::vector<SReal>* getLastResiduals(const sofa::core::objectmodel::Base* solver)
+{
+    if (solver == nullptr)
+        return nullptr;
+
+    using Graph = std::map<std::string, sofa::type::vector<SReal> >;
+    const auto* graphData = dynamic_cast<const sofa::core::objectmodel::Data<Graph>*>(solver->findData("graph"));
+    if (graphData == nullptr)
+        return nullptr;
+
+    const auto& graph = graphData->getValue();
+    const auto it = graph.find("Error");
+    if (it == graph.end() || it->second.empty())
+        return nullptr;
+    return &it->second;
+}
+
+// Number of iterations of the last solve of an iterative linear solver. Returns 0 if not available.
+inline std::size_t getLastNbIterations(const sofa::core::objectmodel::Base* solver)
+{
+    const auto* residuals = getLastResiduals(solver);
+    return residuals != nullptr ? residuals->size() - 1 : 0;
+}
+
+// Residual at the end of the last solve of an iterative linear solver, as compared to its tolerance.
+// Returns 0 if not available.
+inline SReal getLastResidual(const sofa::core::objectmodel::Base* solver)
+{
+    const auto* residuals = getLastResiduals(solver);
+    return residuals != nullptr ? residuals->back() : 0;
+}
+
+// Load and initialize the scene defined in TScene
+template<typename TScene>
+sofa::simulation::Node::SPtr loadScene()
+{
+    sofa::simulation::Node::SPtr root = TScene::getRoot();
+    root->init(sofa::core::execparams::defaultInstance());
+    return root;
+}
+
+// Put back the scene in its initial state, using the snapshot taken after its initialization.
+// If the snapshot cannot be applied (e.g. topological changes), the scene is reloaded with the function load.
+template<typename TLoader>
+void restoreScene(sofa::simulation::Node::SPtr& root, SceneSnapshot& snapshot, const TLoader& load)
+{
+    if (!snapshot.restore())
+    {
+        sofa::simulation::node::unload(root);
+        root = load();
+        snapshot = SceneSnapshot(root.get());
+    }
+}
+
+template<typename TScene>
+void restoreScene(sofa::simulation::Node::SPtr& root, SceneSnapshot& snapshot)
+{
+    restoreScene(root, snapshot, &loadScene<TScene>);
+}
+
+template<typename TScene, typename = void>
+struct HasNbWarmUpSteps : std::false_type {};
+template<typename TScene>
+struct HasNbWarmUpSteps<TScene, std::void_t<decltype(TScene::nbWarmUpSteps)> > : std::true_type {};
+
+// Number of time steps, at the beginning of a simulation, which are not recorded in the latency histogram.
+// Precomputations often happen during the first time steps, so they are not representative of the other steps.
+// TScene can change the default value (1) with a static member nbWarmUpSteps.
+template<typename TScene>
+std::size_t getNbWarmUpSteps()
+{
+    if constexpr (HasNbWarmUpSteps<TScene>::value)
+    {
+        return TScene::nbWarmUpSteps;
+    }
+    else
+    {
+        return 1;
+    }
+}
+
+// Animate the scene for one time step, and record the duration of the step in the histogram if it is not
+// part of the warm-up
+inline void animateAndRecord(sofa::simulation::Node* root, SReal dt, std::size_t stepId, std::size_t nbWarmUpSteps, LatencyHistogram& histogram)
+{
+    const auto begin = std::chrono::steady_clock::now();
+    sofa::simulation::node::animate(root, dt);
+    const auto end = std::chrono::steady_clock::now();
+
+    if (stepId >= nbWarmUpSteps)
+    {
+        histogram.record(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count()));
+    }
+}
+
+// Report the distribution of the frame durations (in seconds) as custom counters
+inline void setLatencyCounters(benchmark::State& state, const LatencyHistogram& histogram)
+{
+    const auto toSeconds = [](std::uint64_t nanoseconds) { return static_cast<double>(nanoseconds) * 1e-9; };
+    state.counters["frame_p50"] = toSeconds(histogram.percentile(50.));
+    state.counters["frame_p95"] = toSeconds(histogram.percentile(95.));
+    state.counters["frame_p99"] = toSeconds(histogram.percentile(99.));
+    state.counters["frame_p99.9"] = toSeconds(histogram.percentile(99.9));
+    state.counters["frame_max"] = toSeconds(histogram.max());
+}
+
 // Generic benchmark for a scene (timing whole animation) with a fixed number of steps a certain number of time
 // TScene (template argument) needs to implement getRoot(), dt and nbSteps
 template<typename TScene>
@@ -23,29 +214,37 @@ void BM_Scene_bench_SimulationFactor(benchmark::State& state)
     
     sofa::component::init();
 
+    auto affinity = applyAffinityFromEnvironment();
+
+    // The scene is loaded only once, then restored from a snapshot for each simulation
+    sofa::simulation::Node::SPtr root = loadScene<TScene>();
+    SceneSnapshot snapshot(root.get());
+
+    const auto nbWarmUpSteps = getNbWarmUpSteps<TScene>();
+    LatencyHistogram histogram;
+
     for (auto _ : state)
     {
         for (auto i = 0; i < state.range(0); ++i)
         {
             state.PauseTiming();
-
-            // Not ideal but did not find a way to clone/duplicate a scene
-            sofa::simulation::Node::SPtr root = TScene::getRoot();
-            root->init(sofa::core::execparams::defaultInstance());
-
+            restoreScene<TScene>(root, snapshot);
             state.ResumeTiming();
-            for (auto j = 0; j < TScene::nbSteps; j++)
+
+            for (std::size_t j = 0; j < TScene::nbSteps; j++)
             {
-                sofa::simulation::node::animate(root.get(), TScene::dt);
+                animateAndRecord(root.get(), TScene::dt, j, nbWarmUpSteps, histogram);
             }
-
-            sofa::simulation::node::unload(root);
         }
     }
 
+    sofa::simulation::node::unload(root);
+
     state.counters["FPS"] = benchmark::Counter(TScene::nbSteps * state.range(0), benchmark::Counter::kIsIterationInvariantRate);
     state.counters["frame"] = benchmark::Counter(TScene::nbSteps * state.range(0), benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert);
+    setLatencyCounters(state, histogram);
 
+    affinity.reset();
     sofa::simulation::graph::cleanup();
 }
 
@@ -78,18 +277,25 @@ void BM_Scene_bench_AdvancedTimer(benchmark::State& state, const std::vector<con
     }
     std::vector<SReal> avgTimers(advancedTimerLabels.size());
 
+    auto affinity = applyAffinityFromEnvironment();
+
+    // The scene is loaded only once, then restored from a snapshot for each iteration
+    sofa::simulation::Node::SPtr root = loadScene<TScene>();
+    SceneSnapshot snapshot(root.get());
+
+    const auto nbWarmUpSteps = getNbWarmUpSteps<TScene>();
+    LatencyHistogram histogram;
+
     for (auto _ : state)
     {
         state.PauseTiming();
-        // Not ideal but did not find a way to clone/duplicate a scene
-        sofa::simulation::Node::SPtr root = TScene::getRoot();
-        root->init(sofa::core::execparams::defaultInstance());
-
+        restoreScene<TScene>(root, snapshot);
         state.ResumeTiming();
+
         for (auto j = 0; j < state.range(0); j++)
         {
             sofa::helper::AdvancedTimer::begin("Animate");
-            sofa::simulation::node::animate(root.get(), TScene::dt);
+            animateAndRecord(root.get(), TScene::dt, j, nbWarmUpSteps, histogram);
             sofa::helper::AdvancedTimer::end("Animate");
 
             const auto records = sofa::helper::AdvancedTimer::getStepData("Animate", true);
@@ -108,10 +314,13 @@ void BM_Scene_bench_AdvancedTimer(benchmark::State& state, const std::vector<con
         }
 
         sofa::helper::AdvancedTimer::clearData("Animate");
-
-        sofa::simulation::node::unload(root);
     }
 
+    // The matrices are the ones assembled during the last time step
+    dumpSystemMatricesFromEnvironment(root.get(), sofa::helper::NameDecoder::decodeTypeName(typeid(TScene)));
+
+    sofa::simulation::node::unload(root);
+
     std::transform(avgTimers.begin(), avgTimers.end(), avgTimers.begin(), [&state](SReal t) { return t / state.range(0);});
     for (unsigned int i = 0; i < advancedTimerLabels.size(); ++i)
     {
@@ -119,8 +328,95 @@ void BM_Scene_bench_AdvancedTimer(benchmark::State& state, const std::vector<con
     }
     state.counters["FPS"] = benchmark::Counter(state.range(0), benchmark::Counter::kIsIterationInvariantRate); // nbTimeSteps * nbIterations / totalDuration
     state.counters["frame"] = benchmark::Counter(state.range(0), benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert);
+    setLatencyCounters(state, histogram);
+
+    affinity.reset();
+    sofa::simulation::graph::cleanup();
+}
+
+// Total duration and number of calls of AdvancedTimer steps, accumulated over the time steps of a benchmark
+struct AdvancedTimerTotals
+{
+    std::vector<SReal> seconds;
+    std::vector<std::size_t> nbCalls;
+    std::size_t nbSteps { 0 };
+
+    // Average duration of one call of the step i, in milliseconds (0 if it is never called)
+    SReal getMsPerCall(std::size_t i) const { return nbCalls[i] > 0 ? 1e3 * seconds[i] / nbCalls[i] : 0; }
+    // Average duration of the step i per time step, in milliseconds
+    SReal getMsPerStep(std::size_t i) const { return nbSteps > 0 ? 1e3 * seconds[i] / nbSteps : 0; }
+    // Average number of calls of the step i per time step
+    SReal getCallsPerStep(std::size_t i) const { return nbSteps > 0 ? static_cast<SReal>(nbCalls[i]) / nbSteps : 0; }
+};
+
+// Generic benchmark for a scene created by the function load (e.g. a parametric scene), animated nbStepsPerIteration
+// times at each iteration, accumulating the durations of the AdvancedTimer labels. onStep is called with the root
+// after each time step, e.g. to read the number of iterations of a solver.
+// The counters FPS and frame_* are set, the caller adds its own counters from the returned totals.
+template<typename TLoader, typename TStepCallback>
+AdvancedTimerTotals BM_Scene_bench_Loader(benchmark::State& state, const TLoader& load, SReal dt, std::size_t nbStepsPerIteration,
+                                          const std::vector<const char*>& advancedTimerLabels, const TStepCallback& onStep)
+{
+    sofa::helper::logging::MessageDispatcher::clearHandlers() ;
 
+    sofa::helper::AdvancedTimer::setEnabled("Animate", true);
+    sofa::helper::AdvancedTimer::setInterval("Animate", 1);
+    sofa::helper::AdvancedTimer::setOutputType("Animate", "gui");
+
+    sofa::component::init();
+
+    std::vector<sofa::helper::AdvancedTimer::IdStep> timerIds(advancedTimerLabels.begin(), advancedTimerLabels.end());
+    AdvancedTimerTotals totals;
+    totals.seconds.assign(advancedTimerLabels.size(), 0);
+    totals.nbCalls.assign(advancedTimerLabels.size(), 0);
+
+    auto affinity = applyAffinityFromEnvironment();
+
+    // The scene is loaded only once, then restored from a snapshot for each iteration
+    sofa::simulation::Node::SPtr root = load();
+    SceneSnapshot snapshot(root.get());
+
+    LatencyHistogram histogram;
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        restoreScene(root, snapshot, load);
+        state.ResumeTiming();
+
+        for (std::size_t i = 0; i < nbStepsPerIteration; ++i)
+        {
+            sofa::helper::AdvancedTimer::begin("Animate");
+            animateAndRecord(root.get(), dt, i, 1, histogram);
+            sofa::helper::AdvancedTimer::end("Animate");
+
+            const auto records = sofa::helper::AdvancedTimer::getStepData("Animate", true);
+            for (std::size_t l = 0; l < timerIds.size(); ++l)
+            {
+                const auto it = records.find(timerIds[l]);
+                if (it != records.end())
+                {
+                    totals.seconds[l] += convertInSeconds(it->second.ttotal);
+                    totals.nbCalls[l] += it->second.num;
+                }
+            }
+
+            onStep(root.get());
+            ++totals.nbSteps;
+        }
+
+        sofa::helper::AdvancedTimer::clearData("Animate");
+    }
+
+    sofa::simulation::node::unload(root);
+
+    state.counters["FPS"] = benchmark::Counter(nbStepsPerIteration, benchmark::Counter::kIsIterationInvariantRate);
+    setLatencyCounters(state, histogram);
+
+    affinity.reset();
     sofa::simulation::graph::cleanup();
+
+    return totals;
 }
 
 // Generic benchmark for a scene (timing whole animation) with a increasing number of steps at once
@@ -134,26 +430,138 @@ void BM_Scene_bench_StepFactor(benchmark::State& state)
 
     sofa::simulation::Simulation* simu = new sofa::simulation::graph::DAGSimulation();
 
+    auto affinity = applyAffinityFromEnvironment();
+
+    // The scene is loaded only once, then restored from a snapshot for each iteration
+    sofa::simulation::Node::SPtr root = loadScene<TScene>();
+    SceneSnapshot snapshot(root.get());
+
+    const auto nbWarmUpSteps = getNbWarmUpSteps<TScene>();
+    LatencyHistogram histogram;
+
     for (auto _ : state)
     {
         state.PauseTiming();
-
-        // Not ideal but did not find a way to clone/duplicate a scene
-        sofa::simulation::Node::SPtr root = TScene::getRoot();
-        root->init(sofa::core::execparams::defaultInstance());
-
+        restoreScene<TScene>(root, snapshot);
         state.ResumeTiming();
+
         for (auto i = 0; i < state.range(0); ++i)
         {
-            sofa::simulation::node::animate(root.get(), TScene::dt);
+            animateAndRecord(root.get(), TScene::dt, i, nbWarmUpSteps, histogram);
         }
-
-        sofa::simulation::node::unload(root);
     }
 
+    sofa::simulation::node::unload(root);
+
     state.counters["FPS"] = benchmark::Counter(state.range(0), benchmark::Counter::kIsIterationInvariantRate);
     state.counters["frame"] = benchmark::Counter(state.range(0), benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert);
+    setLatencyCounters(state, histogram);
 
+    affinity.reset();
     sofa::simulation::graph::cleanup();
 }
 
+
+// Generic benchmark for the throughput of a machine: state.range(0) independent copies of the same scene
+// are simulated concurrently by a task scheduler of state.range(0) threads. The simulations are distributed
+// among the threads by parallelForEach: a simulation is not bound to a thread.
+// Reports the aggregated FPS, the distribution of the frame durations over all simulations, and the scaling
+// efficiency compared to a single simulation running alone (1 means that N simulations run in parallel
+// as fast as a single one).
+// TScene (template argument) needs to implement getRoot(), dt and nbSteps
+template<typename TScene>
+void BM_Scene_bench_ParallelSimulations(benchmark::State& state)
+{
+    using Clock = std::chrono::steady_clock;
+    using Seconds = std::chrono::duration<double>;
+
+    sofa::helper::logging::MessageDispatcher::clearHandlers() ;
+
+    sofa::component::init();
+
+    const auto nbSimulations = static_cast<std::size_t>(state.range(0));
+
+    // The threads are pinned before the scenes are loaded, so that their memory is first touched by pinned threads
+    auto* taskScheduler = sofa::simulation::MainTaskSchedulerFactory::createInRegistry();
+    assert(taskScheduler != nullptr);
+    const auto previousThreadCount = taskScheduler->getThreadCount();
+    taskScheduler->init(static_cast<unsigned int>(nbSimulations));
+    auto affinity = applyAffinityFromEnvironment();
+
+    std::vector<sofa::simulation::Node::SPtr> roots;
+    std::vector<SceneSnapshot> snapshots;
+    roots.reserve(nbSimulations);
+    snapshots.reserve(nbSimulations);
+    for (std::size_t i = 0; i < nbSimulations; ++i)
+    {
+        roots.push_back(loadScene<TScene>());
+        snapshots.emplace_back(roots.back().get());
+    }
+
+    const auto simulateAlone = [&roots, &snapshots]()
+    {
+        restoreScene<TScene>(roots.front(), snapshots.front());
+        const auto begin = Clock::now();
+        for (std::size_t j = 0; j < TScene::nbSteps; ++j)
+        {
+            sofa::simulation::node::animate(roots.front().get(), TScene::dt);
+        }
+        return Seconds(Clock::now() - begin).count();
+    };
+
+    // Reference: duration of a single simulation running alone, with the same number of steps as each parallel
+    // simulation. A first simulation warms up the scene (precomputations, allocations) and is not measured.
+    simulateAlone();
+    const double singleDuration = simulateAlone();
+
+    // One histogram per simulation, so that the threads do not share anything
+    const auto nbWarmUpSteps = getNbWarmUpSteps<TScene>();
+    std::vector<LatencyHistogram> histograms(nbSimulations);
+    double parallelDuration = 0.;
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        for (std::size_t i = 0; i < nbSimulations; ++i)
+        {
+            restoreScene<TScene>(roots[i], snapshots[i]);
+        }
+        state.ResumeTiming();
+
+        const auto begin = Clock::now();
+        sofa::simulation::parallelForEach(*taskScheduler, static_cast<std::size_t>(0), nbSimulations,
+            [&roots, &histograms, nbWarmUpSteps](const std::size_t i)
+            {
+                for (std::size_t j = 0; j < TScene::nbSteps; ++j)
+                {
+                    animateAndRecord(roots[i].get(), TScene::dt, j, nbWarmUpSteps, histograms[i]);
+                }
+            });
+        parallelDuration += Seconds(Clock::now() - begin).count();
+    }
+
+    for (auto& root : roots)
+    {
+        sofa::simulation::node::unload(root);
+    }
+
+    LatencyHistogram histogram;
+    for (const auto& h : histograms)
+    {
+        histogram.merge(h);
+    }
+
+    state.counters["FPS"] = benchmark::Counter(TScene::nbSteps * nbSimulations, benchmark::Counter::kIsIterationInvariantRate);
+    setLatencyCounters(state, histogram);
+    state.counters["efficiency"] = singleDuration * static_cast<double>(state.iterations()) / parallelDuration;
+
+    affinity.reset();
+
+    // The next benchmarks of the process run with the task scheduler as it was before this one
+    if (previousThreadCount > 0)
+        taskScheduler->init(previousThreadCount);
+    else
+        taskScheduler->stop();
+
+    sofa::simulation::graph::cleanup();
+}
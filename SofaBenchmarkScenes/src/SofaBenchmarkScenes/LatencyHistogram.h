@@ -0,0 +1,128 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+/**
+ * Histogram of durations, in the spirit of HdrHistogram.
+ *
+ * The buckets follow a log-linear distribution: each power of two is divided into a fixed number of
+ * linear sub-buckets. The relative error on a recorded value is then bounded by 1 / 2^(SubBucketBits-1),
+ * whatever the order of magnitude of the value, and the memory is fixed.
+ * Recording a value is a couple of bit operations and an increment, so it can be done for each time
+ * step without disturbing the measure.
+ *
+ * Values are durations in nanoseconds.
+ */
+class LatencyHistogram
+{
+public:
+    static constexpr unsigned int SubBucketBits = 7;
+
+    LatencyHistogram()
+        : m_counts(NbBuckets, 0)
+    {}
+
+    void record(std::uint64_t nanoseconds)
+    {
+        ++m_counts[bucketIndex(nanoseconds)];
+        ++m_totalCount;
+        m_min = std::min(m_min, nanoseconds);
+        m_max = std::max(m_max, nanoseconds);
+    }
+
+    /// Add all the values recorded in another histogram
+    void merge(const LatencyHistogram& other)
+    {
+        for (std::size_t i = 0; i < NbBuckets; ++i)
+        {
+            m_counts[i] += other.m_counts[i];
+        }
+        m_totalCount += other.m_totalCount;
+        m_min = std::min(m_min, other.m_min);
+        m_max = std::max(m_max, other.m_max);
+    }
+
+    void clear()
+    {
+        std::fill(m_counts.begin(), m_counts.end(), 0);
+        m_totalCount = 0;
+        m_min = std::numeric_limits<std::uint64_t>::max();
+        m_max = 0;
+    }
+
+    /// Value below which a given percentage of the recorded values falls (percentile between 0 and 100)
+    /// The returned value is the highest value equivalent to the bucket, so it is never underestimated.
+    std::uint64_t percentile(double percentile) const
+    {
+        if (m_totalCount == 0)
+        {
+            return 0;
+        }
+
+        const auto target = std::max<std::uint64_t>(1,
+            static_cast<std::uint64_t>(percentile / 100. * static_cast<double>(m_totalCount) + 0.5));
+
+        std::uint64_t cumulated = 0;
+        for (std::size_t i = 0; i < NbBuckets; ++i)
+        {
+            cumulated += m_counts[i];
+            if (cumulated >= target)
+            {
+                return std::clamp(highestEquivalentValue(i), m_min, m_max);
+            }
+        }
+        return m_max;
+    }
+
+    std::uint64_t min() const { return m_totalCount ? m_min : 0; }
+    std::uint64_t max() const { return m_max; }
+    std::uint64_t totalCount() const { return m_totalCount; }
+
+private:
+    static constexpr std::uint64_t SubBucketCount = std::uint64_t{1} << SubBucketBits;
+    static constexpr std::uint64_t SubBucketHalfCount = SubBucketCount / 2;
+    static constexpr std::size_t NbBuckets = (64 - SubBucketBits + 2) * SubBucketHalfCount;
+
+    static unsigned int mostSignificantBit(std::uint64_t value)
+    {
+        unsigned int msb = 0;
+        while (value >>= 1)
+        {
+            ++msb;
+        }
+        return msb;
+    }
+
+    /// Values lower than SubBucketCount are stored exactly.
+    /// Above, a value is decomposed into an exponent e and a mantissa m in [SubBucketHalfCount, SubBucketCount[
+    /// such that value ~ m * 2^e
+    static std::size_t bucketIndex(std::uint64_t value)
+    {
+        if (value < SubBucketCount)
+        {
+            return static_cast<std::size_t>(value);
+        }
+        const auto exponent = mostSignificantBit(value) - (SubBucketBits - 1);
+        const auto mantissa = value >> exponent;
+        return static_cast<std::size_t>(exponent * SubBucketHalfCount + mantissa);
+    }
+
+    static std::uint64_t highestEquivalentValue(std::size_t index)
+    {
+        if (index < SubBucketCount)
+        {
+            return index;
+        }
+        const auto exponent = index / SubBucketHalfCount - 1;
+        const auto mantissa = index - exponent * SubBucketHalfCount;
+        return ((mantissa + 1) << exponent) - 1;
+    }
+
+    std::vector<std::uint64_t> m_counts;
+    std::uint64_t m_totalCount { 0 };
+    std::uint64_t m_min { std::numeric_limits<std::uint64_t>::max() };
+    std::uint64_t m_max { 0 };
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <sofa/simulation/Node.h>
+#include <sofa/simulation/Simulation.h>
+#include <sofa/core/behavior/BaseMechanicalState.h>
+#include <sofa/core/VecId.h>
+#include <sofa/linearalgebra/FullVector.h>
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+/**
+ * Snapshot of an initialized scene graph, restored in place between benchmark iterations.
+ *
+ * Loading a scene from XML and initializing it can be much more expensive than the measured
+ * time steps. Instead of reloading the scene, the snapshot is taken once after the initialization,
+ * and restoring it:
+ * - resets all the components (same as the Reset button of the GUI), so that internal states
+ * (time, solvers, force fields) go back to their initial values,
+ * - overwrites the state vectors of all the mechanical states with the values captured after the
+ * initialization.
+ * The components are not destroyed, so the topology, the mass and the structures of the assembled
+ * matrices computed during the initialization are kept.
+ *
+ * A snapshot cannot be restored if the number of degrees of freedom changed since it has been
+ * taken (topological changes). In this case, restore() returns false and the scene must be reloaded.
+ */
+class SceneSnapshot
+{
+public:
+    explicit SceneSnapshot(sofa::simulation::Node* root)
+        : m_root(root)
+    {
+        std::vector<sofa::core::behavior::BaseMechanicalState*> mstates;
+        m_root->getTreeObjects<sofa::core::behavior::BaseMechanicalState>(&mstates);
+
+        for (auto* mstate : mstates)
+        {
+            StateRecord record;
+            record.mstate = mstate;
+            record.size = mstate->getSize();
+
+            const auto dimension = std::max(mstate->getCoordDimension(), mstate->getDerivDimension());
+            for (std::size_t i = 0; i < vecIds().size(); ++i)
+            {
+                record.values[i].resize(record.size * dimension);
+                unsigned int offset = 0;
+                mstate->copyToBaseVector(&record.values[i], vecIds()[i], offset);
+            }
+
+            m_records.push_back(std::move(record));
+        }
+    }
+
+    /// Restore the scene in the state it was when the snapshot has been taken
+    /// Returns false if the snapshot cannot be applied to the current scene
+    bool restore() const
+    {
+        sofa::simulation::node::reset(m_root);
+
+        for (const auto& record : m_records)
+        {
+            if (record.mstate->getSize() != record.size)
+            {
+                return false;
+            }
+
+            for (std::size_t i = 0; i < vecIds().size(); ++i)
+            {
+                unsigned int offset = 0;
+                record.mstate->copyFromBaseVector(vecIds()[i], &record.values[i], offset);
+            }
+        }
+        return true;
+    }
+
+    std::size_t getNbMechanicalStates() const { return m_records.size(); }
+
+private:
+
+    /// The state vectors saved in the snapshot
+    static const std::array<sofa::core::VecId, 3>& vecIds()
+    {
+        static const std::array<sofa::core::VecId, 3> ids {
+            sofa::core::vec_id::write_access::position,
+            sofa::core::vec_id::write_access::restPosition,
+            sofa::core::vec_id::write_access::velocity
+        };
+        return ids;
+    }
+
+    struct StateRecord
+    {
+        sofa::core::behavior::BaseMechanicalState* mstate { nullptr };
+        sofa::Size size { 0 };
+        std::array<sofa::linearalgebra::FullVector<SReal>, 3> values;
+    };
+
+    sofa::simulation::Node* m_root { nullptr };
+    std::vector<StateRecord> m_records;
+};
@@ -179,3 +179,8 @@ BENCHMARK_TEMPLATE1(BM_Scene_bench_StepFactor, TetrahedronFEMForceFieldScene)->R
 BENCHMARK_TEMPLATE1(BM_Scene_bench_StepFactor, TetrahedralFEMForceFieldScene)->RangeMultiplier(stepNbSteps)->Ranges({ {minNbSteps, maxNbSteps} })->Unit(benchmark::kMillisecond);
 
 BENCHMARK_TEMPLATE1(BM_Scene_bench_StepFactor, TetrahedralFEMForceFieldOptimScene)->RangeMultiplier(stepNbSteps)->Ranges({ {minNbSteps, maxNbSteps} })->Unit(benchmark::kMillisecond);
+
+// Measure multiple simulations running in parallel
+const int64_t maxNbParallelSimulations = std::thread::hardware_concurrency();
+
+BENCHMARK_TEMPLATE1(BM_Scene_bench_ParallelSimulations, TetrahedronFEMForceFieldScene)->RangeMultiplier(2)->Ranges({ {1, maxNbParallelSimulations} })->UseRealTime()->Unit(benchmark::kMillisecond);
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <sofa/component/linearsolver/iterative/MatrixLinearSolver.h>
+#include <sofa/helper/ScopedAdvancedTimer.h>
+#include <sofa/linearalgebra/CompressedRowSparseMatrix.h>
+#include <sofa/linearalgebra/FullVector.h>
+#include <sofa/simulation/MainTaskSchedulerFactory.h>
+
+#include <utils/MatrixIO.h>
+#include <utils/SupernodalLDLT.h>
+
+#include <Eigen/Dense>
+#include <Eigen/IterativeLinearSolvers>
+
+#include <string>
+#include <vector>
+
+/**
+ * Preconditioner for ShewchukPCGLinearSolver, computed from the assembled system matrix with one of the methods:
+ * - Jacobi: inverse of the diagonal
+ * - BlockJacobi: inverses of the 3x3 diagonal blocks (one per node). If the size of the system is not a multiple
+ *   of 3, the last entries are preconditioned with the inverse of their diagonal.
+ * - IncompleteCholesky: Eigen::IncompleteCholesky with an AMD ordering
+ * - LDL: complete LDL^T factorization (SupernodalLDLT)
+ * The refresh of the preconditioner is controlled by the Data update_step and build_precond of the
+ * ShewchukPCGLinearSolver: the system matrix is assembled (MBKBuild) only at the steps where the PCG refreshes
+ * the preconditioner. At the other steps, the preconditioner is stale: it is not computed again.
+ * AdvancedTimer steps:
+ * - Preconditioner_setup: computation of the preconditioner (only when it is not skipped)
+ * - Preconditioner_apply: application of the preconditioner to a vector
+ */
+template<class TMatrix, class TVector>
+class BenchmarkPreconditioner : public sofa::component::linearsolver::MatrixLinearSolver<TMatrix, TVector>
+{
+public:
+    SOFA_CLASS(SOFA_TEMPLATE2(BenchmarkPreconditioner, TMatrix, TVector), SOFA_TEMPLATE2(sofa::component::linearsolver::MatrixLinearSolver, TMatrix, TVector));
+
+    using Matrix = TMatrix;
+    using Vector = TVector;
+    using EigenVector = Eigen::Matrix<SReal, Eigen::Dynamic, 1>;
+    using ColumnMajorMatrix = Eigen::SparseMatrix<SReal, Eigen::ColMajor, int>;
+
+    sofa::core::objectmodel::Data<std::string> d_method;
+
+    /// The method is resolved once, not at each application of the preconditioner
+    void init() override
+    {
+        Inherit1::init();
+        m_method = parseMethod(d_method.getValue());
+    }
+
+    /// Called by the PCG only at the steps where it refreshes the preconditioner
+    void setSystemMBKMatrix(const sofa::core::MechanicalParams* mparams) override
+    {
+        Inherit1::setSystemMBKMatrix(mparams);
+        m_isMatrixAssembled = true;
+    }
+
+    /// Called at each step (updateSystemMatrix): the preconditioner is computed only if the matrix was assembled
+    /// since the last computation
+    void invert(Matrix& M) override
+    {
+        const bool isStale = !m_isMatrixAssembled && static_cast<Eigen::Index>(M.rowSize()) == m_size;
+        if (isStale)
+            return;
+
+        sofa::helper::ScopedAdvancedTimer timer("Preconditioner_setup");
+        m_isMatrixAssembled = false;
+
+        const auto matrix = matrixio::toEigen(M);
+        m_size = matrix.rows();
+        switch (m_method)
+        {
+        case Method::Jacobi:
+            setupJacobi(matrix);
+            break;
+        case Method::BlockJacobi:
+            setupBlockJacobi(matrix);
+            break;
+        case Method::IncompleteCholesky:
+            setupIncompleteCholesky(matrix);
+            break;
+        case Method::LDL:
+            setupLDL(matrix);
+            break;
+        case Method::Identity:
+            break;
+        }
+    }
+
+    void solve(Matrix& /* M */, Vector& x, Vector& b) override
+    {
+        sofa::helper::ScopedAdvancedTimer timer("Preconditioner_apply");
+
+        const Eigen::Map<const EigenVector> rhs(b.ptr(), m_size);
+        Eigen::Map<EigenVector> solution(x.ptr(), m_size);
+
+        switch (m_method)
+        {
+        case Method::Jacobi:
+            solution = m_inverseDiagonal.cwiseProduct(rhs);
+            break;
+        case Method::BlockJacobi:
+        {
+            const auto nbBlocks = static_cast<Eigen::Index>(m_inverseBlocks.size());
+            for (Eigen::Index i = 0; i < nbBlocks; ++i)
+                solution.template segment<3>(3 * i) = m_inverseBlocks[i] * rhs.template segment<3>(3 * i);
+            const auto nbRemaining = m_size - 3 * nbBlocks;
+            solution.tail(nbRemaining) = m_inverseDiagonal.cwiseProduct(rhs.tail(nbRemaining));
+            break;
+        }
+        case Method::IncompleteCholesky:
+            solution = m_incompleteCholesky.solve(rhs);
+            break;
+        case Method::LDL:
+        {
+            EigenVector result;
+            m_ldlt.solve(rhs, result);
+            solution = result;
+            break;
+        }
+        case Method::Identity:
+            solution = rhs;
+            break;
+        }
+    }
+
+protected:
+    BenchmarkPreconditioner()
+        : d_method(this->initData(&d_method, std::string("Jacobi"), "method", "Preconditioner: Jacobi, BlockJacobi, IncompleteCholesky or LDL"))
+    {}
+
+    enum class Method
+    {
+        Jacobi,
+        BlockJacobi,
+        IncompleteCholesky,
+        LDL,
+        Identity ///< unknown method: the preconditioner is not applied
+    };
+
+    Method parseMethod(const std::string& method)
+    {
+        if (method == "Jacobi")
+            return Method::Jacobi;
+        if (method == "BlockJacobi")
+            return Method::BlockJacobi;
+        if (method == "IncompleteCholesky")
+            return Method::IncompleteCholesky;
+        if (method == "LDL")
+            return Method::LDL;
+        msg_error() << "Unknown method '" << method << "': Jacobi, BlockJacobi, IncompleteCholesky or LDL";
+        return Method::Identity;
+    }
+
+    void setupJacobi(const matrixio::Matrix& matrix)
+    {
+        m_inverseDiagonal = matrix.diagonal();
+        for (Eigen::Index i = 0; i < m_inverseDiagonal.size(); ++i)
+            m_inverseDiagonal[i] = m_inverseDiagonal[i] != 0 ? 1 / m_inverseDiagonal[i] : 1;
+    }
+
+    void setupBlockJacobi(const matrixio::Matrix& matrix)
+    {
+        const auto nbBlocks = matrix.rows() / 3;
+        m_inverseBlocks.assign(nbBlocks, Eigen::Matrix<SReal, 3, 3>::Zero());
+        m_inverseDiagonal.setZero(matrix.rows() - 3 * nbBlocks);
+        for (Eigen::Index i = 0; i < matrix.outerSize(); ++i)
+        {
+            for (matrixio::Matrix::InnerIterator it(matrix, i); it; ++it)
+            {
+                if (i >= 3 * nbBlocks)
+                {
+                    if (it.col() == i)
+                        m_inverseDiagonal[i - 3 * nbBlocks] = it.value();
+                }
+                else if (it.col() / 3 == i / 3)
+                {
+                    m_inverseBlocks[i / 3](i % 3, it.col() % 3) = it.value();
+                }
+            }
+        }
+        for (auto& block : m_inverseBlocks)
+            block = block.inverse().eval();
+        for (Eigen::Index i = 0; i < m_inverseDiagonal.size(); ++i)
+            m_inverseDiagonal[i] = m_inverseDiagonal[i] != 0 ? 1 / m_inverseDiagonal[i] : 1;
+    }
+
+    void setupIncompleteCholesky(const matrixio::Matrix& matrix)
+    {
+        const ColumnMajorMatrix lower = matrix.template triangularView<Eigen::Lower>();
+        m_incompleteCholesky.compute(lower);
+        if (m_incompleteCholesky.info() != Eigen::Success)
+            msg_error() << "The incomplete Cholesky factorization failed";
+    }
+
+    void setupLDL(const matrixio::Matrix& matrix)
+    {
+        ColumnMajorMatrix lower = matrix.template triangularView<Eigen::Lower>();
+        lower.makeCompressed();
+        if (!m_ldlt.hasSymbolic() || m_ldlt.hasPatternChanged(lower))
+            m_ldlt.analyzePattern(lower);
+
+        auto* taskScheduler = sofa::simulation::MainTaskSchedulerFactory::createInRegistry();
+        if (taskScheduler->getThreadCount() < 1)
+            taskScheduler->init(0);
+        if (!m_ldlt.factorize(*taskScheduler, lower))
+            msg_error() << "The LDL^T factorization failed: zero pivot";
+    }
+
+    Method m_method { Method::Jacobi };
+    Eigen::Index m_size { 0 };
+    bool m_isMatrixAssembled { false };
+
+    /// Jacobi: inverse of the diagonal. BlockJacobi: inverse of the diagonal of the entries after the last block.
+    EigenVector m_inverseDiagonal;
+    std::vector<Eigen::Matrix<SReal, 3, 3> > m_inverseBlocks;
+    Eigen::IncompleteCholesky<SReal, Eigen::Lower, Eigen::AMDOrdering<int> > m_incompleteCholesky;
+    SupernodalLDLT<SReal> m_ldlt;
+};
@@ -0,0 +1,132 @@
+#include <SofaBenchmarkScenes/BenchScene.h>
+#include <SofaBenchmarkScenes/BeamSceneBuilder.h>
+
+#include <sofa/linearalgebra/FullVector.h>
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+/**
+ * CGLinearSolver without assembly (GraphScattered template: the products go through the scene graph)
+ * versus with an assembled matrix (CompressedRowSparseMatrixMat3x3d template), on the hexahedral beam of
+ * BeamSceneBuilder from ~1k to ~200k DOFs. Same comparison as python/run.py, without SofaPython3.
+ *
+ * The CG stops at the tolerance or after cgBeamMaxIterations iterations. The cap bounds the duration of a run
+ * on the largest beams, where the unpreconditioned CG needs thousands of iterations: the time steps stopped
+ * by the cap are not converged, and their iterations do not measure the cost of reaching the tolerance.
+ * Counters, averaged over the time steps:
+ * - buildMs: duration of MBKBuild (assembly of the matrix, 0 without assembly)
+ * - solveMs: duration of MBKSolve
+ * - iterations: number of CG iterations, at most cgBeamMaxIterations
+ * - converged: fraction of the time steps whose CG stopped at the tolerance before the cap (1 if all did)
+ * - residual: largest residual at the end of a CG over the time steps, to compare with the counter tolerance
+ * - iterationMs: solveMs / iterations
+ * - vectorOpsMs: duration of the vector operations of one CG iteration (2 dot products, 3 axpy) on a
+ *   contiguous vector of the same size, measured apart. It is a lower bound: without assembly, the vector
+ *   operations are also visitors of the scene graph.
+ * - spmvMs: iterationMs - vectorOpsMs, i.e. the matrix-vector product and the overhead of the iteration
+ */
+
+constexpr std::size_t nbCGStepsPerIteration = 5;
+constexpr int cgBeamMaxIterations = 1000;
+
+// The largest beam of beamResolutionRange() (~1M DOFs) would take hours without preconditioner
+const std::vector<int64_t> cgBeamResolutionRange(beamResolutionRange().begin(), beamResolutionRange().end() - 1);
+
+/// Duration in seconds of the vector operations of one CG iteration on vectors of n values
+static SReal measureCGVectorOperations(std::size_t n)
+{
+    sofa::linearalgebra::FullVector<SReal> x(n), r(n), p(n), q(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        x[i] = 0;
+        r[i] = static_cast<SReal>(i % 7) * 0.1;
+        p[i] = r[i];
+        q[i] = static_cast<SReal>(i % 5) * 0.2;
+    }
+
+    constexpr int nbRepetitions = 10;
+    SReal best = std::numeric_limits<SReal>::max();
+    for (int rep = 0; rep < nbRepetitions; ++rep)
+    {
+        const auto begin = std::chrono::steady_clock::now();
+
+        SReal den = 0;
+        for (std::size_t i = 0; i < n; ++i)
+            den += p[i] * q[i];
+        const SReal alpha = 1 / (den + 1);
+        for (std::size_t i = 0; i < n; ++i)
+            x[i] += alpha * p[i];
+        for (std::size_t i = 0; i < n; ++i)
+            r[i] -= alpha * q[i];
+        SReal rho = 0;
+        for (std::size_t i = 0; i < n; ++i)
+            rho += r[i] * r[i];
+        const SReal beta = rho / (rho + 1);
+        for (std::size_t i = 0; i < n; ++i)
+            p[i] = r[i] + beta * p[i];
+
+        benchmark::DoNotOptimize(x.ptr());
+        benchmark::DoNotOptimize(p.ptr());
+        const auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<SReal>(end - begin).count());
+    }
+    return best;
+}
+
+static void BM_CGLinearSolver_Beam(benchmark::State& state)
+{
+    auto parameters = BeamSceneParameters::fromState(state);
+    parameters.cgMaxIterations = cgBeamMaxIterations;
+    parameters.cgTolerance = 1e-10;
+
+    const auto load = [&parameters]()
+    {
+        sofa::simulation::Node::SPtr root = createBeamScene(parameters);
+        sofa::simulation::node::initRoot(root.get());
+        return root;
+    };
+
+    enum Step { Build, Solve };
+    static const std::vector<const char*> labels { "MBKBuild", "MBKSolve" };
+
+    std::size_t nbIterations = 0;
+    std::size_t nbConvergedSteps = 0;
+    SReal maxResidual = 0;
+    const auto totals = BM_Scene_bench_Loader(state, load, parameters.dt, nbCGStepsPerIteration, labels,
+        [&nbIterations, &nbConvergedSteps, &maxResidual](sofa::simulation::Node* root)
+        {
+            const auto* solver = root->get<sofa::core::behavior::LinearSolver>(sofa::core::objectmodel::BaseContext::SearchDown);
+            const auto stepIterations = getLastNbIterations(solver);
+            nbIterations += stepIterations;
+            if (stepIterations < static_cast<std::size_t>(cgBeamMaxIterations))
+                ++nbConvergedSteps;
+            maxResidual = std::max(maxResidual, getLastResidual(solver));
+        });
+
+    const SReal avgIterations = totals.nbSteps > 0 ? static_cast<SReal>(nbIterations) / totals.nbSteps : 0;
+    const SReal solveMs = totals.getMsPerStep(Solve);
+    const SReal iterationMs = avgIterations > 0 ? solveMs / avgIterations : 0;
+    const SReal vectorOpsMs = 1e3 * measureCGVectorOperations(parameters.getNbDofs());
+
+    state.SetLabel(parameters.toString());
+    state.counters["nbDofs"] = static_cast<double>(parameters.getNbDofs());
+    state.counters["buildMs"] = totals.getMsPerStep(Build);
+    state.counters["solveMs"] = solveMs;
+    state.counters["iterations"] = avgIterations;
+    state.counters["converged"] = totals.nbSteps > 0 ? static_cast<SReal>(nbConvergedSteps) / totals.nbSteps : 0;
+    state.counters["residual"] = maxResidual;
+    state.counters["tolerance"] = parameters.cgTolerance;
+    state.counters["iterationMs"] = iterationMs;
+    state.counters["vectorOpsMs"] = vectorOpsMs;
+    state.counters["spmvMs"] = std::max<SReal>(0, iterationMs - vectorOpsMs);
+}
+
+BENCHMARK(BM_CGLinearSolver_Beam)->ArgsProduct({
+    cgBeamResolutionRange,
+    {arg(ForceFieldType::HexahedronFEM)},
+    {arg(MassType::Uniform)},
+    {arg(OdeSolverType::EulerImplicit)},
+    {arg(LinearSolverType::CGMatrixFree), arg(LinearSolverType::CGAssembled)}
+})->ArgNames(BeamSceneParameters::argNames())->Iterations(1)->Unit(benchmark::kMillisecond);
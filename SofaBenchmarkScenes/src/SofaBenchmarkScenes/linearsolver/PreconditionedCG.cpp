@@ -0,0 +1,92 @@
+#include <SofaBenchmarkScenes/BenchScene.h>
+#include <SofaBenchmarkScenes/BeamSceneBuilder.h>
+#include <SofaBenchmarkScenes/linearsolver/BenchmarkPreconditioner.h>
+
+#include <sofa/core/ObjectFactory.h>
+
+/**
+ * ShewchukPCGLinearSolver (matrix-free CG) with the preconditioners of BenchmarkPreconditioner, on the beam of
+ * BeamSceneBuilder meshed with hexahedra or tetrahedra, to find the cheapest preconditioner for a mesh:
+ * a better preconditioner reduces the number of iterations, but costs more to compute and to apply.
+ * The preconditioner is computed every `interval` time steps (the Data update_step of the PCG), and is stale
+ * in between: the system matrix is not assembled either.
+ * The CG stops at the tolerance. Counters:
+ * - iterations: number of CG iterations per time step
+ * - solveMs: duration of MBKSolve per time step (CG iterations, setup and applications of the preconditioner)
+ * - iterationMs: solveMs / iterations
+ * - buildMs: duration of MBKBuild per time step (assembly of the matrix of the preconditioner)
+ * - setupMs: duration of one computation of the preconditioner (e.g. refactorization)
+ * - setupsPerStep: number of computations of the preconditioner per time step
+ * - applyMs: duration of one application of the preconditioner
+ */
+
+static int BenchmarkPreconditionerClass = sofa::core::RegisterObject("Preconditioner (Jacobi, block Jacobi, incomplete Cholesky or LDL^T) for ShewchukPCGLinearSolver")
+    .add<BenchmarkPreconditioner<sofa::linearalgebra::CompressedRowSparseMatrix<SReal>, sofa::linearalgebra::FullVector<SReal> > >(true)
+    .add<BenchmarkPreconditioner<sofa::linearalgebra::CompressedRowSparseMatrix<sofa::type::Mat<3, 3, SReal> >, sofa::linearalgebra::FullVector<SReal> > >();
+
+constexpr std::size_t nbPCGStepsPerIteration = 10;
+
+static void BM_PCGLinearSolver_Beam(benchmark::State& state)
+{
+    auto parameters = BeamSceneParameters::fromState(state);
+    parameters.cgMaxIterations = 10000;
+    parameters.cgTolerance = 1e-10;
+
+    const auto load = [&parameters]()
+    {
+        sofa::simulation::Node::SPtr root = createBeamScene(parameters);
+        sofa::simulation::node::initRoot(root.get());
+        return root;
+    };
+
+    enum Step { Build, Solve, Setup, Apply };
+    static const std::vector<const char*> labels { "MBKBuild", "MBKSolve", "Preconditioner_setup", "Preconditioner_apply" };
+
+    std::size_t nbIterations = 0;
+    const auto totals = BM_Scene_bench_Loader(state, load, parameters.dt, nbPCGStepsPerIteration, labels,
+        [&nbIterations](sofa::simulation::Node* root)
+        {
+            nbIterations += getLastNbIterations(root->getChild("Beam")->getObject("pcg"));
+        });
+
+    const SReal avgIterations = totals.nbSteps > 0 ? static_cast<SReal>(nbIterations) / totals.nbSteps : 0;
+    const SReal solveMs = totals.getMsPerStep(Solve);
+
+    state.SetLabel(parameters.toString());
+    state.counters["nbDofs"] = static_cast<double>(parameters.getNbDofs());
+    state.counters["iterations"] = avgIterations;
+    state.counters["solveMs"] = solveMs;
+    state.counters["iterationMs"] = avgIterations > 0 ? solveMs / avgIterations : 0;
+    state.counters["buildMs"] = totals.getMsPerStep(Build);
+    state.counters["setupMs"] = totals.getMsPerCall(Setup);
+    state.counters["setupsPerStep"] = totals.getCallsPerStep(Setup);
+    state.counters["applyMs"] = totals.getMsPerCall(Apply);
+}
+
+/// All the preconditioners on both meshes, the stale ones being refreshed every 5 time steps
+static void pcgBeamArguments(benchmark::internal::Benchmark* benchmark)
+{
+    static const std::vector<int64_t> resolutions { 4, 6, 10, 16 };
+    static const std::vector<ForceFieldType> forceFields { ForceFieldType::HexahedronFEM, ForceFieldType::TetrahedronFEM };
+    static const std::vector<PreconditionerType> preconditioners { PreconditionerType::None, PreconditionerType::Jacobi,
+        PreconditionerType::BlockJacobi, PreconditionerType::IncompleteCholesky, PreconditionerType::LDL };
+
+    for (const auto resolution : resolutions)
+    {
+        for (const auto forceField : forceFields)
+        {
+            for (const auto preconditioner : preconditioners)
+            {
+                for (const int64_t interval : { 1, 5 })
+                {
+                    if (preconditioner == PreconditionerType::None && interval != 1)
+                        continue;
+                    benchmark->Args({ resolution, arg(forceField), arg(MassType::Uniform), arg(OdeSolverType::EulerImplicit),
+                        arg(LinearSolverType::PCG), arg(preconditioner), interval });
+                }
+            }
+        }
+    }
+}
+
+BENCHMARK(BM_PCGLinearSolver_Beam)->Apply(pcgBeamArguments)->ArgNames(BeamSceneParameters::preconditionerArgNames())->Iterations(1)->Unit(benchmark::kMillisecond);
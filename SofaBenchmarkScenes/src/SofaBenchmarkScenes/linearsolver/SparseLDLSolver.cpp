@@ -53,6 +53,11 @@ constexpr int64_t stepNbSteps = 2;
 
 BENCHMARK_TEMPLATE1(BM_Scene_bench_StepFactor, SparseLDLSolverScene)->RangeMultiplier(stepNbSteps)->Ranges({ {minNbSteps, maxNbSteps} })->Unit(benchmark::kMillisecond);
 
+// Measure multiple simulations running in parallel
+const int64_t maxNbParallelSimulations = std::thread::hardware_concurrency();
+
+BENCHMARK_TEMPLATE1(BM_Scene_bench_ParallelSimulations, SparseLDLSolverScene)->RangeMultiplier(2)->Ranges({ {1, maxNbParallelSimulations} })->UseRealTime()->Unit(benchmark::kMillisecond);
+
 
 void BM_SparseLDLSolver(benchmark::State& state)
 {
@@ -0,0 +1,60 @@
+#include <SofaBenchmarkScenes/BenchScene.h>
+#include <SofaBenchmarkScenes/BeamSceneBuilder.h>
+#include <SofaBenchmarkScenes/linearsolver/SupernodalLDLSolver.h>
+
+#include <sofa/core/ObjectFactory.h>
+
+#include <array>
+
+/**
+ * SparseLDLSolver (simplicial factorization) versus SupernodalLDLSolver on the hexahedral beam of
+ * BeamSceneBuilder, sweeping the resolution of the grid. Counters, in milliseconds per call:
+ * - buildMs: MBKBuild (assembly of the system matrix)
+ * - solveMs: MBKSolve (factorization and solve, for both solvers)
+ * - copyMs, analyzeMs, factorizeMs, substitutionMs: steps of SupernodalLDLSolver, not reported for
+ *   SparseLDLSolver which does not have the same AdvancedTimer steps. The analysis is done only in the first
+ *   time step, the sparsity of the matrix being constant.
+ */
+
+static int SupernodalLDLSolverClass = sofa::core::RegisterObject("Direct linear solver based on a supernodal LDL^T factorization")
+    .add<SupernodalLDLSolver<sofa::linearalgebra::CompressedRowSparseMatrix<SReal>, sofa::linearalgebra::FullVector<SReal> > >(true)
+    .add<SupernodalLDLSolver<sofa::linearalgebra::CompressedRowSparseMatrix<sofa::type::Mat<3, 3, SReal> >, sofa::linearalgebra::FullVector<SReal> > >();
+
+constexpr std::size_t nbLDLStepsPerIteration = 5;
+
+const std::vector<int64_t> ldlBeamResolutionRange { 4, 6, 10, 16 };
+
+static void BM_SupernodalLDLSolver_Beam(benchmark::State& state)
+{
+    const auto parameters = BeamSceneParameters::fromState(state);
+
+    const auto load = [&parameters]()
+    {
+        sofa::simulation::Node::SPtr root = createBeamScene(parameters);
+        sofa::simulation::node::initRoot(root.get());
+        return root;
+    };
+
+    static const std::vector<const char*> labels { "MBKBuild", "MBKSolve", "SupernodalLDL_copy", "SupernodalLDL_analyze", "SupernodalLDL_factorize", "SupernodalLDL_solve" };
+    static const std::array<const char*, 6> counterNames { "buildMs", "solveMs", "copyMs", "analyzeMs", "factorizeMs", "substitutionMs" };
+
+    const auto totals = BM_Scene_bench_Loader(state, load, parameters.dt, nbLDLStepsPerIteration, labels, [](sofa::simulation::Node*) {});
+
+    state.SetLabel(parameters.toString());
+    state.counters["nbDofs"] = static_cast<double>(parameters.getNbDofs());
+
+    // MBKBuild and MBKSolve are common to both solvers, the other steps are only timed by SupernodalLDLSolver
+    const std::size_t nbCounters = parameters.linearSolver == LinearSolverType::SupernodalLDL ? labels.size() : 2;
+    for (std::size_t l = 0; l < nbCounters; ++l)
+    {
+        state.counters[counterNames[l]] = totals.getMsPerCall(l);
+    }
+}
+
+BENCHMARK(BM_SupernodalLDLSolver_Beam)->ArgsProduct({
+    ldlBeamResolutionRange,
+    {arg(ForceFieldType::HexahedronFEM)},
+    {arg(MassType::Uniform)},
+    {arg(OdeSolverType::EulerImplicit)},
+    {arg(LinearSolverType::SparseLDL), arg(LinearSolverType::SupernodalLDL)}
+})->ArgNames(BeamSceneParameters::argNames())->Iterations(1)->Unit(benchmark::kMillisecond);
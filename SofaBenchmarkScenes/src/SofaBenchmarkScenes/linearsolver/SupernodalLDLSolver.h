@@ -0,0 +1,75 @@
+#pragma once
+
+#include <sofa/component/linearsolver/iterative/MatrixLinearSolver.h>
+#include <sofa/helper/ScopedAdvancedTimer.h>
+#include <sofa/linearalgebra/CompressedRowSparseMatrix.h>
+#include <sofa/linearalgebra/FullVector.h>
+#include <sofa/simulation/MainTaskSchedulerFactory.h>
+
+#include <utils/MatrixIO.h>
+#include <utils/SupernodalLDLT.h>
+
+/**
+ * Direct linear solver based on SupernodalLDLT, with the same templates as SparseLDLSolver (e.g.
+ * CompressedRowSparseMatrixMat3x3d), to compare the supernodal factorization to the simplicial one of
+ * SparseLDLSolver in the same scenes. The analysis is done again only if the sparsity of the system matrix
+ * changes. The factorization runs on the main task scheduler.
+ * AdvancedTimer steps:
+ * - SupernodalLDL_copy: conversion of the system matrix
+ * - SupernodalLDL_analyze: symbolic analysis
+ * - SupernodalLDL_factorize: numeric factorization
+ * - SupernodalLDL_solve: forward and backward substitutions
+ */
+template<class TMatrix, class TVector>
+class SupernodalLDLSolver : public sofa::component::linearsolver::MatrixLinearSolver<TMatrix, TVector>
+{
+public:
+    SOFA_CLASS(SOFA_TEMPLATE2(SupernodalLDLSolver, TMatrix, TVector), SOFA_TEMPLATE2(sofa::component::linearsolver::MatrixLinearSolver, TMatrix, TVector));
+
+    using Matrix = TMatrix;
+    using Vector = TVector;
+    using Factorization = SupernodalLDLT<SReal>;
+
+    void invert(Matrix& M) override
+    {
+        typename Factorization::Matrix lower;
+        {
+            sofa::helper::ScopedAdvancedTimer timer("SupernodalLDL_copy");
+            const auto matrix = matrixio::toEigen(M);
+            lower = matrix.template triangularView<Eigen::Lower>();
+            lower.makeCompressed();
+        }
+
+        if (!m_factorization.hasSymbolic() || m_factorization.hasPatternChanged(lower))
+        {
+            sofa::helper::ScopedAdvancedTimer timer("SupernodalLDL_analyze");
+            m_factorization.analyzePattern(lower);
+        }
+
+        auto* taskScheduler = sofa::simulation::MainTaskSchedulerFactory::createInRegistry();
+        if (taskScheduler->getThreadCount() < 1)
+            taskScheduler->init(0);
+
+        sofa::helper::ScopedAdvancedTimer timer("SupernodalLDL_factorize");
+        m_isFactorized = m_factorization.factorize(*taskScheduler, lower);
+        if (!m_isFactorized)
+            msg_error() << "The factorization failed: zero pivot";
+    }
+
+    void solve(Matrix& /* M */, Vector& x, Vector& b) override
+    {
+        if (!m_isFactorized)
+            return;
+
+        sofa::helper::ScopedAdvancedTimer timer("SupernodalLDL_solve");
+        const auto n = static_cast<Eigen::Index>(b.size());
+        const typename Factorization::Vector rhs = Eigen::Map<const typename Factorization::Vector>(b.ptr(), n);
+        typename Factorization::Vector solution;
+        m_factorization.solve(rhs, solution);
+        Eigen::Map<typename Factorization::Vector>(x.ptr(), n) = solution;
+    }
+
+protected:
+    Factorization m_factorization;
+    bool m_isFactorized { false };
+};
@@ -0,0 +1,62 @@
+#include <SofaBenchmarkScenes/BenchScene.h>
+#include <SofaBenchmarkScenes/BeamSceneBuilder.h>
+
+constexpr std::size_t nbStepsPerIteration = 10;
+
+// Generic benchmark for a beam scene whose size and components are defined by the benchmark arguments
+// (see BeamSceneParameters::fromState)
+static void BM_BeamScene_Scaling(benchmark::State& state)
+{
+    const auto parameters = BeamSceneParameters::fromState(state);
+    const auto load = [&parameters]()
+    {
+        sofa::simulation::Node::SPtr root = createBeamScene(parameters);
+        sofa::simulation::node::initRoot(root.get());
+        return root;
+    };
+
+    BM_Scene_bench_Loader(state, load, parameters.dt, nbStepsPerIteration, {}, [](sofa::simulation::Node*) {});
+
+    state.SetLabel(parameters.toString());
+    state.counters["nbDofs"] = static_cast<double>(parameters.getNbDofs());
+    state.counters["frame"] = benchmark::Counter(nbStepsPerIteration, benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert);
+}
+
+// Direct solvers are limited to ~200k dofs
+const std::vector<int64_t> directSolverResolutionRange(beamResolutionRange().begin(), beamResolutionRange().end() - 1);
+
+// Scaling of the force fields
+BENCHMARK(BM_BeamScene_Scaling)->ArgsProduct({
+    beamResolutionRange(),
+    {arg(ForceFieldType::TetrahedronFEM), arg(ForceFieldType::TetrahedralCorotationalFEM), arg(ForceFieldType::FastTetrahedralCorotational), arg(ForceFieldType::HexahedronFEM)},
+    {arg(MassType::Diagonal)},
+    {arg(OdeSolverType::EulerImplicit)},
+    {arg(LinearSolverType::CGMatrixFree)}
+})->ArgNames(BeamSceneParameters::argNames())->Unit(benchmark::kMillisecond);
+
+// Scaling of the masses
+BENCHMARK(BM_BeamScene_Scaling)->ArgsProduct({
+    beamResolutionRange(),
+    {arg(ForceFieldType::TetrahedronFEM)},
+    {arg(MassType::Uniform), arg(MassType::MeshMatrix)},
+    {arg(OdeSolverType::EulerImplicit)},
+    {arg(LinearSolverType::CGMatrixFree)}
+})->ArgNames(BeamSceneParameters::argNames())->Unit(benchmark::kMillisecond);
+
+// Scaling of the ODE solvers
+BENCHMARK(BM_BeamScene_Scaling)->ArgsProduct({
+    beamResolutionRange(),
+    {arg(ForceFieldType::TetrahedronFEM)},
+    {arg(MassType::Diagonal)},
+    {arg(OdeSolverType::Static), arg(OdeSolverType::NewmarkImplicit)},
+    {arg(LinearSolverType::CGAssembled)}
+})->ArgNames(BeamSceneParameters::argNames())->Unit(benchmark::kMillisecond);
+
+// Scaling of the linear solvers
+BENCHMARK(BM_BeamScene_Scaling)->ArgsProduct({
+    directSolverResolutionRange,
+    {arg(ForceFieldType::HexahedronFEM)},
+    {arg(MassType::Uniform)},
+    {arg(OdeSolverType::EulerImplicit)},
+    {arg(LinearSolverType::CGMatrixFree), arg(LinearSolverType::CGAssembled), arg(LinearSolverType::SparseLDL), arg(LinearSolverType::SparseLU)}
+})->ArgNames(BeamSceneParameters::argNames())->Unit(benchmark::kMillisecond);
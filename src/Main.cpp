@@ -2,6 +2,8 @@
 
 #include <sofa/simulation/init.h>
 
+#include <utils/ThreadAffinity.h>
+
 int main(int argc, char** argv)
 {
     char arg0_default[]="benchmark";
@@ -14,6 +16,9 @@ int main(int argc, char** argv)
     ::benchmark::Initialize(&argc, argv);
     if(::benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
 
+    ::benchmark::AddCustomContext("cpu_topology", CpuTopology::get().toString());
+    ::benchmark::AddCustomContext("affinity", toString(affinityPolicyFromEnvironment()));
+
     sofa::simulation::core::init();
 
     ::benchmark::RunSpecifiedBenchmarks();
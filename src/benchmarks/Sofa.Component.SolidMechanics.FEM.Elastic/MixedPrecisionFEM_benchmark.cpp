@@ -0,0 +1,278 @@
+#include <benchmark/benchmark.h>
+#include <sofa/config.h>
+#include <utils/TetrahedronFEMKernel.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+/**
+ * Mixed-precision corotational tetrahedra: the element math (extraction of the rotations, stress, products by
+ * the element stiffness) runs in float with tetrafem::CorotationalTetrahedra<float>, while the positions,
+ * velocities, the accumulation of the nodal forces and the linear solver stay in double.
+ *
+ * BM_MixedPrecisionFEM_Element* measure the throughput of the element kernels alone, in float and in double,
+ * the forces being accumulated in double in both cases.
+ *
+ * BM_MixedPrecisionFEM_Beam simulates the beam of the TetrahedronFEMForceField benchmarks (2m * 2m * 10m nodes,
+ * E = 20000, total mass 320), clamped at z = 0 and bending under gravity, during nbMixedPrecisionSteps time steps
+ * of implicit Euler, solved by a matrix-free conjugate gradient (as EulerImplicitSolver and CGLinearSolver).
+ * Each run simulates the beam in double, the reference, then with the float kernels, so that the speedup and
+ * the error compare simulations of the same run. The CG is solved to the tolerance mixedPrecisionCGTolerance
+ * (the cap on the iterations only guards against a stagnation), so that the error is the one of the precision
+ * and not of a truncated solve: the largest residual shows whether the tolerance was reached.
+ * Counters, for the double (double*) and the mixed-precision (mixed*) simulations:
+ * - stepMs: duration of a time step
+ * - cgIterations: average number of CG iterations per time step
+ * - cgResidual: largest relative residual |r| / |b| at the end of the CG, over the time steps
+ * - speedup: doubleStepMs / mixedStepMs
+ * - maxError: largest distance between the final positions of the two simulations
+ * - relativeError: maxError divided by the largest displacement of the double simulation
+ *
+ * The float kernels only gain from their width when the compiler can use wide vector instructions: this file is
+ * compiled for the build machine with the CMake option SOFABENCHMARK_ENABLE_NATIVE_ARCH. The instruction sets
+ * used by Eigen in this file are written in the context of the output (mixed_precision_simd), "None" or
+ * "SSE, SSE2" meaning that speedup compares float and double on the baseline instruction set.
+ */
+
+using Vec3d = Eigen::Matrix<SReal, 3, 1>;
+
+constexpr std::size_t nbMixedPrecisionSteps = 1000;
+constexpr SReal mixedPrecisionTimeStep = 0.01;
+constexpr std::size_t mixedPrecisionMaxCGIterations = 1000;
+constexpr SReal mixedPrecisionCGTolerance = 1e-9;
+
+static const bool mixedPrecisionContextAdded = []()
+{
+    benchmark::AddCustomContext("mixed_precision_simd", Eigen::SimdInstructionSetsInUse());
+    return true;
+}();
+
+static tetrafem::TwistedBeam createMixedPrecisionBeam(int64_t multiplier)
+{
+    return tetrafem::createTwistedBeam(static_cast<sofa::Index>(2 * multiplier), static_cast<sofa::Index>(2 * multiplier),
+        static_cast<sofa::Index>(10 * multiplier));
+}
+
+static SReal dot(const std::vector<Vec3d>& a, const std::vector<Vec3d>& b)
+{
+    SReal result = 0;
+    for (std::size_t i = 0; i < a.size(); ++i)
+        result += a[i].dot(b[i]);
+    return result;
+}
+
+/// Beam clamped at z = 0 under gravity, with the element math in TReal and everything else in double
+template<class TReal>
+class CorotationalBeamSimulation
+{
+public:
+    explicit CorotationalBeamSimulation(const tetrafem::TwistedBeam& beam)
+        : m_x(beam.restPositions)
+        , m_v(beam.restPositions.size(), Vec3d::Zero())
+    {
+        m_fem.init(beam.restPositions, beam.tetrahedra, 20000, static_cast<TReal>(0.3));
+        m_nodeMass = 320 / static_cast<SReal>(m_x.size());
+        for (const auto& p : beam.restPositions)
+            m_isFixed.push_back(p.z() < 1e-6);
+
+        for (auto* v : { &m_f, &m_b, &m_dv, &m_r, &m_p, &m_q })
+            v->resize(m_x.size());
+    }
+
+    const std::vector<Vec3d>& getPositions() const { return m_x; }
+    std::size_t getNbCGIterations() const { return m_nbCGIterations; }
+    SReal getMaxCGResidual() const { return m_maxCGResidual; }
+
+    void step()
+    {
+        const SReal h = mixedPrecisionTimeStep;
+
+        // b = h f(x) + h^2 df/dx v, the rotations being updated by the computation of f
+        std::fill(m_f.begin(), m_f.end(), Vec3d(0, -9.81 * m_nodeMass, 0));
+        for (std::size_t e = 0; e < m_fem.getNbElements(); ++e)
+            m_fem.computeElementForce(e, m_x, [this](sofa::Index n, const auto& f) { m_f[n] += f.template cast<SReal>(); });
+        addDForce(m_v, h * h, m_b, true);
+        for (std::size_t n = 0; n < m_b.size(); ++n)
+            m_b[n] += h * m_f[n];
+        project(m_b);
+
+        solve();
+
+        for (std::size_t n = 0; n < m_x.size(); ++n)
+        {
+            m_v[n] += m_dv[n];
+            m_x[n] += h * m_v[n];
+        }
+    }
+
+private:
+    /// df = -kFactor K dx, accumulated in double. The result is cleared first if clear is true.
+    void addDForce(const std::vector<Vec3d>& dx, SReal kFactor, std::vector<Vec3d>& df, bool clear) const
+    {
+        if (clear)
+            std::fill(df.begin(), df.end(), Vec3d::Zero());
+        for (std::size_t e = 0; e < m_fem.getNbElements(); ++e)
+            m_fem.computeElementDForce(e, dx, static_cast<TReal>(kFactor), [&df](sofa::Index n, const auto& f) { df[n] += f.template cast<SReal>(); });
+    }
+
+    void project(std::vector<Vec3d>& v) const
+    {
+        for (std::size_t n = 0; n < v.size(); ++n)
+            if (m_isFixed[n])
+                v[n].setZero();
+    }
+
+    /// (M - h^2 df/dx) dv = b by a conjugate gradient
+    void solve()
+    {
+        const SReal h2 = mixedPrecisionTimeStep * mixedPrecisionTimeStep;
+        const auto multiply = [this, h2](const std::vector<Vec3d>& p, std::vector<Vec3d>& q)
+        {
+            addDForce(p, h2, q, true);
+            for (std::size_t n = 0; n < p.size(); ++n)
+                q[n] = m_nodeMass * p[n] - q[n];
+            project(q);
+        };
+
+        std::fill(m_dv.begin(), m_dv.end(), Vec3d::Zero());
+        m_r = m_b;
+        m_p = m_r;
+        SReal rr = dot(m_r, m_r);
+        const SReal bb = rr;
+        const SReal threshold = mixedPrecisionCGTolerance * mixedPrecisionCGTolerance * bb;
+        for (std::size_t it = 0; it < mixedPrecisionMaxCGIterations && rr > threshold; ++it)
+        {
+            multiply(m_p, m_q);
+            const SReal alpha = rr / dot(m_p, m_q);
+            for (std::size_t n = 0; n < m_dv.size(); ++n)
+            {
+                m_dv[n] += alpha * m_p[n];
+                m_r[n] -= alpha * m_q[n];
+            }
+            const SReal rrNew = dot(m_r, m_r);
+            for (std::size_t n = 0; n < m_p.size(); ++n)
+                m_p[n] = m_r[n] + (rrNew / rr) * m_p[n];
+            rr = rrNew;
+            ++m_nbCGIterations;
+        }
+        if (bb > 0)
+            m_maxCGResidual = std::max(m_maxCGResidual, std::sqrt(rr / bb));
+    }
+
+    tetrafem::CorotationalTetrahedra<TReal> m_fem;
+    SReal m_nodeMass { 0 };
+    std::vector<bool> m_isFixed;
+
+    std::vector<Vec3d> m_x;
+    std::vector<Vec3d> m_v;
+    std::size_t m_nbCGIterations { 0 };
+    SReal m_maxCGResidual { 0 };
+
+    // Work vectors
+    std::vector<Vec3d> m_f, m_b, m_dv, m_r, m_p, m_q;
+};
+
+template<class TReal>
+static void BM_MixedPrecisionFEM_ElementForce(benchmark::State& state)
+{
+    const auto beam = createMixedPrecisionBeam(state.range(0));
+    tetrafem::CorotationalTetrahedra<TReal> fem;
+    fem.init(beam.restPositions, beam.tetrahedra, 4000, static_cast<TReal>(0.3));
+
+    std::vector<Vec3d> forces(beam.positions.size());
+    for (auto _ : state)
+    {
+        std::fill(forces.begin(), forces.end(), Vec3d::Zero());
+        for (std::size_t e = 0; e < fem.getNbElements(); ++e)
+            fem.computeElementForce(e, beam.positions, [&forces](sofa::Index n, const auto& f) { forces[n] += f.template cast<SReal>(); });
+        benchmark::ClobberMemory();
+    }
+    state.counters["elements"] = benchmark::Counter(static_cast<double>(fem.getNbElements()), benchmark::Counter::kIsIterationInvariantRate);
+}
+
+template<class TReal>
+static void BM_MixedPrecisionFEM_ElementDForce(benchmark::State& state)
+{
+    const auto beam = createMixedPrecisionBeam(state.range(0));
+    tetrafem::CorotationalTetrahedra<TReal> fem;
+    fem.init(beam.restPositions, beam.tetrahedra, 4000, static_cast<TReal>(0.3));
+
+    std::vector<Vec3d> dx(beam.positions.size());
+    for (std::size_t n = 0; n < dx.size(); ++n)
+        dx[n] = beam.positions[n] - beam.restPositions[n];
+    for (std::size_t e = 0; e < fem.getNbElements(); ++e)
+        fem.computeElementForce(e, beam.positions, [](sofa::Index, const auto&) {});
+
+    std::vector<Vec3d> df(beam.positions.size());
+    for (auto _ : state)
+    {
+        std::fill(df.begin(), df.end(), Vec3d::Zero());
+        for (std::size_t e = 0; e < fem.getNbElements(); ++e)
+            fem.computeElementDForce(e, dx, 1, [&df](sofa::Index n, const auto& f) { df[n] += f.template cast<SReal>(); });
+        benchmark::ClobberMemory();
+    }
+    state.counters["elements"] = benchmark::Counter(static_cast<double>(fem.getNbElements()), benchmark::Counter::kIsIterationInvariantRate);
+}
+
+BENCHMARK_TEMPLATE(BM_MixedPrecisionFEM_ElementForce, float)->RangeMultiplier(2)->Ranges({ {1, 8} })->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_MixedPrecisionFEM_ElementForce, double)->RangeMultiplier(2)->Ranges({ {1, 8} })->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_MixedPrecisionFEM_ElementDForce, float)->RangeMultiplier(2)->Ranges({ {1, 8} })->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_MixedPrecisionFEM_ElementDForce, double)->RangeMultiplier(2)->Ranges({ {1, 8} })->Unit(benchmark::kMicrosecond);
+
+using Clock = std::chrono::steady_clock;
+
+struct SimulationResult
+{
+    std::vector<Vec3d> positions;
+    std::size_t nbCGIterations { 0 };
+    SReal maxCGResidual { 0 };
+    double seconds { 0 };
+
+    double getStepMs() const { return 1e3 * seconds / nbMixedPrecisionSteps; }
+    double getCGIterationsPerStep() const { return static_cast<double>(nbCGIterations) / nbMixedPrecisionSteps; }
+};
+
+template<class TReal>
+static SimulationResult simulateBeam(const tetrafem::TwistedBeam& beam)
+{
+    CorotationalBeamSimulation<TReal> simulation(beam);
+    const auto begin = Clock::now();
+    for (std::size_t i = 0; i < nbMixedPrecisionSteps; ++i)
+        simulation.step();
+    const double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    return { simulation.getPositions(), simulation.getNbCGIterations(), simulation.getMaxCGResidual(), seconds };
+}
+
+static void BM_MixedPrecisionFEM_Beam(benchmark::State& state)
+{
+    const auto beam = createMixedPrecisionBeam(state.range(0));
+
+    SimulationResult reference;
+    SimulationResult mixed;
+    for (auto _ : state)
+    {
+        reference = simulateBeam<double>(beam);
+        mixed = simulateBeam<float>(beam);
+    }
+
+    SReal maxError = 0;
+    SReal maxDisplacement = 0;
+    for (std::size_t n = 0; n < reference.positions.size(); ++n)
+    {
+        maxError = std::max(maxError, (mixed.positions[n] - reference.positions[n]).norm());
+        maxDisplacement = std::max(maxDisplacement, (reference.positions[n] - beam.restPositions[n]).norm());
+    }
+
+    state.counters["doubleStepMs"] = reference.getStepMs();
+    state.counters["mixedStepMs"] = mixed.getStepMs();
+    state.counters["doubleCGIterations"] = reference.getCGIterationsPerStep();
+    state.counters["mixedCGIterations"] = mixed.getCGIterationsPerStep();
+    state.counters["doubleCGResidual"] = reference.maxCGResidual;
+    state.counters["mixedCGResidual"] = mixed.maxCGResidual;
+    state.counters["speedup"] = mixed.seconds > 0 ? reference.seconds / mixed.seconds : 0;
+    state.counters["maxError"] = maxError;
+    state.counters["relativeError"] = maxDisplacement > 0 ? maxError / maxDisplacement : 0;
+}
+
+BENCHMARK(BM_MixedPrecisionFEM_Beam)->DenseRange(1, 3)->ArgNames({"multiplier"})->Iterations(1)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,269 @@
+#include <benchmark/benchmark.h>
+#include <sofa/config.h>
+#include <sofa/simulation/MainTaskSchedulerFactory.h>
+#include <sofa/simulation/ParallelForEach.h>
+#include <utils/ElementColoring.h>
+#include <utils/FEMSparsityPattern.h>
+#include <utils/TetrahedronFEMKernel.h>
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <thread>
+#include <vector>
+
+/**
+ * Parallel accumulation of the nodal forces of elements sharing nodes, on the beam of the TetrahedronFEMForceField
+ * benchmarks (corotational tetrahedra of tetrafem::CorotationalTetrahedra). Strategies:
+ * - Sequential: reference, one thread
+ * - GreedyColoring, BalancedColoring: the colors one after the other, the elements of a color in parallel, the
+ *   forces being added directly to the nodes (see ElementColoring.h). The coloring is computed before the
+ *   benchmark, and update() only checks that it is still valid at each iteration.
+ * - Atomic: all the elements in parallel, each component added with a compare-and-swap loop
+ * - ThreadLocal: one force vector per thread, filled by a contiguous range of elements, then summed in parallel
+ *   over the nodes
+ * Kernels:
+ * - Force: addForce, with the computation of the rotations
+ * - DForce: addDForce, with the rotations of the last addForce
+ * Before the timing, the forces of the strategy are compared to the ones of the sequential accumulation: the
+ * benchmark fails if they differ by more than the rounding of the different orders of summation.
+ * Only tetrahedra are benchmarked: there is no hexahedral kernel outside of HexahedronFEMForceField (see
+ * HexahedronFEMForceField_benchmark.cpp). The colorings of hexahedral meshes are measured by BM_ElementColoring.
+ * Counters:
+ * - elements: number of elements processed per second
+ * - colors, imbalance: number of colors, and size of the largest color divided by the average size
+ */
+
+enum class AccumulationStrategy : int64_t { Sequential, GreedyColoring, BalancedColoring, Atomic, ThreadLocal };
+enum class ForceKernel : int64_t { Force, DForce };
+
+using TetrahedronFEM = tetrafem::CorotationalTetrahedra<SReal>;
+using Vec3 = TetrahedronFEM::Vec3;
+
+/// Multipliers of the beam of 2m * 2m * 10m nodes: up to 20480 nodes and 106650 tetrahedra
+const auto forceBeamMultiplierRange = benchmark::CreateRange(1, 8, 2);
+const auto forceThreadNumberRange = benchmark::CreateRange(1, std::thread::hardware_concurrency(), 2);
+
+static tetrafem::TwistedBeam createForceBeam(int64_t multiplier)
+{
+    return tetrafem::createTwistedBeam(static_cast<sofa::Index>(2 * multiplier), static_cast<sofa::Index>(2 * multiplier),
+        static_cast<sofa::Index>(10 * multiplier));
+}
+
+template<class AddForce>
+static void computeElement(TetrahedronFEM& fem, ForceKernel kernel, std::size_t e, const std::vector<Vec3>& x, const std::vector<Vec3>& dx, AddForce&& add)
+{
+    if (kernel == ForceKernel::Force)
+        fem.computeElementForce(e, x, add);
+    else
+        fem.computeElementDForce(e, dx, 1, add);
+}
+
+static void atomicAdd(std::atomic<SReal>& target, SReal value)
+{
+    SReal current = target.load(std::memory_order_relaxed);
+    while (!target.compare_exchange_weak(current, current + value, std::memory_order_relaxed))
+    {
+    }
+}
+
+/// Maximum difference between the nodal forces, relative to the largest reference force
+static bool isSameForces(const std::vector<Vec3>& forces, const std::vector<Vec3>& reference)
+{
+    SReal maxReference = 0;
+    SReal maxDifference = 0;
+    for (std::size_t n = 0; n < forces.size(); ++n)
+    {
+        maxReference = std::max(maxReference, reference[n].cwiseAbs().maxCoeff());
+        maxDifference = std::max(maxDifference, (forces[n] - reference[n]).cwiseAbs().maxCoeff());
+    }
+    return maxDifference <= 1000 * std::numeric_limits<SReal>::epsilon() * maxReference;
+}
+
+static void BM_ForceAccumulation_Tetrahedra(benchmark::State& state)
+{
+    const auto strategy = static_cast<AccumulationStrategy>(state.range(2));
+    const auto kernel = static_cast<ForceKernel>(state.range(3));
+
+    const auto beam = createForceBeam(state.range(0));
+    TetrahedronFEM fem;
+    fem.init(beam.restPositions, beam.tetrahedra, 4000, 0.3);
+    const auto nbNodes = fem.getNbNodes();
+    const auto nbElements = fem.getNbElements();
+
+    std::vector<Vec3> dx(nbNodes);
+    for (sofa::Index n = 0; n < nbNodes; ++n)
+        dx[n] = beam.positions[n] - beam.restPositions[n];
+
+    // Rotations of the deformed beam, used by addDForce
+    for (std::size_t e = 0; e < nbElements; ++e)
+        fem.computeElementForce(e, beam.positions, [](sofa::Index, const Vec3&) {});
+
+    auto* taskScheduler = sofa::simulation::MainTaskSchedulerFactory::createInRegistry();
+    assert(taskScheduler != nullptr);
+    taskScheduler->init(state.range(1));
+    const std::size_t nbThreads = taskScheduler->getThreadCount();
+
+    const bool isColored = strategy == AccumulationStrategy::GreedyColoring || strategy == AccumulationStrategy::BalancedColoring;
+    const auto coloringStrategy = strategy == AccumulationStrategy::BalancedColoring ? elementcoloring::Strategy::Balanced : elementcoloring::Strategy::Greedy;
+    elementcoloring::ElementColoring coloring;
+    if (isColored)
+        coloring.update(nbNodes, beam.tetrahedra, coloringStrategy, 0);
+
+    std::vector<Vec3> forces(nbNodes);
+    std::vector<std::atomic<SReal> > atomicForces(strategy == AccumulationStrategy::Atomic ? 3 * nbNodes : 0);
+    std::vector<std::vector<Vec3> > threadForces(strategy == AccumulationStrategy::ThreadLocal ? nbThreads : 0, std::vector<Vec3>(nbNodes));
+
+    const auto addToForces = [&forces](sofa::Index n, const Vec3& f) { forces[n] += f; };
+
+    const auto accumulateForces = [&]()
+    {
+        switch (strategy)
+        {
+        case AccumulationStrategy::Sequential:
+            std::fill(forces.begin(), forces.end(), Vec3::Zero());
+            for (std::size_t e = 0; e < nbElements; ++e)
+                computeElement(fem, kernel, e, beam.positions, dx, addToForces);
+            break;
+
+        case AccumulationStrategy::GreedyColoring:
+        case AccumulationStrategy::BalancedColoring:
+            coloring.update(nbNodes, beam.tetrahedra, coloringStrategy, 0);
+            std::fill(forces.begin(), forces.end(), Vec3::Zero());
+            elementcoloring::parallelForEachElementByColor(*taskScheduler, coloring, [&](sofa::Index e)
+            {
+                computeElement(fem, kernel, e, beam.positions, dx, addToForces);
+            });
+            break;
+
+        case AccumulationStrategy::Atomic:
+            for (auto& f : atomicForces)
+                f.store(0, std::memory_order_relaxed);
+            sofa::simulation::parallelForEachRange(*taskScheduler, static_cast<std::size_t>(0), nbElements,
+                [&](const auto& range)
+                {
+                    for (auto e = range.start; e != range.end; ++e)
+                    {
+                        computeElement(fem, kernel, e, beam.positions, dx, [&atomicForces](sofa::Index n, const Vec3& f)
+                        {
+                            for (int i = 0; i < 3; ++i)
+                                atomicAdd(atomicForces[3 * n + i], f[i]);
+                        });
+                    }
+                });
+            break;
+
+        case AccumulationStrategy::ThreadLocal:
+            sofa::simulation::parallelForEach(*taskScheduler, static_cast<std::size_t>(0), nbThreads,
+                [&](std::size_t b)
+                {
+                    auto& local = threadForces[b];
+                    std::fill(local.begin(), local.end(), Vec3::Zero());
+                    for (std::size_t e = nbElements * b / nbThreads; e < nbElements * (b + 1) / nbThreads; ++e)
+                    {
+                        computeElement(fem, kernel, e, beam.positions, dx, [&local](sofa::Index n, const Vec3& f) { local[n] += f; });
+                    }
+                });
+            sofa::simulation::parallelForEachRange(*taskScheduler, static_cast<sofa::Index>(0), nbNodes,
+                [&](const auto& range)
+                {
+                    for (auto n = range.start; n != range.end; ++n)
+                    {
+                        forces[n] = threadForces[0][n];
+                        for (std::size_t b = 1; b < nbThreads; ++b)
+                            forces[n] += threadForces[b][n];
+                    }
+                });
+            break;
+        }
+    };
+
+    std::vector<Vec3> referenceForces(nbNodes, Vec3::Zero());
+    for (std::size_t e = 0; e < nbElements; ++e)
+        computeElement(fem, kernel, e, beam.positions, dx, [&referenceForces](sofa::Index n, const Vec3& f) { referenceForces[n] += f; });
+
+    accumulateForces();
+    if (strategy == AccumulationStrategy::Atomic)
+    {
+        for (sofa::Index n = 0; n < nbNodes; ++n)
+            forces[n] = Vec3(atomicForces[3 * n].load(), atomicForces[3 * n + 1].load(), atomicForces[3 * n + 2].load());
+    }
+    if (!isSameForces(forces, referenceForces))
+    {
+        state.SkipWithError("The forces differ from the sequential accumulation");
+        return;
+    }
+
+    for (auto _ : state)
+    {
+        accumulateForces();
+        benchmark::ClobberMemory();
+    }
+
+    state.counters["elements"] = benchmark::Counter(static_cast<double>(nbElements), benchmark::Counter::kIsIterationInvariantRate);
+    if (isColored)
+    {
+        state.counters["colors"] = coloring.getNbColors();
+        state.counters["imbalance"] = coloring.getImbalance();
+    }
+}
+
+/// All the strategies on all the thread counts, except the sequential one which runs on one thread
+static void forceAccumulationArguments(benchmark::internal::Benchmark* benchmark)
+{
+    static const std::vector<AccumulationStrategy> strategies { AccumulationStrategy::Sequential, AccumulationStrategy::GreedyColoring,
+        AccumulationStrategy::BalancedColoring, AccumulationStrategy::Atomic, AccumulationStrategy::ThreadLocal };
+
+    for (const auto multiplier : forceBeamMultiplierRange)
+    {
+        for (const auto threads : forceThreadNumberRange)
+        {
+            for (const auto strategy : strategies)
+            {
+                if (strategy == AccumulationStrategy::Sequential && threads != 1)
+                    continue;
+                for (const auto kernel : { ForceKernel::Force, ForceKernel::DForce })
+                {
+                    benchmark->Args({ multiplier, threads, static_cast<int64_t>(strategy), static_cast<int64_t>(kernel) });
+                }
+            }
+        }
+    }
+}
+
+BENCHMARK(BM_ForceAccumulation_Tetrahedra)->Apply(forceAccumulationArguments)->ArgNames({"multiplier", "threads", "strategy", "kernel"})
+->Threads(1)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+/**
+ * Computation of the coloring of a cubic grid of n * n * n nodes, meshed with hexahedra or tetrahedra (6 per cube),
+ * i.e. the cost paid once per change of the topology. Counters: colors, imbalance (as above).
+ */
+template<std::size_t K>
+static void runElementColoring(benchmark::State& state, sofa::Index n, const std::vector<std::array<sofa::Index, K> >& elements)
+{
+    const auto strategy = static_cast<elementcoloring::Strategy>(state.range(2));
+    elementcoloring::ElementColoring coloring;
+    for (auto _ : state)
+    {
+        coloring.invalidate();
+        coloring.update(n * n * n, elements, strategy, 0);
+    }
+
+    state.counters["elements"] = benchmark::Counter(static_cast<double>(elements.size()), benchmark::Counter::kIsIterationInvariantRate);
+    state.counters["colors"] = coloring.getNbColors();
+    state.counters["imbalance"] = coloring.getImbalance();
+}
+
+static void BM_ElementColoring(benchmark::State& state)
+{
+    const auto n = static_cast<sofa::Index>(state.range(0));
+    if (static_cast<fempattern::MeshTopology>(state.range(1)) == fempattern::MeshTopology::Hexahedra)
+        runElementColoring(state, n, fempattern::createGridHexahedra(n, n, n));
+    else
+        runElementColoring(state, n, fempattern::createGridTetrahedra(n, n, n));
+}
+
+BENCHMARK(BM_ElementColoring)->ArgsProduct({
+    {16, 32, 64},
+    {static_cast<int64_t>(fempattern::MeshTopology::Hexahedra), static_cast<int64_t>(fempattern::MeshTopology::Tetrahedra)},
+    {static_cast<int64_t>(elementcoloring::Strategy::Greedy), static_cast<int64_t>(elementcoloring::Strategy::Balanced)}
+})->ArgNames({"grid", "topology", "strategy"})->Unit(benchmark::kMillisecond);
@@ -0,0 +1,214 @@
+#include <benchmark/benchmark.h>
+#include <sofa/config.h>
+#include <utils/BatchedStiffnessAccumulator.h>
+#include <utils/FEMSparsityPattern.h>
+#include <utils/MatrixIO.h>
+#include <utils/StiffnessMatrixAccumulator.h>
+#include <Eigen/Sparse>
+#include <limits>
+#include <random>
+#include <vector>
+
+/**
+ * Cost of the accumulation of the element stiffness matrices, depending on the call path:
+ * - PerEntryVirtual: one virtual call of StiffnessMatrixAccumulator per scalar entry (144 per tetrahedron, 576
+ *   per hexahedron)
+ * - PerBlockVirtual: one virtual call per 3x3 block (16 per tetrahedron, 64 per hexahedron), as in the
+ *   buildStiffnessMatrix of TetrahedronFEMForceField and HexahedronFEMForceField
+ * - Batched: the element matrices are written in an ElementMatrixBatch, given to a BatchedMatrixAccumulator in
+ *   one virtual call per nbElementsPerBatch elements
+ * and on the accumulated matrix:
+ * - CRS: CompressedRowSparseMatrix of 3x3 blocks. In the three paths, the entries or the blocks are added at
+ *   their positions cached by a CRSStructureCache during the first assembly, so the paths differ only by
+ *   the number of calls and the granularity of the scatter.
+ * - EigenTriplets: list of scalar triplets (setFromTriplets is not measured)
+ * The matrix of an element is a reference matrix scaled per element, computed on the fly: the benchmark measures
+ * the calls and the scatter, not the element math. The mesh is a cubic grid of n * n * n nodes.
+ * Before the timing, the accumulated matrix (or the matrix of the triplets) is compared to the one assembled
+ * directly from the element matrices: the benchmark fails if they differ.
+ * Counters:
+ * - elements: number of elements accumulated per second
+ * - callsPerElement: number of virtual calls per element
+ */
+
+enum class AccumulationPath : int64_t { PerEntryVirtual = 0, PerBlockVirtual = 1, Batched = 2 };
+enum class AccumulationTarget : int64_t { CRS = 0, EigenTriplets = 1 };
+
+constexpr std::size_t nbElementsPerBatch = 64;
+
+template<std::size_t NbNodes>
+static std::vector<std::array<sofa::Index, NbNodes> > createGridElements(sofa::Index n)
+{
+    if constexpr (NbNodes == 4)
+        return fempattern::createGridTetrahedra(n, n, n);
+    else
+        return fempattern::createGridHexahedra(n, n, n);
+}
+
+static matrixio::Matrix toMatrix(Eigen::Index size, const std::vector<StiffnessTriplet>& triplets)
+{
+    matrixio::Matrix matrix(size, size);
+    matrix.setFromTriplets(triplets.begin(), triplets.end());
+    return matrix;
+}
+
+/// The entries are sums of the same terms in different orders
+static bool isSameStiffness(const matrixio::Matrix& matrix, const matrixio::Matrix& reference)
+{
+    if (matrix.rows() != reference.rows() || matrix.cols() != reference.cols())
+        return false;
+    const matrixio::Matrix difference = matrix - reference;
+    const SReal maxReference = reference.coeffs().cwiseAbs().maxCoeff();
+    const SReal maxDifference = difference.nonZeros() > 0 ? difference.coeffs().cwiseAbs().maxCoeff() : 0;
+    return maxDifference <= 1000 * std::numeric_limits<SReal>::epsilon() * maxReference;
+}
+
+template<std::size_t NbNodes>
+static void runStiffnessAccumulation(benchmark::State& state)
+{
+    using Batch = batchedstiffness::ElementMatrixBatch<NbNodes>;
+    constexpr int Size = Batch::Size;
+
+    const auto n = static_cast<sofa::Index>(state.range(0));
+    const auto path = static_cast<AccumulationPath>(state.range(1));
+    const auto target = static_cast<AccumulationTarget>(state.range(2));
+
+    const auto elements = createGridElements<NbNodes>(n);
+
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<SReal> distribution(-1, 1);
+    typename Batch::ElementMatrix reference;
+    for (int r = 0; r < Size; ++r)
+        for (int c = 0; c <= r; ++c)
+            reference(r, c) = reference(c, r) = distribution(gen);
+    const auto scale = [](std::size_t e) { return 1 + static_cast<SReal>(e % 7) / 10; };
+
+    StiffnessCRS matrix;
+    matrix.resizeBlock(n * n * n, n * n * n);
+    std::vector<StiffnessTriplet> triplets;
+
+    CRSStiffnessAccumulator crsAccumulator(matrix);
+    TripletStiffnessAccumulator tripletAccumulator(triplets);
+    batchedstiffness::CRSBatchedMatrixAccumulator<SReal> crsBatchedAccumulator(matrix);
+    batchedstiffness::TripletBatchedMatrixAccumulator<SReal> tripletBatchedAccumulator(triplets);
+
+    // Accessed through the base classes, as a force field does, and hidden from the optimizer so that the calls
+    // are not devirtualized
+    sofa::core::behavior::StiffnessMatrixAccumulator* accumulator = &crsAccumulator;
+    batchedstiffness::BatchedMatrixAccumulator<SReal>* batchedAccumulator = &crsBatchedAccumulator;
+    if (target == AccumulationTarget::EigenTriplets)
+    {
+        accumulator = &tripletAccumulator;
+        batchedAccumulator = &tripletBatchedAccumulator;
+    }
+    benchmark::DoNotOptimize(accumulator);
+    benchmark::DoNotOptimize(batchedAccumulator);
+
+    Batch batch(nbElementsPerBatch);
+
+    const auto assemble = [&]()
+    {
+        if (target == AccumulationTarget::EigenTriplets)
+            triplets.clear();
+        else if (path == AccumulationPath::Batched)
+            crsBatchedAccumulator.begin();
+        else
+            crsAccumulator.begin();
+
+        for (std::size_t e = 0; e < elements.size(); ++e)
+        {
+            const auto& nodes = elements[e];
+            const SReal s = scale(e);
+            switch (path)
+            {
+            case AccumulationPath::PerEntryVirtual:
+                for (int r = 0; r < Size; ++r)
+                    for (int c = 0; c < Size; ++c)
+                        accumulator->add(3 * nodes[r / 3] + r % 3, 3 * nodes[c / 3] + c % 3, s * reference(r, c));
+                break;
+
+            case AccumulationPath::PerBlockVirtual:
+                for (std::size_t a = 0; a < NbNodes; ++a)
+                {
+                    for (std::size_t b = 0; b < NbNodes; ++b)
+                    {
+                        sofa::type::Mat<3, 3, SReal> block;
+                        for (int i = 0; i < 3; ++i)
+                            for (int j = 0; j < 3; ++j)
+                                block[i][j] = s * reference(3 * a + i, 3 * b + j);
+                        accumulator->add(3 * nodes[a], 3 * nodes[b], block);
+                    }
+                }
+                break;
+
+            case AccumulationPath::Batched:
+                batch.add(nodes) = s * reference;
+                if (batch.isFull())
+                {
+                    batchedAccumulator->addBatch(batch);
+                    batch.clear();
+                }
+                break;
+            }
+        }
+        if (batch.size() > 0)
+        {
+            batchedAccumulator->addBatch(batch);
+            batch.clear();
+        }
+
+        if (target == AccumulationTarget::EigenTriplets)
+            return;
+        if (path == AccumulationPath::Batched)
+            crsBatchedAccumulator.end();
+        else
+            crsAccumulator.end();
+    };
+
+    // The first assembly creates the sparsity of the matrix. The second one refills it as the timed assemblies,
+    // and is checked.
+    assemble();
+    assemble();
+
+    std::vector<StiffnessTriplet> referenceTriplets;
+    referenceTriplets.reserve(elements.size() * Size * Size);
+    for (std::size_t e = 0; e < elements.size(); ++e)
+        for (int r = 0; r < Size; ++r)
+            for (int c = 0; c < Size; ++c)
+                referenceTriplets.emplace_back(3 * elements[e][r / 3] + r % 3, 3 * elements[e][c / 3] + c % 3, scale(e) * reference(r, c));
+    if (!isSameStiffness(target == AccumulationTarget::CRS ? matrixio::toEigen(matrix) : toMatrix(3 * n * n * n, triplets),
+                         toMatrix(3 * n * n * n, referenceTriplets)))
+    {
+        state.SkipWithError("The accumulated matrix differs from the element matrices");
+        return;
+    }
+
+    for (auto _ : state)
+    {
+        assemble();
+        benchmark::ClobberMemory();
+    }
+
+    const double callsPerElement[] { Size * Size, NbNodes * NbNodes, 1. / nbElementsPerBatch };
+    state.counters["elements"] = benchmark::Counter(static_cast<double>(elements.size()), benchmark::Counter::kIsIterationInvariantRate);
+    state.counters["callsPerElement"] = callsPerElement[static_cast<std::size_t>(path)];
+}
+
+static void BM_StiffnessAccumulation_Tetrahedra(benchmark::State& state)
+{
+    runStiffnessAccumulation<4>(state);
+}
+
+static void BM_StiffnessAccumulation_Hexahedra(benchmark::State& state)
+{
+    runStiffnessAccumulation<8>(state);
+}
+
+const std::vector<std::vector<int64_t> > stiffnessAccumulationArguments {
+    {8, 16, 24},
+    {static_cast<int64_t>(AccumulationPath::PerEntryVirtual), static_cast<int64_t>(AccumulationPath::PerBlockVirtual), static_cast<int64_t>(AccumulationPath::Batched)},
+    {static_cast<int64_t>(AccumulationTarget::CRS), static_cast<int64_t>(AccumulationTarget::EigenTriplets)}
+};
+
+BENCHMARK(BM_StiffnessAccumulation_Tetrahedra)->ArgsProduct(stiffnessAccumulationArguments)->ArgNames({"grid", "path", "target"})->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_StiffnessAccumulation_Hexahedra)->ArgsProduct(stiffnessAccumulationArguments)->ArgNames({"grid", "path", "target"})->Unit(benchmark::kMicrosecond);
@@ -2,25 +2,30 @@
 #include <sofa/config.h>
 #include <sofa/core/behavior/BaseLocalForceFieldMatrix.h>
 #include <sofa/core/behavior/ForceField.h>
+#include <sofa/core/topology/BaseMeshTopology.h>
+#include <sofa/linearalgebra/CompressedRowSparseMatrix.h>
+#include <sofa/simulation/MainTaskSchedulerFactory.h>
+#include <sofa/simulation/ParallelForEach.h>
 #include <sofa/simulation/Simulation.h>
 #include <sofa/simpleapi/SimpleApi.h>
 #include <sofa/simulation/Node.h>
 #include <sofa/simulation/graph/DAGNode.h>
+#include <utils/ParallelCRSAssembly.h>
+#include <utils/StiffnessMatrixAccumulator.h>
+#include <utils/TetrahedronFEMKernel.h>
+#include <Eigen/Sparse>
+#include <cassert>
+#include <thread>
+#include <vector>
+
+using ForceField3d = sofa::core::behavior::ForceField<sofa::defaulttype::Vec3dTypes>;
 
 /**
- * Benchmark of TetrahedronFEMForceField::buildStiffnessMatrix
- *
- * A cantilever beam.
- * Number of elements depends on the benchmark parameter
- * The scene is initialized and one time step is performed
- * After that, the function buildStiffnessMatrix is called.
- * The function does not accumulate anything because it uses StiffnessMatrixAccumulator which does nothing.
- * However, the calls to virtual functions is still taken into account in the benchmark.
+ * A cantilever beam of tetrahedra, initialized, after one time step.
+ * Number of elements depends on the multiplier
  */
-static void BM_TetrahedronFEMForceField_buildStiffnessMatrix(benchmark::State& state)
+static ForceField3d::SPtr createTetrahedronFEMBeam(const sofa::simulation::NodeSPtr& root, int64_t multiplier)
 {
-    const auto multiplier = state.range(0);
-    const sofa::simulation::NodeSPtr root = sofa::core::objectmodel::New<sofa::simulation::graph::DAGNode>();
     sofa::simpleapi::createObject(root, "DefaultAnimationLoop");
 
     sofa::simpleapi::importPlugin("Sofa.Component.ODESolver.Backward");
@@ -62,7 +67,28 @@ static void BM_TetrahedronFEMForceField_buildStiffnessMatrix(benchmark::State& s
 
     sofa::simulation::node::initRoot(root.get());
 
-    sofa::core::behavior::ForceField<sofa::defaulttype::Vec3dTypes>::SPtr forcefield = dynamic_cast<sofa::core::behavior::ForceField<sofa::defaulttype::Vec3dTypes>*>(forceFieldObject.get());
+    ForceField3d::SPtr forcefield = dynamic_cast<ForceField3d*>(forceFieldObject.get());
+    if (forcefield)
+    {
+        sofa::simulation::node::animate(root.get(), 0.1_sreal);
+    }
+    return forcefield;
+}
+
+/**
+ * Benchmark of TetrahedronFEMForceField::buildStiffnessMatrix
+ *
+ * A cantilever beam.
+ * Number of elements depends on the benchmark parameter
+ * The scene is initialized and one time step is performed
+ * After that, the function buildStiffnessMatrix is called.
+ * The function does not accumulate anything because it uses StiffnessMatrixAccumulator which does nothing.
+ * However, the calls to virtual functions is still taken into account in the benchmark.
+ */
+static void BM_TetrahedronFEMForceField_buildStiffnessMatrix(benchmark::State& state)
+{
+    const sofa::simulation::NodeSPtr root = sofa::core::objectmodel::New<sofa::simulation::graph::DAGNode>();
+    const auto forcefield = createTetrahedronFEMBeam(root, state.range(0));
 
     if (forcefield)
     {
@@ -71,8 +97,6 @@ static void BM_TetrahedronFEMForceField_buildStiffnessMatrix(benchmark::State& s
         sofa::core::behavior::StiffnessMatrix matrix;
         matrix.setMatrixAccumulator(&acc, forcefield->getMState(), forcefield->getMState());
 
-        sofa::simulation::node::animate(root.get(), 0.1_sreal);
-
         for (auto _ : state)
         {
             forcefield->buildStiffnessMatrix(&matrix);
@@ -80,6 +104,235 @@ static void BM_TetrahedronFEMForceField_buildStiffnessMatrix(benchmark::State& s
     }
 }
 
+/// Multipliers of the beam: up to 20480 nodes and 106650 tetrahedra
+constexpr int64_t maxTetrahedronBeamMultiplier = 8;
 
 BENCHMARK(BM_TetrahedronFEMForceField_buildStiffnessMatrix)
-->RangeMultiplier(2)->Ranges({ {1, 4} })->Unit(benchmark::kMicrosecond);
+->RangeMultiplier(2)->Ranges({ {1, maxTetrahedronBeamMultiplier} })->Unit(benchmark::kMicrosecond);
+
+static std::size_t getNbTetrahedra(const sofa::simulation::NodeSPtr& root)
+{
+    const auto* topology = dynamic_cast<sofa::core::topology::BaseMeshTopology*>(root->getObject("topo"));
+    return topology ? topology->getNbTetrahedra() : 0;
+}
+
+static void setStiffnessCounters(benchmark::State& state, std::size_t nbElements, std::size_t nbNonZeroBlocks)
+{
+    state.counters["elements"] = benchmark::Counter(static_cast<double>(nbElements), benchmark::Counter::kIsIterationInvariantRate);
+    state.counters["nnzBlocks"] = static_cast<double>(nbNonZeroBlocks);
+}
+
+/**
+ * Same scene, with an accumulator building a real matrix: the benchmark includes the element math, the
+ * virtual calls, the insertion of the blocks and the compression of the matrix (CRS 3x3 or Eigen triplets).
+ * Each iteration builds the matrix from scratch, as the Eigen triplets and the parallel assembly below.
+ */
+
+static void BM_TetrahedronFEMForceField_buildStiffnessMatrix_CRS(benchmark::State& state)
+{
+    const sofa::simulation::NodeSPtr root = sofa::core::objectmodel::New<sofa::simulation::graph::DAGNode>();
+    const auto forcefield = createTetrahedronFEMBeam(root, state.range(0));
+    if (!forcefield)
+    {
+        state.SkipWithError("The force field could not be created");
+        return;
+    }
+
+    const auto nbNodes = static_cast<sofa::Index>(forcefield->getMState()->getSize());
+    StiffnessCRS crs;
+    crs.resizeBlock(nbNodes, nbNodes);
+    CRSStiffnessAccumulator acc(crs, CRSStiffnessAccumulator::StructureLookup::Rebuilt);
+
+    sofa::core::behavior::StiffnessMatrix matrix;
+    matrix.setMatrixAccumulator(&acc, forcefield->getMState(), forcefield->getMState());
+
+    for (auto _ : state)
+    {
+        acc.begin();
+        forcefield->buildStiffnessMatrix(&matrix);
+        acc.end();
+    }
+
+    setStiffnessCounters(state, getNbTetrahedra(root), crs.colsValue.size());
+}
+
+static void BM_TetrahedronFEMForceField_buildStiffnessMatrix_EigenTriplets(benchmark::State& state)
+{
+    const sofa::simulation::NodeSPtr root = sofa::core::objectmodel::New<sofa::simulation::graph::DAGNode>();
+    const auto forcefield = createTetrahedronFEMBeam(root, state.range(0));
+    if (!forcefield)
+    {
+        state.SkipWithError("The force field could not be created");
+        return;
+    }
+
+    const auto size = static_cast<Eigen::Index>(3 * forcefield->getMState()->getSize());
+    std::vector<StiffnessTriplet> triplets;
+    TripletStiffnessAccumulator acc(triplets);
+
+    sofa::core::behavior::StiffnessMatrix matrix;
+    matrix.setMatrixAccumulator(&acc, forcefield->getMState(), forcefield->getMState());
+
+    Eigen::SparseMatrix<SReal, Eigen::RowMajor> eigenMatrix(size, size);
+    for (auto _ : state)
+    {
+        triplets.clear();
+        forcefield->buildStiffnessMatrix(&matrix);
+        eigenMatrix.setFromTriplets(triplets.begin(), triplets.end());
+    }
+
+    setStiffnessCounters(state, getNbTetrahedra(root), eigenMatrix.nonZeros() / 9);
+}
+
+BENCHMARK(BM_TetrahedronFEMForceField_buildStiffnessMatrix_CRS)
+->RangeMultiplier(2)->Ranges({ {1, maxTetrahedronBeamMultiplier} })->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_TetrahedronFEMForceField_buildStiffnessMatrix_EigenTriplets)
+->RangeMultiplier(2)->Ranges({ {1, maxTetrahedronBeamMultiplier} })->Unit(benchmark::kMicrosecond);
+
+/**
+ * Parallel element loop. TetrahedronFEMForceField::buildStiffnessMatrix is sequential, so the element math of
+ * the method "large" is reproduced by tetrafem::CorotationalTetrahedra, on the same beam (same grid, each cube
+ * split in 6 tetrahedra), twisted around its axis so that each element has its own rotation.
+ * The elements are split in one contiguous range per thread, and the blocks are accumulated without lock:
+ * - CRS: one BlockTripletBuffer per thread, merged into a CompressedRowSparseMatrix of 3x3 blocks by
+ *   ParallelCRSAssembler,
+ * - EigenTriplets: each element writes its 144 scalar triplets at its own position in a shared array, then
+ *   Eigen::SparseMatrix::setFromTriplets (sequential) sums the duplicates.
+ * The sequential reference (ElementLoop_CRS) inserts the blocks with wblock() then compresses, as the
+ * accumulator of BM_TetrahedronFEMForceField_buildStiffnessMatrix_CRS, without the virtual calls. As the
+ * parallel assembly, it builds the structure of the matrix at each iteration.
+ */
+
+using TetrahedronFEM = tetrafem::CorotationalTetrahedra<SReal>;
+
+static tetrafem::TwistedBeam createTetrahedronBeamMesh(int64_t multiplier)
+{
+    return tetrafem::createTwistedBeam(static_cast<sofa::Index>(2 * multiplier), static_cast<sofa::Index>(2 * multiplier),
+        static_cast<sofa::Index>(10 * multiplier));
+}
+
+static sofa::type::Mat<3, 3, SReal> toBlock(const TetrahedronFEM::Mat3& m)
+{
+    sofa::type::Mat<3, 3, SReal> block;
+    for (int i = 0; i < 3; ++i)
+        for (int j = 0; j < 3; ++j)
+            block[i][j] = m(i, j);
+    return block;
+}
+
+static sofa::simulation::TaskScheduler* initStiffnessTaskScheduler(const benchmark::State& state)
+{
+    auto* taskScheduler = sofa::simulation::MainTaskSchedulerFactory::createInRegistry();
+    assert(taskScheduler != nullptr);
+    taskScheduler->init(state.range(1));
+    return taskScheduler;
+}
+
+static void BM_TetrahedronFEM_ElementLoop_CRS(benchmark::State& state)
+{
+    const auto mesh = createTetrahedronBeamMesh(state.range(0));
+    TetrahedronFEM fem;
+    fem.init(mesh.restPositions, mesh.tetrahedra, 4000, 0.3);
+    const auto nbNodes = fem.getNbNodes();
+
+    StiffnessCRS matrix;
+    matrix.resizeBlock(nbNodes, nbNodes);
+    for (auto _ : state)
+    {
+        clearCRSStructure(matrix);
+        for (std::size_t e = 0; e < fem.getNbElements(); ++e)
+        {
+            fem.computeElementStiffness(e, mesh.positions, [&matrix](sofa::Index a, sofa::Index b, const TetrahedronFEM::Mat3& block)
+            {
+                *matrix.wblock(a, b, true) += toBlock(block);
+            });
+        }
+        matrix.compress();
+    }
+
+    setStiffnessCounters(state, fem.getNbElements(), matrix.colsValue.size());
+}
+
+static void BM_TetrahedronFEM_ParallelElementLoop_CRS(benchmark::State& state)
+{
+    const auto mesh = createTetrahedronBeamMesh(state.range(0));
+    TetrahedronFEM fem;
+    fem.init(mesh.restPositions, mesh.tetrahedra, 4000, 0.3);
+    const auto nbNodes = fem.getNbNodes();
+    const auto nbElements = fem.getNbElements();
+
+    auto* taskScheduler = initStiffnessTaskScheduler(state);
+    const std::size_t nbBuffers = taskScheduler->getThreadCount();
+
+    ParallelCRSAssembler<StiffnessCRS> assembler(nbNodes, nbNodes, nbBuffers);
+    for (std::size_t b = 0; b < nbBuffers; ++b)
+        assembler.getBuffer(b).reserve(16 * (nbElements / nbBuffers + 1));
+
+    StiffnessCRS matrix;
+    for (auto _ : state)
+    {
+        assembler.clear();
+        sofa::simulation::parallelForEach(*taskScheduler, static_cast<std::size_t>(0), nbBuffers,
+            [&](std::size_t b)
+            {
+                auto& buffer = assembler.getBuffer(b);
+                for (std::size_t e = nbElements * b / nbBuffers; e < nbElements * (b + 1) / nbBuffers; ++e)
+                {
+                    fem.computeElementStiffness(e, mesh.positions, [&buffer](sofa::Index a, sofa::Index c, const TetrahedronFEM::Mat3& block)
+                    {
+                        buffer.add(a, c, toBlock(block));
+                    });
+                }
+            });
+        assembler.assemble(*taskScheduler, matrix);
+    }
+
+    setStiffnessCounters(state, nbElements, matrix.colsValue.size());
+}
+
+static void BM_TetrahedronFEM_ParallelElementLoop_EigenTriplets(benchmark::State& state)
+{
+    constexpr std::size_t nbTripletsPerElement = 16 * 9;
+
+    const auto mesh = createTetrahedronBeamMesh(state.range(0));
+    TetrahedronFEM fem;
+    fem.init(mesh.restPositions, mesh.tetrahedra, 4000, 0.3);
+    const auto size = static_cast<Eigen::Index>(3 * fem.getNbNodes());
+    const auto nbElements = fem.getNbElements();
+
+    auto* taskScheduler = initStiffnessTaskScheduler(state);
+
+    std::vector<Eigen::Triplet<SReal> > triplets(nbTripletsPerElement * nbElements);
+    Eigen::SparseMatrix<SReal, Eigen::RowMajor> matrix(size, size);
+    for (auto _ : state)
+    {
+        sofa::simulation::parallelForEachRange(*taskScheduler, static_cast<std::size_t>(0), nbElements,
+            [&](const auto& range)
+            {
+                for (auto e = range.start; e != range.end; ++e)
+                {
+                    auto* triplet = triplets.data() + nbTripletsPerElement * e;
+                    fem.computeElementStiffness(e, mesh.positions, [&triplet](sofa::Index a, sofa::Index b, const TetrahedronFEM::Mat3& block)
+                    {
+                        for (int i = 0; i < 3; ++i)
+                            for (int j = 0; j < 3; ++j)
+                                *triplet++ = Eigen::Triplet<SReal>(3 * a + i, 3 * b + j, block(i, j));
+                    });
+                }
+            });
+        matrix.setFromTriplets(triplets.begin(), triplets.end());
+    }
+
+    setStiffnessCounters(state, nbElements, matrix.nonZeros() / 9);
+}
+
+const auto stiffnessThreadNumberRange = benchmark::CreateRange(1, std::thread::hardware_concurrency(), 2);
+
+BENCHMARK(BM_TetrahedronFEM_ElementLoop_CRS)
+->RangeMultiplier(2)->Ranges({ {1, maxTetrahedronBeamMultiplier} })->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_TetrahedronFEM_ParallelElementLoop_CRS)->ArgsProduct({
+    benchmark::CreateRange(1, maxTetrahedronBeamMultiplier, 2), stiffnessThreadNumberRange
+})->ArgNames({"multiplier", "threads"})->Threads(1)->UseRealTime()->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_TetrahedronFEM_ParallelElementLoop_EigenTriplets)->ArgsProduct({
+    benchmark::CreateRange(1, maxTetrahedronBeamMultiplier, 2), stiffnessThreadNumberRange
+})->ArgNames({"multiplier", "threads"})->Threads(1)->UseRealTime()->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,317 @@
+#include <benchmark/benchmark.h>
+#include <utils/MatrixIO.h>
+#include <utils/SparseTransposeProduct.h>
+#include <utils/SupernodalLDLT.h>
+#include <sofa/linearalgebra/CompressedRowSparseMatrix.h>
+#include <sofa/linearalgebra/FullVector.h>
+#include <sofa/simulation/MainTaskSchedulerFactory.h>
+#include <Eigen/Sparse>
+#include <Eigen/SparseCholesky>
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * Sparse kernels on matrices captured in real scenes (see SOFABENCHMARK_DUMP_MATRICES in the scene benchmarks),
+ * or on any Matrix Market file. All the .mtx and .csr files of the directory given in the environment variable
+ * SOFABENCHMARK_MATRIX_DIR are benchmarked, one benchmark per file, named after the file:
+ * - compression of the entries (in random order, as from an assembly) in Eigen and CompressedRowSparseMatrix
+ * - matrix-vector product in Eigen and CompressedRowSparseMatrix
+ * - A * A in Eigen, and A^T A with the numeric phase of SparseTransposeProduct
+ * - LDL^T factorization with Eigen::SimplicialLDLT and SupernodalLDLT (AMD ordering), for square matrices. The
+ *   symbolic factorization is done once, as in a solver where the sparsity does not change.
+ * Counters:
+ * - rows: number of rows of the matrix
+ * - nnz: number of non-zeros of the matrix
+ */
+
+using CapturedMatrix = matrixio::Matrix;
+
+/// The matrices are loaded on the first use, and kept for all the benchmarks of the same file
+static const CapturedMatrix* getCapturedMatrix(const std::string& filename)
+{
+    static std::map<std::string, std::unique_ptr<CapturedMatrix> > cache;
+
+    auto it = cache.find(filename);
+    if (it == cache.end())
+    {
+        auto matrix = std::make_unique<CapturedMatrix>();
+        if (!matrixio::readMatrix(filename, *matrix))
+            matrix.reset();
+        else
+            matrix->makeCompressed();
+        it = cache.emplace(filename, std::move(matrix)).first;
+    }
+    return it->second.get();
+}
+
+static const CapturedMatrix* loadCapturedMatrix(benchmark::State& state, const std::string& filename)
+{
+    const auto* matrix = getCapturedMatrix(filename);
+    if (matrix == nullptr)
+        state.SkipWithError(("Cannot read the matrix " + filename).c_str());
+    return matrix;
+}
+
+static void setMatrixCounters(benchmark::State& state, const CapturedMatrix& matrix)
+{
+    state.counters["rows"] = static_cast<double>(matrix.rows());
+    state.counters["nnz"] = static_cast<double>(matrix.nonZeros());
+}
+
+/// Entries of the matrix in a random (but reproducible) order
+static std::vector<Eigen::Triplet<double> > shuffledTriplets(const CapturedMatrix& matrix)
+{
+    std::vector<Eigen::Triplet<double> > triplets;
+    triplets.reserve(matrix.nonZeros());
+    for (Eigen::Index i = 0; i < matrix.outerSize(); ++i)
+        for (CapturedMatrix::InnerIterator it(matrix, i); it; ++it)
+            triplets.emplace_back(it.row(), it.col(), it.value());
+
+    std::mt19937 generator(0);
+    std::shuffle(triplets.begin(), triplets.end(), generator);
+    return triplets;
+}
+
+static void BM_CapturedMatrix_Compression_Eigen(benchmark::State& state, const std::string& filename)
+{
+    const auto* matrix = loadCapturedMatrix(state, filename);
+    if (matrix == nullptr)
+        return;
+    const auto triplets = shuffledTriplets(*matrix);
+
+    for (auto _ : state)
+    {
+        CapturedMatrix compressed(matrix->rows(), matrix->cols());
+        compressed.setFromTriplets(triplets.begin(), triplets.end());
+        benchmark::DoNotOptimize(compressed.valuePtr());
+    }
+
+    setMatrixCounters(state, *matrix);
+}
+
+static void BM_CapturedMatrix_Compression_CRS(benchmark::State& state, const std::string& filename)
+{
+    const auto* matrix = loadCapturedMatrix(state, filename);
+    if (matrix == nullptr)
+        return;
+    const auto triplets = shuffledTriplets(*matrix);
+
+    for (auto _ : state)
+    {
+        sofa::linearalgebra::CompressedRowSparseMatrix<double> compressed;
+        compressed.resize(matrix->rows(), matrix->cols());
+        for (const auto& t : triplets)
+        {
+            compressed.add(t.row(), t.col(), t.value());
+        }
+        compressed.compress();
+        benchmark::DoNotOptimize(compressed.colsValue.data());
+    }
+
+    setMatrixCounters(state, *matrix);
+}
+
+static void BM_CapturedMatrix_SpMV_Eigen(benchmark::State& state, const std::string& filename)
+{
+    const auto* matrix = loadCapturedMatrix(state, filename);
+    if (matrix == nullptr)
+        return;
+
+    const Eigen::VectorXd x = Eigen::VectorXd::Ones(matrix->cols());
+    Eigen::VectorXd y(matrix->rows());
+
+    for (auto _ : state)
+    {
+        y.noalias() = *matrix * x;
+        benchmark::ClobberMemory();
+    }
+
+    setMatrixCounters(state, *matrix);
+}
+
+static void BM_CapturedMatrix_SpMV_CRS(benchmark::State& state, const std::string& filename)
+{
+    const auto* matrix = loadCapturedMatrix(state, filename);
+    if (matrix == nullptr)
+        return;
+
+    sofa::linearalgebra::CompressedRowSparseMatrix<double> crs;
+    crs.resize(matrix->rows(), matrix->cols());
+    for (Eigen::Index i = 0; i < matrix->outerSize(); ++i)
+        for (CapturedMatrix::InnerIterator it(*matrix, i); it; ++it)
+            crs.add(it.row(), it.col(), it.value());
+    crs.compress();
+
+    sofa::linearalgebra::FullVector<double> x(matrix->cols()), y(matrix->rows());
+    for (Eigen::Index i = 0; i < matrix->cols(); ++i)
+        x[i] = 1;
+
+    for (auto _ : state)
+    {
+        crs.mul(y, x);
+        benchmark::ClobberMemory();
+    }
+
+    setMatrixCounters(state, *matrix);
+}
+
+static void BM_CapturedMatrix_Product_Eigen(benchmark::State& state, const std::string& filename)
+{
+    const auto* matrix = loadCapturedMatrix(state, filename);
+    if (matrix == nullptr)
+        return;
+    if (matrix->rows() != matrix->cols())
+    {
+        state.SkipWithError("A * A requires a square matrix");
+        return;
+    }
+
+    for (auto _ : state)
+    {
+        CapturedMatrix res;
+        benchmark::DoNotOptimize(res = *matrix * *matrix);
+    }
+
+    setMatrixCounters(state, *matrix);
+}
+
+static void BM_CapturedMatrix_Product_TransposeNumeric(benchmark::State& state, const std::string& filename)
+{
+    const auto* matrix = loadCapturedMatrix(state, filename);
+    if (matrix == nullptr)
+        return;
+
+    auto* taskScheduler = sofa::simulation::MainTaskSchedulerFactory::createInRegistry();
+    assert(taskScheduler != nullptr);
+    taskScheduler->init(1);
+
+    SparseTransposeProduct<double> product;
+    CapturedMatrix res;
+    product.computeSymbolic(*taskScheduler, *matrix, *matrix, res);
+
+    for (auto _ : state)
+    {
+        product.computeNumeric(*taskScheduler, *matrix, *matrix, res);
+        benchmark::DoNotOptimize(res.valuePtr());
+    }
+
+    setMatrixCounters(state, *matrix);
+}
+
+static void BM_CapturedMatrix_Factorization_SimplicialLDLT(benchmark::State& state, const std::string& filename)
+{
+    const auto* matrix = loadCapturedMatrix(state, filename);
+    if (matrix == nullptr)
+        return;
+    if (matrix->rows() != matrix->cols())
+    {
+        state.SkipWithError("The factorization requires a square matrix");
+        return;
+    }
+
+    // SimplicialLDLT works on column-major matrices
+    const Eigen::SparseMatrix<double> columnMajor = *matrix;
+    Eigen::SimplicialLDLT<Eigen::SparseMatrix<double> > solver;
+
+    const auto symbolicBegin = std::chrono::steady_clock::now();
+    solver.analyzePattern(columnMajor);
+    const auto symbolicEnd = std::chrono::steady_clock::now();
+
+    for (auto _ : state)
+    {
+        solver.factorize(columnMajor);
+        if (solver.info() != Eigen::Success)
+        {
+            state.SkipWithError("The factorization failed");
+            break;
+        }
+    }
+
+    setMatrixCounters(state, *matrix);
+    state.counters["symbolicUs"] = std::chrono::duration<double, std::micro>(symbolicEnd - symbolicBegin).count();
+}
+
+static void BM_CapturedMatrix_Factorization_SupernodalLDLT(benchmark::State& state, const std::string& filename)
+{
+    const auto* matrix = loadCapturedMatrix(state, filename);
+    if (matrix == nullptr)
+        return;
+    if (matrix->rows() != matrix->cols())
+    {
+        state.SkipWithError("The factorization requires a square matrix");
+        return;
+    }
+
+    auto* taskScheduler = sofa::simulation::MainTaskSchedulerFactory::createInRegistry();
+    assert(taskScheduler != nullptr);
+    taskScheduler->init(1);
+
+    SupernodalLDLT<double>::Matrix lower = matrix->triangularView<Eigen::Lower>();
+    lower.makeCompressed();
+    SupernodalLDLT<double> solver;
+
+    const auto symbolicBegin = std::chrono::steady_clock::now();
+    solver.analyzePattern(lower);
+    const auto symbolicEnd = std::chrono::steady_clock::now();
+
+    for (auto _ : state)
+    {
+        if (!solver.factorize(*taskScheduler, lower))
+        {
+            state.SkipWithError("The factorization failed");
+            break;
+        }
+    }
+
+    setMatrixCounters(state, *matrix);
+    state.counters["symbolicUs"] = std::chrono::duration<double, std::micro>(symbolicEnd - symbolicBegin).count();
+}
+
+/// Register the benchmarks of all the matrix files found in SOFABENCHMARK_MATRIX_DIR, sorted by name
+static bool registerCapturedMatrixBenchmarks()
+{
+    const char* directory = std::getenv("SOFABENCHMARK_MATRIX_DIR");
+    if (directory == nullptr || *directory == '\0')
+        return false;
+
+    std::vector<std::filesystem::path> files;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error))
+    {
+        if (entry.is_regular_file() && matrixio::isMatrixFile(entry.path().string()))
+            files.push_back(entry.path());
+    }
+    std::sort(files.begin(), files.end());
+
+    using Benchmark = void (*)(benchmark::State&, const std::string&);
+    const std::vector<std::pair<const char*, Benchmark> > benchmarks {
+        { "BM_CapturedMatrix_Compression_Eigen", &BM_CapturedMatrix_Compression_Eigen },
+        { "BM_CapturedMatrix_Compression_CRS", &BM_CapturedMatrix_Compression_CRS },
+        { "BM_CapturedMatrix_SpMV_Eigen", &BM_CapturedMatrix_SpMV_Eigen },
+        { "BM_CapturedMatrix_SpMV_CRS", &BM_CapturedMatrix_SpMV_CRS },
+        { "BM_CapturedMatrix_Product_Eigen", &BM_CapturedMatrix_Product_Eigen },
+        { "BM_CapturedMatrix_Product_TransposeNumeric", &BM_CapturedMatrix_Product_TransposeNumeric },
+        { "BM_CapturedMatrix_Factorization_SimplicialLDLT", &BM_CapturedMatrix_Factorization_SimplicialLDLT },
+        { "BM_CapturedMatrix_Factorization_SupernodalLDLT", &BM_CapturedMatrix_Factorization_SupernodalLDLT }
+    };
+
+    for (const auto& [name, function] : benchmarks)
+    {
+        for (const auto& file : files)
+        {
+            const auto benchmarkName = std::string(name) + "/" + file.filename().string();
+            benchmark::RegisterBenchmark(benchmarkName.c_str(), function, file.string())->Unit(benchmark::kMicrosecond);
+        }
+    }
+    return true;
+}
+
+static const bool capturedMatrixBenchmarksRegistered = registerCapturedMatrixBenchmarks();
@@ -0,0 +1,101 @@
+#include <benchmark/benchmark.h>
+#include <utils/FEMSparsityPattern.h>
+#include <utils/SparseMatrix.h>
+#include <utils/SupernodalLDLT.h>
+#include <sofa/simulation/MainTaskSchedulerFactory.h>
+#include <Eigen/Sparse>
+#include <Eigen/SparseCholesky>
+#include <cassert>
+#include <chrono>
+#include <thread>
+
+/**
+ * LDL^T factorization of stiffness-like matrices of a cubic grid of n * n * n hexahedra (3 DOFs per node),
+ * simplicial (Eigen::SimplicialLDLT, the same algorithm as SparseLDLSolver) versus supernodal
+ * (SupernodalLDLT). Both use an AMD ordering. The benchmark time is the numeric factorization, repeated as
+ * at each time step of a simulation where the sparsity does not change. Counters:
+ * - analyzeMs: duration of the symbolic analysis, done once
+ * - solveMs: duration of the forward and backward substitutions
+ * - nnzL: number of non-zeros of L
+ */
+
+const std::vector<int64_t> ldltGridSizeRange { 8, 12, 16, 20 };
+const auto ldltThreadNumberRange = benchmark::CreateRange(1, std::thread::hardware_concurrency(), 2);
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsedMs(Clock::time_point begin)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+}
+
+static Eigen::SparseMatrix<double> createLDLTMatrix(const benchmark::State& state)
+{
+    Eigen::SparseMatrix<double> matrix;
+    generateStiffnessSparseMatrix(matrix, fempattern::createGridGraph(static_cast<sofa::Index>(state.range(0)),
+        fempattern::MeshTopology::Hexahedra, fempattern::NodeOrdering::Natural), 3);
+    return matrix;
+}
+
+static void BM_SparseLDLT_Simplicial(benchmark::State& state)
+{
+    const auto matrix = createLDLTMatrix(state);
+    const Eigen::VectorXd b = Eigen::VectorXd::Ones(matrix.rows());
+
+    Eigen::SimplicialLDLT<Eigen::SparseMatrix<double> > solver;
+    const auto analyzeBegin = Clock::now();
+    solver.analyzePattern(matrix);
+    const auto analyzeMs = elapsedMs(analyzeBegin);
+
+    for (auto _ : state)
+    {
+        solver.factorize(matrix);
+    }
+
+    const auto solveBegin = Clock::now();
+    const Eigen::VectorXd x = solver.solve(b);
+    const auto solveMs = elapsedMs(solveBegin);
+    benchmark::DoNotOptimize(x.data());
+
+    state.counters["analyzeMs"] = analyzeMs;
+    state.counters["solveMs"] = solveMs;
+    state.counters["nnzL"] = static_cast<double>(solver.matrixL().nestedExpression().nonZeros() + matrix.rows());
+}
+
+static void BM_SparseLDLT_Supernodal(benchmark::State& state)
+{
+    const auto matrix = createLDLTMatrix(state);
+    const Eigen::VectorXd b = Eigen::VectorXd::Ones(matrix.rows());
+
+    auto* taskScheduler = sofa::simulation::MainTaskSchedulerFactory::createInRegistry();
+    assert(taskScheduler != nullptr);
+    taskScheduler->init(state.range(1));
+
+    SupernodalLDLT<double> solver;
+    const auto analyzeBegin = Clock::now();
+    solver.analyzePattern(matrix);
+    const auto analyzeMs = elapsedMs(analyzeBegin);
+
+    for (auto _ : state)
+    {
+        if (!solver.factorize(*taskScheduler, matrix))
+        {
+            state.SkipWithError("The factorization failed");
+            break;
+        }
+    }
+
+    Eigen::VectorXd x;
+    const auto solveBegin = Clock::now();
+    solver.solve(b, x);
+    const auto solveMs = elapsedMs(solveBegin);
+    benchmark::DoNotOptimize(x.data());
+
+    state.counters["analyzeMs"] = analyzeMs;
+    state.counters["solveMs"] = solveMs;
+    state.counters["nnzL"] = static_cast<double>(solver.getNbNonZerosL());
+    state.counters["supernodes"] = solver.getNbSupernodes();
+}
+
+BENCHMARK(BM_SparseLDLT_Simplicial)->ArgsProduct({ldltGridSizeRange})->ArgNames({"grid"})->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_SparseLDLT_Supernodal)->ArgsProduct({ldltGridSizeRange, ldltThreadNumberRange})->ArgNames({"grid", "threads"})->Threads(1)->UseRealTime()->Unit(benchmark::kMillisecond);
@@ -1,12 +1,20 @@
 #include <iostream>
 #include <benchmark/benchmark.h>
 #include <utils/RandomValuePool.h>
+#include <utils/ParallelCRSAssembly.h>
+#include <utils/PeakMemory.h>
+#include <utils/SparseMatrix.h>
 #include <sofa/linearalgebra/CompressedRowSparseMatrix.h>
+#include <sofa/simulation/MainTaskSchedulerFactory.h>
 #include <Eigen/Sparse>
+#include <cassert>
+#include <thread>
+#include <vector>
 
 constexpr int64_t minMatrixSize = 1 << 9;
 constexpr int64_t maxMatrixSize = 1 << 12;
 constexpr int64_t nbMaxNonZeros = maxMatrixSize * maxMatrixSize * 150 / 1000 + 1;
+const auto compressionThreadNumberRange = benchmark::CreateRange(1, std::thread::hardware_concurrency(), 2);
 
 template<class TReal>
 static void BM_SparseMatrixCompression_Eigen(benchmark::State& state)
@@ -70,3 +78,215 @@ static void BM_SparseMatrixCompression_CRS(benchmark::State& state)
 
 BENCHMARK_TEMPLATE(BM_SparseMatrixCompression_Eigen, SReal)->ArgsProduct({benchmark::CreateRange(minMatrixSize, maxMatrixSize, 2), {10, 20, 100, 150}})->Unit(benchmark::kMicrosecond);
 BENCHMARK_TEMPLATE(BM_SparseMatrixCompression_CRS, SReal)->ArgsProduct({benchmark::CreateRange(minMatrixSize, maxMatrixSize, 2), {10, 20, 100, 150}})->Unit(benchmark::kMicrosecond);
+
+/// Parallel counting sorts of the triplets by column then by row, and sum of the duplicates in each row
+/// (see ParallelCRSAssembly.h). The triplets are split in one buffer per thread.
+template<class TReal>
+static void BM_SparseMatrixCompression_ParallelCRS(benchmark::State& state)
+{
+    using Matrix = sofa::linearalgebra::CompressedRowSparseMatrix<TReal>;
+
+    const auto matrixSize = state.range(0);
+    const auto sparsityPerMil = state.range(1);
+    const auto sparsity = static_cast<TReal>(sparsityPerMil) / 1000.; //since only integers can be passed as an argument, a number between 0 and 1000 must be provided
+    const auto nbNonZero = static_cast<sofa::SignedIndex>(sparsity * static_cast<TReal>(matrixSize*matrixSize));
+
+    const auto& values = RandomValuePool<TReal, nbMaxNonZeros>::get();
+
+    const auto& indices_x = RandomValuePool<sofa::SignedIndex, nbMaxNonZeros>::get();
+    const auto& indices_y = RandomValuePool<sofa::SignedIndex, nbMaxNonZeros+1>::get(); //not the same size to generate other values
+
+    auto* taskScheduler = sofa::simulation::MainTaskSchedulerFactory::createInRegistry();
+    assert(taskScheduler != nullptr);
+    taskScheduler->init(state.range(2));
+    const std::size_t nbBuffers = taskScheduler->getThreadCount();
+
+    ParallelCRSAssembler<Matrix> assembler(matrixSize, matrixSize, nbBuffers);
+
+    for (auto _ : state)
+    {
+        Matrix matrix;
+
+        assembler.clear();
+        sofa::simulation::CpuTask::Status status;
+        for (std::size_t b = 0; b < nbBuffers; ++b)
+        {
+            taskScheduler->addTask(status, [&, b]()
+            {
+                auto& buffer = assembler.getBuffer(b);
+                const auto first = static_cast<std::size_t>(nbNonZero) * b / nbBuffers;
+                const auto last = static_cast<std::size_t>(nbNonZero) * (b + 1) / nbBuffers;
+                for (std::size_t i = first; i < last; ++i)
+                {
+                    buffer.add(indices_x[i], indices_y[i], values[i]);
+                }
+            });
+        }
+        taskScheduler->workUntilDone(&status);
+
+        assembler.assemble(*taskScheduler, matrix);
+    }
+
+    state.counters["nbNonZero"] = benchmark::Counter(nbNonZero);
+}
+
+BENCHMARK_TEMPLATE(BM_SparseMatrixCompression_ParallelCRS, SReal)->ArgsProduct({benchmark::CreateRange(minMatrixSize, maxMatrixSize, 2), {10, 20, 100, 150}, compressionThreadNumberRange})
+->Threads(1)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+/**
+ * Larger matrices (up to ~250k rows) with the pattern of a FEM stiffness matrix: a hexahedral grid with 3 DOFs
+ * per node (see FEMSparsityPattern.h), i.e. 81 non-zeros per row in the interior. The first argument is the
+ * number of nodes along an edge of the grid, the second the ordering of the nodes:
+ * - natural: the columns of a row are close to the diagonal (banded matrix),
+ * - random: the columns are scattered, as with the numbering of a mesher.
+ * The triplets are generated by generateStiffnessTriplets, and given to each builder in the same order. Counters:
+ * - nnz: number of input triplets per second
+ * - peakMemMB: largest memory allocated during the first build, intermediate arrays included (see PeakMemory.h)
+ * The parallel builder is measured on 1 to hardware_concurrency threads.
+ */
+
+constexpr sofa::Size nbPatternDofsPerNode = 3;
+const std::vector<int64_t> patternGridSizeRange { 11, 17, 27, 44 };
+const std::vector<int64_t> patternOrderingRange {
+    static_cast<int64_t>(fempattern::NodeOrdering::Natural),
+    static_cast<int64_t>(fempattern::NodeOrdering::Random) };
+
+static fempattern::NodeGraph createPatternGraph(const benchmark::State& state)
+{
+    return fempattern::createGridGraph(static_cast<sofa::Index>(state.range(0)),
+        fempattern::MeshTopology::Hexahedra, static_cast<fempattern::NodeOrdering>(state.range(1)));
+}
+
+static void setPatternCounters(benchmark::State& state, std::size_t nbTriplets, std::size_t peakBytes)
+{
+    state.counters["nnz"] = benchmark::Counter(static_cast<double>(nbTriplets), benchmark::Counter::kIsIterationInvariantRate);
+    state.counters["peakMemMB"] = benchmark::Counter(static_cast<double>(peakBytes) / (1024. * 1024.));
+}
+
+template<class TReal>
+static void BM_SparseMatrixCompression_Pattern_Eigen(benchmark::State& state)
+{
+    const auto graph = createPatternGraph(state);
+    const auto matrixSize = static_cast<int64_t>(graph.nbNodes() * nbPatternDofsPerNode);
+    const auto triplets = generateStiffnessTriplets<TReal>(graph, nbPatternDofsPerNode);
+
+    const auto build = [&]()
+    {
+        Eigen::SparseMatrix<TReal, Eigen::RowMajor> matrix(matrixSize, matrixSize);
+        matrix.setFromTriplets(triplets.begin(), triplets.end());
+        benchmark::DoNotOptimize(matrix.nonZeros());
+    };
+
+    std::size_t peakBytes = 0;
+    {
+        PeakMemoryTracker tracker;
+        build();
+        peakBytes = tracker.getPeakIncrease();
+    }
+
+    for (auto _ : state)
+    {
+        build();
+    }
+
+    setPatternCounters(state, triplets.size(), peakBytes);
+}
+
+template<class TReal>
+static void BM_SparseMatrixCompression_Pattern_CRS(benchmark::State& state)
+{
+    const auto graph = createPatternGraph(state);
+    const auto matrixSize = static_cast<int64_t>(graph.nbNodes() * nbPatternDofsPerNode);
+    const auto triplets = generateStiffnessTriplets<TReal>(graph, nbPatternDofsPerNode);
+
+    const auto build = [&]()
+    {
+        sofa::linearalgebra::CompressedRowSparseMatrix<TReal> matrix;
+        matrix.resize(matrixSize, matrixSize);
+        for (const auto& t : triplets)
+        {
+            matrix.add(t.row(), t.col(), t.value());
+        }
+        matrix.compress();
+        benchmark::DoNotOptimize(matrix.colsValue.data());
+    };
+
+    std::size_t peakBytes = 0;
+    {
+        PeakMemoryTracker tracker;
+        build();
+        peakBytes = tracker.getPeakIncrease();
+    }
+
+    for (auto _ : state)
+    {
+        build();
+    }
+
+    setPatternCounters(state, triplets.size(), peakBytes);
+}
+
+template<class TReal>
+static void BM_SparseMatrixCompression_Pattern_ParallelCRS(benchmark::State& state)
+{
+    using Matrix = sofa::linearalgebra::CompressedRowSparseMatrix<TReal>;
+
+    const auto graph = createPatternGraph(state);
+    const auto matrixSize = static_cast<int64_t>(graph.nbNodes() * nbPatternDofsPerNode);
+    const auto triplets = generateStiffnessTriplets<TReal>(graph, nbPatternDofsPerNode);
+
+    auto* taskScheduler = sofa::simulation::MainTaskSchedulerFactory::createInRegistry();
+    assert(taskScheduler != nullptr);
+    taskScheduler->init(state.range(2));
+    const std::size_t nbBuffers = taskScheduler->getThreadCount();
+
+    // The work arrays of the assembler are part of the memory used by the build
+    const auto build = [&]()
+    {
+        Matrix matrix;
+        ParallelCRSAssembler<Matrix> assembler(matrixSize, matrixSize, nbBuffers);
+
+        sofa::simulation::CpuTask::Status status;
+        for (std::size_t b = 0; b < nbBuffers; ++b)
+        {
+            taskScheduler->addTask(status, [&, b]()
+            {
+                auto& buffer = assembler.getBuffer(b);
+                const std::size_t first = triplets.size() * b / nbBuffers;
+                const std::size_t last = triplets.size() * (b + 1) / nbBuffers;
+                buffer.reserve(last - first);
+                for (std::size_t i = first; i < last; ++i)
+                {
+                    buffer.add(triplets[i].row(), triplets[i].col(), triplets[i].value());
+                }
+            });
+        }
+        taskScheduler->workUntilDone(&status);
+
+        assembler.assemble(*taskScheduler, matrix);
+        benchmark::DoNotOptimize(matrix.colsValue.data());
+    };
+
+    std::size_t peakBytes = 0;
+    {
+        PeakMemoryTracker tracker;
+        build();
+        peakBytes = tracker.getPeakIncrease();
+    }
+
+    for (auto _ : state)
+    {
+        build();
+    }
+
+    setPatternCounters(state, triplets.size(), peakBytes);
+}
+
+#define PATTERNARGS ->ArgsProduct({patternGridSizeRange, patternOrderingRange})->ArgNames({"grid", "ordering"})->Unit(benchmark::kMillisecond)
+
+BENCHMARK_TEMPLATE(BM_SparseMatrixCompression_Pattern_Eigen, SReal) PATTERNARGS;
+BENCHMARK_TEMPLATE(BM_SparseMatrixCompression_Pattern_CRS, SReal) PATTERNARGS;
+BENCHMARK_TEMPLATE(BM_SparseMatrixCompression_Pattern_ParallelCRS, SReal)->ArgsProduct({patternGridSizeRange, patternOrderingRange, compressionThreadNumberRange})
+->ArgNames({"grid", "ordering", "threads"})->Threads(1)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+#undef PATTERNARGS
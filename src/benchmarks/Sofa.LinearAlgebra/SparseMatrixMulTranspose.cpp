@@ -1,8 +1,15 @@
 #include <iostream>
 #include <benchmark/benchmark.h>
 #include <utils/RandomValuePool.h>
+#include <utils/SparseTransposeProduct.h>
 #include <sofa/linearalgebra/CompressedRowSparseMatrix.h>
+#include <sofa/simulation/MainTaskSchedulerFactory.h>
 #include <Eigen/Sparse>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <random>
+#include <thread>
 
 constexpr int64_t minMatrixSize = 1 << 9;
 constexpr int64_t maxMatrixSize = 1 << 12;
@@ -93,6 +100,124 @@ static void BM_SparseMatrixMulTranspose_CRS(benchmark::State& state)
     state.counters["nbNonZero"] = benchmark::Counter(nbNonZero);
 }
 
+/// Row-major matrices A and B whose entries are spread over the whole matrix. The indices of RandomValuePool
+/// are in [0, 100), which would restrict the non-zeros to the upper left corner of the matrices.
+template<class TReal>
+static void createRowMajorMatrices(int64_t matrixSize, int64_t nbNonZero,
+                                   typename SparseTransposeProduct<TReal>::Matrix& matrix_a,
+                                   typename SparseTransposeProduct<TReal>::Matrix& matrix_b)
+{
+    std::mt19937 gen(matrixSize + nbNonZero);
+    std::uniform_int_distribution<int64_t> randIndex(0, matrixSize - 1);
+    std::uniform_real_distribution<TReal> randValue(-1, 1);
+
+    matrix_a.resize(matrixSize, matrixSize);
+    matrix_b.resize(matrixSize, matrixSize);
+
+    sofa::type::vector<Eigen::Triplet<TReal> > triplets_a, triplets_b;
+    for (int64_t i = 0; i < nbNonZero; ++i)
+    {
+        triplets_a.emplace_back(randIndex(gen), randIndex(gen), randValue(gen));
+        triplets_b.emplace_back(randIndex(gen), randIndex(gen), randValue(gen));
+    }
+    matrix_a.setFromTriplets(triplets_a.begin(), triplets_a.end());
+    matrix_b.setFromTriplets(triplets_b.begin(), triplets_b.end());
+}
+
+/// Reference for the two following benchmarks: Eigen product on the same matrices, structure and values
+/// computed at each call
+template<class TReal>
+static void BM_SparseMatrixMulTranspose_EigenRowMajor(benchmark::State& state)
+{
+    const auto matrixSize = state.range(0);
+    const auto sparsity = static_cast<TReal>(state.range(1)) / 1000.;
+    const auto nbNonZero = static_cast<int64_t>(sparsity * static_cast<TReal>(matrixSize*matrixSize));
+
+    typename SparseTransposeProduct<TReal>::Matrix matrix_a, matrix_b, res;
+    createRowMajorMatrices<TReal>(matrixSize, nbNonZero, matrix_a, matrix_b);
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(res = matrix_a.transpose() * matrix_b);
+    }
+
+    state.counters["nbNonZero"] = benchmark::Counter(nbNonZero);
+    state.counters["nbNonZeroResult"] = benchmark::Counter(res.nonZeros());
+}
+
+/// Cost of the symbolic phase of SparseTransposeProduct, paid once as long as the sparsity does not change
+template<class TReal>
+static void BM_SparseMatrixMulTranspose_Symbolic(benchmark::State& state)
+{
+    const auto matrixSize = state.range(0);
+    const auto sparsity = static_cast<TReal>(state.range(1)) / 1000.;
+    const auto nbNonZero = static_cast<int64_t>(sparsity * static_cast<TReal>(matrixSize*matrixSize));
+
+    typename SparseTransposeProduct<TReal>::Matrix matrix_a, matrix_b, res;
+    createRowMajorMatrices<TReal>(matrixSize, nbNonZero, matrix_a, matrix_b);
+
+    auto* taskScheduler = sofa::simulation::MainTaskSchedulerFactory::createInRegistry();
+    assert(taskScheduler != nullptr);
+    taskScheduler->init(state.range(2));
+
+    for (auto _ : state)
+    {
+        SparseTransposeProduct<TReal> product;
+        product.computeSymbolic(*taskScheduler, matrix_a, matrix_b, res);
+        benchmark::DoNotOptimize(res.innerIndexPtr());
+    }
+
+    state.counters["nbNonZero"] = benchmark::Counter(nbNonZero);
+    state.counters["nbNonZeroResult"] = benchmark::Counter(res.nonZeros());
+}
+
+constexpr int nbSymbolicRepetitions = 5;
+
+/**
+ * Cost of the numeric phase of SparseTransposeProduct, i.e. the cost of A^T B at each time step when the
+ * sparsity is constant. The symbolic phase is computed before the loop nbSymbolicRepetitions times, and its
+ * shortest duration is reported in the counter symbolicUs.
+ */
+template<class TReal>
+static void BM_SparseMatrixMulTranspose_Numeric(benchmark::State& state)
+{
+    const auto matrixSize = state.range(0);
+    const auto sparsity = static_cast<TReal>(state.range(1)) / 1000.;
+    const auto nbNonZero = static_cast<int64_t>(sparsity * static_cast<TReal>(matrixSize*matrixSize));
+
+    typename SparseTransposeProduct<TReal>::Matrix matrix_a, matrix_b, res;
+    createRowMajorMatrices<TReal>(matrixSize, nbNonZero, matrix_a, matrix_b);
+
+    auto* taskScheduler = sofa::simulation::MainTaskSchedulerFactory::createInRegistry();
+    assert(taskScheduler != nullptr);
+    taskScheduler->init(state.range(2));
+
+    SparseTransposeProduct<TReal> product;
+    double symbolicUs = std::numeric_limits<double>::max();
+    for (int rep = 0; rep < nbSymbolicRepetitions; ++rep)
+    {
+        product = SparseTransposeProduct<TReal>();
+        const auto begin = std::chrono::steady_clock::now();
+        product.computeSymbolic(*taskScheduler, matrix_a, matrix_b, res);
+        const auto end = std::chrono::steady_clock::now();
+        symbolicUs = std::min(symbolicUs, std::chrono::duration<double, std::micro>(end - begin).count());
+    }
+
+    for (auto _ : state)
+    {
+        product.computeNumeric(*taskScheduler, matrix_a, matrix_b, res);
+        benchmark::ClobberMemory();
+    }
+
+    state.counters["nbNonZero"] = benchmark::Counter(nbNonZero);
+    state.counters["nbNonZeroResult"] = benchmark::Counter(res.nonZeros());
+    state.counters["symbolicUs"] = symbolicUs;
+}
+
+const auto mulTransposeThreadNumberRange = benchmark::CreateRange(1, std::thread::hardware_concurrency(), 2);
 
 BENCHMARK_TEMPLATE(BM_SparseMatrixMulTranspose_Eigen, SReal)->ArgsProduct({benchmark::CreateRange(minMatrixSize, maxMatrixSize, 2), {10, 20, 100, 150}})->Unit(benchmark::kMicrosecond);
 BENCHMARK_TEMPLATE(BM_SparseMatrixMulTranspose_CRS, SReal)->ArgsProduct({benchmark::CreateRange(minMatrixSize, maxMatrixSize, 2), {10, 20, 100, 150}})->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_SparseMatrixMulTranspose_EigenRowMajor, SReal)->ArgsProduct({benchmark::CreateRange(minMatrixSize, maxMatrixSize, 2), {10, 20, 100, 150}})->ArgNames({"size", "sparsity"})->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_SparseMatrixMulTranspose_Symbolic, SReal)->ArgsProduct({benchmark::CreateRange(minMatrixSize, maxMatrixSize, 2), {10, 20, 100, 150}, mulTransposeThreadNumberRange})->ArgNames({"size", "sparsity", "threads"})->Threads(1)->UseRealTime()->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_SparseMatrixMulTranspose_Numeric, SReal)->ArgsProduct({benchmark::CreateRange(minMatrixSize, maxMatrixSize, 2), {10, 20, 100, 150}, mulTransposeThreadNumberRange})->ArgNames({"size", "sparsity", "threads"})->Threads(1)->UseRealTime()->Unit(benchmark::kMicrosecond);
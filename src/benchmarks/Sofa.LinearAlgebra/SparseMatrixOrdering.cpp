@@ -0,0 +1,116 @@
+#include <benchmark/benchmark.h>
+#include <utils/BlockSparseMatrixProduct.h>
+#include <utils/FEMSparsityPattern.h>
+#include <utils/SparseMatrix.h>
+#include <sofa/linearalgebra/CompressedRowSparseMatrix.h>
+#include <sofa/linearalgebra/FullVector.h>
+#include <Eigen/Sparse>
+
+/**
+ * Sparse kernels on stiffness-like matrices of a cubic grid of n * n * n nodes with 3 DOFs, meshed with
+ * hexahedra (27 coupled nodes per row) or tetrahedra (15), and numbered in the natural order of the grid, in
+ * a random order (as an unstructured mesh), or renumbered with RCM or AMD. The pattern being the same, the
+ * differences between the orderings come from the locality of the accesses to the vectors and blocks.
+ * Counters:
+ * - bandwidth: largest distance between two coupled nodes
+ * - nnzPerRow: average number of scalar non-zeros per row
+ */
+
+const std::vector<int64_t> orderingGridSizeRange { 16, 32, 48 };
+const std::vector<int64_t> orderingProductGridSizeRange { 8, 16, 24 };
+const std::vector<int64_t> meshTopologyRange {
+    static_cast<int64_t>(fempattern::MeshTopology::Hexahedra),
+    static_cast<int64_t>(fempattern::MeshTopology::Tetrahedra) };
+const std::vector<int64_t> nodeOrderingRange {
+    static_cast<int64_t>(fempattern::NodeOrdering::Natural),
+    static_cast<int64_t>(fempattern::NodeOrdering::Random),
+    static_cast<int64_t>(fempattern::NodeOrdering::RCM),
+    static_cast<int64_t>(fempattern::NodeOrdering::AMD) };
+
+using Mat3x3d = sofa::type::Mat<3, 3, double>;
+
+static fempattern::NodeGraph createGraph(const benchmark::State& state)
+{
+    return fempattern::createGridGraph(static_cast<sofa::Index>(state.range(0)),
+        static_cast<fempattern::MeshTopology>(state.range(1)),
+        static_cast<fempattern::NodeOrdering>(state.range(2)));
+}
+
+static void setOrderingCounters(benchmark::State& state, const fempattern::NodeGraph& graph)
+{
+    state.SetLabel(fempattern::toString(static_cast<fempattern::NodeOrdering>(state.range(2))));
+    state.counters["bandwidth"] = static_cast<double>(fempattern::bandwidth(graph));
+    state.counters["nnzPerRow"] = 3. * static_cast<double>(graph.nbEntries()) / static_cast<double>(graph.nbNodes());
+}
+
+static void BM_SparseMatrixOrdering_SpMV_Eigen(benchmark::State& state)
+{
+    const auto graph = createGraph(state);
+    Eigen::SparseMatrix<double, Eigen::RowMajor> matrix;
+    generateStiffnessSparseMatrix(matrix, graph, 3);
+
+    const Eigen::VectorXd x = Eigen::VectorXd::Ones(matrix.cols());
+    Eigen::VectorXd y(matrix.rows());
+
+    for (auto _ : state)
+    {
+        y.noalias() = matrix * x;
+        benchmark::ClobberMemory();
+    }
+
+    setOrderingCounters(state, graph);
+}
+
+static void BM_SparseMatrixOrdering_SpMV_CRS3x3(benchmark::State& state)
+{
+    const auto graph = createGraph(state);
+    sofa::linearalgebra::CompressedRowSparseMatrix<Mat3x3d> matrix;
+    generateStiffnessBlockSparseMatrix(matrix, graph);
+
+    const auto n = 3 * matrix.rowBSize();
+    sofa::linearalgebra::FullVector<double> x(n), y(n);
+    for (std::size_t i = 0; i < n; ++i)
+        x[i] = 1;
+
+    for (auto _ : state)
+    {
+        matrix.mul(y, x);
+        benchmark::ClobberMemory();
+    }
+
+    setOrderingCounters(state, graph);
+}
+
+/// K * K from the block intersection: the locality of the accesses to the blocks of the right-hand side
+/// depends on the ordering
+static void BM_SparseMatrixOrdering_BlockProduct(benchmark::State& state)
+{
+    using Matrix = sofa::linearalgebra::CompressedRowSparseMatrix<Mat3x3d>;
+
+    const auto graph = createGraph(state);
+    Matrix matrix;
+    generateStiffnessBlockSparseMatrix(matrix, graph);
+
+    BlockSparseMatrixProduct<Matrix, Matrix, Matrix> product;
+    product.m_lhs = &matrix;
+    product.m_rhs = &matrix;
+    product.computeProduct();
+
+    for (auto _ : state)
+    {
+        product.computeProduct();
+    }
+
+    setOrderingCounters(state, graph);
+}
+
+#define ORDERINGARGS(sizes) \
+    ->ArgsProduct({sizes, meshTopologyRange, nodeOrderingRange}) \
+    ->ArgNames({"grid", "topology", "ordering"}) \
+    ->Unit(benchmark::kMicrosecond)
+
+BENCHMARK(BM_SparseMatrixOrdering_SpMV_Eigen) ORDERINGARGS(orderingGridSizeRange);
+BENCHMARK(BM_SparseMatrixOrdering_SpMV_CRS3x3) ORDERINGARGS(orderingGridSizeRange);
+BENCHMARK(BM_SparseMatrixOrdering_BlockProduct) ORDERINGARGS(orderingProductGridSizeRange);
+
+#undef ORDERINGARGS
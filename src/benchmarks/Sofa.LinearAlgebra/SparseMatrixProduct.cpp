@@ -6,7 +6,9 @@
 #include <sofa/simulation/MainTaskSchedulerFactory.h>
 #include <sofa/simulation/MainTaskSchedulerRegistry.h>
 #include <sofa/simulation/ParallelSparseMatrixProduct.h>
+#include <utils/BlockSparseMatrixProduct.h>
 #include <utils/SparseMatrix.h>
+#include <tuple>
 
 template<class T>
 struct SparseMatrixProductInit
@@ -37,9 +39,46 @@ struct SparseMatrixProductInit<
     }
 };
 
+template<class Lhs, class Rhs, class ResultType>
+struct SparseMatrixProductInit<ParallelBlockSparseMatrixProduct<Lhs, Rhs, ResultType>>
+{
+    static void init(ParallelBlockSparseMatrixProduct<Lhs, Rhs, ResultType>& product)
+    {
+        product.taskScheduler = sofa::simulation::MainTaskSchedulerFactory::createInRegistry();
+        product.taskScheduler->init();
+    };
 
-template<class TProduct>
-class BM_SparseMatrixProduct : public benchmark::Fixture
+    static void cleanup()
+    {
+        sofa::simulation::MainTaskSchedulerRegistry::clear();
+    }
+};
+
+/// Random matrices: the first argument is the size of the matrices, the second the ratio of non-zeros, per mil
+struct RandomProductMatrices
+{
+    template<class TMatrix>
+    static void generate(TMatrix& matrix, int64_t matrixSize, int64_t sparsityPerMil)
+    {
+        const auto sparsity = static_cast<SReal>(sparsityPerMil) / 1000.; //since only integers can be passed as an argument, a number between 0 and 1000 must be provided
+        generateRandomSparseMatrix(matrix, matrixSize, matrixSize, sparsity);
+    }
+};
+
+/// Stiffness-like matrices of a hexahedral grid with 3 DOFs per node: the first argument is the number of nodes
+/// along an edge of the grid, the second the ordering of the nodes
+struct FEMPatternProductMatrices
+{
+    template<class TMatrix>
+    static void generate(TMatrix& matrix, int64_t gridSize, int64_t ordering)
+    {
+        generateStiffnessSparseMatrix(matrix, fempattern::createGridGraph(static_cast<sofa::Index>(gridSize),
+            fempattern::MeshTopology::Hexahedra, static_cast<fempattern::NodeOrdering>(ordering)), 3);
+    }
+};
+
+template<class TProduct, class TMatrixGenerator>
+class SparseMatrixProductFixture : public benchmark::Fixture
 {
 public:
     using MatrixLHS = typename TProduct::LhsCleaned;
@@ -47,16 +86,15 @@ public:
 
     void SetUp(const ::benchmark::State& state) override
     {
-        const auto matrixSize = state.range(0);
-        const auto sparsityPerMil = state.range(1);
-        const auto sparsity = static_cast<SReal>(sparsityPerMil) / 1000.; //since only integers can be passed as an argument, a number between 0 and 1000 must be provided
+        const auto arg0 = state.range(0);
+        const auto arg1 = state.range(1);
 
-        auto itA = matrixMapA.find({matrixSize, sparsityPerMil});
+        auto itA = matrixMapA.find({arg0, arg1});
         if (itA == matrixMapA.end())
         {
             MatrixLHS matrixA;
-            generateRandomSparseMatrix(matrixA, matrixSize, matrixSize, sparsity);
-            if (const auto insertIt = matrixMapA.insert({{matrixSize, sparsityPerMil}, matrixA}); insertIt.second)
+            TMatrixGenerator::generate(matrixA, arg0, arg1);
+            if (const auto insertIt = matrixMapA.insert({{arg0, arg1}, matrixA}); insertIt.second)
             {
                 a = &insertIt.first->second;
             }
@@ -66,12 +104,12 @@ public:
             a = &itA->second;
         }
 
-        auto itB = matrixMapB.find({matrixSize, sparsityPerMil});
+        auto itB = matrixMapB.find({arg0, arg1});
         if (itB == matrixMapB.end())
         {
             MatrixRHS matrixB;
-            generateRandomSparseMatrix(matrixB, matrixSize, matrixSize, sparsity);
-            if (const auto insertIt = matrixMapB.insert({ {matrixSize, sparsityPerMil}, matrixB}); insertIt.second)
+            TMatrixGenerator::generate(matrixB, arg0, arg1);
+            if (const auto insertIt = matrixMapB.insert({ {arg0, arg1}, matrixB}); insertIt.second)
             {
                 b = &insertIt.first->second;
             }
@@ -81,11 +119,11 @@ public:
             b = &itB->second;
         }
 
-        auto it = productMap.find({matrixSize, sparsityPerMil});
+        auto it = productMap.find({arg0, arg1});
         if (it == productMap.end())
         {
             TProduct p;
-            const auto insertIt = productMap.insert({ {matrixSize, sparsityPerMil}, p});
+            const auto insertIt = productMap.insert({ {arg0, arg1}, p});
             if (insertIt.second)
             {
                 product = &insertIt.first->second;
@@ -138,48 +176,72 @@ private:
     static std::map< std::pair< int, int>, TProduct > productMap;
 };
 
+template<class TProduct, class TMatrixGenerator>
+std::map< std::pair< int, int>, typename SparseMatrixProductFixture<TProduct, TMatrixGenerator>::MatrixLHS> SparseMatrixProductFixture<TProduct, TMatrixGenerator>::matrixMapA;
+template<class TProduct, class TMatrixGenerator>
+std::map< std::pair< int, int>, typename SparseMatrixProductFixture<TProduct, TMatrixGenerator>::MatrixRHS> SparseMatrixProductFixture<TProduct, TMatrixGenerator>::matrixMapB;
+template<class TProduct, class TMatrixGenerator>
+std::map< std::pair< int, int>, TProduct > SparseMatrixProductFixture<TProduct, TMatrixGenerator>::productMap;
+
+/// Products of random matrices
 template<class TProduct>
-std::map< std::pair< int, int>, typename BM_SparseMatrixProduct<TProduct>::MatrixLHS> BM_SparseMatrixProduct<TProduct>::matrixMapA;
-template<class TProduct>
-std::map< std::pair< int, int>, typename BM_SparseMatrixProduct<TProduct>::MatrixRHS> BM_SparseMatrixProduct<TProduct>::matrixMapB;
+class BM_SparseMatrixProduct : public SparseMatrixProductFixture<TProduct, RandomProductMatrices> {};
+
+/**
+ * Products of stiffness-like matrices of a hexahedral grid with 3 DOFs per node (see FEMSparsityPattern.h),
+ * from 81 to ~10k rows. The first argument is the number of nodes along an edge of the grid, the second the
+ * ordering of the nodes: natural (banded) or random (scattered, as the numbering of a mesher).
+ */
 template<class TProduct>
-std::map< std::pair< int, int>, TProduct > BM_SparseMatrixProduct<TProduct>::productMap;
+class BM_SparseMatrixProduct_FEMPattern : public SparseMatrixProductFixture<TProduct, FEMPatternProductMatrices> {};
+
+const std::vector<int64_t> productOrderingRange {
+    static_cast<int64_t>(fempattern::NodeOrdering::Natural),
+    static_cast<int64_t>(fempattern::NodeOrdering::Random) };
 
 #define BENCHARGS \
     ->ArgsProduct({{100, 1000}, {10, 20, 100, 150}}) \
     ->Args({10000, 1}) \
     ->Args({10000, 5}) \
 
-#define SPARSEMATRIXPRODUCTBENCHMARK(Name, ScalarType, ProductType, StorageLHS, StorageRHS, StorageResult) \
-    using Product ## Name = ProductType< \
-        Eigen::SparseMatrix<ScalarType, StorageLHS>, \
-        Eigen::SparseMatrix<ScalarType, StorageRHS>, \
-        Eigen::SparseMatrix<ScalarType, StorageResult> \
-    >;\
-    BENCHMARK_TEMPLATE_DEFINE_F(BM_SparseMatrixProduct, RegularProduct ## Name, Product ## Name)(benchmark::State& st) \
+#define FEMPATTERNBENCHARGS \
+    ->ArgsProduct({{3, 7, 15}, productOrderingRange}) \
+    ->ArgNames({"grid", "ordering"}) \
+
+#define SPARSEMATRIXPRODUCTFIXTUREBENCHMARK(Fixture, Name, Args) \
+    BENCHMARK_TEMPLATE_DEFINE_F(Fixture, RegularProduct ## Name, Product ## Name)(benchmark::State& st) \
     { \
         for (auto _ : st) \
         {\
             this->regularProduct(st); \
         }\
     } \
-    BENCHMARK_TEMPLATE_DEFINE_F(BM_SparseMatrixProduct, FastProduct ## Name, Product ## Name)(benchmark::State& st) \
+    BENCHMARK_TEMPLATE_DEFINE_F(Fixture, FastProduct ## Name, Product ## Name)(benchmark::State& st) \
     { \
         for (auto _ : st) \
         {\
             this->fastProduct(st); \
         }\
     } \
-    BENCHMARK_TEMPLATE_DEFINE_F(BM_SparseMatrixProduct, ForceComputingIntersection ## Name, Product ## Name)(benchmark::State& st) \
+    BENCHMARK_TEMPLATE_DEFINE_F(Fixture, ForceComputingIntersection ## Name, Product ## Name)(benchmark::State& st) \
     { \
         for (auto _ : st) \
         {\
             this->forceComputingIntersection(st); \
         }\
     }\
-    BENCHMARK_REGISTER_F(BM_SparseMatrixProduct, RegularProduct ## Name)->Unit(benchmark::kMicrosecond) BENCHARGS;\
-    BENCHMARK_REGISTER_F(BM_SparseMatrixProduct, FastProduct ## Name)->Unit(benchmark::kMicrosecond) BENCHARGS;\
-    BENCHMARK_REGISTER_F(BM_SparseMatrixProduct, ForceComputingIntersection ## Name)->Unit(benchmark::kMicrosecond) BENCHARGS;
+    BENCHMARK_REGISTER_F(Fixture, RegularProduct ## Name)->Unit(benchmark::kMicrosecond) Args;\
+    BENCHMARK_REGISTER_F(Fixture, FastProduct ## Name)->Unit(benchmark::kMicrosecond) Args;\
+    BENCHMARK_REGISTER_F(Fixture, ForceComputingIntersection ## Name)->Unit(benchmark::kMicrosecond) Args;
+
+#define SPARSEMATRIXPRODUCTBENCHMARK(Name, ScalarType, ProductType, StorageLHS, StorageRHS, StorageResult) \
+    using Product ## Name = ProductType< \
+        Eigen::SparseMatrix<ScalarType, StorageLHS>, \
+        Eigen::SparseMatrix<ScalarType, StorageRHS>, \
+        Eigen::SparseMatrix<ScalarType, StorageResult> \
+    >;\
+    SPARSEMATRIXPRODUCTFIXTUREBENCHMARK(BM_SparseMatrixProduct, Name, BENCHARGS) \
+    SPARSEMATRIXPRODUCTFIXTUREBENCHMARK(BM_SparseMatrixProduct_FEMPattern, Name, FEMPATTERNBENCHARGS)
 
 
 using Eigen::ColMajor;
@@ -203,5 +265,131 @@ SPARSEMATRIXPRODUCTBENCHMARK(ParRowColRow, SReal, sofa::simulation::ParallelSpar
 SPARSEMATRIXPRODUCTBENCHMARK(ParColRowRow, SReal, sofa::simulation::ParallelSparseMatrixProduct, ColMajor, RowMajor, RowMajor)
 SPARSEMATRIXPRODUCTBENCHMARK(ParRowRowRow, SReal, sofa::simulation::ParallelSparseMatrixProduct, RowMajor, RowMajor, RowMajor)
 
+/**
+ * Products of matrices made of NxN blocks (3x3 for deformable objects, 6x6 for rigids), computed either on
+ * the scalar matrices with SparseMatrixProduct and ParallelSparseMatrixProduct, or on the blocks with
+ * BlockSparseMatrixProduct and ParallelBlockSparseMatrixProduct, to measure the gain of an intersection
+ * computed at the block level. Both use the same block sparsity pattern: one block per pair of nodes of a
+ * hexahedral grid sharing an element, i.e. 27 blocks per row in the interior.
+ * The first argument is the number of nodes along an edge of the grid, the second the ordering of the nodes.
+ */
+
+template<sofa::Size N>
+using BlockMatrix = sofa::linearalgebra::CompressedRowSparseMatrix<sofa::type::Mat<N, N, SReal> >;
+
+template<sofa::Size N>
+using ScalarProduct = sofa::linearalgebra::SparseMatrixProduct<
+    Eigen::SparseMatrix<SReal, RowMajor>, Eigen::SparseMatrix<SReal, RowMajor>, Eigen::SparseMatrix<SReal, RowMajor> >;
+template<sofa::Size N>
+using ParallelScalarProduct = sofa::simulation::ParallelSparseMatrixProduct<
+    Eigen::SparseMatrix<SReal, RowMajor>, Eigen::SparseMatrix<SReal, RowMajor>, Eigen::SparseMatrix<SReal, RowMajor> >;
+template<sofa::Size N>
+using BlockedProduct = BlockSparseMatrixProduct<BlockMatrix<N>, BlockMatrix<N>, BlockMatrix<N> >;
+template<sofa::Size N>
+using ParallelBlockedProduct = ParallelBlockSparseMatrixProduct<BlockMatrix<N>, BlockMatrix<N>, BlockMatrix<N> >;
+
+/// Block matrix generated once per grid size, ordering and operand (0 for lhs, 1 for rhs)
+template<sofa::Size N>
+static const BlockMatrix<N>& getBlockMatrix(int64_t gridSize, int64_t ordering, int operand)
+{
+    static std::map<std::tuple<int64_t, int64_t, int>, BlockMatrix<N> > matrices;
+    const auto key = std::make_tuple(gridSize, ordering, operand);
+    auto it = matrices.find(key);
+    if (it == matrices.end())
+    {
+        it = matrices.emplace(key, BlockMatrix<N>()).first;
+        generateStiffnessBlockSparseMatrix(it->second, fempattern::createGridGraph(static_cast<sofa::Index>(gridSize),
+            fempattern::MeshTopology::Hexahedra, static_cast<fempattern::NodeOrdering>(ordering)));
+    }
+    return it->second;
+}
+
+template<sofa::Size N>
+static void convertBlockMatrix(const BlockMatrix<N>& blockMatrix, BlockMatrix<N>& matrix)
+{
+    matrix = blockMatrix;
+}
+
+template<sofa::Size N, int Options>
+static void convertBlockMatrix(const BlockMatrix<N>& blockMatrix, Eigen::SparseMatrix<SReal, Options>& matrix)
+{
+    sofa::type::vector<Eigen::Triplet<SReal> > triplets;
+    triplets.reserve(N * N * blockMatrix.colsIndex.size());
+    for (std::size_t i = 0; i < blockMatrix.rowIndex.size(); ++i)
+    {
+        for (auto k = blockMatrix.rowBegin[i]; k < blockMatrix.rowBegin[i + 1]; ++k)
+        {
+            for (sofa::Size r = 0; r < N; ++r)
+                for (sofa::Size c = 0; c < N; ++c)
+                    triplets.emplace_back(N * blockMatrix.rowIndex[i] + r, N * blockMatrix.colsIndex[k] + c, blockMatrix.colsValue[k][r][c]);
+        }
+    }
+    matrix.resize(N * blockMatrix.rowBSize(), N * blockMatrix.colBSize());
+    matrix.setFromTriplets(triplets.begin(), triplets.end());
+}
+
+template<class TProduct, sofa::Size N>
+static void BM_BlockSparseMatrixProduct(benchmark::State& state, bool forceComputingIntersection)
+{
+    typename TProduct::LhsCleaned lhs;
+    typename TProduct::RhsCleaned rhs;
+    convertBlockMatrix(getBlockMatrix<N>(state.range(0), state.range(1), 0), lhs);
+    convertBlockMatrix(getBlockMatrix<N>(state.range(0), state.range(1), 1), rhs);
+
+    TProduct product;
+    SparseMatrixProductInit<TProduct>::init(product);
+    product.m_lhs = &lhs;
+    product.m_rhs = &rhs;
+    product.computeProduct();
+
+    for (auto _ : state)
+    {
+        product.computeProduct(forceComputingIntersection);
+    }
+
+    state.counters["nbBlocks"] = static_cast<double>(getBlockMatrix<N>(state.range(0), state.range(1), 0).colsIndex.size());
+
+    SparseMatrixProductInit<TProduct>::cleanup();
+}
+
+/// Intersection and product at each iteration
+template<class TProduct, sofa::Size N>
+static void BM_BlockSparseMatrixProduct_ForceComputingIntersection(benchmark::State& state)
+{
+    BM_BlockSparseMatrixProduct<TProduct, N>(state, true);
+}
+
+/// Product from the intersection computed before the loop
+template<class TProduct, sofa::Size N>
+static void BM_BlockSparseMatrixProduct_FastProduct(benchmark::State& state)
+{
+    BM_BlockSparseMatrixProduct<TProduct, N>(state, false);
+}
+
+// From 125 to ~5k block rows. The size of the intersection on the scalar matrices grows with N^3: the
+// largest grids are not run
+#define BLOCKBENCHARGS \
+    ->ArgsProduct({{5, 10, 17}, productOrderingRange}) \
+    ->ArgNames({"grid", "ordering"}) \
+    ->Unit(benchmark::kMicrosecond)
+
+#define BLOCKSPARSEMATRIXPRODUCTBENCHMARK(ProductType, N) \
+    BENCHMARK_TEMPLATE(BM_BlockSparseMatrixProduct_ForceComputingIntersection, ProductType<N>, N) BLOCKBENCHARGS; \
+    BENCHMARK_TEMPLATE(BM_BlockSparseMatrixProduct_FastProduct, ProductType<N>, N) BLOCKBENCHARGS;
+
+BLOCKSPARSEMATRIXPRODUCTBENCHMARK(ScalarProduct, 3)
+BLOCKSPARSEMATRIXPRODUCTBENCHMARK(ParallelScalarProduct, 3)
+BLOCKSPARSEMATRIXPRODUCTBENCHMARK(BlockedProduct, 3)
+BLOCKSPARSEMATRIXPRODUCTBENCHMARK(ParallelBlockedProduct, 3)
+
+BLOCKSPARSEMATRIXPRODUCTBENCHMARK(ScalarProduct, 6)
+BLOCKSPARSEMATRIXPRODUCTBENCHMARK(ParallelScalarProduct, 6)
+BLOCKSPARSEMATRIXPRODUCTBENCHMARK(BlockedProduct, 6)
+BLOCKSPARSEMATRIXPRODUCTBENCHMARK(ParallelBlockedProduct, 6)
+
+#undef BLOCKSPARSEMATRIXPRODUCTBENCHMARK
+#undef BLOCKBENCHARGS
 #undef BENCHARGS
+#undef FEMPATTERNBENCHARGS
+#undef SPARSEMATRIXPRODUCTFIXTUREBENCHMARK
 #undef SPARSEMATRIXPRODUCTBENCHMARK
@@ -0,0 +1,280 @@
+#include <benchmark/benchmark.h>
+#include <utils/BlockSparseMatrix.h>
+#include <utils/SparseMatrix.h>
+#include <sofa/linearalgebra/CompressedRowSparseMatrix.h>
+#include <sofa/linearalgebra/FullVector.h>
+#include <sofa/simulation/MainTaskSchedulerFactory.h>
+#include <Eigen/Sparse>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <random>
+#include <thread>
+#include <vector>
+
+/**
+ * Sparse matrix-vector products, as in the iterations of CGLinearSolver, on the stiffness-like matrix of a
+ * cubic grid of nodes with 3 DOFs meshed with hexahedra (see FEMSparsityPattern.h): each node is coupled to
+ * its 27 neighbors, so each block row has up to 27 blocks of 3x3.
+ * Compared implementations: CompressedRowSparseMatrix::mul with 3x3 blocks and with scalars, a row-major
+ * Eigen::SparseMatrix, and the BSR kernels of BlockSparseMatrix.h (double or float storage, always
+ * accumulated in double) on several threads. The BSR product is measured with each of its kernels (scalar,
+ * AVX2/FMA selected at runtime), whose name is the label of the benchmark. Before being measured, the BSR
+ * products are checked against CompressedRowSparseMatrix::mul and mulTranspose.
+ * The first argument is the number of nodes along an edge of the grid. Counters:
+ * - blocks: number of 3x3 blocks processed per second
+ * - bytes: minimal memory traffic per second (matrix values and indices, input and output vectors)
+ */
+
+const std::vector<int64_t> gridSizeRange { 8, 16, 32, 48 };
+const auto spmvThreadNumberRange = benchmark::CreateRange(1, std::thread::hardware_concurrency(), 2);
+
+using CRS3x3d = sofa::linearalgebra::CompressedRowSparseMatrix<sofa::type::Mat<3, 3, double> >;
+
+/// Matrix of the grid, built once per size and shared by all the benchmarks
+static const CRS3x3d& getGridMatrix(int64_t gridSize)
+{
+    static std::map<int64_t, CRS3x3d> matrices;
+    auto it = matrices.find(gridSize);
+    if (it != matrices.end())
+        return it->second;
+
+    CRS3x3d& matrix = matrices[gridSize];
+    generateStiffnessBlockSparseMatrix(matrix, fempattern::createGridGraph(static_cast<sofa::Index>(gridSize),
+        fempattern::MeshTopology::Hexahedra, fempattern::NodeOrdering::Natural));
+    return matrix;
+}
+
+static std::vector<double> createVector(std::size_t size)
+{
+    std::mt19937 gen(13);
+    std::uniform_real_distribution<double> rand(-1, 1);
+    std::vector<double> v(size);
+    for (auto& e : v)
+        e = rand(gen);
+    return v;
+}
+
+static void setSpMVCounters(benchmark::State& state, std::size_t nbBlocks, std::size_t nbBlockRows, std::size_t bytesPerValue)
+{
+    const double bytes = static_cast<double>(nbBlocks) * (9 * bytesPerValue + sizeof(sofa::Index))
+        + static_cast<double>(nbBlockRows) * (sizeof(sofa::Index) + 2 * 3 * sizeof(double));
+    state.counters["blocks"] = benchmark::Counter(static_cast<double>(nbBlocks), benchmark::Counter::kIsIterationInvariantRate);
+    state.counters["bytes"] = benchmark::Counter(bytes, benchmark::Counter::kIsIterationInvariantRate, benchmark::Counter::OneK::kIs1024);
+}
+
+static void BM_SpMV_CRS3x3(benchmark::State& state)
+{
+    const auto& matrix = getGridMatrix(state.range(0));
+    const auto n = 3 * matrix.rowBSize();
+    const auto values = createVector(n);
+
+    sofa::linearalgebra::FullVector<double> x(n), y(n);
+    for (std::size_t i = 0; i < n; ++i)
+        x[i] = values[i];
+
+    for (auto _ : state)
+    {
+        matrix.mul(y, x);
+        benchmark::ClobberMemory();
+    }
+
+    setSpMVCounters(state, matrix.colsIndex.size(), matrix.rowBSize(), sizeof(double));
+}
+
+static void BM_SpMV_CRSScalar(benchmark::State& state)
+{
+    const auto& blockMatrix = getGridMatrix(state.range(0));
+    const auto n = 3 * blockMatrix.rowBSize();
+    const auto values = createVector(n);
+
+    sofa::linearalgebra::CompressedRowSparseMatrix<double> matrix;
+    matrix.resize(n, n);
+    for (std::size_t i = 0; i < blockMatrix.rowIndex.size(); ++i)
+    {
+        for (auto k = blockMatrix.rowBegin[i]; k < blockMatrix.rowBegin[i + 1]; ++k)
+        {
+            matrix.add(3 * blockMatrix.rowIndex[i], 3 * blockMatrix.colsIndex[k], blockMatrix.colsValue[k]);
+        }
+    }
+    matrix.compress();
+
+    sofa::linearalgebra::FullVector<double> x(n), y(n);
+    for (std::size_t i = 0; i < n; ++i)
+        x[i] = values[i];
+
+    for (auto _ : state)
+    {
+        matrix.mul(y, x);
+        benchmark::ClobberMemory();
+    }
+
+    // 9 column indices per block instead of 1
+    setSpMVCounters(state, blockMatrix.colsIndex.size(), blockMatrix.rowBSize(), sizeof(double) + sizeof(sofa::Index));
+}
+
+static Eigen::SparseMatrix<double, Eigen::RowMajor> toEigen(const CRS3x3d& blockMatrix)
+{
+    const auto n = static_cast<Eigen::Index>(3 * blockMatrix.rowBSize());
+    std::vector<Eigen::Triplet<double> > triplets;
+    triplets.reserve(9 * blockMatrix.colsIndex.size());
+    for (std::size_t i = 0; i < blockMatrix.rowIndex.size(); ++i)
+    {
+        for (auto k = blockMatrix.rowBegin[i]; k < blockMatrix.rowBegin[i + 1]; ++k)
+        {
+            for (int r = 0; r < 3; ++r)
+                for (int c = 0; c < 3; ++c)
+                    triplets.emplace_back(3 * blockMatrix.rowIndex[i] + r, 3 * blockMatrix.colsIndex[k] + c, blockMatrix.colsValue[k][r][c]);
+        }
+    }
+    Eigen::SparseMatrix<double, Eigen::RowMajor> matrix(n, n);
+    matrix.setFromTriplets(triplets.begin(), triplets.end());
+    return matrix;
+}
+
+static void BM_SpMV_Eigen(benchmark::State& state)
+{
+    const auto& blockMatrix = getGridMatrix(state.range(0));
+    const auto matrix = toEigen(blockMatrix);
+    const auto values = createVector(matrix.rows());
+
+    const Eigen::VectorXd x = Eigen::Map<const Eigen::VectorXd>(values.data(), matrix.rows());
+    Eigen::VectorXd y(matrix.rows());
+
+    for (auto _ : state)
+    {
+        y.noalias() = matrix * x;
+        benchmark::ClobberMemory();
+    }
+
+    setSpMVCounters(state, blockMatrix.colsIndex.size(), blockMatrix.rowBSize(), sizeof(double) + sizeof(int));
+}
+
+/// True if y is equal to the product computed by CompressedRowSparseMatrix, up to the rounding of the values
+/// of the matrix stored in StorageReal
+template<typename StorageReal>
+static bool isSameProduct(const std::vector<double>& y, const sofa::linearalgebra::FullVector<double>& reference)
+{
+    double maxReference = 0;
+    double maxDifference = 0;
+    for (std::size_t i = 0; i < y.size(); ++i)
+    {
+        maxReference = std::max(maxReference, std::abs(reference[i]));
+        maxDifference = std::max(maxDifference, std::abs(y[i] - reference[i]));
+    }
+    return maxDifference <= 100 * std::numeric_limits<StorageReal>::epsilon() * maxReference;
+}
+
+template<typename StorageReal>
+static void BM_SpMV_BSR(benchmark::State& state)
+{
+    const auto kernel = static_cast<bsr::Kernel>(state.range(2));
+    state.SetLabel(bsr::toString(kernel));
+    if (!bsr::isSupported(kernel))
+    {
+        state.SkipWithError("The kernel is not supported by this processor");
+        return;
+    }
+
+    const auto& crs = getGridMatrix(state.range(0));
+    BSR3x3Matrix<StorageReal> matrix;
+    matrix.fromCRS(crs);
+    const auto n = 3 * static_cast<std::size_t>(matrix.nbBlockRows());
+    const auto x = createVector(n);
+    std::vector<double> y(n);
+
+    auto* taskScheduler = sofa::simulation::MainTaskSchedulerFactory::createInRegistry();
+    assert(taskScheduler != nullptr);
+    taskScheduler->init(state.range(1));
+
+    sofa::linearalgebra::FullVector<double> crsX(n), crsY(n);
+    std::copy(x.begin(), x.end(), crsX.ptr());
+    crs.mul(crsY, crsX);
+    bsr::multiply(*taskScheduler, matrix, x.data(), y.data(), kernel);
+    if (!isSameProduct<StorageReal>(y, crsY))
+    {
+        state.SkipWithError("The BSR product differs from CompressedRowSparseMatrix::mul");
+        return;
+    }
+
+    for (auto _ : state)
+    {
+        bsr::multiply(*taskScheduler, matrix, x.data(), y.data(), kernel);
+        benchmark::ClobberMemory();
+    }
+
+    setSpMVCounters(state, matrix.nbBlocks(), matrix.nbBlockRows(), sizeof(StorageReal));
+}
+
+static void BM_SpMVTranspose_Eigen(benchmark::State& state)
+{
+    const auto& blockMatrix = getGridMatrix(state.range(0));
+    const auto matrix = toEigen(blockMatrix);
+    const auto values = createVector(matrix.rows());
+
+    const Eigen::VectorXd x = Eigen::Map<const Eigen::VectorXd>(values.data(), matrix.rows());
+    Eigen::VectorXd y(matrix.cols());
+
+    for (auto _ : state)
+    {
+        y.noalias() = matrix.transpose() * x;
+        benchmark::ClobberMemory();
+    }
+
+    setSpMVCounters(state, blockMatrix.colsIndex.size(), blockMatrix.rowBSize(), sizeof(double) + sizeof(int));
+}
+
+template<typename StorageReal>
+static void BM_SpMVTranspose_BSR(benchmark::State& state)
+{
+    const auto& crs = getGridMatrix(state.range(0));
+    BSR3x3Matrix<StorageReal> matrix;
+    matrix.fromCRS(crs);
+    const auto n = 3 * static_cast<std::size_t>(matrix.nbBlockRows());
+    const auto x = createVector(n);
+    std::vector<double> y(n);
+    std::vector<double> work;
+
+    auto* taskScheduler = sofa::simulation::MainTaskSchedulerFactory::createInRegistry();
+    assert(taskScheduler != nullptr);
+    taskScheduler->init(state.range(1));
+
+    sofa::linearalgebra::FullVector<double> crsX(n), crsY(n);
+    std::copy(x.begin(), x.end(), crsX.ptr());
+    crs.mulTranspose(crsY, crsX);
+    bsr::multiplyTranspose(*taskScheduler, matrix, x.data(), y.data(), work);
+    if (!isSameProduct<StorageReal>(y, crsY))
+    {
+        state.SkipWithError("The BSR transposed product differs from CompressedRowSparseMatrix::mulTranspose");
+        return;
+    }
+
+    for (auto _ : state)
+    {
+        bsr::multiplyTranspose(*taskScheduler, matrix, x.data(), y.data(), work);
+        benchmark::ClobberMemory();
+    }
+
+    setSpMVCounters(state, matrix.nbBlocks(), matrix.nbBlockRows(), sizeof(StorageReal));
+}
+
+#define SPMVARGS ->ArgsProduct({gridSizeRange})->ArgNames({"grid"})->Unit(benchmark::kMicrosecond)
+#define SPMVTHREADARGS ->ArgsProduct({gridSizeRange, spmvThreadNumberRange})->ArgNames({"grid", "threads"})->Threads(1)->UseRealTime()->Unit(benchmark::kMicrosecond)
+#define SPMVKERNELARGS ->ArgsProduct({gridSizeRange, spmvThreadNumberRange, spmvKernelRange})->ArgNames({"grid", "threads", "kernel"})->Threads(1)->UseRealTime()->Unit(benchmark::kMicrosecond)
+
+const std::vector<int64_t> spmvKernelRange { static_cast<int64_t>(bsr::Kernel::Scalar), static_cast<int64_t>(bsr::Kernel::AVX2) };
+
+BENCHMARK(BM_SpMV_CRS3x3) SPMVARGS;
+BENCHMARK(BM_SpMV_CRSScalar) SPMVARGS;
+BENCHMARK(BM_SpMV_Eigen) SPMVARGS;
+BENCHMARK_TEMPLATE(BM_SpMV_BSR, double) SPMVKERNELARGS;
+BENCHMARK_TEMPLATE(BM_SpMV_BSR, float) SPMVKERNELARGS;
+
+BENCHMARK(BM_SpMVTranspose_Eigen) SPMVARGS;
+BENCHMARK_TEMPLATE(BM_SpMVTranspose_BSR, double) SPMVTHREADARGS;
+BENCHMARK_TEMPLATE(BM_SpMVTranspose_BSR, float) SPMVTHREADARGS;
+
+#undef SPMVKERNELARGS
+#undef SPMVTHREADARGS
+#undef SPMVARGS
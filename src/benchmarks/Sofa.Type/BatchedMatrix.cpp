@@ -0,0 +1,314 @@
+#include <benchmark/benchmark.h>
+
+#include <utils/BatchedMat3x3.h>
+
+#include <sofa/type/Mat.h>
+#include <sofa/helper/decompose.h>
+#include <Eigen/Dense>
+#include <random>
+#include <vector>
+
+/**
+ * 3x3 matrix operations of the corotational FEM, computed for all the elements at once:
+ * one matrix at a time with sofa::type::Mat and Eigen, versus BatchedMat3x3 where the SIMD lanes are
+ * different elements.
+ */
+
+constexpr int64_t minNbMatrices = 1 << 8;
+constexpr int64_t maxNbMatrices = 1 << 16;
+
+// Blocks of the stiffness matrix of a tetrahedron
+constexpr std::size_t nbBlocksPerTetra = 16;
+
+// Number of Newton iterations of the polar decompositions
+constexpr unsigned int nbPolarIterations = 6;
+
+// Deformation gradients F = R * S of elements in a large rotation and a moderate stretch
+static const std::vector<Eigen::Matrix3d>& getDeformationGradients()
+{
+    static std::vector<Eigen::Matrix3d> gradients;
+    if (gradients.empty())
+    {
+        std::mt19937 gen(0);
+        std::uniform_real_distribution<double> rand(-1., 1.);
+        gradients.resize(maxNbMatrices * nbBlocksPerTetra);
+        for (auto& F : gradients)
+        {
+            const Eigen::Vector3d axis = Eigen::Vector3d(rand(gen), rand(gen), rand(gen) + 2.).normalized();
+            const Eigen::Matrix3d R = Eigen::AngleAxisd(3. * rand(gen), axis).toRotationMatrix();
+            Eigen::Matrix3d S;
+            S << 1. + 0.2 * rand(gen), 0.1 * rand(gen), 0.1 * rand(gen),
+                 0., 1. + 0.2 * rand(gen), 0.1 * rand(gen),
+                 0., 0., 1. + 0.2 * rand(gen);
+            F = R * (0.5 * (S + S.transpose()));
+        }
+    }
+    return gradients;
+}
+
+template<typename ScalarType>
+std::vector<sofa::type::Mat<3, 3, ScalarType> > createTypeMatrices(std::size_t n)
+{
+    const auto& gradients = getDeformationGradients();
+    std::vector<sofa::type::Mat<3, 3, ScalarType> > matrices(n);
+    for (std::size_t i = 0; i < n; ++i)
+        for (sofa::Size r = 0; r < 3; ++r)
+            for (sofa::Size c = 0; c < 3; ++c)
+                matrices[i](r, c) = static_cast<ScalarType>(gradients[i](r, c));
+    return matrices;
+}
+
+template<typename ScalarType>
+std::vector<Eigen::Matrix<ScalarType, 3, 3> > createEigenMatrices(std::size_t n)
+{
+    const auto& gradients = getDeformationGradients();
+    std::vector<Eigen::Matrix<ScalarType, 3, 3> > matrices(n);
+    for (std::size_t i = 0; i < n; ++i)
+        matrices[i] = gradients[i].cast<ScalarType>();
+    return matrices;
+}
+
+template<typename ScalarType>
+BatchedMat3x3<ScalarType> createBatchedMatrices(std::size_t n)
+{
+    const auto& gradients = getDeformationGradients();
+    BatchedMat3x3<ScalarType> matrices(n);
+    for (std::size_t i = 0; i < n; ++i)
+        matrices.set(i, gradients[i].cast<ScalarType>().eval());
+    return matrices;
+}
+
+template<typename ScalarType>
+static void BM_BatchedMatrix_typemat_determinant(benchmark::State& state)
+{
+    const auto matrices = createTypeMatrices<ScalarType>(state.range(0));
+    std::vector<ScalarType> det(matrices.size());
+
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < matrices.size(); ++i)
+        {
+            det[i] = sofa::type::determinant(matrices[i]);
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template<typename ScalarType>
+static void BM_BatchedMatrix_eigenmat_determinant(benchmark::State& state)
+{
+    const auto matrices = createEigenMatrices<ScalarType>(state.range(0));
+    std::vector<ScalarType> det(matrices.size());
+
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < matrices.size(); ++i)
+        {
+            det[i] = matrices[i].determinant();
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template<typename ScalarType>
+static void BM_BatchedMatrix_batched_determinant(benchmark::State& state)
+{
+    const auto matrices = createBatchedMatrices<ScalarType>(state.range(0));
+    std::vector<ScalarType> det(matrices.stride());
+
+    for (auto _ : state)
+    {
+        batched::determinant(matrices, det.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template<typename ScalarType>
+static void BM_BatchedMatrix_typemat_invert(benchmark::State& state)
+{
+    const auto matrices = createTypeMatrices<ScalarType>(state.range(0));
+    auto inverses = matrices;
+
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < matrices.size(); ++i)
+        {
+            inverses[i].invert(matrices[i]);
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template<typename ScalarType>
+static void BM_BatchedMatrix_eigenmat_invert(benchmark::State& state)
+{
+    const auto matrices = createEigenMatrices<ScalarType>(state.range(0));
+    auto inverses = matrices;
+
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < matrices.size(); ++i)
+        {
+            inverses[i] = matrices[i].inverse();
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template<typename ScalarType>
+static void BM_BatchedMatrix_batched_invert(benchmark::State& state)
+{
+    const auto matrices = createBatchedMatrices<ScalarType>(state.range(0));
+    BatchedMat3x3<ScalarType> inverses(matrices.size());
+
+    for (auto _ : state)
+    {
+        batched::invert(inverses, matrices);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Polar decomposition as computed in the corotational force fields
+template<typename ScalarType>
+static void BM_BatchedMatrix_typemat_polarDecomposition(benchmark::State& state)
+{
+    const auto matrices = createTypeMatrices<ScalarType>(state.range(0));
+    auto rotations = matrices;
+
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < matrices.size(); ++i)
+        {
+            sofa::helper::Decompose<ScalarType>::polarDecomposition(matrices[i], rotations[i]);
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Same scaled Newton iterations as the batched version, one matrix at a time
+template<typename ScalarType>
+static void BM_BatchedMatrix_eigenmat_polarDecomposition(benchmark::State& state)
+{
+    const auto matrices = createEigenMatrices<ScalarType>(state.range(0));
+    auto rotations = matrices;
+
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < matrices.size(); ++i)
+        {
+            Eigen::Matrix<ScalarType, 3, 3> R = matrices[i];
+            for (unsigned int it = 0; it < nbPolarIterations; ++it)
+            {
+                const ScalarType g = static_cast<ScalarType>(1) / std::cbrt(std::abs(R.determinant()));
+                R = static_cast<ScalarType>(0.5) * (g * R + R.inverse().transpose() / g);
+            }
+            rotations[i] = R;
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template<typename ScalarType>
+static void BM_BatchedMatrix_batched_polarDecomposition(benchmark::State& state)
+{
+    const auto matrices = createBatchedMatrices<ScalarType>(state.range(0));
+    BatchedMat3x3<ScalarType> rotations(matrices.size());
+
+    for (auto _ : state)
+    {
+        batched::polarDecomposition(rotations, matrices, nbPolarIterations);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Rotation of the 16 blocks of the stiffness matrix of each tetrahedron: R^T K R
+template<typename ScalarType>
+static void BM_BatchedMatrix_typemat_rotateBlocks(benchmark::State& state)
+{
+    const std::size_t nbElements = state.range(0);
+    const auto rotations = createTypeMatrices<ScalarType>(nbElements);
+    const auto blocks = createTypeMatrices<ScalarType>(nbElements * nbBlocksPerTetra);
+    auto rotatedBlocks = blocks;
+
+    for (auto _ : state)
+    {
+        for (std::size_t e = 0; e < nbElements; ++e)
+        {
+            const auto& R = rotations[e];
+            for (std::size_t b = 0; b < nbBlocksPerTetra; ++b)
+            {
+                const std::size_t i = e * nbBlocksPerTetra + b;
+                rotatedBlocks[i] = R.multTranspose(blocks[i] * R);
+            }
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * nbBlocksPerTetra);
+}
+
+template<typename ScalarType>
+static void BM_BatchedMatrix_eigenmat_rotateBlocks(benchmark::State& state)
+{
+    const std::size_t nbElements = state.range(0);
+    const auto rotations = createEigenMatrices<ScalarType>(nbElements);
+    const auto blocks = createEigenMatrices<ScalarType>(nbElements * nbBlocksPerTetra);
+    auto rotatedBlocks = blocks;
+
+    for (auto _ : state)
+    {
+        for (std::size_t e = 0; e < nbElements; ++e)
+        {
+            const auto& R = rotations[e];
+            for (std::size_t b = 0; b < nbBlocksPerTetra; ++b)
+            {
+                const std::size_t i = e * nbBlocksPerTetra + b;
+                rotatedBlocks[i].noalias() = R.transpose() * blocks[i] * R;
+            }
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * nbBlocksPerTetra);
+}
+
+template<typename ScalarType>
+static void BM_BatchedMatrix_batched_rotateBlocks(benchmark::State& state)
+{
+    const std::size_t nbElements = state.range(0);
+    const auto rotations = createBatchedMatrices<ScalarType>(nbElements);
+    const auto blocks = createBatchedMatrices<ScalarType>(nbElements * nbBlocksPerTetra);
+    BatchedMat3x3<ScalarType> rotatedBlocks(blocks.size());
+
+    for (auto _ : state)
+    {
+        batched::rotateBlocks(rotatedBlocks, rotations, blocks, nbBlocksPerTetra);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * nbBlocksPerTetra);
+}
+
+#define BMARGS ->RangeMultiplier(4)->Range(minNbMatrices, maxNbMatrices)->Unit(benchmark::kMicrosecond)
+
+#define BATCHEDMATRIXBENCHMARK(op) \
+    BENCHMARK_TEMPLATE(BM_BatchedMatrix_typemat_##op, float) BMARGS; \
+    BENCHMARK_TEMPLATE(BM_BatchedMatrix_typemat_##op, double) BMARGS; \
+    BENCHMARK_TEMPLATE(BM_BatchedMatrix_eigenmat_##op, float) BMARGS; \
+    BENCHMARK_TEMPLATE(BM_BatchedMatrix_eigenmat_##op, double) BMARGS; \
+    BENCHMARK_TEMPLATE(BM_BatchedMatrix_batched_##op, float) BMARGS; \
+    BENCHMARK_TEMPLATE(BM_BatchedMatrix_batched_##op, double) BMARGS;
+
+BATCHEDMATRIXBENCHMARK(determinant)
+BATCHEDMATRIXBENCHMARK(invert)
+BATCHEDMATRIXBENCHMARK(polarDecomposition)
+BATCHEDMATRIXBENCHMARK(rotateBlocks)
+
+#undef BATCHEDMATRIXBENCHMARK
+#undef BMARGS
@@ -0,0 +1,292 @@
+#include <benchmark/benchmark.h>
+
+#include <utils/BatchedQuat.h>
+
+#include <sofa/type/Mat.h>
+#include <sofa/type/Quat.h>
+#include <sofa/type/Vec.h>
+#include <random>
+#include <vector>
+
+/**
+ * Rotation of many vectors, as in the rigid mappings and the update of collision spheres:
+ * a loop over sofa::type::Quat versus the batched kernels of BatchedQuat.h.
+ * The counter "rotations" is the number of rotated vectors (or interpolated/converted quaternions) per second.
+ */
+
+constexpr int64_t minNbRotations = 1 << 8;
+constexpr int64_t maxNbRotations = 1 << 16;
+
+template<typename ScalarType>
+std::vector<sofa::type::Quat<ScalarType> > createQuats(std::size_t n, unsigned int seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<ScalarType> rand(-1, 1);
+    std::vector<sofa::type::Quat<ScalarType> > quats;
+    quats.reserve(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        sofa::type::Quat<ScalarType> q(rand(gen), rand(gen), rand(gen), rand(gen));
+        q.normalize();
+        quats.push_back(q);
+    }
+    return quats;
+}
+
+template<typename ScalarType>
+std::vector<sofa::type::Vec<3, ScalarType> > createVecs(std::size_t n, unsigned int seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<ScalarType> rand(-1, 1);
+    std::vector<sofa::type::Vec<3, ScalarType> > vecs;
+    vecs.reserve(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        vecs.emplace_back(rand(gen), rand(gen), rand(gen));
+    }
+    return vecs;
+}
+
+template<typename ScalarType>
+SoAQuat<ScalarType> toSoA(const std::vector<sofa::type::Quat<ScalarType> >& quats)
+{
+    SoAQuat<ScalarType> soa(quats.size());
+    for (std::size_t i = 0; i < quats.size(); ++i)
+        soa.set(i, quats[i]);
+    return soa;
+}
+
+template<typename ScalarType>
+SoAVec3<ScalarType> toSoA(const std::vector<sofa::type::Vec<3, ScalarType> >& vecs)
+{
+    SoAVec3<ScalarType> soa(vecs.size());
+    for (std::size_t i = 0; i < vecs.size(); ++i)
+        for (std::size_t c = 0; c < 3; ++c)
+            soa(i, c) = vecs[i][c];
+    return soa;
+}
+
+static void setRotationsCounter(benchmark::State& state)
+{
+    state.counters["rotations"] = benchmark::Counter(static_cast<double>(state.range(0)), benchmark::Counter::kIsIterationInvariantRate);
+}
+
+// One quaternion, many vectors
+
+template<typename ScalarType>
+static void BM_BatchedQuat_typequat_rotate_one(benchmark::State& state)
+{
+    const auto q = createQuats<ScalarType>(1, 0).front();
+    const auto v = createVecs<ScalarType>(state.range(0), 1);
+    auto out = v;
+
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < v.size(); ++i)
+        {
+            out[i] = q.rotate(v[i]);
+        }
+        benchmark::ClobberMemory();
+    }
+    setRotationsCounter(state);
+}
+
+template<typename ScalarType>
+static void BM_BatchedQuat_batched_rotate_one(benchmark::State& state)
+{
+    const auto q = createQuats<ScalarType>(1, 0).front();
+    const auto v = toSoA(createVecs<ScalarType>(state.range(0), 1));
+    SoAVec3<ScalarType> out(v.size());
+
+    for (auto _ : state)
+    {
+        batched::rotate(out, q, v);
+        benchmark::ClobberMemory();
+    }
+    setRotationsCounter(state);
+}
+
+template<typename ScalarType>
+static void BM_BatchedQuat_typequat_inverseRotate_one(benchmark::State& state)
+{
+    const auto q = createQuats<ScalarType>(1, 0).front();
+    const auto v = createVecs<ScalarType>(state.range(0), 1);
+    auto out = v;
+
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < v.size(); ++i)
+        {
+            out[i] = q.inverseRotate(v[i]);
+        }
+        benchmark::ClobberMemory();
+    }
+    setRotationsCounter(state);
+}
+
+template<typename ScalarType>
+static void BM_BatchedQuat_batched_inverseRotate_one(benchmark::State& state)
+{
+    const auto q = createQuats<ScalarType>(1, 0).front();
+    const auto v = toSoA(createVecs<ScalarType>(state.range(0), 1));
+    SoAVec3<ScalarType> out(v.size());
+
+    for (auto _ : state)
+    {
+        batched::inverseRotate(out, q, v);
+        benchmark::ClobberMemory();
+    }
+    setRotationsCounter(state);
+}
+
+// One quaternion per vector
+
+template<typename ScalarType>
+static void BM_BatchedQuat_typequat_rotate_many(benchmark::State& state)
+{
+    const auto q = createQuats<ScalarType>(state.range(0), 0);
+    const auto v = createVecs<ScalarType>(state.range(0), 1);
+    auto out = v;
+
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < v.size(); ++i)
+        {
+            out[i] = q[i].rotate(v[i]);
+        }
+        benchmark::ClobberMemory();
+    }
+    setRotationsCounter(state);
+}
+
+template<typename ScalarType>
+static void BM_BatchedQuat_batched_rotate_many(benchmark::State& state)
+{
+    const auto q = toSoA(createQuats<ScalarType>(state.range(0), 0));
+    const auto v = toSoA(createVecs<ScalarType>(state.range(0), 1));
+    SoAVec3<ScalarType> out(v.size());
+
+    for (auto _ : state)
+    {
+        batched::rotate(out, q, v);
+        benchmark::ClobberMemory();
+    }
+    setRotationsCounter(state);
+}
+
+template<typename ScalarType>
+static void BM_BatchedQuat_typequat_inverseRotate_many(benchmark::State& state)
+{
+    const auto q = createQuats<ScalarType>(state.range(0), 0);
+    const auto v = createVecs<ScalarType>(state.range(0), 1);
+    auto out = v;
+
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < v.size(); ++i)
+        {
+            out[i] = q[i].inverseRotate(v[i]);
+        }
+        benchmark::ClobberMemory();
+    }
+    setRotationsCounter(state);
+}
+
+template<typename ScalarType>
+static void BM_BatchedQuat_batched_inverseRotate_many(benchmark::State& state)
+{
+    const auto q = toSoA(createQuats<ScalarType>(state.range(0), 0));
+    const auto v = toSoA(createVecs<ScalarType>(state.range(0), 1));
+    SoAVec3<ScalarType> out(v.size());
+
+    for (auto _ : state)
+    {
+        batched::inverseRotate(out, q, v);
+        benchmark::ClobberMemory();
+    }
+    setRotationsCounter(state);
+}
+
+// Interpolation between two sets of orientations
+
+template<typename ScalarType>
+static void BM_BatchedQuat_typequat_slerp(benchmark::State& state)
+{
+    const auto a = createQuats<ScalarType>(state.range(0), 0);
+    const auto b = createQuats<ScalarType>(state.range(0), 1);
+    auto out = a;
+
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < a.size(); ++i)
+        {
+            out[i].slerp(a[i], b[i], static_cast<ScalarType>(0.3));
+        }
+        benchmark::ClobberMemory();
+    }
+    setRotationsCounter(state);
+}
+
+template<typename ScalarType>
+static void BM_BatchedQuat_batched_slerp(benchmark::State& state)
+{
+    const auto a = toSoA(createQuats<ScalarType>(state.range(0), 0));
+    const auto b = toSoA(createQuats<ScalarType>(state.range(0), 1));
+    SoAQuat<ScalarType> out(a.size());
+
+    for (auto _ : state)
+    {
+        batched::slerp(out, a, b, static_cast<ScalarType>(0.3));
+        benchmark::ClobberMemory();
+    }
+    setRotationsCounter(state);
+}
+
+template<typename ScalarType>
+static void BM_BatchedQuat_typequat_toMatrix(benchmark::State& state)
+{
+    const auto q = createQuats<ScalarType>(state.range(0), 0);
+    std::vector<sofa::type::Mat<3, 3, ScalarType> > out(q.size());
+
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < q.size(); ++i)
+        {
+            q[i].toMatrix(out[i]);
+        }
+        benchmark::ClobberMemory();
+    }
+    setRotationsCounter(state);
+}
+
+template<typename ScalarType>
+static void BM_BatchedQuat_batched_toMatrix(benchmark::State& state)
+{
+    const auto q = toSoA(createQuats<ScalarType>(state.range(0), 0));
+    BatchedMat3x3<ScalarType> out(q.size());
+
+    for (auto _ : state)
+    {
+        batched::toMatrix(out, q);
+        benchmark::ClobberMemory();
+    }
+    setRotationsCounter(state);
+}
+
+#define BMARGS ->RangeMultiplier(4)->Range(minNbRotations, maxNbRotations)->Unit(benchmark::kMicrosecond)
+
+#define BATCHEDQUATBENCHMARK(op) \
+    BENCHMARK_TEMPLATE(BM_BatchedQuat_typequat_##op, float) BMARGS; \
+    BENCHMARK_TEMPLATE(BM_BatchedQuat_typequat_##op, double) BMARGS; \
+    BENCHMARK_TEMPLATE(BM_BatchedQuat_batched_##op, float) BMARGS; \
+    BENCHMARK_TEMPLATE(BM_BatchedQuat_batched_##op, double) BMARGS;
+
+BATCHEDQUATBENCHMARK(rotate_one)
+BATCHEDQUATBENCHMARK(inverseRotate_one)
+BATCHEDQUATBENCHMARK(rotate_many)
+BATCHEDQUATBENCHMARK(inverseRotate_many)
+BATCHEDQUATBENCHMARK(slerp)
+BATCHEDQUATBENCHMARK(toMatrix)
+
+#undef BATCHEDQUATBENCHMARK
+#undef BMARGS
@@ -0,0 +1,230 @@
+#include <benchmark/benchmark.h>
+
+#include <utils/SoAVec3.h>
+
+#include <sofa/type/Vec.h>
+#include <sofa/type/vector.h>
+#include <random>
+#include <type_traits>
+
+/**
+ * Comparison of memory layouts for vectors of 3D points (VecCoord):
+ * - array of structures: sofa::type::vector<Vec3d>, as in MechanicalObject
+ * - structure of arrays: SoAVec3
+ * - array of structures of arrays: AoSoAVec3, with blocks of 4 and 8 points
+ * The sizes range from vectors fitting in the L1 cache to vectors in DRAM.
+ * The explicit AVX2/FMA kernels of SoAVec3.h are only compiled with the CMake option SOFABENCHMARK_ENABLE_NATIVE_ARCH,
+ * which applies to this file only. In the default build, the SoA kernels are the portable scalar loops, with no
+ * SIMD beyond what the compiler auto-vectorizes for the baseline instruction set.
+ */
+
+using AoSVec3d = sofa::type::vector<sofa::type::Vec3d>;
+using SoAVec3d = SoAVec3<double>;
+using AoSoA4Vec3d = AoSoAVec3<double, 4>;
+using AoSoA8Vec3d = AoSoAVec3<double, 8>;
+
+// 1k points (24kB) to 4M points (96MB)
+constexpr int64_t minNbPoints = 1 << 10;
+constexpr int64_t maxNbPoints = 1 << 22;
+
+namespace vecops
+{
+using soa::axpy;
+using soa::peq;
+using soa::scaledAdd;
+using soa::dot;
+using soa::norm;
+using soa::pointNorms;
+
+// Reference kernels on the array of structures, written as the vector operations of MechanicalObject
+void axpy(AoSVec3d& y, double a, const AoSVec3d& x)
+{
+    for (std::size_t i = 0; i < y.size(); ++i)
+    {
+        y[i] += x[i] * a;
+    }
+}
+
+void peq(AoSVec3d& v, const AoSVec3d& w)
+{
+    for (std::size_t i = 0; i < v.size(); ++i)
+    {
+        v[i] += w[i];
+    }
+}
+
+void scaledAdd(AoSVec3d& r, const AoSVec3d& a, const AoSVec3d& b, double f)
+{
+    for (std::size_t i = 0; i < r.size(); ++i)
+    {
+        r[i] = a[i] + b[i] * f;
+    }
+}
+
+double dot(const AoSVec3d& a, const AoSVec3d& b)
+{
+    double r = 0;
+    for (std::size_t i = 0; i < a.size(); ++i)
+    {
+        r += sofa::type::dot(a[i], b[i]);
+    }
+    return r;
+}
+
+double norm(const AoSVec3d& a)
+{
+    return std::sqrt(dot(a, a));
+}
+
+void pointNorms(const AoSVec3d& a, double* norms)
+{
+    for (std::size_t i = 0; i < a.size(); ++i)
+    {
+        norms[i] = a[i].norm();
+    }
+}
+}
+
+template<class Container>
+Container createRandomVector(std::size_t nbPoints, unsigned int seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> rand(-1., 1.);
+
+    Container v;
+    v.resize(nbPoints);
+    for (std::size_t i = 0; i < nbPoints; ++i)
+    {
+        for (std::size_t c = 0; c < 3; ++c)
+        {
+            if constexpr (std::is_same_v<Container, AoSVec3d>)
+            {
+                v[i][c] = rand(gen);
+            }
+            else
+            {
+                v(i, c) = rand(gen);
+            }
+        }
+    }
+    return v;
+}
+
+template<class Container>
+static void BM_VecLayout_axpy(benchmark::State& state)
+{
+    const auto nbPoints = static_cast<std::size_t>(state.range(0));
+    auto y = createRandomVector<Container>(nbPoints, 0);
+    const auto x = createRandomVector<Container>(nbPoints, 1);
+
+    for (auto _ : state)
+    {
+        vecops::axpy(y, 1e-6, x);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(state.iterations() * state.range(0) * 3 * sizeof(double) * 3); // 2 reads, 1 write
+}
+
+template<class Container>
+static void BM_VecLayout_peq(benchmark::State& state)
+{
+    const auto nbPoints = static_cast<std::size_t>(state.range(0));
+    auto v = createRandomVector<Container>(nbPoints, 0);
+    const auto w = createRandomVector<Container>(nbPoints, 1);
+
+    for (auto _ : state)
+    {
+        vecops::peq(v, w);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(state.iterations() * state.range(0) * 3 * sizeof(double) * 3);
+}
+
+template<class Container>
+static void BM_VecLayout_scaledAdd(benchmark::State& state)
+{
+    const auto nbPoints = static_cast<std::size_t>(state.range(0));
+    auto r = createRandomVector<Container>(nbPoints, 0);
+    const auto a = createRandomVector<Container>(nbPoints, 1);
+    const auto b = createRandomVector<Container>(nbPoints, 2);
+
+    for (auto _ : state)
+    {
+        vecops::scaledAdd(r, a, b, 0.5);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(state.iterations() * state.range(0) * 3 * sizeof(double) * 3);
+}
+
+template<class Container>
+static void BM_VecLayout_dot(benchmark::State& state)
+{
+    const auto nbPoints = static_cast<std::size_t>(state.range(0));
+    const auto a = createRandomVector<Container>(nbPoints, 0);
+    const auto b = createRandomVector<Container>(nbPoints, 1);
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(vecops::dot(a, b));
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(state.iterations() * state.range(0) * 3 * sizeof(double) * 2);
+}
+
+template<class Container>
+static void BM_VecLayout_norm(benchmark::State& state)
+{
+    const auto nbPoints = static_cast<std::size_t>(state.range(0));
+    const auto a = createRandomVector<Container>(nbPoints, 0);
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(vecops::norm(a));
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(state.iterations() * state.range(0) * 3 * sizeof(double));
+}
+
+// Norm of each point: the only kernel of this file where the components of a point are combined together
+template<class Container>
+static void BM_VecLayout_pointNorms(benchmark::State& state)
+{
+    const auto nbPoints = static_cast<std::size_t>(state.range(0));
+    const auto a = createRandomVector<Container>(nbPoints, 0);
+    std::vector<double> norms(nbPoints);
+
+    for (auto _ : state)
+    {
+        vecops::pointNorms(a, norms.data());
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(state.iterations() * state.range(0) * 4 * sizeof(double));
+}
+
+#define BMARGS ->RangeMultiplier(8)->Range(minNbPoints, maxNbPoints)->Unit(benchmark::kMicrosecond)
+
+#define VECLAYOUTBENCHMARK(Container) \
+    BENCHMARK_TEMPLATE(BM_VecLayout_axpy, Container) BMARGS; \
+    BENCHMARK_TEMPLATE(BM_VecLayout_peq, Container) BMARGS; \
+    BENCHMARK_TEMPLATE(BM_VecLayout_scaledAdd, Container) BMARGS; \
+    BENCHMARK_TEMPLATE(BM_VecLayout_dot, Container) BMARGS; \
+    BENCHMARK_TEMPLATE(BM_VecLayout_norm, Container) BMARGS; \
+    BENCHMARK_TEMPLATE(BM_VecLayout_pointNorms, Container) BMARGS;
+
+VECLAYOUTBENCHMARK(AoSVec3d)
+VECLAYOUTBENCHMARK(SoAVec3d)
+VECLAYOUTBENCHMARK(AoSoA4Vec3d)
+VECLAYOUTBENCHMARK(AoSoA8Vec3d)
+
+#undef VECLAYOUTBENCHMARK
+#undef BMARGS
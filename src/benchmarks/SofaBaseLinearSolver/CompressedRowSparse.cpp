@@ -2,6 +2,13 @@
 
 #include <sofa/linearalgebra/CompressedRowSparseMatrix.h>
 #include <sofa/helper/RandomGenerator.h>
+#include <sofa/simulation/MainTaskSchedulerFactory.h>
+#include <utils/CRSStructureCache.h>
+#include <utils/ParallelCRSAssembly.h>
+
+#include <map>
+#include <thread>
+#include <type_traits>
 
 using sofa::linearalgebra::CompressedRowSparseMatrix;
 
@@ -144,3 +151,233 @@ BENCHMARK_TEMPLATE_F(BM_CRS_Fixture, Add3x3BlocScalar_CRS3x3d, sofa::type::Mat<3
         this->addBlocScalar(st);
     }
 }
+
+/**
+ * Assembly of a larger number of 3x3 blocs, including the compression of the matrix: serial insertion
+ * (as in the fixture above) versus the parallel assembly of ParallelCRSAssembly.h, where each task fills
+ * its own buffer of blocs before a parallel merge.
+ * The matrix has one bloc row per 10 blocs, so that the rows have a few duplicated positions, as in an
+ * assembled stiffness matrix.
+ */
+
+const std::vector<int64_t> nbAssembledBlocsRange { 1000, 10000, 100000, 1000000 };
+const auto assemblyThreadNumberRange = benchmark::CreateRange(1, std::thread::hardware_concurrency(), 2);
+
+static sofa::Index getNbBlocRows(int64_t nbBlocs)
+{
+    return static_cast<sofa::Index>(std::max<int64_t>(1000, nbBlocs / 10));
+}
+
+/// Random bloc positions (in bloc indices), always the same for a given number of blocs
+static const std::vector< std::pair<sofa::Index, sofa::Index> >& getBlocPositions(int64_t nbBlocs)
+{
+    static std::map<int64_t, std::vector< std::pair<sofa::Index, sofa::Index> > > positions;
+    auto it = positions.find(nbBlocs);
+    if (it == positions.end())
+    {
+        const sofa::Index nbBlocRows = getNbBlocRows(nbBlocs);
+        std::vector< std::pair<sofa::Index, sofa::Index> > vec(nbBlocs);
+        sofa::helper::RandomGenerator randomGenerator;
+        randomGenerator.initSeed(12);
+        for (auto& pos : vec)
+        {
+            pos = {randomGenerator.random<sofa::Index>(0, nbBlocRows), randomGenerator.random<sofa::Index>(0, nbBlocRows)};
+        }
+        it = positions.emplace(nbBlocs, std::move(vec)).first;
+    }
+    return it->second;
+}
+
+static const sofa::type::Mat<3, 3, double> assembledBloc {
+    sofa::type::Mat<3, 3, double>::Line{1., 2., 3.},
+    sofa::type::Mat<3, 3, double>::Line{4., 5., 6.},
+    sofa::type::Mat<3, 3, double>::Line{7., 8., 9.}
+};
+
+/// A 3x3 bloc is a single block of a CRS made of 3x3 blocs, but 9 blocks of a CRS made of scalars
+template<class TBlock>
+static void addBlocToBuffer(BlockTripletBuffer<TBlock>& buffer, sofa::Index blocRow, sofa::Index blocCol, const sofa::type::Mat<3, 3, double>& bloc)
+{
+    if constexpr (std::is_same_v<TBlock, double>)
+    {
+        for (sofa::Index i = 0; i < 3; ++i)
+        {
+            for (sofa::Index j = 0; j < 3; ++j)
+            {
+                buffer.add(3 * blocRow + i, 3 * blocCol + j, bloc(i, j));
+            }
+        }
+    }
+    else
+    {
+        buffer.add(blocRow, blocCol, bloc);
+    }
+}
+
+static void setAssemblyCounters(benchmark::State& state)
+{
+    state.counters["blocs"] = benchmark::Counter(static_cast<double>(state.range(0)), benchmark::Counter::kIsIterationInvariantRate);
+}
+
+/// Serial insertion with CompressedRowSparseMatrix::add, then compression
+template<class T>
+static void BM_CRS_Assembly_Serial(benchmark::State& state)
+{
+    const auto& positions = getBlocPositions(state.range(0));
+    const sofa::Index nbBlocRows = getNbBlocRows(state.range(0));
+
+    CompressedRowSparseMatrix<T> mat;
+    mat.resize(3 * nbBlocRows, 3 * nbBlocRows);
+
+    for (auto _ : state)
+    {
+        mat.clear();
+        for (const auto& pos : positions)
+        {
+            mat.add(3 * pos.first, 3 * pos.second, assembledBloc);
+        }
+        mat.compress();
+    }
+
+    setAssemblyCounters(state);
+}
+
+/// Serial insertion with the bloc shortcut of CRS made of 3x3 blocs, then compression
+static void BM_CRS_Assembly_SerialShortcut(benchmark::State& state)
+{
+    const auto& positions = getBlocPositions(state.range(0));
+    const sofa::Index nbBlocRows = getNbBlocRows(state.range(0));
+
+    CompressedRowSparseMatrix<sofa::type::Mat<3, 3, double> > mat;
+    mat.resize(3 * nbBlocRows, 3 * nbBlocRows);
+
+    for (auto _ : state)
+    {
+        mat.clear();
+        for (const auto& pos : positions)
+        {
+            *(mat.wblock(pos.first, pos.second, true)) += assembledBloc;
+        }
+        mat.compress();
+    }
+
+    setAssemblyCounters(state);
+}
+
+/// One buffer per thread, each filled by a task with a contiguous part of the blocs, then parallel merge
+template<class T>
+static void BM_CRS_Assembly_Parallel(benchmark::State& state)
+{
+    using Matrix = CompressedRowSparseMatrix<T>;
+    constexpr sofa::Index blocSize = std::is_same_v<T, double> ? 3 : 1;
+
+    const auto& positions = getBlocPositions(state.range(0));
+    const sofa::Index nbBlocRows = getNbBlocRows(state.range(0));
+
+    auto* taskScheduler = sofa::simulation::MainTaskSchedulerFactory::createInRegistry();
+    assert(taskScheduler != nullptr);
+    taskScheduler->init(state.range(1));
+    const std::size_t nbBuffers = taskScheduler->getThreadCount();
+
+    Matrix mat;
+    ParallelCRSAssembler<Matrix> assembler(blocSize * nbBlocRows, blocSize * nbBlocRows, nbBuffers);
+
+    for (auto _ : state)
+    {
+        assembler.clear();
+
+        sofa::simulation::CpuTask::Status status;
+        for (std::size_t b = 0; b < nbBuffers; ++b)
+        {
+            taskScheduler->addTask(status, [&assembler, &positions, b, nbBuffers]()
+            {
+                auto& buffer = assembler.getBuffer(b);
+                const std::size_t first = positions.size() * b / nbBuffers;
+                const std::size_t last = positions.size() * (b + 1) / nbBuffers;
+                for (std::size_t i = first; i < last; ++i)
+                {
+                    addBlocToBuffer(buffer, positions[i].first, positions[i].second, assembledBloc);
+                }
+            });
+        }
+        taskScheduler->workUntilDone(&status);
+
+        assembler.assemble(*taskScheduler, mat);
+    }
+
+    setAssemblyCounters(state);
+}
+
+BENCHMARK_TEMPLATE(BM_CRS_Assembly_Serial, double)->ArgsProduct({nbAssembledBlocsRange})->ArgNames({"blocs"})->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_CRS_Assembly_Serial, sofa::type::Mat<3,3,double>)->ArgsProduct({nbAssembledBlocsRange})->ArgNames({"blocs"})->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_CRS_Assembly_SerialShortcut)->ArgsProduct({nbAssembledBlocsRange})->ArgNames({"blocs"})->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_CRS_Assembly_Parallel, double)->ArgsProduct({nbAssembledBlocsRange, assemblyThreadNumberRange})->ArgNames({"blocs", "threads"})->Threads(1)->UseRealTime()->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_CRS_Assembly_Parallel, sofa::type::Mat<3,3,double>)->ArgsProduct({nbAssembledBlocsRange, assemblyThreadNumberRange})->ArgNames({"blocs", "threads"})->Threads(1)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+/**
+ * Repeated assembly with an unchanged sparsity, as at each time step of a FEM simulation without
+ * topological changes: the first build (insertion, compression and computation of the cached positions)
+ * versus the refill of the values at the cached positions.
+ * Each first build starts from an empty structure: the recording discards the sparsity of the matrix.
+ */
+
+const std::vector<int64_t> nbRefilledBlocsRange { 10000, 100000, 1000000 };
+
+using CRS3x3d = CompressedRowSparseMatrix<sofa::type::Mat<3, 3, double> >;
+
+static void BM_CRS_StructureCache_FirstBuild(benchmark::State& state)
+{
+    const auto& positions = getBlocPositions(state.range(0));
+    const sofa::Index nbBlocRows = getNbBlocRows(state.range(0));
+
+    CRS3x3d mat;
+    mat.resize(3 * nbBlocRows, 3 * nbBlocRows);
+    CRSStructureCache<CRS3x3d> cache;
+
+    for (auto _ : state)
+    {
+        cache.invalidate();
+        cache.begin(mat);
+        for (const auto& pos : positions)
+        {
+            cache.add(mat, pos.first, pos.second, assembledBloc);
+        }
+        cache.end(mat);
+    }
+
+    setAssemblyCounters(state);
+}
+
+static void BM_CRS_StructureCache_Refill(benchmark::State& state)
+{
+    const auto& positions = getBlocPositions(state.range(0));
+    const sofa::Index nbBlocRows = getNbBlocRows(state.range(0));
+
+    CRS3x3d mat;
+    mat.resize(3 * nbBlocRows, 3 * nbBlocRows);
+    CRSStructureCache<CRS3x3d> cache;
+
+    const auto assemble = [&]()
+    {
+        cache.begin(mat);
+        for (const auto& pos : positions)
+        {
+            cache.add(mat, pos.first, pos.second, assembledBloc);
+        }
+        cache.end(mat);
+    };
+
+    // First build, not measured
+    assemble();
+    assert(cache.isReady());
+
+    for (auto _ : state)
+    {
+        assemble();
+    }
+
+    setAssemblyCounters(state);
+}
+
+BENCHMARK(BM_CRS_StructureCache_FirstBuild)->ArgsProduct({nbRefilledBlocsRange})->ArgNames({"blocs"})->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_CRS_StructureCache_Refill)->ArgsProduct({nbRefilledBlocsRange})->ArgNames({"blocs"})->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,309 @@
+#include <benchmark/benchmark.h>
+#include <sofa/simulation/DefaultTaskScheduler.h>
+#include <sofa/simulation/MainTaskSchedulerFactory.h>
+#include <sofa/simulation/ParallelForEach.h>
+#include <utils/WorkStealingScheduler.h>
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <thread>
+#include <vector>
+
+/**
+ * Scheduling overhead of parallel loops whose elements are cheap, as the per-element work of a force field
+ * (50-500 ns). The cost of an element goes from 10 ns to 100 us, and the elements are grouped in chunks of
+ * `grain` elements, each chunk being a task.
+ * The counter "efficiency" is the ideal duration (serial duration / nb threads) divided by the measured duration.
+ */
+
+// Cost of an element in nanoseconds
+const std::vector<int64_t> payloadRange { 10, 100, 1000, 10000, 100000 };
+// Number of elements per task
+const std::vector<int64_t> grainRange { 1, 4, 16, 64, 256, 1024 };
+// At least 2 threads: on a single CPU machine, the range would be empty and its creation would abort
+const auto fineGrainThreadNumberRange = benchmark::CreateRange(2, std::max(2u, std::thread::hardware_concurrency()), 2);
+
+// The number of elements is chosen so that the serial loop lasts ~10 ms, whatever the cost of an element
+constexpr int64_t serialDurationNanoseconds = 10'000'000;
+
+static int64_t getNbElements(int64_t payloadNanoseconds)
+{
+    return std::max<int64_t>(1024, serialDurationNanoseconds / payloadNanoseconds);
+}
+
+/// Busy loop of a chain of dependent integer operations. Unlike payloadTask in TaskScheduler.cpp, it does not
+/// read the clock, so that its duration can be a few nanoseconds.
+static void spin(std::uint64_t nbIterations)
+{
+    std::uint64_t x = nbIterations;
+    for (std::uint64_t i = 0; i < nbIterations; ++i)
+    {
+        x = x * 6364136223846793005ull + 1442695040888963407ull;
+        benchmark::DoNotOptimize(x);
+    }
+}
+
+/// Number of iterations of spin() per nanosecond, measured once
+static double getSpinIterationsPerNanosecond()
+{
+    static const double iterationsPerNanosecond = []()
+    {
+        constexpr std::uint64_t nbIterations = 1 << 24;
+        double best = 0;
+        for (int i = 0; i < 5; ++i)
+        {
+            const auto begin = std::chrono::steady_clock::now();
+            spin(nbIterations);
+            const auto end = std::chrono::steady_clock::now();
+            const auto ns = std::chrono::duration<double, std::nano>(end - begin).count();
+            best = std::max(best, nbIterations / ns);
+        }
+        return best;
+    }();
+    return iterationsPerNanosecond;
+}
+
+static std::uint64_t getSpinIterations(int64_t payloadNanoseconds)
+{
+    return static_cast<std::uint64_t>(std::max(1., payloadNanoseconds * getSpinIterationsPerNanosecond()));
+}
+
+static void setEfficiencyCounters(benchmark::State& state, int64_t nbElements, int64_t payloadNanoseconds, unsigned int nbThreads)
+{
+    const double theorySeconds = static_cast<double>(nbElements) * payloadNanoseconds * 1e-9 / nbThreads;
+    state.counters["theoryMs"] = benchmark::Counter(theorySeconds * 1e3);
+    // theorySeconds * iterations / elapsed time
+    state.counters["efficiency"] = benchmark::Counter(theorySeconds, benchmark::Counter::kIsIterationInvariantRate);
+    state.counters["elements"] = benchmark::Counter(static_cast<double>(nbElements), benchmark::Counter::kIsIterationInvariantRate);
+}
+
+/// Reference: the same elements in a serial loop, to check the calibration of spin()
+static void BM_FineGrain_Serial(benchmark::State& state)
+{
+    const int64_t payload = state.range(0);
+    const int64_t nbElements = getNbElements(payload);
+    const auto nbSpins = getSpinIterations(payload);
+
+    for (auto _ : state)
+    {
+        for (int64_t i = 0; i < nbElements; ++i)
+        {
+            spin(nbSpins);
+        }
+    }
+
+    setEfficiencyCounters(state, nbElements, payload, 1);
+}
+
+BENCHMARK(BM_FineGrain_Serial)->ArgsProduct({payloadRange})->ArgNames({"payloadNs"})->Unit(benchmark::kMillisecond);
+
+/// One task per chunk, with the task scheduler of SOFA
+static void BM_FineGrain_TaskScheduler(benchmark::State& state)
+{
+    const int64_t payload = state.range(0);
+    const int64_t grain = state.range(1);
+    const int64_t nbElements = getNbElements(payload);
+    const auto nbSpins = getSpinIterations(payload);
+
+    auto* taskScheduler = sofa::simulation::MainTaskSchedulerFactory::createInRegistry();
+    assert(taskScheduler != nullptr);
+    taskScheduler->init(state.range(2));
+
+    for (auto _ : state)
+    {
+        sofa::simulation::CpuTask::Status status;
+        for (int64_t first = 0; first < nbElements; first += grain)
+        {
+            const int64_t last = std::min(first + grain, nbElements);
+            taskScheduler->addTask(status, [first, last, nbSpins]()
+            {
+                for (int64_t i = first; i < last; ++i)
+                {
+                    spin(nbSpins);
+                }
+            });
+        }
+        taskScheduler->workUntilDone(&status);
+    }
+
+    setEfficiencyCounters(state, nbElements, payload, taskScheduler->getThreadCount());
+}
+
+BENCHMARK(BM_FineGrain_TaskScheduler)->ArgsProduct(
+{
+    payloadRange, grainRange, fineGrainThreadNumberRange
+})->ArgNames({"payloadNs", "grain", "threads"})->Threads(1)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+/// sofa::simulation::parallelForEachRange chooses its own chunks, so it has no grain argument
+static void BM_FineGrain_ParallelForEachRange(benchmark::State& state)
+{
+    const int64_t payload = state.range(0);
+    const int64_t nbElements = getNbElements(payload);
+    const auto nbSpins = getSpinIterations(payload);
+
+    auto* taskScheduler = sofa::simulation::MainTaskSchedulerFactory::createInRegistry();
+    assert(taskScheduler != nullptr);
+    taskScheduler->init(state.range(1));
+
+    for (auto _ : state)
+    {
+        sofa::simulation::parallelForEachRange(*taskScheduler,
+            static_cast<int64_t>(0), nbElements,
+            [nbSpins](const auto& range)
+            {
+                for (auto it = range.start; it != range.end; ++it)
+                {
+                    spin(nbSpins);
+                }
+            });
+    }
+
+    setEfficiencyCounters(state, nbElements, payload, taskScheduler->getThreadCount());
+}
+
+BENCHMARK(BM_FineGrain_ParallelForEachRange)->ArgsProduct(
+{
+    payloadRange, fineGrainThreadNumberRange
+})->ArgNames({"payloadNs", "threads"})->Threads(1)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+/// Recursive splitting down to the grain, with the work-stealing scheduler
+static void BM_FineGrain_WorkStealingScheduler(benchmark::State& state)
+{
+    const int64_t payload = state.range(0);
+    const int64_t grain = state.range(1);
+    const int64_t nbElements = getNbElements(payload);
+    const auto nbSpins = getSpinIterations(payload);
+
+    WorkStealingScheduler taskScheduler(state.range(2));
+
+    for (auto _ : state)
+    {
+        workstealing::parallelForEachRange(taskScheduler,
+            static_cast<int64_t>(0), nbElements,
+            [nbSpins](const auto& range)
+            {
+                for (auto it = range.start; it != range.end; ++it)
+                {
+                    spin(nbSpins);
+                }
+            }, grain);
+    }
+
+    setEfficiencyCounters(state, nbElements, payload, taskScheduler.getThreadCount());
+}
+
+BENCHMARK(BM_FineGrain_WorkStealingScheduler)->ArgsProduct(
+{
+    payloadRange, grainRange, fineGrainThreadNumberRange
+})->ArgNames({"payloadNs", "grain", "threads"})->Threads(1)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+/**
+ * Search of the smallest grain worth parallelizing, for a given element cost and number of threads.
+ * The grain is doubled from 1 until the loop is not faster anymore. Reported counters:
+ * - breakEvenGrain: smallest grain for which the parallel loop is faster than the serial loop
+ * - efficientGrain: smallest grain reaching 90% of the best measured efficiency
+ * - bestEfficiency: best measured efficiency
+ * 0 means that no grain was found, e.g. the parallel loop is never faster than the serial loop.
+ */
+static void BM_FineGrain_BreakEvenGrain(benchmark::State& state)
+{
+    const int64_t payload = state.range(0);
+    const int64_t nbElements = getNbElements(payload);
+    const auto nbSpins = getSpinIterations(payload);
+
+    auto* taskScheduler = sofa::simulation::MainTaskSchedulerFactory::createInRegistry();
+    assert(taskScheduler != nullptr);
+    taskScheduler->init(state.range(1));
+    const unsigned int nbThreads = taskScheduler->getThreadCount();
+
+    // Best of a few runs, to filter out the noise. The serial and the parallel loops are measured the same way.
+    constexpr int nbRepetitions = 5;
+    const auto bestOfRepetitions = [](const auto& run)
+    {
+        double best = std::numeric_limits<double>::max();
+        for (int r = 0; r < nbRepetitions; ++r)
+        {
+            const auto begin = std::chrono::steady_clock::now();
+            run();
+            const auto end = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double>(end - begin).count());
+        }
+        return best;
+    };
+
+    const auto measure = [&](int64_t grain)
+    {
+        return bestOfRepetitions([&]()
+        {
+            sofa::simulation::CpuTask::Status status;
+            for (int64_t first = 0; first < nbElements; first += grain)
+            {
+                const int64_t last = std::min(first + grain, nbElements);
+                taskScheduler->addTask(status, [first, last, nbSpins]()
+                {
+                    for (int64_t i = first; i < last; ++i)
+                    {
+                        spin(nbSpins);
+                    }
+                });
+            }
+            taskScheduler->workUntilDone(&status);
+        });
+    };
+
+    // The serial duration is measured, not derived from the calibration
+    const double serialSeconds = bestOfRepetitions([nbElements, nbSpins]()
+    {
+        for (int64_t i = 0; i < nbElements; ++i)
+        {
+            spin(nbSpins);
+        }
+    });
+
+    std::vector<std::pair<int64_t, double> > efficiencies;
+    for (auto _ : state)
+    {
+        efficiencies.clear();
+        for (int64_t grain = 1; grain <= nbElements; grain *= 2)
+        {
+            const double efficiency = serialSeconds / nbThreads / measure(grain);
+            efficiencies.emplace_back(grain, efficiency);
+
+            // Beyond the best efficiency, larger grains only reduce the parallelism
+            if (efficiencies.size() > 2 && efficiency < efficiencies[efficiencies.size() - 2].second
+                && efficiencies[efficiencies.size() - 2].second < efficiencies[efficiencies.size() - 3].second)
+            {
+                break;
+            }
+        }
+    }
+
+    double bestEfficiency = 0;
+    for (const auto& [grain, efficiency] : efficiencies)
+    {
+        bestEfficiency = std::max(bestEfficiency, efficiency);
+    }
+
+    int64_t breakEvenGrain = 0;
+    int64_t efficientGrain = 0;
+    for (const auto& [grain, efficiency] : efficiencies)
+    {
+        // speedup = efficiency * nbThreads
+        if (breakEvenGrain == 0 && efficiency * nbThreads > 1)
+            breakEvenGrain = grain;
+        if (efficientGrain == 0 && efficiency >= 0.9 * bestEfficiency)
+            efficientGrain = grain;
+    }
+
+    state.counters["breakEvenGrain"] = static_cast<double>(breakEvenGrain);
+    state.counters["efficientGrain"] = static_cast<double>(efficientGrain);
+    state.counters["bestEfficiency"] = bestEfficiency;
+}
+
+BENCHMARK(BM_FineGrain_BreakEvenGrain)->ArgsProduct(
+{
+    payloadRange, fineGrainThreadNumberRange
+})->ArgNames({"payloadNs", "threads"})->Threads(1)->Iterations(1)->UseRealTime()->Unit(benchmark::kMillisecond);
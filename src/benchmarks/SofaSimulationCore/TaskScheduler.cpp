@@ -7,11 +7,17 @@
 #include <sofa/type/vector_T.h>
 #include <utils/RandomValuePool.h>
 #include <utils/thread_pool.hpp>
+#include <utils/ThreadAffinity.h>
+#include <utils/WorkStealingScheduler.h>
 
 constexpr unsigned int payloadDurationMicroseconds = 100;
 constexpr unsigned int maxTaskNumberRange = 1e5;
 const auto taskNumberRange = benchmark::CreateRange(1e3, maxTaskNumberRange, 10);
 const auto threadNumberRange = benchmark::CreateRange(1, std::thread::hardware_concurrency(), 2);
+const std::vector<int64_t> affinityPolicyRange {
+    static_cast<int64_t>(AffinityPolicy::None), static_cast<int64_t>(AffinityPolicy::Compact),
+    static_cast<int64_t>(AffinityPolicy::Scatter), static_cast<int64_t>(AffinityPolicy::NoSMT)
+};
 
 class EmptyTask : public sofa::simulation::CpuTask
 {
@@ -326,3 +332,287 @@ BENCHMARK(BM_ThreadPool_PayloadTask_ParallelizeLoop)->ArgsProduct(
 {
     taskNumberRange,threadNumberRange
 })->Threads(1)->Unit(benchmark::kMillisecond);
+
+class WorkStealingEmptyTask : public WorkStealingScheduler::Task
+{
+public:
+    explicit WorkStealingEmptyTask(WorkStealingScheduler::Status* status)
+        : WorkStealingScheduler::Task(status) {}
+
+    void run() final {}
+};
+
+class WorkStealingPayloadTask : public WorkStealingScheduler::Task
+{
+public:
+    explicit WorkStealingPayloadTask(WorkStealingScheduler::Status* status)
+        : WorkStealingScheduler::Task(status) {}
+
+    void run() final
+    {
+        payloadTask();
+    }
+};
+
+template<class TTask>
+static void BM_WorkStealingScheduler(benchmark::State &state)
+{
+    WorkStealingScheduler taskScheduler(state.range(1));
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+
+        sofa::type::vector<TTask> tasks;
+        tasks.reserve(state.range(0));
+
+        WorkStealingScheduler::Status status;
+
+        state.ResumeTiming();
+
+        for (unsigned int i = 0; i < state.range(0); ++i)
+        {
+            tasks.emplace_back(&status);
+            taskScheduler.addTask(&tasks.back());
+        }
+
+        taskScheduler.workUntilDone(&status);
+    }
+
+    if constexpr (std::is_same_v<TTask, WorkStealingPayloadTask>)
+    {
+        //The duration in ms that it would take if no overhead: number of tasks * duration of one task / nb of threads
+        state.counters["theoryMs"] = benchmark::Counter(state.range(0) * payloadDurationMicroseconds / 1000 / taskScheduler.getThreadCount());
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_WorkStealingScheduler, WorkStealingEmptyTask)->ArgsProduct(
+{
+    taskNumberRange, threadNumberRange
+})->Threads(1)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_WorkStealingScheduler, WorkStealingPayloadTask)->ArgsProduct(
+{
+    taskNumberRange, threadNumberRange
+})->Threads(1)->Unit(benchmark::kMillisecond);
+
+static void BM_WorkStealingScheduler_PayloadTask_ParallelizeLoop(benchmark::State &state)
+{
+    constexpr auto loop = [](const int64_t b)
+    {
+        payloadTask();
+    };
+
+    WorkStealingScheduler taskScheduler(state.range(1));
+
+    for (auto _ : state)
+    {
+        workstealing::parallelForEach(taskScheduler,
+            static_cast<int64_t>(0), state.range(0), loop);
+    }
+
+    //The duration in ms that it would take if no overhead: number of tasks * duration of one task / nb of threads
+    state.counters["theoryMs"] = benchmark::Counter(state.range(0) * payloadDurationMicroseconds / 1000 / state.range(1));
+}
+
+BENCHMARK(BM_WorkStealingScheduler_PayloadTask_ParallelizeLoop)->ArgsProduct(
+{
+    taskNumberRange,threadNumberRange
+})->Threads(1)->Unit(benchmark::kMillisecond);
+
+static void BM_WorkStealingScheduler_PayloadTask_ParallelizeLoopRange(benchmark::State &state)
+{
+    constexpr auto loop = [](const auto& range)
+    {
+        for (auto it = range.start; it != range.end; ++it)
+        {
+            payloadTask();
+        }
+    };
+
+    WorkStealingScheduler taskScheduler(state.range(1));
+
+    for (auto _ : state)
+    {
+        workstealing::parallelForEachRange(taskScheduler,
+            static_cast<int64_t>(0), state.range(0), loop);
+    }
+
+    //The duration in ms that it would take if no overhead: number of tasks * duration of one task / nb of threads
+    state.counters["theoryMs"] = benchmark::Counter(state.range(0) * payloadDurationMicroseconds / 1000 / state.range(1));
+}
+
+BENCHMARK(BM_WorkStealingScheduler_PayloadTask_ParallelizeLoopRange)->ArgsProduct(
+{
+    taskNumberRange,threadNumberRange
+})->Threads(1)->Unit(benchmark::kMillisecond);
+
+static void BM_WorkStealingScheduler_MatrixMultTransposeTask_ParallelizeLoopRange(benchmark::State &state)
+{
+    constexpr auto totalsize = maxTaskNumberRange * 3*3 * 2;
+    const std::array<float, totalsize>& values = RandomValuePool<float, totalsize>::get();
+
+    std::vector<sofa::type::Mat<3, 3, float > > vc1;
+    std::vector<sofa::type::Mat<3, 3, float > > vc2;
+    vc1.reserve(state.range(0));
+    vc2.reserve(state.range(0));
+
+    auto it = values.begin();
+
+    WorkStealingScheduler taskScheduler(state.range(1));
+
+    for (unsigned int i = 0; i < state.range(0); i++)
+    {
+        sofa::type::Mat<3, 3, float > mat1, mat2;
+        for (int a = 0; a < 3; ++a)
+        {
+            for (int b = 0; b < 3; ++b)
+            {
+                mat1[a][b] = *it++;
+                mat2[a][b] = *it++;
+            }
+        }
+        vc1.push_back(mat1);
+        vc2.push_back(mat2);
+    }
+
+    for (auto _ : state)
+    {
+        workstealing::parallelForEachRange(taskScheduler,
+            static_cast<int64_t>(0), state.range(0),
+            [&vc1, &vc2](const auto& range)
+            {
+                for (auto it = range.start; it != range.end; ++it)
+                {
+                    benchmark::DoNotOptimize(vc1[it].multTranspose(vc2[it]));
+                }
+            });
+    }
+}
+
+BENCHMARK(BM_WorkStealingScheduler_MatrixMultTransposeTask_ParallelizeLoopRange)->ArgsProduct(
+{
+    taskNumberRange,threadNumberRange
+})->Threads(1)->Unit(benchmark::kMicrosecond);
+
+// Same as BM_TaskScheduler_MatrixMultTransposeTask_ParallelizeLoopRange, with the threads pinned according to
+// an affinity policy, and the matrices initialized in parallel so that their pages are allocated on the NUMA
+// node of the thread which uses them
+static void BM_TaskScheduler_MatrixMultTransposeTask_ParallelizeLoopRange_Affinity(benchmark::State &state)
+{
+    using Matrix = sofa::type::Mat<3, 3, float >;
+    constexpr auto totalsize = maxTaskNumberRange * 3*3 * 2;
+    const std::array<float, totalsize>& values = RandomValuePool<float, totalsize>::get();
+    const auto policy = static_cast<AffinityPolicy>(state.range(2));
+
+    auto *taskScheduler =sofa::simulation::MainTaskSchedulerFactory::createInRegistry();
+    assert(taskScheduler != nullptr);
+
+    taskScheduler->init(state.range(1));
+    pinTaskSchedulerThreads(*taskScheduler, policy);
+
+    FirstTouchArray<Matrix> vc1(state.range(0));
+    FirstTouchArray<Matrix> vc2(state.range(0));
+
+    sofa::simulation::parallelForEachRange(*taskScheduler,
+        static_cast<int64_t>(0), state.range(0),
+        [&vc1, &vc2, &values](const auto& range)
+        {
+            for (auto i = range.start; i != range.end; ++i)
+            {
+                Matrix mat1, mat2;
+                auto it = values.begin() + i * 3*3 * 2;
+                for (int a = 0; a < 3; ++a)
+                {
+                    for (int b = 0; b < 3; ++b)
+                    {
+                        mat1[a][b] = *it++;
+                        mat2[a][b] = *it++;
+                    }
+                }
+                vc1.construct(i, mat1);
+                vc2.construct(i, mat2);
+            }
+        });
+
+    for (auto _ : state)
+    {
+        sofa::simulation::parallelForEachRange(*taskScheduler,
+            static_cast<int64_t>(0), state.range(0),
+            [&vc1, &vc2](const auto& range)
+            {
+                for (auto it = range.start; it != range.end; ++it)
+                {
+                    benchmark::DoNotOptimize(vc1[it].multTranspose(vc2[it]));
+                }
+            });
+    }
+
+    // The task scheduler is shared with the other benchmarks
+    pinTaskSchedulerThreads(*taskScheduler, AffinityPolicy::None);
+
+    state.SetLabel(toString(policy));
+}
+
+BENCHMARK(BM_TaskScheduler_MatrixMultTransposeTask_ParallelizeLoopRange_Affinity)->ArgsProduct(
+{
+    taskNumberRange, threadNumberRange, affinityPolicyRange
+})->ArgNames({"tasks", "threads", "affinity"})->Threads(1)->Unit(benchmark::kMicrosecond);
+
+static void BM_WorkStealingScheduler_MatrixMultTransposeTask_ParallelizeLoopRange_Affinity(benchmark::State &state)
+{
+    using Matrix = sofa::type::Mat<3, 3, float >;
+    constexpr auto totalsize = maxTaskNumberRange * 3*3 * 2;
+    const std::array<float, totalsize>& values = RandomValuePool<float, totalsize>::get();
+    const auto policy = static_cast<AffinityPolicy>(state.range(2));
+
+    WorkStealingScheduler taskScheduler(state.range(1));
+    pinTaskSchedulerThreads(taskScheduler, policy);
+
+    FirstTouchArray<Matrix> vc1(state.range(0));
+    FirstTouchArray<Matrix> vc2(state.range(0));
+
+    // Same grain as the benchmark loop, so that a chunk is likely to be initialized and used by the same thread
+    workstealing::parallelForEachRange(taskScheduler,
+        static_cast<int64_t>(0), state.range(0),
+        [&vc1, &vc2, &values](const auto& range)
+        {
+            for (auto i = range.start; i != range.end; ++i)
+            {
+                Matrix mat1, mat2;
+                auto it = values.begin() + i * 3*3 * 2;
+                for (int a = 0; a < 3; ++a)
+                {
+                    for (int b = 0; b < 3; ++b)
+                    {
+                        mat1[a][b] = *it++;
+                        mat2[a][b] = *it++;
+                    }
+                }
+                vc1.construct(i, mat1);
+                vc2.construct(i, mat2);
+            }
+        });
+
+    for (auto _ : state)
+    {
+        workstealing::parallelForEachRange(taskScheduler,
+            static_cast<int64_t>(0), state.range(0),
+            [&vc1, &vc2](const auto& range)
+            {
+                for (auto it = range.start; it != range.end; ++it)
+                {
+                    benchmark::DoNotOptimize(vc1[it].multTranspose(vc2[it]));
+                }
+            });
+    }
+
+    // The worker threads are destroyed with the scheduler, but the main thread remains
+    unpinCurrentThread();
+
+    state.SetLabel(toString(policy));
+}
+
+BENCHMARK(BM_WorkStealingScheduler_MatrixMultTransposeTask_ParallelizeLoopRange_Affinity)->ArgsProduct(
+{
+    taskNumberRange, threadNumberRange, affinityPolicyRange
+})->ArgNames({"tasks", "threads", "affinity"})->Threads(1)->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,271 @@
+#pragma once
+
+#include <utils/SoAVec3.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+/**
+ * N 3x3 matrices in a structure-of-arrays layout: the entry (r,c) of all the matrices, then the entry (r,c+1)
+ * of all the matrices, etc. A kernel processes Lanes matrices at once, each lane being a different matrix, so
+ * that the same operation is applied to consecutive values in memory.
+ * Each entry is padded to a multiple of Lanes values, so the kernels never need a scalar remainder loop.
+ */
+template<typename TReal>
+class BatchedMat3x3
+{
+public:
+    using Real = TReal;
+    static constexpr std::size_t Lanes = 64 / sizeof(Real);
+
+    BatchedMat3x3() = default;
+    explicit BatchedMat3x3(std::size_t size) { resize(size); }
+
+    void resize(std::size_t size)
+    {
+        m_size = size;
+        m_stride = (size + Lanes - 1) / Lanes * Lanes;
+        m_data.assign(9 * m_stride, static_cast<Real>(0));
+    }
+
+    std::size_t size() const { return m_size; }
+    std::size_t stride() const { return m_stride; }
+
+    /// Entry (r,c) of all the matrices
+    Real* entry(std::size_t r, std::size_t c) { return m_data.data() + (3 * r + c) * m_stride; }
+    const Real* entry(std::size_t r, std::size_t c) const { return m_data.data() + (3 * r + c) * m_stride; }
+
+    Real& operator()(std::size_t i, std::size_t r, std::size_t c) { return m_data[(3 * r + c) * m_stride + i]; }
+    Real operator()(std::size_t i, std::size_t r, std::size_t c) const { return m_data[(3 * r + c) * m_stride + i]; }
+
+    /// Copy from/to any matrix type providing operator()(row, col), such as sofa::type::Mat or Eigen::Matrix
+    template<class Matrix>
+    void set(std::size_t i, const Matrix& m)
+    {
+        for (std::size_t r = 0; r < 3; ++r)
+            for (std::size_t c = 0; c < 3; ++c)
+                (*this)(i, r, c) = m(r, c);
+    }
+
+    template<class Matrix>
+    void get(std::size_t i, Matrix& m) const
+    {
+        for (std::size_t r = 0; r < 3; ++r)
+            for (std::size_t c = 0; c < 3; ++c)
+                m(r, c) = (*this)(i, r, c);
+    }
+
+private:
+    std::size_t m_size { 0 };
+    std::size_t m_stride { 0 };
+    std::vector<Real, AlignedAllocator<Real> > m_data;
+};
+
+namespace batched
+{
+
+namespace detail
+{
+
+/// A pack of Lanes 3x3 matrices, local to a kernel. The pack does not alias the batch, so the compiler
+/// vectorizes the loops over the lanes.
+template<typename Real, std::size_t Lanes>
+struct Pack
+{
+    Real m[9][Lanes];
+};
+
+template<typename Real, std::size_t Lanes>
+void load(Pack<Real, Lanes>& p, const BatchedMat3x3<Real>& batch, std::size_t first)
+{
+    for (std::size_t k = 0; k < 9; ++k)
+    {
+        const Real* src = batch.entry(k / 3, k % 3) + first;
+        for (std::size_t l = 0; l < Lanes; ++l)
+            p.m[k][l] = src[l];
+    }
+}
+
+template<typename Real, std::size_t Lanes>
+void store(const Pack<Real, Lanes>& p, BatchedMat3x3<Real>& batch, std::size_t first)
+{
+    for (std::size_t k = 0; k < 9; ++k)
+    {
+        Real* dst = batch.entry(k / 3, k % 3) + first;
+        for (std::size_t l = 0; l < Lanes; ++l)
+            dst[l] = p.m[k][l];
+    }
+}
+
+template<typename Real, std::size_t Lanes>
+void determinant(const Pack<Real, Lanes>& a, Real (&det)[Lanes])
+{
+    const auto& m = a.m;
+    for (std::size_t l = 0; l < Lanes; ++l)
+    {
+        det[l] = m[0][l] * (m[4][l] * m[8][l] - m[5][l] * m[7][l])
+               - m[1][l] * (m[3][l] * m[8][l] - m[5][l] * m[6][l])
+               + m[2][l] * (m[3][l] * m[7][l] - m[4][l] * m[6][l]);
+    }
+}
+
+/// Cofactor matrix divided by the determinant, i.e. the inverse transposed.
+/// A singular matrix gives a null matrix instead of a division by zero, without a branch.
+template<typename Real, std::size_t Lanes>
+void inverseTranspose(Pack<Real, Lanes>& out, const Pack<Real, Lanes>& a, const Real (&det)[Lanes])
+{
+    const auto& m = a.m;
+    for (std::size_t l = 0; l < Lanes; ++l)
+    {
+        const Real invDet = det[l] != 0 ? static_cast<Real>(1) / det[l] : static_cast<Real>(0);
+        out.m[0][l] = (m[4][l] * m[8][l] - m[5][l] * m[7][l]) * invDet;
+        out.m[1][l] = (m[5][l] * m[6][l] - m[3][l] * m[8][l]) * invDet;
+        out.m[2][l] = (m[3][l] * m[7][l] - m[4][l] * m[6][l]) * invDet;
+        out.m[3][l] = (m[2][l] * m[7][l] - m[1][l] * m[8][l]) * invDet;
+        out.m[4][l] = (m[0][l] * m[8][l] - m[2][l] * m[6][l]) * invDet;
+        out.m[5][l] = (m[1][l] * m[6][l] - m[0][l] * m[7][l]) * invDet;
+        out.m[6][l] = (m[1][l] * m[5][l] - m[2][l] * m[4][l]) * invDet;
+        out.m[7][l] = (m[2][l] * m[3][l] - m[0][l] * m[5][l]) * invDet;
+        out.m[8][l] = (m[0][l] * m[4][l] - m[1][l] * m[3][l]) * invDet;
+    }
+}
+
+}
+
+/// det[i] = det(m_i). det must have room for m.stride() values.
+template<typename Real>
+void determinant(const BatchedMat3x3<Real>& m, Real* det)
+{
+    constexpr std::size_t Lanes = BatchedMat3x3<Real>::Lanes;
+    detail::Pack<Real, Lanes> a;
+    Real d[Lanes];
+    for (std::size_t first = 0; first < m.stride(); first += Lanes)
+    {
+        detail::load(a, m, first);
+        detail::determinant(a, d);
+        for (std::size_t l = 0; l < Lanes; ++l)
+            det[first + l] = d[l];
+    }
+}
+
+/// out_i = m_i^-1. The inverse of a singular matrix is set to the null matrix.
+template<typename Real>
+void invert(BatchedMat3x3<Real>& out, const BatchedMat3x3<Real>& m)
+{
+    constexpr std::size_t Lanes = BatchedMat3x3<Real>::Lanes;
+    if (out.size() != m.size())
+        out.resize(m.size());
+
+    detail::Pack<Real, Lanes> a, invT;
+    Real d[Lanes];
+    for (std::size_t first = 0; first < m.stride(); first += Lanes)
+    {
+        detail::load(a, m, first);
+        detail::determinant(a, d);
+        detail::inverseTranspose(invT, a, d);
+
+        detail::Pack<Real, Lanes> inv;
+        for (std::size_t r = 0; r < 3; ++r)
+            for (std::size_t c = 0; c < 3; ++c)
+                for (std::size_t l = 0; l < Lanes; ++l)
+                    inv.m[3 * r + c][l] = invT.m[3 * c + r][l];
+        detail::store(inv, out, first);
+    }
+}
+
+/**
+ * Rotation part of the polar decomposition m_i = R_i * S_i, with the scaled Newton iteration
+ * R <- (g R + R^-T / g) / 2, where g = |det R|^(-1/3).
+ * The number of iterations is fixed, so that all the lanes follow the same path. For the moderately
+ * deformed elements of a FEM simulation, 6 iterations reach the machine precision in double.
+ */
+template<typename Real>
+void polarDecomposition(BatchedMat3x3<Real>& R, const BatchedMat3x3<Real>& m, unsigned int nbIterations = 6)
+{
+    constexpr std::size_t Lanes = BatchedMat3x3<Real>::Lanes;
+    if (R.size() != m.size())
+        R.resize(m.size());
+
+    detail::Pack<Real, Lanes> r, invT;
+    Real d[Lanes], half_g[Lanes], half_invg[Lanes];
+    for (std::size_t first = 0; first < m.stride(); first += Lanes)
+    {
+        detail::load(r, m, first);
+        for (unsigned int it = 0; it < nbIterations; ++it)
+        {
+            detail::determinant(r, d);
+            detail::inverseTranspose(invT, r, d);
+            for (std::size_t l = 0; l < Lanes; ++l)
+            {
+                const Real g = d[l] != 0 ? static_cast<Real>(1) / std::cbrt(std::abs(d[l])) : static_cast<Real>(1);
+                half_g[l] = static_cast<Real>(0.5) * g;
+                half_invg[l] = static_cast<Real>(0.5) / g;
+            }
+            for (std::size_t k = 0; k < 9; ++k)
+                for (std::size_t l = 0; l < Lanes; ++l)
+                    r.m[k][l] = half_g[l] * r.m[k][l] + half_invg[l] * invT.m[k][l];
+        }
+        detail::store(r, R, first);
+    }
+}
+
+/**
+ * out = R^T K R for blocks of stiffness matrices.
+ * An element has nbBlocksPerRotation 3x3 blocks (16 for a tetrahedron, 64 for a hexahedron), all rotated
+ * by the rotation of the element. K and out store the blocks block-major: the block b of the element e is at
+ * the index b * R.size() + e, so that the lanes are always consecutive elements. K must have exactly
+ * nbBlocksPerRotation * R.size() blocks.
+ */
+template<typename Real>
+void rotateBlocks(BatchedMat3x3<Real>& out, const BatchedMat3x3<Real>& R, const BatchedMat3x3<Real>& K, std::size_t nbBlocksPerRotation)
+{
+    constexpr std::size_t Lanes = BatchedMat3x3<Real>::Lanes;
+    const std::size_t nbElements = R.size();
+    assert(K.size() == nbBlocksPerRotation * nbElements);
+    if (out.size() != K.size())
+        out.resize(K.size());
+
+    detail::Pack<Real, Lanes> rot, k, kr, rtkr;
+    for (std::size_t first = 0; first < R.stride(); first += Lanes)
+    {
+        detail::load(rot, R, first);
+        for (std::size_t b = 0; b < nbBlocksPerRotation; ++b)
+        {
+            // The block-major offsets are not multiples of Lanes, so the packs are loaded with the generic accessor
+            const std::size_t offset = b * nbElements + first;
+            const std::size_t nbLanes = std::min(Lanes, nbElements - std::min(nbElements, first));
+            for (std::size_t e = 0; e < 9; ++e)
+            {
+                const Real* src = K.entry(e / 3, e % 3) + offset;
+                for (std::size_t l = 0; l < nbLanes; ++l)
+                    k.m[e][l] = src[l];
+                for (std::size_t l = nbLanes; l < Lanes; ++l)
+                    k.m[e][l] = 0;
+            }
+
+            // kr = K R
+            for (std::size_t i = 0; i < 3; ++i)
+                for (std::size_t j = 0; j < 3; ++j)
+                    for (std::size_t l = 0; l < Lanes; ++l)
+                        kr.m[3 * i + j][l] = k.m[3 * i][l] * rot.m[j][l] + k.m[3 * i + 1][l] * rot.m[3 + j][l] + k.m[3 * i + 2][l] * rot.m[6 + j][l];
+
+            // rtkr = R^T kr
+            for (std::size_t i = 0; i < 3; ++i)
+                for (std::size_t j = 0; j < 3; ++j)
+                    for (std::size_t l = 0; l < Lanes; ++l)
+                        rtkr.m[3 * i + j][l] = rot.m[i][l] * kr.m[j][l] + rot.m[3 + i][l] * kr.m[3 + j][l] + rot.m[6 + i][l] * kr.m[6 + j][l];
+
+            for (std::size_t e = 0; e < 9; ++e)
+            {
+                Real* dst = out.entry(e / 3, e % 3) + offset;
+                for (std::size_t l = 0; l < nbLanes; ++l)
+                    dst[l] = rtkr.m[e][l];
+            }
+        }
+    }
+}
+
+}
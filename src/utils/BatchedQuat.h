@@ -0,0 +1,272 @@
+#pragma once
+
+#include <utils/SoAVec3.h>
+#include <utils/BatchedMat3x3.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+/**
+ * Quaternions in a structure-of-arrays layout: all the x, then all the y, all the z and all the w.
+ * The components are ordered as in sofa::type::Quat (the real part is the last one).
+ * Each component is padded to a multiple of Padding values, as in SoAVec3.
+ */
+template<typename TReal>
+class SoAQuat
+{
+public:
+    using Real = TReal;
+    static constexpr std::size_t Padding = 64 / sizeof(Real);
+
+    SoAQuat() = default;
+    explicit SoAQuat(std::size_t size) { resize(size); }
+
+    void resize(std::size_t size)
+    {
+        m_size = size;
+        m_stride = (size + Padding - 1) / Padding * Padding;
+        m_data.assign(4 * m_stride, static_cast<Real>(0));
+    }
+
+    std::size_t size() const { return m_size; }
+    std::size_t stride() const { return m_stride; }
+
+    Real* component(std::size_t c) { return m_data.data() + c * m_stride; }
+    const Real* component(std::size_t c) const { return m_data.data() + c * m_stride; }
+
+    Real& operator()(std::size_t i, std::size_t c) { return m_data[c * m_stride + i]; }
+    Real operator()(std::size_t i, std::size_t c) const { return m_data[c * m_stride + i]; }
+
+    /// Copy from/to any quaternion type providing operator[] in the order x, y, z, w, such as sofa::type::Quat
+    template<class Quat>
+    void set(std::size_t i, const Quat& q)
+    {
+        for (std::size_t c = 0; c < 4; ++c)
+            (*this)(i, c) = q[c];
+    }
+
+    template<class Quat>
+    void get(std::size_t i, Quat& q) const
+    {
+        for (std::size_t c = 0; c < 4; ++c)
+            q[c] = (*this)(i, c);
+    }
+
+private:
+    std::size_t m_size { 0 };
+    std::size_t m_stride { 0 };
+    std::vector<Real, AlignedAllocator<Real> > m_data;
+};
+
+namespace batched
+{
+
+namespace detail
+{
+
+template<typename Real>
+std::size_t paddedSize(std::size_t size)
+{
+    constexpr std::size_t Padding = 64 / sizeof(Real);
+    return (size + Padding - 1) / Padding * Padding;
+}
+
+/// Rotation matrix of a unit quaternion (x, y, z, w), row-major
+template<typename Real>
+void quatToMatrix(Real x, Real y, Real z, Real w, Real (&m)[9])
+{
+    m[0] = 1 - 2 * (y * y + z * z); m[1] = 2 * (x * y - z * w);     m[2] = 2 * (x * z + y * w);
+    m[3] = 2 * (x * y + z * w);     m[4] = 1 - 2 * (x * x + z * z); m[5] = 2 * (y * z - x * w);
+    m[6] = 2 * (x * z - y * w);     m[7] = 2 * (y * z + x * w);     m[8] = 1 - 2 * (x * x + y * y);
+}
+
+/// out_i = m v_i. With a single rotation, a 3x3 product (9 multiply-adds per point) is cheaper than
+/// the quaternion formula.
+template<typename Real>
+void rotateByMatrix(SoAVec3<Real>& out, const Real (&m)[9], const SoAVec3<Real>& v)
+{
+    if (out.size() != v.size())
+        out.resize(v.size());
+
+    const Real* __restrict vx = v.component(0);
+    const Real* __restrict vy = v.component(1);
+    const Real* __restrict vz = v.component(2);
+    Real* __restrict ox = out.component(0);
+    Real* __restrict oy = out.component(1);
+    Real* __restrict oz = out.component(2);
+
+    const Real m0 = m[0], m1 = m[1], m2 = m[2], m3 = m[3], m4 = m[4], m5 = m[5], m6 = m[6], m7 = m[7], m8 = m[8];
+    const std::size_t n = paddedSize<Real>(v.size());
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        const Real x = vx[i], y = vy[i], z = vz[i];
+        ox[i] = m0 * x + m1 * y + m2 * z;
+        oy[i] = m3 * x + m4 * y + m5 * z;
+        oz[i] = m6 * x + m7 * y + m8 * z;
+    }
+}
+
+/// out_i = q_i v_i q_i^-1, with sign = -1 for the inverse rotation (conjugate quaternion).
+/// The quaternions and vectors are loaded in local packs, as in BatchedMat3x3, so that the loops over the
+/// lanes are vectorized.
+template<typename Real>
+void rotatePerPoint(SoAVec3<Real>& out, const SoAQuat<Real>& q, const SoAVec3<Real>& v, Real sign)
+{
+    constexpr std::size_t Lanes = 64 / sizeof(Real);
+    if (out.size() != v.size())
+        out.resize(v.size());
+
+    Real qv[3][Lanes], qw[Lanes], p[3][Lanes], t[3][Lanes], r[3][Lanes];
+    const std::size_t n = paddedSize<Real>(v.size());
+    for (std::size_t first = 0; first < n; first += Lanes)
+    {
+        for (std::size_t c = 0; c < 3; ++c)
+        {
+            const Real* qc = q.component(c) + first;
+            const Real* vc = v.component(c) + first;
+            for (std::size_t l = 0; l < Lanes; ++l)
+            {
+                qv[c][l] = sign * qc[l];
+                p[c][l] = vc[l];
+            }
+        }
+        const Real* w = q.component(3) + first;
+        for (std::size_t l = 0; l < Lanes; ++l)
+            qw[l] = w[l];
+
+        // t = 2 q x v, r = v + w t + q x t
+        for (std::size_t l = 0; l < Lanes; ++l)
+        {
+            t[0][l] = 2 * (qv[1][l] * p[2][l] - qv[2][l] * p[1][l]);
+            t[1][l] = 2 * (qv[2][l] * p[0][l] - qv[0][l] * p[2][l]);
+            t[2][l] = 2 * (qv[0][l] * p[1][l] - qv[1][l] * p[0][l]);
+        }
+        for (std::size_t l = 0; l < Lanes; ++l)
+        {
+            r[0][l] = p[0][l] + qw[l] * t[0][l] + (qv[1][l] * t[2][l] - qv[2][l] * t[1][l]);
+            r[1][l] = p[1][l] + qw[l] * t[1][l] + (qv[2][l] * t[0][l] - qv[0][l] * t[2][l]);
+            r[2][l] = p[2][l] + qw[l] * t[2][l] + (qv[0][l] * t[1][l] - qv[1][l] * t[0][l]);
+        }
+
+        for (std::size_t c = 0; c < 3; ++c)
+        {
+            Real* oc = out.component(c) + first;
+            for (std::size_t l = 0; l < Lanes; ++l)
+                oc[l] = r[c][l];
+        }
+    }
+}
+
+}
+
+/// out_i = q v_i q^-1: all the vectors rotated by the same quaternion q, given in the order x, y, z, w
+template<typename Real, class Quat>
+void rotate(SoAVec3<Real>& out, const Quat& q, const SoAVec3<Real>& v)
+{
+    Real m[9];
+    detail::quatToMatrix<Real>(q[0], q[1], q[2], q[3], m);
+    detail::rotateByMatrix(out, m, v);
+}
+
+/// out_i = q^-1 v_i q
+template<typename Real, class Quat>
+void inverseRotate(SoAVec3<Real>& out, const Quat& q, const SoAVec3<Real>& v)
+{
+    Real m[9];
+    detail::quatToMatrix<Real>(-q[0], -q[1], -q[2], q[3], m);
+    detail::rotateByMatrix(out, m, v);
+}
+
+/// out_i = q_i v_i q_i^-1
+template<typename Real>
+void rotate(SoAVec3<Real>& out, const SoAQuat<Real>& q, const SoAVec3<Real>& v)
+{
+    detail::rotatePerPoint(out, q, v, static_cast<Real>(1));
+}
+
+/// out_i = q_i^-1 v_i q_i
+template<typename Real>
+void inverseRotate(SoAVec3<Real>& out, const SoAQuat<Real>& q, const SoAVec3<Real>& v)
+{
+    detail::rotatePerPoint(out, q, v, static_cast<Real>(-1));
+}
+
+/**
+ * Spherical linear interpolation out_i = slerp(a_i, b_i, t) along the shortest path.
+ * When a_i and b_i are almost equal, sin(theta) vanishes and the linear interpolation is used instead,
+ * with a select rather than a branch. The result is normalized.
+ */
+template<typename Real>
+void slerp(SoAQuat<Real>& out, const SoAQuat<Real>& a, const SoAQuat<Real>& b, Real t)
+{
+    if (out.size() != a.size())
+        out.resize(a.size());
+
+    const Real* __restrict ax = a.component(0); const Real* __restrict ay = a.component(1);
+    const Real* __restrict az = a.component(2); const Real* __restrict aw = a.component(3);
+    const Real* __restrict bx = b.component(0); const Real* __restrict by = b.component(1);
+    const Real* __restrict bz = b.component(2); const Real* __restrict bw = b.component(3);
+    Real* __restrict ox = out.component(0); Real* __restrict oy = out.component(1);
+    Real* __restrict oz = out.component(2); Real* __restrict ow = out.component(3);
+
+    constexpr Real linearThreshold = static_cast<Real>(0.9995);
+    for (std::size_t i = 0; i < a.size(); ++i)
+    {
+        Real cosTheta = ax[i] * bx[i] + ay[i] * by[i] + az[i] * bz[i] + aw[i] * bw[i];
+        const Real flip = cosTheta < 0 ? static_cast<Real>(-1) : static_cast<Real>(1);
+        cosTheta *= flip;
+
+        const Real theta = std::acos(std::min(cosTheta, static_cast<Real>(1)));
+        const Real sinTheta = std::sin(theta);
+        const bool linear = cosTheta > linearThreshold;
+        const Real invSin = linear ? static_cast<Real>(0) : static_cast<Real>(1) / sinTheta;
+        const Real wa = linear ? 1 - t : std::sin((1 - t) * theta) * invSin;
+        const Real wb = flip * (linear ? t : std::sin(t * theta) * invSin);
+
+        const Real x = wa * ax[i] + wb * bx[i];
+        const Real y = wa * ay[i] + wb * by[i];
+        const Real z = wa * az[i] + wb * bz[i];
+        const Real w = wa * aw[i] + wb * bw[i];
+        const Real invNorm = static_cast<Real>(1) / std::sqrt(x * x + y * y + z * z + w * w);
+        ox[i] = x * invNorm;
+        oy[i] = y * invNorm;
+        oz[i] = z * invNorm;
+        ow[i] = w * invNorm;
+    }
+}
+
+/// Rotation matrices of unit quaternions
+template<typename Real>
+void toMatrix(BatchedMat3x3<Real>& out, const SoAQuat<Real>& q)
+{
+    if (out.size() != q.size())
+        out.resize(q.size());
+
+    const Real* __restrict x = q.component(0);
+    const Real* __restrict y = q.component(1);
+    const Real* __restrict z = q.component(2);
+    const Real* __restrict w = q.component(3);
+
+    // BatchedMat3x3 and SoAQuat are padded on the same cache line size, so their strides are equal
+    Real* __restrict m = out.entry(0, 0);
+    const std::size_t stride = out.stride();
+    for (std::size_t i = 0; i < stride; ++i)
+    {
+        const Real xx = x[i] * x[i], yy = y[i] * y[i], zz = z[i] * z[i];
+        const Real xy = x[i] * y[i], xz = x[i] * z[i], yz = y[i] * z[i];
+        const Real xw = x[i] * w[i], yw = y[i] * w[i], zw = z[i] * w[i];
+        m[i] = 1 - 2 * (yy + zz);
+        m[stride + i] = 2 * (xy - zw);
+        m[2 * stride + i] = 2 * (xz + yw);
+        m[3 * stride + i] = 2 * (xy + zw);
+        m[4 * stride + i] = 1 - 2 * (xx + zz);
+        m[5 * stride + i] = 2 * (yz - xw);
+        m[6 * stride + i] = 2 * (xz - yw);
+        m[7 * stride + i] = 2 * (yz + xw);
+        m[8 * stride + i] = 1 - 2 * (xx + yy);
+    }
+}
+
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <utils/CRSStructureCache.h>
+#include <sofa/linearalgebra/CompressedRowSparseMatrix.h>
+
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+/**
+ * Accumulation of element stiffness matrices by batches, instead of one virtual call per block or per entry
+ * (StiffnessMatrixAccumulator). A force field fills an ElementMatrixBatch with the nodes and the dense matrix of
+ * each element (12x12 for a tetrahedron, 24x24 for a hexahedron), then gives the whole batch to the
+ * accumulator in a single virtual call. The accumulator scatters the 3x3 blocks in a non-virtual loop, which
+ * the compiler can unroll for the size of the element.
+ */
+namespace batchedstiffness
+{
+
+using Index = sofa::Index;
+
+/// Nodes and dense matrices (3 DOFs per node, row-major) of at most `capacity` elements of NbNodes nodes
+template<std::size_t NbNodes, class TReal = SReal>
+class ElementMatrixBatch
+{
+public:
+    using Real = TReal;
+    static constexpr int Size = 3 * static_cast<int>(NbNodes);
+    using Nodes = std::array<Index, NbNodes>;
+    using ElementMatrix = Eigen::Matrix<Real, Size, Size, Eigen::RowMajor>;
+
+    explicit ElementMatrixBatch(std::size_t capacity)
+        : m_nodes(capacity), m_values(capacity * Size * Size)
+    {}
+
+    std::size_t size() const { return m_size; }
+    std::size_t capacity() const { return m_nodes.size(); }
+    bool isFull() const { return m_size == m_nodes.size(); }
+    void clear() { m_size = 0; }
+
+    /// Append an element, the batch being not full. The returned map is the matrix of the element, to be filled.
+    Eigen::Map<ElementMatrix> add(const Nodes& nodes)
+    {
+        assert(!isFull());
+        m_nodes[m_size] = nodes;
+        return Eigen::Map<ElementMatrix>(m_values.data() + Size * Size * m_size++);
+    }
+
+    const Nodes& nodes(std::size_t e) const { return m_nodes[e]; }
+    Eigen::Map<const ElementMatrix> matrix(std::size_t e) const { return Eigen::Map<const ElementMatrix>(m_values.data() + Size * Size * e); }
+
+private:
+    std::size_t m_size { 0 };
+    std::vector<Nodes> m_nodes;
+    std::vector<Real> m_values;
+};
+
+/// Receiver of the batches of tetrahedra (4 nodes) and hexahedra (8 nodes)
+template<class TReal = SReal>
+class BatchedMatrixAccumulator
+{
+public:
+    virtual ~BatchedMatrixAccumulator() = default;
+
+    virtual void addBatch(const ElementMatrixBatch<4, TReal>& batch) = 0;
+    virtual void addBatch(const ElementMatrixBatch<8, TReal>& batch) = 0;
+};
+
+/**
+ * Scatter into a CompressedRowSparseMatrix of 3x3 blocks. The sparsity is recorded by the first assembly (see
+ * CRSStructureCache): the next assemblies, with the same elements in the same order, add each block at its
+ * cached position. Each assembly is enclosed by begin() and end().
+ */
+template<class TReal = SReal>
+class CRSBatchedMatrixAccumulator : public BatchedMatrixAccumulator<TReal>
+{
+public:
+    using Matrix = sofa::linearalgebra::CompressedRowSparseMatrix<sofa::type::Mat<3, 3, TReal> >;
+    using Block = typename Matrix::Block;
+
+    explicit CRSBatchedMatrixAccumulator(Matrix& matrix) : m_matrix(matrix) {}
+
+    void begin() { m_structure.begin(m_matrix); }
+    void end() { m_structure.end(m_matrix); }
+
+    /// Record the sparsity again at the next assembly, e.g. after a change of the topology
+    void invalidate() { m_structure.invalidate(); }
+
+    void addBatch(const ElementMatrixBatch<4, TReal>& batch) override { scatter(batch); }
+    void addBatch(const ElementMatrixBatch<8, TReal>& batch) override { scatter(batch); }
+
+private:
+    template<std::size_t NbNodes>
+    void scatter(const ElementMatrixBatch<NbNodes, TReal>& batch)
+    {
+        for (std::size_t e = 0; e < batch.size(); ++e)
+        {
+            const auto& nodes = batch.nodes(e);
+            const auto matrix = batch.matrix(e);
+            for (std::size_t a = 0; a < NbNodes; ++a)
+            {
+                for (std::size_t b = 0; b < NbNodes; ++b)
+                {
+                    Block block;
+                    for (int i = 0; i < 3; ++i)
+                        for (int j = 0; j < 3; ++j)
+                            block[i][j] = matrix(3 * a + i, 3 * b + j);
+                    m_structure.add(m_matrix, nodes[a], nodes[b], block);
+                }
+            }
+        }
+    }
+
+    Matrix& m_matrix;
+    CRSStructureCache<Matrix> m_structure;
+};
+
+/// Scatter into a list of scalar triplets, for Eigen::SparseMatrix::setFromTriplets
+template<class TReal = SReal>
+class TripletBatchedMatrixAccumulator : public BatchedMatrixAccumulator<TReal>
+{
+public:
+    using Triplet = Eigen::Triplet<TReal>;
+
+    explicit TripletBatchedMatrixAccumulator(std::vector<Triplet>& triplets) : m_triplets(triplets) {}
+
+    void addBatch(const ElementMatrixBatch<4, TReal>& batch) override { scatter(batch); }
+    void addBatch(const ElementMatrixBatch<8, TReal>& batch) override { scatter(batch); }
+
+private:
+    template<std::size_t NbNodes>
+    void scatter(const ElementMatrixBatch<NbNodes, TReal>& batch)
+    {
+        constexpr int Size = ElementMatrixBatch<NbNodes, TReal>::Size;
+        for (std::size_t e = 0; e < batch.size(); ++e)
+        {
+            const auto& nodes = batch.nodes(e);
+            const auto matrix = batch.matrix(e);
+            for (int r = 0; r < Size; ++r)
+            {
+                const auto row = static_cast<int>(3 * nodes[r / 3] + r % 3);
+                for (int c = 0; c < Size; ++c)
+                    m_triplets.emplace_back(row, static_cast<int>(3 * nodes[c / 3] + c % 3), matrix(r, c));
+            }
+        }
+    }
+
+    std::vector<Triplet>& m_triplets;
+};
+
+}
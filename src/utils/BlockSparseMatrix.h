@@ -0,0 +1,311 @@
+#pragma once
+
+#include <utils/SoAVec3.h>
+
+#include <sofa/linearalgebra/CompressedRowSparseMatrix.h>
+#include <sofa/simulation/ParallelForEach.h>
+#include <sofa/simulation/TaskScheduler.h>
+#include <sofa/type/Mat.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+// The AVX2/FMA kernel is compiled for the x86-64 processors whatever the compilation flags, and selected at
+// runtime if the processor supports it: it does not depend on SOFABENCHMARK_ENABLE_NATIVE_ARCH.
+#if defined(__x86_64__) || defined(_M_X64)
+#define SOFABENCHMARK_BSR_AVX2_KERNEL 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define SOFABENCHMARK_TARGET_AVX2_FMA
+#else
+#define SOFABENCHMARK_TARGET_AVX2_FMA __attribute__((target("avx2,fma")))
+#endif
+#else
+#define SOFABENCHMARK_BSR_AVX2_KERNEL 0
+#endif
+
+/**
+ * Block sparse row (BSR) matrix made of 3x3 blocks, dedicated to the matrix-vector products of the
+ * iterative solvers.
+ * Compared to CompressedRowSparseMatrix<Mat<3,3,double>>:
+ * - rowBegin has an entry for every block row, including the empty ones, so that a range of rows can be
+ *   processed without searching in rowIndex,
+ * - the blocks are stored column-major, so that a product by a block is the sum of its three columns
+ *   weighted by the components of the vector, i.e. three fused multiply-adds on 4-wide registers,
+ * - the values can be stored in float (StorageReal) to halve the memory traffic, the products being always
+ *   accumulated in double.
+ * The value array has one padding value at its end, so that the last column of the last block can be loaded
+ * with a 4-wide load.
+ */
+template<typename TStorageReal>
+class BSR3x3Matrix
+{
+public:
+    using StorageReal = TStorageReal;
+    using Index = sofa::Index;
+    static constexpr std::size_t BlockSize = 9;
+
+    Index nbBlockRows() const { return m_nbBlockRows; }
+    Index nbBlockCols() const { return m_nbBlockCols; }
+    std::size_t nbBlocks() const { return m_colsIndex.size(); }
+
+    const std::vector<Index>& rowBegin() const { return m_rowBegin; }
+    const std::vector<Index>& colsIndex() const { return m_colsIndex; }
+
+    /// The 9 values of the k-th block, column-major
+    const StorageReal* block(std::size_t k) const { return m_values.data() + k * BlockSize; }
+
+    /// Copy of a compressed CRS matrix made of 3x3 blocks
+    template<class TBlockReal>
+    void fromCRS(const sofa::linearalgebra::CompressedRowSparseMatrix<sofa::type::Mat<3, 3, TBlockReal> >& crs)
+    {
+        m_nbBlockRows = static_cast<Index>(crs.rowBSize());
+        m_nbBlockCols = static_cast<Index>(crs.colBSize());
+
+        m_rowBegin.assign(m_nbBlockRows + 1, 0);
+        for (std::size_t i = 0; i < crs.rowIndex.size(); ++i)
+        {
+            m_rowBegin[crs.rowIndex[i] + 1] = crs.rowBegin[i + 1] - crs.rowBegin[i];
+        }
+        for (Index r = 0; r < m_nbBlockRows; ++r)
+        {
+            m_rowBegin[r + 1] += m_rowBegin[r];
+        }
+
+        const std::size_t nnzb = crs.colsIndex.size();
+        m_colsIndex.resize(nnzb);
+        m_values.assign(nnzb * BlockSize + 1, 0);
+        for (std::size_t i = 0; i < crs.rowIndex.size(); ++i)
+        {
+            Index k = m_rowBegin[crs.rowIndex[i]];
+            for (auto c = crs.rowBegin[i]; c < crs.rowBegin[i + 1]; ++c, ++k)
+            {
+                m_colsIndex[k] = crs.colsIndex[c];
+                const auto& b = crs.colsValue[c];
+                StorageReal* v = m_values.data() + k * BlockSize;
+                for (int col = 0; col < 3; ++col)
+                    for (int row = 0; row < 3; ++row)
+                        v[3 * col + row] = static_cast<StorageReal>(b[row][col]);
+            }
+        }
+    }
+
+private:
+    Index m_nbBlockRows { 0 };
+    Index m_nbBlockCols { 0 };
+    std::vector<Index> m_rowBegin;
+    std::vector<Index> m_colsIndex;
+    std::vector<StorageReal, AlignedAllocator<StorageReal> > m_values;
+};
+
+namespace bsr
+{
+
+/// Kernel of the products by the blocks
+enum class Kernel : int
+{
+    Scalar = 0,
+    AVX2 = 1 ///< 4-wide fused multiply-adds, x86-64 processors with AVX2 and FMA only
+};
+
+inline const char* toString(Kernel kernel)
+{
+    return kernel == Kernel::AVX2 ? "AVX2" : "Scalar";
+}
+
+/// True if the processor running the program can execute the kernel
+inline bool isSupported(Kernel kernel)
+{
+    if (kernel == Kernel::Scalar)
+        return true;
+#if SOFABENCHMARK_BSR_AVX2_KERNEL
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    const bool fma = (info[2] & (1 << 12)) != 0;
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    __cpuidex(info, 7, 0);
+    const bool avx2 = (info[1] & (1 << 5)) != 0;
+    return fma && avx2 && osxsave && (_xgetbv(0) & 6) == 6;
+#else
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+#else
+    return false;
+#endif
+}
+
+/// Fastest kernel supported by the processor
+inline Kernel getDefaultKernel()
+{
+    static const Kernel kernel = isSupported(Kernel::AVX2) ? Kernel::AVX2 : Kernel::Scalar;
+    return kernel;
+}
+
+namespace detail
+{
+
+/// y[3r..3r+2] = sum of the blocks of the row r times x, for the rows [firstRow, lastRow)
+template<typename StorageReal>
+void multiplyRows(const BSR3x3Matrix<StorageReal>& A, const double* __restrict x, double* __restrict y,
+                  sofa::Index firstRow, sofa::Index lastRow)
+{
+    const auto& rowBegin = A.rowBegin();
+    const auto& colsIndex = A.colsIndex();
+    for (auto r = firstRow; r < lastRow; ++r)
+    {
+        double y0 = 0, y1 = 0, y2 = 0;
+        for (auto k = rowBegin[r]; k < rowBegin[r + 1]; ++k)
+        {
+            const StorageReal* b = A.block(k);
+            const double* xc = x + 3 * colsIndex[k];
+            const double x0 = xc[0], x1 = xc[1], x2 = xc[2];
+            y0 += b[0] * x0 + b[3] * x1 + b[6] * x2;
+            y1 += b[1] * x0 + b[4] * x1 + b[7] * x2;
+            y2 += b[2] * x0 + b[5] * x1 + b[8] * x2;
+        }
+        y[3 * r] = y0;
+        y[3 * r + 1] = y1;
+        y[3 * r + 2] = y2;
+    }
+}
+
+#if SOFABENCHMARK_BSR_AVX2_KERNEL
+SOFABENCHMARK_TARGET_AVX2_FMA inline __m256d loadColumn(const double* c) { return _mm256_loadu_pd(c); }
+SOFABENCHMARK_TARGET_AVX2_FMA inline __m256d loadColumn(const float* c) { return _mm256_cvtps_pd(_mm_loadu_ps(c)); }
+
+/// The 4th lane of a column is the first value of the next column (or the padding): it only pollutes the
+/// 4th lane of the accumulator, which is not stored
+template<typename StorageReal>
+SOFABENCHMARK_TARGET_AVX2_FMA void multiplyRowsAVX2(const BSR3x3Matrix<StorageReal>& A, const double* __restrict x, double* __restrict y,
+                      sofa::Index firstRow, sofa::Index lastRow)
+{
+    const auto& rowBegin = A.rowBegin();
+    const auto& colsIndex = A.colsIndex();
+    for (auto r = firstRow; r < lastRow; ++r)
+    {
+        __m256d acc0 = _mm256_setzero_pd();
+        __m256d acc1 = _mm256_setzero_pd();
+        for (auto k = rowBegin[r]; k < rowBegin[r + 1]; ++k)
+        {
+            const StorageReal* b = A.block(k);
+            const double* xc = x + 3 * colsIndex[k];
+            acc0 = _mm256_fmadd_pd(loadColumn(b), _mm256_broadcast_sd(xc), acc0);
+            acc1 = _mm256_fmadd_pd(loadColumn(b + 3), _mm256_broadcast_sd(xc + 1), acc1);
+            acc0 = _mm256_fmadd_pd(loadColumn(b + 6), _mm256_broadcast_sd(xc + 2), acc0);
+        }
+        alignas(32) double lanes[4];
+        _mm256_store_pd(lanes, _mm256_add_pd(acc0, acc1));
+        y[3 * r] = lanes[0];
+        y[3 * r + 1] = lanes[1];
+        y[3 * r + 2] = lanes[2];
+    }
+}
+#endif
+
+template<typename StorageReal>
+void multiplyRange(const BSR3x3Matrix<StorageReal>& A, const double* x, double* y,
+                   sofa::Index firstRow, sofa::Index lastRow, Kernel kernel)
+{
+    assert(isSupported(kernel));
+#if SOFABENCHMARK_BSR_AVX2_KERNEL
+    if (kernel == Kernel::AVX2)
+    {
+        multiplyRowsAVX2(A, x, y, firstRow, lastRow);
+        return;
+    }
+#endif
+    multiplyRows(A, x, y, firstRow, lastRow);
+}
+
+/// y[3c..3c+2] += transpose of the blocks of the rows [firstRow, lastRow) times x
+template<typename StorageReal>
+void multiplyTransposeRows(const BSR3x3Matrix<StorageReal>& A, const double* __restrict x, double* __restrict y,
+                           sofa::Index firstRow, sofa::Index lastRow)
+{
+    const auto& rowBegin = A.rowBegin();
+    const auto& colsIndex = A.colsIndex();
+    for (auto r = firstRow; r < lastRow; ++r)
+    {
+        const double x0 = x[3 * r], x1 = x[3 * r + 1], x2 = x[3 * r + 2];
+        for (auto k = rowBegin[r]; k < rowBegin[r + 1]; ++k)
+        {
+            // column-major: the column c of the block is the row c of its transpose
+            const StorageReal* b = A.block(k);
+            double* yc = y + 3 * colsIndex[k];
+            yc[0] += b[0] * x0 + b[1] * x1 + b[2] * x2;
+            yc[1] += b[3] * x0 + b[4] * x1 + b[5] * x2;
+            yc[2] += b[6] * x0 + b[7] * x1 + b[8] * x2;
+        }
+    }
+}
+
+}
+
+/// y = A x. x has 3 * nbBlockCols values, y has 3 * nbBlockRows values. The kernel must be supported.
+template<typename StorageReal>
+void multiply(const BSR3x3Matrix<StorageReal>& A, const double* x, double* y, Kernel kernel = getDefaultKernel())
+{
+    detail::multiplyRange(A, x, y, 0, A.nbBlockRows(), kernel);
+}
+
+/// y = A x, the block rows being distributed over the threads of the task scheduler
+template<typename StorageReal>
+void multiply(sofa::simulation::TaskScheduler& taskScheduler, const BSR3x3Matrix<StorageReal>& A, const double* x, double* y,
+              Kernel kernel = getDefaultKernel())
+{
+    sofa::simulation::parallelForEachRange(taskScheduler, static_cast<sofa::Index>(0), A.nbBlockRows(),
+        [&A, x, y, kernel](const auto& range)
+        {
+            detail::multiplyRange(A, x, y, range.start, range.end, kernel);
+        });
+}
+
+/// y = A^T x. x has 3 * nbBlockRows values, y has 3 * nbBlockCols values.
+template<typename StorageReal>
+void multiplyTranspose(const BSR3x3Matrix<StorageReal>& A, const double* x, double* y)
+{
+    std::fill(y, y + 3 * A.nbBlockCols(), 0.);
+    detail::multiplyTransposeRows(A, x, y, 0, A.nbBlockRows());
+}
+
+/**
+ * y = A^T x in parallel. The transposed product scatters into y, so each part of the rows accumulates into
+ * its own copy of y (in work, nbParts * 3 * nbBlockCols values, kept by the caller between two products),
+ * and the copies are then summed in parallel over the entries of y.
+ */
+template<typename StorageReal>
+void multiplyTranspose(sofa::simulation::TaskScheduler& taskScheduler, const BSR3x3Matrix<StorageReal>& A,
+                       const double* x, double* y, std::vector<double>& work)
+{
+    const std::size_t nbParts = std::max(1u, taskScheduler.getThreadCount());
+    const std::size_t n = 3 * static_cast<std::size_t>(A.nbBlockCols());
+    work.resize(nbParts * n);
+
+    sofa::simulation::parallelForEach(taskScheduler, static_cast<std::size_t>(0), nbParts,
+        [&A, x, &work, n, nbParts](std::size_t p)
+        {
+            double* yp = work.data() + p * n;
+            std::fill(yp, yp + n, 0.);
+            const auto firstRow = static_cast<sofa::Index>(A.nbBlockRows() * p / nbParts);
+            const auto lastRow = static_cast<sofa::Index>(A.nbBlockRows() * (p + 1) / nbParts);
+            detail::multiplyTransposeRows(A, x, yp, firstRow, lastRow);
+        });
+
+    sofa::simulation::parallelForEachRange(taskScheduler, static_cast<std::size_t>(0), n,
+        [y, &work, n, nbParts](const auto& range)
+        {
+            for (auto i = range.start; i != range.end; ++i)
+            {
+                double sum = 0;
+                for (std::size_t p = 0; p < nbParts; ++p)
+                    sum += work[p * n + i];
+                y[i] = sum;
+            }
+        });
+}
+
+}
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <sofa/linearalgebra/CompressedRowSparseMatrix.h>
+#include <sofa/simulation/ParallelForEach.h>
+#include <sofa/simulation/TaskScheduler.h>
+#include <sofa/type/Mat.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/**
+ * Product of two CompressedRowSparseMatrix made of blocks (e.g. 3x3 for the mapping Jacobians and the
+ * stiffness matrices of deformable objects, 6x6 for rigids), with the same principle and interface as
+ * sofa::linearalgebra::SparseMatrixProduct, which works only on scalar Eigen matrices:
+ * - the intersection (computed once, as long as the sparsity does not change) lists, for each block of the
+ *   result, the pairs (block of lhs, block of rhs) whose products are summed in it,
+ * - the product itself only accumulates the products of the pairs of the intersection.
+ * The intersection is computed at the block level: compared to the same product on the scalar matrices, it
+ * has N*N times fewer entries, each with N times fewer pairs, and each pair is a N x N block product.
+ */
+template<class TLhs, class TRhs, class TResult>
+class BlockSparseMatrixProduct
+{
+public:
+    using Lhs = TLhs;
+    using Rhs = TRhs;
+    using ResultType = TResult;
+    using LhsCleaned = Lhs;
+    using RhsCleaned = Rhs;
+    using Index = sofa::Index;
+
+    const Lhs* m_lhs { nullptr };
+    const Rhs* m_rhs { nullptr };
+
+    virtual ~BlockSparseMatrixProduct() = default;
+
+    /// Product from the intersection, which is computed first if needed
+    void computeProduct(bool forceComputingIntersection = false)
+    {
+        assert(m_lhs != nullptr && m_rhs != nullptr);
+        if (forceComputingIntersection || !m_hasComputedIntersection)
+        {
+            computeIntersection();
+            m_hasComputedIntersection = true;
+        }
+        computeProductFromIntersection();
+    }
+
+    /// Product without intersection, as a reference
+    void computeRegularProduct()
+    {
+        assert(m_lhs != nullptr && m_rhs != nullptr);
+        m_lhs->mul(m_productResult, *m_rhs);
+    }
+
+    const ResultType& getProductResult() const { return m_productResult; }
+
+    /// Number of pairs of blocks in the intersection, i.e. of block products in computeProduct
+    std::size_t getNbIntersectionPairs() const { return m_pairs.size(); }
+
+protected:
+    virtual void computeProductFromIntersection()
+    {
+        computeBlocks(0, m_productResult.colsIndex.size());
+    }
+
+    /// Value of the result blocks [first, last) from the pairs of the intersection
+    void computeBlocks(std::size_t first, std::size_t last)
+    {
+        const auto& lhsValues = m_lhs->colsValue;
+        const auto& rhsValues = m_rhs->colsValue;
+        auto& resultValues = m_productResult.colsValue;
+        for (std::size_t b = first; b < last; ++b)
+        {
+            typename ResultType::Block sum;
+            sum.clear();
+            for (auto p = m_pairBegin[b]; p < m_pairBegin[b + 1]; ++p)
+            {
+                accumulateProduct(sum, lhsValues[m_pairs[p].first], rhsValues[m_pairs[p].second]);
+            }
+            resultValues[b] = sum;
+        }
+    }
+
+    /// Gustavson's algorithm on the blocks: for each block row i of lhs, and each block (i,k) of this row,
+    /// the blocks (k,j) of rhs contribute to the block (i,j) of the result. The structure of the result is
+    /// written in its compressed arrays, and the pairs of each of its blocks are stored contiguously.
+    void computeIntersection()
+    {
+        const Lhs& lhs = *m_lhs;
+        const Rhs& rhs = *m_rhs;
+        assert(lhs.colBSize() == rhs.rowBSize());
+
+        // Position of each block row of rhs in rhs.rowIndex, which lists only the non-empty rows
+        m_rhsRowPosition.assign(rhs.rowBSize(), sofa::InvalidID);
+        for (std::size_t i = 0; i < rhs.rowIndex.size(); ++i)
+        {
+            m_rhsRowPosition[rhs.rowIndex[i]] = static_cast<Index>(i);
+        }
+
+        m_productResult.resizeBlock(lhs.rowBSize(), rhs.colBSize());
+        m_productResult.rowIndex.clear();
+        m_productResult.rowBegin.clear();
+        m_productResult.colsIndex.clear();
+        m_pairBegin.clear();
+        m_pairs.clear();
+
+        for (std::size_t i = 0; i < lhs.rowIndex.size(); ++i)
+        {
+            m_rowContributions.clear();
+            for (auto a = lhs.rowBegin[i]; a < lhs.rowBegin[i + 1]; ++a)
+            {
+                const Index k = m_rhsRowPosition[lhs.colsIndex[a]];
+                if (k == sofa::InvalidID)
+                    continue;
+                for (auto b = rhs.rowBegin[k]; b < rhs.rowBegin[k + 1]; ++b)
+                {
+                    m_rowContributions.push_back({rhs.colsIndex[b], {a, b}});
+                }
+            }
+            if (m_rowContributions.empty())
+                continue;
+
+            // stable: the pairs of a block are summed in the order of the columns of lhs
+            std::stable_sort(m_rowContributions.begin(), m_rowContributions.end(),
+                [](const auto& c0, const auto& c1) { return c0.first < c1.first; });
+
+            m_productResult.rowIndex.push_back(lhs.rowIndex[i]);
+            m_productResult.rowBegin.push_back(static_cast<Index>(m_productResult.colsIndex.size()));
+            for (std::size_t c = 0; c < m_rowContributions.size(); ++c)
+            {
+                if (c == 0 || m_rowContributions[c].first != m_rowContributions[c - 1].first)
+                {
+                    m_productResult.colsIndex.push_back(m_rowContributions[c].first);
+                    m_pairBegin.push_back(static_cast<Index>(m_pairs.size()));
+                }
+                m_pairs.push_back(m_rowContributions[c].second);
+            }
+        }
+        m_productResult.rowBegin.push_back(static_cast<Index>(m_productResult.colsIndex.size()));
+        m_pairBegin.push_back(static_cast<Index>(m_pairs.size()));
+        m_productResult.colsValue.resize(m_productResult.colsIndex.size());
+
+        // resizeBlock() with an unchanged size marks the matrix as not compressed if it had blocks: the arrays
+        // written above are the compressed form, so compress() and wblock() must not merge them again
+        m_productResult.compressed = true;
+    }
+
+    /// sum += a * b, without temporary block
+    template<sofa::Size L, sofa::Size M, sofa::Size N, class Real>
+    static void accumulateProduct(sofa::type::Mat<L, N, Real>& sum, const sofa::type::Mat<L, M, Real>& a,
+                                  const sofa::type::Mat<M, N, Real>& b)
+    {
+        for (sofa::Size r = 0; r < L; ++r)
+        {
+            for (sofa::Size k = 0; k < M; ++k)
+            {
+                const Real ark = a[r][k];
+                for (sofa::Size c = 0; c < N; ++c)
+                {
+                    sum[r][c] += ark * b[k][c];
+                }
+            }
+        }
+    }
+
+    ResultType m_productResult;
+    bool m_hasComputedIntersection { false };
+
+    /// Pairs (index in lhs.colsValue, index in rhs.colsValue) of the result block b are
+    /// m_pairs[m_pairBegin[b]] to m_pairs[m_pairBegin[b + 1] - 1]
+    std::vector<Index> m_pairBegin;
+    std::vector<std::pair<Index, Index> > m_pairs;
+
+    // Work arrays of the intersection
+    std::vector<Index> m_rhsRowPosition;
+    std::vector<std::pair<Index, std::pair<Index, Index> > > m_rowContributions;
+};
+
+/// Same as BlockSparseMatrixProduct, the blocks of the result being computed in parallel, as in
+/// sofa::simulation::ParallelSparseMatrixProduct
+template<class TLhs, class TRhs, class TResult>
+class ParallelBlockSparseMatrixProduct : public BlockSparseMatrixProduct<TLhs, TRhs, TResult>
+{
+public:
+    sofa::simulation::TaskScheduler* taskScheduler { nullptr };
+
+protected:
+    void computeProductFromIntersection() override
+    {
+        assert(taskScheduler != nullptr);
+        sofa::simulation::parallelForEachRange(*taskScheduler,
+            static_cast<std::size_t>(0), this->m_productResult.colsIndex.size(),
+            [this](const auto& range)
+            {
+                this->computeBlocks(range.start, range.end);
+            });
+    }
+};
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <sofa/linearalgebra/CompressedRowSparseMatrix.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+/// Empty a CompressedRowSparseMatrix and its structure, keeping its size. clear() and resizeBlock() with the
+/// same size keep the compressed structure and only zero the values: the blocks of a previous sparsity would
+/// stay in the pattern, and the next insertions would only refill it. Resizing to an empty matrix first
+/// discards the structure.
+template<class TMatrix>
+void clearCRSStructure(TMatrix& matrix)
+{
+    const auto nbBlockRows = matrix.rowBSize();
+    const auto nbBlockCols = matrix.colBSize();
+    matrix.resizeBlock(0, 0);
+    matrix.resizeBlock(nbBlockRows, nbBlockCols);
+}
+
+/**
+ * Reuse of the sparsity pattern of a CompressedRowSparseMatrix assembled repeatedly with the same sequence
+ * of insertions, as a stiffness matrix at each time step when the topology does not change.
+ *
+ * The first assembly is recorded: the blocks are inserted with wblock() and, after compress(), the position
+ * of each insertion in colsValue is computed once (binary search in the compressed rows). The next
+ * assemblies only zero the values and accumulate each block at its cached position: no search, no
+ * temporary block list and no reallocation.
+ *
+ * The k-th insertion of a refill must be at the same position as the k-th insertion of the recorded
+ * assembly. This is checked with assertions only; invalidate() must be called when the sparsity changes.
+ */
+template<class TMatrix>
+class CRSStructureCache
+{
+public:
+    using Matrix = TMatrix;
+    using Block = typename Matrix::Block;
+    using Index = sofa::Index;
+
+    enum class State { Empty, Recording, Ready, Refilling };
+
+    State getState() const { return m_state; }
+    bool isReady() const { return m_state == State::Ready; }
+    std::size_t getNbInsertions() const { return m_valuePositions.size(); }
+
+    /// Forget the structure: the next assembly is recorded again
+    void invalidate()
+    {
+        m_state = State::Empty;
+        m_rows.clear();
+        m_cols.clear();
+        m_valuePositions.clear();
+    }
+
+    /// Start an assembly: recorded if the structure is not known yet, otherwise a refill of the values
+    void begin(Matrix& matrix)
+    {
+        if (m_state == State::Ready)
+        {
+            std::fill(matrix.colsValue.begin(), matrix.colsValue.end(), Block());
+            m_next = 0;
+            m_state = State::Refilling;
+        }
+        else
+        {
+            invalidate();
+            clearCRSStructure(matrix);
+            m_state = State::Recording;
+        }
+    }
+
+    void add(Matrix& matrix, Index blockRow, Index blockCol, const Block& value)
+    {
+        getBlock(matrix, blockRow, blockCol) += value;
+    }
+
+    /// Add value to the entry (r, c) of a block. Each call is an insertion, cached as the blocks.
+    template<class TReal>
+    void addEntry(Matrix& matrix, Index blockRow, Index blockCol, Index r, Index c, TReal value)
+    {
+        getBlock(matrix, blockRow, blockCol)[r][c] += value;
+    }
+
+    /// End an assembly. After a recording, the matrix is compressed and the positions of the insertions
+    /// are computed.
+    void end(Matrix& matrix)
+    {
+        if (m_state == State::Refilling)
+        {
+            assert(m_next == m_valuePositions.size());
+            m_state = State::Ready;
+            return;
+        }
+
+        assert(m_state == State::Recording);
+        matrix.compress();
+
+        m_valuePositions.resize(m_rows.size());
+        for (std::size_t k = 0; k < m_rows.size(); ++k)
+        {
+            m_valuePositions[k] = findValuePosition(matrix, m_rows[k], m_cols[k]);
+        }
+
+#ifdef NDEBUG
+        // The positions are only kept to check the refills
+        m_rows = {};
+        m_cols = {};
+#endif
+        m_state = State::Ready;
+    }
+
+private:
+    /// Block of the next insertion: at its cached position in a refill, inserted with wblock() in a recording
+    Block& getBlock(Matrix& matrix, Index blockRow, Index blockCol)
+    {
+        if (m_state == State::Refilling)
+        {
+            assert(m_next < m_valuePositions.size());
+            assert(m_rows[m_next] == blockRow && m_cols[m_next] == blockCol);
+            return matrix.colsValue[m_valuePositions[m_next++]];
+        }
+
+        assert(m_state == State::Recording);
+        m_rows.push_back(blockRow);
+        m_cols.push_back(blockCol);
+        return *(matrix.wblock(blockRow, blockCol, true));
+    }
+
+    static Index findValuePosition(const Matrix& matrix, Index blockRow, Index blockCol)
+    {
+        const auto rowIt = std::lower_bound(matrix.rowIndex.begin(), matrix.rowIndex.end(), blockRow);
+        assert(rowIt != matrix.rowIndex.end() && *rowIt == blockRow);
+        const auto i = static_cast<std::size_t>(rowIt - matrix.rowIndex.begin());
+
+        const auto colsBegin = matrix.colsIndex.begin() + matrix.rowBegin[i];
+        const auto colsEnd = matrix.colsIndex.begin() + matrix.rowBegin[i + 1];
+        const auto colIt = std::lower_bound(colsBegin, colsEnd, blockCol);
+        assert(colIt != colsEnd && *colIt == blockCol);
+        return static_cast<Index>(colIt - matrix.colsIndex.begin());
+    }
+
+    State m_state { State::Empty };
+    std::vector<Index> m_rows;
+    std::vector<Index> m_cols;
+    std::vector<Index> m_valuePositions;
+    std::size_t m_next { 0 };
+};
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <sofa/config.h>
+#include <sofa/simulation/ParallelForEach.h>
+#include <sofa/simulation/TaskScheduler.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+/**
+ * Coloring of the elements of a mesh (tetrahedra, hexahedra, or any element of K nodes) such that two elements
+ * sharing a node never have the same color. The elements of a color can then accumulate their nodal
+ * contributions (addForce, addDForce) concurrently without atomics: the colors are processed one after the
+ * other, and the elements of a color in parallel.
+ *
+ * Strategies:
+ * - Greedy: each element, in the order of the mesh, takes the smallest color not used by its neighbors. Few
+ *   colors, but the last colors are small, so the end of the loop has little parallelism.
+ * - Balanced: the greedy coloring, then each element moves to the smallest color not used by its neighbors
+ *   if this color has fewer elements than its own (one pass of vertex-centric shuffling). Same number of
+ *   colors, with sizes closer to the average.
+ *
+ * The coloring is kept until the topology changes: update() recomputes it only if the revision of the
+ * topology (e.g. BaseMeshTopology::getRevision()), the number of elements or the strategy changed.
+ */
+namespace elementcoloring
+{
+
+using Index = sofa::Index;
+
+enum class Strategy { Greedy, Balanced };
+
+inline const char* toString(Strategy strategy)
+{
+    switch (strategy)
+    {
+        case Strategy::Greedy: return "Greedy";
+        case Strategy::Balanced: return "Balanced";
+    }
+    return "";
+}
+
+class ElementColoring
+{
+public:
+    /// Compute the coloring if it is not up to date. Returns true if it has been computed.
+    template<std::size_t K>
+    bool update(Index nbNodes, const std::vector<std::array<Index, K> >& elements, Strategy strategy, int revision)
+    {
+        if (isUpToDate(elements.size(), strategy, revision))
+            return false;
+        compute(nbNodes, elements, strategy);
+        m_revision = revision;
+        return true;
+    }
+
+    bool isUpToDate(std::size_t nbElements, Strategy strategy, int revision) const
+    {
+        return m_isComputed && m_revision == revision && m_strategy == strategy && m_colors.size() == nbElements;
+    }
+
+    /// Force the computation at the next update
+    void invalidate() { m_isComputed = false; }
+
+    template<std::size_t K>
+    void compute(Index nbNodes, const std::vector<std::array<Index, K> >& elements, Strategy strategy)
+    {
+        buildNodeElements(nbNodes, elements);
+
+        const std::size_t nbElements = elements.size();
+        m_colors.assign(nbElements, noColor);
+        m_colorSizes.clear();
+        m_forbidden.clear();
+
+        // Greedy: smallest color not used by the neighbors already colored
+        for (std::size_t e = 0; e < nbElements; ++e)
+        {
+            markNeighborColors(elements[e], e);
+            Index color = 0;
+            while (color < m_forbidden.size() && m_forbidden[color] == e)
+                ++color;
+            setColor(e, color);
+        }
+
+        if (strategy == Strategy::Balanced)
+        {
+            // Move each element to the smallest allowed color if it is smaller than its own. The neighbors of an
+            // element are all colored here, so the coloring stays valid after each move.
+            std::fill(m_forbidden.begin(), m_forbidden.end(), std::numeric_limits<std::size_t>::max());
+            for (std::size_t e = 0; e < nbElements; ++e)
+            {
+                markNeighborColors(elements[e], e);
+                Index best = m_colors[e];
+                for (Index color = 0; color < m_colorSizes.size(); ++color)
+                {
+                    if (m_forbidden[color] != e && m_colorSizes[color] + 1 < m_colorSizes[best])
+                        best = color;
+                }
+                if (best != m_colors[e])
+                {
+                    --m_colorSizes[m_colors[e]];
+                    setColor(e, best);
+                }
+            }
+        }
+
+        // Elements sorted by color, in the order of the mesh inside a color
+        m_colorBegin.assign(m_colorSizes.size() + 1, 0);
+        for (Index color = 0; color < m_colorSizes.size(); ++color)
+            m_colorBegin[color + 1] = m_colorBegin[color] + m_colorSizes[color];
+        m_elements.resize(nbElements);
+        std::vector<Index> next(m_colorBegin.begin(), m_colorBegin.end() - 1);
+        for (std::size_t e = 0; e < nbElements; ++e)
+            m_elements[next[m_colors[e]]++] = static_cast<Index>(e);
+
+        m_strategy = strategy;
+        m_isComputed = true;
+    }
+
+    Index getNbColors() const { return static_cast<Index>(m_colorSizes.size()); }
+    Index getColor(std::size_t element) const { return m_colors[element]; }
+    Index getColorSize(Index color) const { return m_colorSizes[color]; }
+
+    /// Elements of a color, in [begin, end)
+    const Index* begin(Index color) const { return m_elements.data() + m_colorBegin[color]; }
+    const Index* end(Index color) const { return m_elements.data() + m_colorBegin[color + 1]; }
+
+    /// Size of the largest color divided by the average size (1 for a perfect balance)
+    double getImbalance() const
+    {
+        if (m_colorSizes.empty())
+            return 1;
+        const auto largest = *std::max_element(m_colorSizes.begin(), m_colorSizes.end());
+        return static_cast<double>(largest) * m_colorSizes.size() / m_colors.size();
+    }
+
+private:
+    static constexpr Index noColor = std::numeric_limits<Index>::max();
+
+    template<std::size_t K>
+    void buildNodeElements(Index nbNodes, const std::vector<std::array<Index, K> >& elements)
+    {
+        m_nodeElementBegin.assign(nbNodes + 1, 0);
+        for (const auto& element : elements)
+            for (const Index node : element)
+                ++m_nodeElementBegin[node + 1];
+        for (Index n = 0; n < nbNodes; ++n)
+            m_nodeElementBegin[n + 1] += m_nodeElementBegin[n];
+
+        m_nodeElements.resize(m_nodeElementBegin.back());
+        std::vector<Index> next(m_nodeElementBegin.begin(), m_nodeElementBegin.end() - 1);
+        for (std::size_t e = 0; e < elements.size(); ++e)
+            for (const Index node : elements[e])
+                m_nodeElements[next[node]++] = static_cast<Index>(e);
+    }
+
+    /// m_forbidden[c] == e for each color c of the neighbors of the element e (the element itself excluded)
+    template<std::size_t K>
+    void markNeighborColors(const std::array<Index, K>& element, std::size_t e)
+    {
+        for (const Index node : element)
+        {
+            for (Index k = m_nodeElementBegin[node]; k < m_nodeElementBegin[node + 1]; ++k)
+            {
+                const Index neighbor = m_nodeElements[k];
+                if (neighbor != e && m_colors[neighbor] != noColor)
+                    m_forbidden[m_colors[neighbor]] = e;
+            }
+        }
+    }
+
+    void setColor(std::size_t e, Index color)
+    {
+        if (color >= m_colorSizes.size())
+        {
+            m_colorSizes.resize(color + 1, 0);
+            m_forbidden.resize(color + 1, std::numeric_limits<std::size_t>::max());
+        }
+        m_colors[e] = color;
+        ++m_colorSizes[color];
+    }
+
+    bool m_isComputed { false };
+    int m_revision { 0 };
+    Strategy m_strategy { Strategy::Greedy };
+
+    std::vector<Index> m_colors;
+    std::vector<Index> m_colorSizes;
+    std::vector<Index> m_colorBegin;
+    std::vector<Index> m_elements;
+
+    // Work arrays: elements around each node, in compressed rows, and colors forbidden for the current element
+    std::vector<Index> m_nodeElementBegin;
+    std::vector<Index> m_nodeElements;
+    std::vector<std::size_t> m_forbidden;
+};
+
+/// Call f(element) for all the elements, color by color, the elements of a color being processed in parallel
+template<class F>
+void parallelForEachElementByColor(sofa::simulation::TaskScheduler& taskScheduler, const ElementColoring& coloring, const F& f)
+{
+    for (Index color = 0; color < coloring.getNbColors(); ++color)
+    {
+        sofa::simulation::parallelForEachRange(taskScheduler, coloring.begin(color), coloring.end(color),
+            [&f](const auto& range)
+            {
+                for (auto it = range.start; it != range.end; ++it)
+                    f(*it);
+            });
+    }
+}
+
+}
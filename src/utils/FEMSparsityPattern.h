@@ -0,0 +1,349 @@
+#pragma once
+
+#include <Eigen/Sparse>
+#include <sofa/config.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <vector>
+
+/**
+ * Sparsity patterns of FEM stiffness matrices, built from the topology of a mesh instead of random positions:
+ * two nodes are coupled if they share an element, so the pattern is symmetric, has a diagonal, and its
+ * number of non-zeros per row is fixed by the topology (27 nodes for hexahedra on a grid, i.e. 81 scalar
+ * non-zeros per row with 3 DOFs per node, 15 nodes for tetrahedra, i.e. 45).
+ * The nodes can be renumbered (randomly, as the output of a mesher, or with RCM/AMD) to measure the effect
+ * of the ordering on the cache behavior of the sparse kernels.
+ */
+namespace fempattern
+{
+
+using Index = sofa::Index;
+
+/// Symmetric adjacency of the nodes, including each node itself, in compressed rows with sorted columns
+struct NodeGraph
+{
+    std::vector<Index> rowBegin { 0 };
+    std::vector<Index> neighbors;
+
+    Index nbNodes() const { return static_cast<Index>(rowBegin.size() - 1); }
+    Index degree(Index node) const { return rowBegin[node + 1] - rowBegin[node]; }
+    std::size_t nbEntries() const { return neighbors.size(); }
+};
+
+/// Graph of the nodes coupled by the elements, each element being a list of K nodes
+template<std::size_t K>
+NodeGraph createGraphFromElements(Index nbNodes, const std::vector<std::array<Index, K> >& elements)
+{
+    std::vector<std::vector<Index> > adjacency(nbNodes);
+    for (Index n = 0; n < nbNodes; ++n)
+    {
+        adjacency[n].push_back(n);
+    }
+    for (const auto& element : elements)
+    {
+        for (const Index a : element)
+            for (const Index b : element)
+                if (a != b)
+                    adjacency[a].push_back(b);
+    }
+
+    NodeGraph graph;
+    graph.rowBegin.resize(nbNodes + 1);
+    for (Index n = 0; n < nbNodes; ++n)
+    {
+        auto& list = adjacency[n];
+        std::sort(list.begin(), list.end());
+        list.erase(std::unique(list.begin(), list.end()), list.end());
+        graph.rowBegin[n + 1] = graph.rowBegin[n] + static_cast<Index>(list.size());
+    }
+    graph.neighbors.reserve(graph.rowBegin.back());
+    for (const auto& list : adjacency)
+    {
+        graph.neighbors.insert(graph.neighbors.end(), list.begin(), list.end());
+    }
+    return graph;
+}
+
+inline Index gridNode(Index x, Index y, Index z, Index nx, Index ny)
+{
+    return x + nx * (y + ny * z);
+}
+
+/// Hexahedra of a regular grid of nx * ny * nz nodes, numbered along x, then y, then z
+inline std::vector<std::array<Index, 8> > createGridHexahedra(Index nx, Index ny, Index nz)
+{
+    std::vector<std::array<Index, 8> > hexahedra;
+    for (Index z = 0; z + 1 < nz; ++z)
+    for (Index y = 0; y + 1 < ny; ++y)
+    for (Index x = 0; x + 1 < nx; ++x)
+    {
+        hexahedra.push_back({
+            gridNode(x, y, z, nx, ny), gridNode(x + 1, y, z, nx, ny),
+            gridNode(x + 1, y + 1, z, nx, ny), gridNode(x, y + 1, z, nx, ny),
+            gridNode(x, y, z + 1, nx, ny), gridNode(x + 1, y, z + 1, nx, ny),
+            gridNode(x + 1, y + 1, z + 1, nx, ny), gridNode(x, y + 1, z + 1, nx, ny)});
+    }
+    return hexahedra;
+}
+
+/// Each cube of the grid split in 6 tetrahedra around its diagonal (Freudenthal decomposition), as a
+/// conforming tetrahedral mesh: an interior node is connected to 14 others
+inline std::vector<std::array<Index, 4> > createGridTetrahedra(Index nx, Index ny, Index nz)
+{
+    // The 6 paths from the corner (0,0,0) to the corner (1,1,1) along the axes, one per permutation of the axes
+    constexpr std::array<std::array<int, 3>, 6> axisPermutations {{
+        {0, 1, 2}, {0, 2, 1}, {1, 0, 2}, {1, 2, 0}, {2, 0, 1}, {2, 1, 0}}};
+
+    std::vector<std::array<Index, 4> > tetrahedra;
+    for (Index z = 0; z + 1 < nz; ++z)
+    for (Index y = 0; y + 1 < ny; ++y)
+    for (Index x = 0; x + 1 < nx; ++x)
+    {
+        for (const auto& axes : axisPermutations)
+        {
+            std::array<Index, 3> corner { x, y, z };
+            std::array<Index, 4> tetra;
+            tetra[0] = gridNode(corner[0], corner[1], corner[2], nx, ny);
+            for (int i = 0; i < 3; ++i)
+            {
+                ++corner[axes[i]];
+                tetra[i + 1] = gridNode(corner[0], corner[1], corner[2], nx, ny);
+            }
+            tetrahedra.push_back(tetra);
+        }
+    }
+    return tetrahedra;
+}
+
+/// Largest distance between a node and its neighbors
+inline Index bandwidth(const NodeGraph& graph)
+{
+    Index b = 0;
+    for (Index n = 0; n < graph.nbNodes(); ++n)
+    {
+        for (auto e = graph.rowBegin[n]; e < graph.rowBegin[n + 1]; ++e)
+        {
+            const Index m = graph.neighbors[e];
+            b = std::max(b, m > n ? m - n : n - m);
+        }
+    }
+    return b;
+}
+
+/**
+ * Graph renumbered with order, where order[newIndex] is the old index of the node. The orderings below
+ * return this convention.
+ */
+inline NodeGraph permute(const NodeGraph& graph, const std::vector<Index>& order)
+{
+    const Index n = graph.nbNodes();
+    std::vector<Index> newIndex(n);
+    for (Index i = 0; i < n; ++i)
+    {
+        newIndex[order[i]] = i;
+    }
+
+    NodeGraph permuted;
+    permuted.rowBegin.resize(n + 1);
+    permuted.neighbors.resize(graph.nbEntries());
+    for (Index i = 0; i < n; ++i)
+    {
+        const Index old = order[i];
+        permuted.rowBegin[i + 1] = permuted.rowBegin[i] + graph.degree(old);
+        auto* dst = permuted.neighbors.data() + permuted.rowBegin[i];
+        for (auto e = graph.rowBegin[old]; e < graph.rowBegin[old + 1]; ++e)
+        {
+            *dst++ = newIndex[graph.neighbors[e]];
+        }
+        std::sort(permuted.neighbors.begin() + permuted.rowBegin[i], permuted.neighbors.begin() + permuted.rowBegin[i + 1]);
+    }
+    return permuted;
+}
+
+/// Random renumbering, as the numbering of the nodes of an unstructured mesh
+inline std::vector<Index> randomOrdering(Index nbNodes, std::uint32_t seed = 7)
+{
+    std::vector<Index> order(nbNodes);
+    std::iota(order.begin(), order.end(), 0);
+    std::mt19937 gen(seed);
+    std::shuffle(order.begin(), order.end(), gen);
+    return order;
+}
+
+namespace detail
+{
+
+struct LevelStructure
+{
+    std::size_t nbLevels { 0 };
+    std::size_t lastLevelBegin { 0 }; ///< index in order of the first node of the last level
+};
+
+/// Breadth-first search from start, the unvisited neighbors of each node being appended to order by
+/// increasing degree
+inline LevelStructure cuthillMcKee(const NodeGraph& graph, Index start, std::vector<char>& visited,
+                                   std::vector<Index>& order)
+{
+    LevelStructure levels;
+    std::vector<Index> neighbors;
+    std::size_t levelBegin = order.size();
+
+    order.push_back(start);
+    visited[start] = 1;
+    while (levelBegin < order.size())
+    {
+        const std::size_t levelEnd = order.size();
+        levels.lastLevelBegin = levelBegin;
+        ++levels.nbLevels;
+        for (std::size_t i = levelBegin; i < levelEnd; ++i)
+        {
+            const Index node = order[i];
+            neighbors.clear();
+            for (auto e = graph.rowBegin[node]; e < graph.rowBegin[node + 1]; ++e)
+            {
+                const Index m = graph.neighbors[e];
+                if (!visited[m])
+                {
+                    visited[m] = 1;
+                    neighbors.push_back(m);
+                }
+            }
+            std::stable_sort(neighbors.begin(), neighbors.end(),
+                [&graph](Index a, Index b) { return graph.degree(a) < graph.degree(b); });
+            order.insert(order.end(), neighbors.begin(), neighbors.end());
+        }
+        levelBegin = levelEnd;
+    }
+    return levels;
+}
+
+}
+
+/**
+ * Reverse Cuthill-McKee ordering: reduces the bandwidth, so that the entries of a row and the vector values
+ * they multiply are close in memory. Each connected component starts at a pseudo-peripheral node, found by
+ * repeated searches from the node of minimal degree of the last level, as long as the number of levels
+ * increases (George-Liu).
+ */
+inline std::vector<Index> reverseCuthillMcKeeOrdering(const NodeGraph& graph)
+{
+    const Index n = graph.nbNodes();
+    std::vector<Index> order;
+    order.reserve(n);
+    std::vector<char> visited(n, 0);
+    std::vector<char> probeVisited(n, 0);
+    std::vector<Index> probeOrder;
+
+    for (Index seed = 0; seed < n; ++seed)
+    {
+        if (visited[seed])
+            continue;
+
+        Index start = seed;
+        std::size_t nbLevels = 0;
+        while (true)
+        {
+            probeOrder.clear();
+            const auto levels = detail::cuthillMcKee(graph, start, probeVisited, probeOrder);
+            for (const Index node : probeOrder)
+                probeVisited[node] = 0;
+
+            if (levels.nbLevels <= nbLevels)
+                break;
+            nbLevels = levels.nbLevels;
+
+            Index candidate = probeOrder[levels.lastLevelBegin];
+            for (std::size_t i = levels.lastLevelBegin + 1; i < probeOrder.size(); ++i)
+            {
+                if (graph.degree(probeOrder[i]) < graph.degree(candidate))
+                    candidate = probeOrder[i];
+            }
+            start = candidate;
+        }
+
+        detail::cuthillMcKee(graph, start, visited, order);
+    }
+
+    std::reverse(order.begin(), order.end());
+    return order;
+}
+
+/**
+ * Approximate minimum degree ordering (Eigen::AMDOrdering): reduces the fill-in of a direct factorization
+ * rather than the bandwidth.
+ */
+inline std::vector<Index> approximateMinimumDegreeOrdering(const NodeGraph& graph)
+{
+    const auto n = static_cast<Eigen::Index>(graph.nbNodes());
+    std::vector<Eigen::Triplet<double> > triplets;
+    triplets.reserve(graph.nbEntries());
+    for (Index i = 0; i < graph.nbNodes(); ++i)
+    {
+        for (auto e = graph.rowBegin[i]; e < graph.rowBegin[i + 1]; ++e)
+        {
+            triplets.emplace_back(i, graph.neighbors[e], 1.);
+        }
+    }
+    Eigen::SparseMatrix<double, Eigen::ColMajor, int> pattern(n, n);
+    pattern.setFromTriplets(triplets.begin(), triplets.end());
+
+    // As used by Eigen::SimplicialCholesky, indices()[newIndex] is the old index
+    Eigen::PermutationMatrix<Eigen::Dynamic, Eigen::Dynamic, int> permutation;
+    Eigen::AMDOrdering<int> amd;
+    amd(pattern, permutation);
+
+    std::vector<Index> order(graph.nbNodes());
+    for (Eigen::Index i = 0; i < n; ++i)
+    {
+        order[i] = static_cast<Index>(permutation.indices()[i]);
+    }
+    return order;
+}
+
+enum class NodeOrdering : int64_t { Natural = 0, Random = 1, RCM = 2, AMD = 3 };
+
+inline const char* toString(NodeOrdering ordering)
+{
+    switch (ordering)
+    {
+        case NodeOrdering::Natural: return "natural";
+        case NodeOrdering::Random: return "random";
+        case NodeOrdering::RCM: return "RCM";
+        case NodeOrdering::AMD: return "AMD";
+    }
+    return "";
+}
+
+/// The RCM and AMD orderings are computed on the randomly renumbered graph, so that they do not benefit
+/// from the structure of the natural numbering
+inline NodeGraph reorder(const NodeGraph& graph, NodeOrdering ordering)
+{
+    if (ordering == NodeOrdering::Natural)
+        return graph;
+
+    NodeGraph shuffled = permute(graph, randomOrdering(graph.nbNodes()));
+    switch (ordering)
+    {
+        case NodeOrdering::RCM: return permute(shuffled, reverseCuthillMcKeeOrdering(shuffled));
+        case NodeOrdering::AMD: return permute(shuffled, approximateMinimumDegreeOrdering(shuffled));
+        default: return shuffled;
+    }
+}
+
+enum class MeshTopology : int64_t { Hexahedra = 0, Tetrahedra = 1 };
+
+/// Graph of a grid of n * n * n nodes meshed with hexahedra or tetrahedra, renumbered with ordering
+inline NodeGraph createGridGraph(Index n, MeshTopology topology, NodeOrdering ordering)
+{
+    const Index nbNodes = n * n * n;
+    const NodeGraph graph = topology == MeshTopology::Hexahedra
+        ? createGraphFromElements(nbNodes, createGridHexahedra(n, n, n))
+        : createGraphFromElements(nbNodes, createGridTetrahedra(n, n, n));
+    return reorder(graph, ordering);
+}
+
+}
@@ -0,0 +1,358 @@
+#pragma once
+
+#include <Eigen/Sparse>
+#include <sofa/config.h>
+#include <sofa/linearalgebra/CompressedRowSparseMatrix.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SOFABENCHMARK_HAS_MMAP 1
+#endif
+
+/**
+ * Import and export of sparse matrices, to benchmark the sparse kernels on matrices captured in a running
+ * scene instead of synthetic ones:
+ * - Matrix Market (.mtx), coordinate format, readable by most tools. Real, integer and pattern matrices,
+ *   general or symmetric, can be read. The matrices are written as real general.
+ * - binary CSR (.csr), a header followed by the arrays of a row-major Eigen::SparseMatrix with int indices,
+ *   each 8-byte aligned, so that a file can be memory-mapped and used without parsing nor copy:
+ *       char magic[8] = "SOFACSR1"; uint64 rows, cols, nnz;
+ *       int32 outer[rows + 1]; int32 inner[nnz]; (padding); double values[nnz]
+ *   The byte order is the one of the machine that wrote the file.
+ * All the functions return false if the file cannot be read or written.
+ */
+namespace matrixio
+{
+
+using Matrix = Eigen::SparseMatrix<double, Eigen::RowMajor, int>;
+using MatrixMap = Eigen::Map<const Matrix>;
+
+inline bool endsWith(const std::string& s, const std::string& suffix)
+{
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+/// Scalar row-major copy of a CompressedRowSparseMatrix with scalar or Mat blocks
+template<class TBlock>
+Matrix toEigen(const sofa::linearalgebra::CompressedRowSparseMatrix<TBlock>& crs)
+{
+    std::vector<Eigen::Triplet<double> > triplets;
+    Eigen::Index nbRows = 0;
+    Eigen::Index nbCols = 0;
+    if constexpr (std::is_arithmetic_v<TBlock>)
+    {
+        nbRows = crs.rowSize();
+        nbCols = crs.colSize();
+        triplets.reserve(crs.colsIndex.size());
+        for (std::size_t i = 0; i < crs.rowIndex.size(); ++i)
+            for (auto k = crs.rowBegin[i]; k < crs.rowBegin[i + 1]; ++k)
+                triplets.emplace_back(crs.rowIndex[i], crs.colsIndex[k], crs.colsValue[k]);
+    }
+    else
+    {
+        constexpr auto L = TBlock::nbLines;
+        constexpr auto C = TBlock::nbCols;
+        nbRows = L * crs.rowBSize();
+        nbCols = C * crs.colBSize();
+        triplets.reserve(L * C * crs.colsIndex.size());
+        for (std::size_t i = 0; i < crs.rowIndex.size(); ++i)
+            for (auto k = crs.rowBegin[i]; k < crs.rowBegin[i + 1]; ++k)
+                for (sofa::Size r = 0; r < L; ++r)
+                    for (sofa::Size c = 0; c < C; ++c)
+                        triplets.emplace_back(L * crs.rowIndex[i] + r, C * crs.colsIndex[k] + c, crs.colsValue[k][r][c]);
+    }
+    Matrix matrix(nbRows, nbCols);
+    matrix.setFromTriplets(triplets.begin(), triplets.end());
+    return matrix;
+}
+
+inline bool writeMatrixMarket(const std::string& filename, const Matrix& matrix)
+{
+    std::ofstream file(filename);
+    if (!file)
+        return false;
+
+    file << "%%MatrixMarket matrix coordinate real general\n";
+    file << matrix.rows() << ' ' << matrix.cols() << ' ' << matrix.nonZeros() << '\n';
+    file << std::setprecision(std::numeric_limits<double>::max_digits10);
+    for (Eigen::Index i = 0; i < matrix.outerSize(); ++i)
+    {
+        for (Matrix::InnerIterator it(matrix, i); it; ++it)
+        {
+            file << it.row() + 1 << ' ' << it.col() + 1 << ' ' << it.value() << '\n';
+        }
+    }
+    return static_cast<bool>(file);
+}
+
+inline bool readMatrixMarket(const std::string& filename, Matrix& matrix)
+{
+    std::ifstream file(filename);
+    std::string line;
+    if (!file || !std::getline(file, line))
+        return false;
+
+    std::string banner, object, format, field, symmetry;
+    std::istringstream header(line);
+    header >> banner >> object >> format >> field >> symmetry;
+    std::transform(format.begin(), format.end(), format.begin(), ::tolower);
+    std::transform(field.begin(), field.end(), field.begin(), ::tolower);
+    std::transform(symmetry.begin(), symmetry.end(), symmetry.begin(), ::tolower);
+    if (banner != "%%MatrixMarket" || format != "coordinate" || field == "complex")
+        return false;
+    const bool isPattern = field == "pattern";
+    const bool isSymmetric = symmetry == "symmetric";
+    const bool isSkew = symmetry == "skew-symmetric";
+
+    while (std::getline(file, line) && (line.empty() || line[0] == '%')) {}
+
+    Eigen::Index nbRows = 0, nbCols = 0, nnz = 0;
+    std::istringstream size(line);
+    if (!(size >> nbRows >> nbCols >> nnz))
+        return false;
+
+    std::vector<Eigen::Triplet<double> > triplets;
+    triplets.reserve(isSymmetric || isSkew ? 2 * nnz : nnz);
+    for (Eigen::Index e = 0; e < nnz; ++e)
+    {
+        Eigen::Index row, col;
+        double value = 1;
+        if (!(file >> row >> col) || (!isPattern && !(file >> value)))
+            return false;
+        --row;
+        --col;
+        if (row < 0 || col < 0 || row >= nbRows || col >= nbCols)
+            return false;
+        triplets.emplace_back(row, col, value);
+        if ((isSymmetric || isSkew) && row != col)
+            triplets.emplace_back(col, row, isSkew ? -value : value);
+    }
+
+    matrix.resize(nbRows, nbCols);
+    matrix.setFromTriplets(triplets.begin(), triplets.end());
+    return true;
+}
+
+namespace detail
+{
+
+constexpr char binaryMagic[8] = { 'S', 'O', 'F', 'A', 'C', 'S', 'R', '1' };
+
+struct BinaryHeader
+{
+    char magic[8];
+    std::uint64_t rows;
+    std::uint64_t cols;
+    std::uint64_t nnz;
+};
+
+inline std::size_t align8(std::size_t offset)
+{
+    return (offset + 7) & ~static_cast<std::size_t>(7);
+}
+
+struct BinaryLayout
+{
+    std::size_t outerOffset { sizeof(BinaryHeader) };
+    std::size_t innerOffset { 0 };
+    std::size_t valuesOffset { 0 };
+    std::size_t size { 0 };
+
+    explicit BinaryLayout(const BinaryHeader& header)
+    {
+        innerOffset = align8(outerOffset + (header.rows + 1) * sizeof(int));
+        valuesOffset = align8(innerOffset + header.nnz * sizeof(int));
+        size = valuesOffset + header.nnz * sizeof(double);
+    }
+};
+
+}
+
+inline bool writeBinaryCSR(const std::string& filename, const Matrix& matrix)
+{
+    if (!matrix.isCompressed())
+    {
+        Matrix compressed = matrix;
+        compressed.makeCompressed();
+        return writeBinaryCSR(filename, compressed);
+    }
+
+    detail::BinaryHeader header;
+    std::memcpy(header.magic, detail::binaryMagic, sizeof(header.magic));
+    header.rows = static_cast<std::uint64_t>(matrix.rows());
+    header.cols = static_cast<std::uint64_t>(matrix.cols());
+    header.nnz = static_cast<std::uint64_t>(matrix.nonZeros());
+    const detail::BinaryLayout layout(header);
+
+    std::vector<char> buffer(layout.size, 0);
+    std::memcpy(buffer.data(), &header, sizeof(header));
+    std::memcpy(buffer.data() + layout.outerOffset, matrix.outerIndexPtr(), (header.rows + 1) * sizeof(int));
+    if (header.nnz > 0) // the index and value arrays of an empty matrix are null
+    {
+        std::memcpy(buffer.data() + layout.innerOffset, matrix.innerIndexPtr(), header.nnz * sizeof(int));
+        std::memcpy(buffer.data() + layout.valuesOffset, matrix.valuePtr(), header.nnz * sizeof(double));
+    }
+
+    std::ofstream file(filename, std::ios::binary);
+    file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    return static_cast<bool>(file);
+}
+
+/**
+ * Binary CSR file mapped in memory (read into a buffer on the platforms without mmap). The matrix returned
+ * by map() points into the file and is valid as long as this object exists.
+ */
+class MappedCSRMatrix
+{
+public:
+    MappedCSRMatrix() = default;
+    MappedCSRMatrix(const MappedCSRMatrix&) = delete;
+    MappedCSRMatrix& operator=(const MappedCSRMatrix&) = delete;
+    ~MappedCSRMatrix() { close(); }
+
+    bool open(const std::string& filename)
+    {
+        close();
+#if defined(SOFABENCHMARK_HAS_MMAP)
+        const int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (::fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            void* address = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (address != MAP_FAILED)
+            {
+                m_data = static_cast<const char*>(address);
+                m_size = static_cast<std::size_t>(st.st_size);
+                m_isMapped = true;
+            }
+        }
+        ::close(fd);
+#else
+        std::ifstream file(filename, std::ios::binary | std::ios::ate);
+        if (file)
+        {
+            m_buffer.resize(static_cast<std::size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+            m_data = m_buffer.data();
+            m_size = m_buffer.size();
+        }
+#endif
+        if (!isValid())
+        {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+#if defined(SOFABENCHMARK_HAS_MMAP)
+        if (m_isMapped)
+            ::munmap(const_cast<char*>(m_data), m_size);
+#endif
+        m_isMapped = false;
+        m_buffer.clear();
+        m_data = nullptr;
+        m_size = 0;
+    }
+
+    bool isOpen() const { return m_data != nullptr; }
+
+    MatrixMap map() const
+    {
+        const auto& h = header();
+        const detail::BinaryLayout layout(h);
+        return MatrixMap(static_cast<Eigen::Index>(h.rows), static_cast<Eigen::Index>(h.cols), static_cast<Eigen::Index>(h.nnz),
+            reinterpret_cast<const int*>(m_data + layout.outerOffset),
+            reinterpret_cast<const int*>(m_data + layout.innerOffset),
+            reinterpret_cast<const double*>(m_data + layout.valuesOffset));
+    }
+
+private:
+    const detail::BinaryHeader& header() const { return *reinterpret_cast<const detail::BinaryHeader*>(m_data); }
+
+    /// Checks the header and the CSR structure, so that a truncated or corrupted file cannot make the
+    /// sparse kernels read out of the arrays
+    bool isValid() const
+    {
+        if (m_data == nullptr || m_size < sizeof(detail::BinaryHeader))
+            return false;
+        const auto& h = header();
+        constexpr auto maxInt = static_cast<std::uint64_t>(std::numeric_limits<int>::max());
+        if (std::memcmp(h.magic, detail::binaryMagic, sizeof(h.magic)) != 0
+            || h.rows >= maxInt || h.cols >= maxInt || h.nnz >= maxInt
+            || detail::BinaryLayout(h).size > m_size)
+            return false;
+
+        const detail::BinaryLayout layout(h);
+        const auto* outer = reinterpret_cast<const int*>(m_data + layout.outerOffset);
+        const auto* inner = reinterpret_cast<const int*>(m_data + layout.innerOffset);
+        if (outer[0] != 0 || static_cast<std::uint64_t>(outer[h.rows]) != h.nnz)
+            return false;
+        for (std::uint64_t row = 0; row < h.rows; ++row)
+        {
+            if (outer[row + 1] < outer[row])
+                return false;
+        }
+        const auto cols = static_cast<int>(h.cols);
+        return std::all_of(inner, inner + h.nnz, [cols](int col) { return col >= 0 && col < cols; });
+    }
+
+    const char* m_data { nullptr };
+    std::size_t m_size { 0 };
+    bool m_isMapped { false };
+    std::vector<char> m_buffer;
+};
+
+inline bool readBinaryCSR(const std::string& filename, Matrix& matrix)
+{
+    MappedCSRMatrix mapped;
+    if (!mapped.open(filename))
+        return false;
+    matrix = mapped.map();
+    return true;
+}
+
+/// Matrix Market or binary CSR, from the extension (.mtx or .csr)
+inline bool isMatrixFile(const std::string& filename)
+{
+    return endsWith(filename, ".mtx") || endsWith(filename, ".csr");
+}
+
+inline bool readMatrix(const std::string& filename, Matrix& matrix)
+{
+    if (endsWith(filename, ".mtx"))
+        return readMatrixMarket(filename, matrix);
+    if (endsWith(filename, ".csr"))
+        return readBinaryCSR(filename, matrix);
+    return false;
+}
+
+inline bool writeMatrix(const std::string& filename, const Matrix& matrix)
+{
+    if (endsWith(filename, ".mtx"))
+        return writeMatrixMarket(filename, matrix);
+    if (endsWith(filename, ".csr"))
+        return writeBinaryCSR(filename, matrix);
+    return false;
+}
+
+}
@@ -0,0 +1,317 @@
+#pragma once
+
+#include <sofa/linearalgebra/CompressedRowSparseMatrix.h>
+#include <sofa/simulation/ParallelForEach.h>
+#include <sofa/simulation/TaskScheduler.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Unsorted list of blocks (block row, block column, value) filled by a single thread, without any lock.
+ * The same position can be added several times: the values are summed during the merge.
+ */
+template<class TBlock>
+class BlockTripletBuffer
+{
+public:
+    using Block = TBlock;
+    using Index = sofa::Index;
+
+    void clear()
+    {
+        m_rows.clear();
+        m_cols.clear();
+        m_values.clear();
+    }
+
+    void reserve(std::size_t n)
+    {
+        m_rows.reserve(n);
+        m_cols.reserve(n);
+        m_values.reserve(n);
+    }
+
+    void add(Index blockRow, Index blockCol, const Block& value)
+    {
+        m_rows.push_back(blockRow);
+        m_cols.push_back(blockCol);
+        m_values.push_back(value);
+    }
+
+    std::size_t size() const { return m_rows.size(); }
+    Index row(std::size_t i) const { return m_rows[i]; }
+    Index col(std::size_t i) const { return m_cols[i]; }
+    const Block& value(std::size_t i) const { return m_values[i]; }
+
+private:
+    std::vector<Index> m_rows;
+    std::vector<Index> m_cols;
+    std::vector<Block> m_values;
+};
+
+/**
+ * Parallel assembly of a CompressedRowSparseMatrix from one BlockTripletBuffer per task.
+ *
+ * Each task of the assembly fills its own buffer, so the insertion needs no synchronization. The buffers
+ * are then merged in parallel with a LSD radix sort of two digits, the column then the row, each digit
+ * being sorted with a counting sort:
+ * 1. each part of the input counts its blocks per column, an exclusive scan in the order (column, part),
+ *    parallel over the columns, gives to each pair its own range in the output, and the parts scatter their
+ *    blocks concurrently into disjoint ranges,
+ * 2. same with the rows, on the output of the first pass: the blocks are now sorted by row, then column,
+ * 3. in each row, segmented reduction of the duplicated positions, in a linear pass,
+ * 4. scan of the number of blocks per row and parallel copy into the arrays of the matrix.
+ * Only the identifiers of the blocks are moved by the sorts: the values are read once, by the reduction.
+ * The counting sorts are stable, so the sum of the duplicated blocks is always done in the same order: the
+ * result does not depend on the number of threads.
+ *
+ * The arrays rowIndex, rowBegin, colsIndex and colsValue of the matrix are written directly, which is
+ * equivalent to a call to compress() on a matrix whose blocks are sorted, and the matrix is marked as compressed.
+ */
+template<class TMatrix>
+class ParallelCRSAssembler
+{
+public:
+    using Matrix = TMatrix;
+    using Block = typename Matrix::Block;
+    using Index = sofa::Index;
+    using Buffer = BlockTripletBuffer<Block>;
+
+    ParallelCRSAssembler() = default;
+    ParallelCRSAssembler(Index nbBlockRows, Index nbBlockCols, std::size_t nbBuffers)
+    {
+        resize(nbBlockRows, nbBlockCols, nbBuffers);
+    }
+
+    void resize(Index nbBlockRows, Index nbBlockCols, std::size_t nbBuffers)
+    {
+        m_nbBlockRows = nbBlockRows;
+        m_nbBlockCols = nbBlockCols;
+        m_buffers.resize(nbBuffers);
+        m_rowCounts.assign(nbBuffers * static_cast<std::size_t>(nbBlockRows), 0);
+        m_colCounts.assign(nbBuffers * static_cast<std::size_t>(nbBlockCols), 0);
+        clear();
+    }
+
+    /// Empty the buffers, keeping their capacity for the next assembly
+    void clear()
+    {
+        for (auto& buffer : m_buffers)
+            buffer.clear();
+    }
+
+    std::size_t getNbBuffers() const { return m_buffers.size(); }
+
+    /// Buffer of the task b. A buffer must be filled by a single thread at a time.
+    Buffer& getBuffer(std::size_t b) { return m_buffers[b]; }
+
+    /// Merge the buffers into the matrix, replacing its content
+    void assemble(sofa::simulation::TaskScheduler& taskScheduler, Matrix& matrix)
+    {
+        const std::size_t nbParts = m_buffers.size();
+        const std::size_t nbRows = m_nbBlockRows;
+        const std::size_t nbCols = m_nbBlockCols;
+
+        // 1. Counting sort by column. The parts are the buffers.
+        sofa::simulation::parallelForEach(taskScheduler, static_cast<std::size_t>(0), nbParts,
+            [this, nbCols](std::size_t b)
+            {
+                Index* counts = m_colCounts.data() + b * nbCols;
+                std::fill(counts, counts + nbCols, 0);
+                const Buffer& buffer = m_buffers[b];
+                for (std::size_t i = 0; i < buffer.size(); ++i)
+                    ++counts[buffer.col(i)];
+            });
+        const Index total = exclusiveScan(taskScheduler, m_colCounts, nbCols, nbParts, nullptr);
+
+        m_colSortedIds.resize(total);
+        m_colSortedRows.resize(total);
+        sofa::simulation::parallelForEach(taskScheduler, static_cast<std::size_t>(0), nbParts,
+            [this, nbCols](std::size_t b)
+            {
+                Index* next = m_colCounts.data() + b * nbCols;
+                const Buffer& buffer = m_buffers[b];
+                for (std::size_t i = 0; i < buffer.size(); ++i)
+                {
+                    const Index pos = next[buffer.col(i)]++;
+                    m_colSortedIds[pos] = makeId(b, i);
+                    m_colSortedRows[pos] = buffer.row(i);
+                }
+            });
+
+        // 2. Counting sort by row. The parts are contiguous ranges of the output of the first pass.
+        sofa::simulation::parallelForEach(taskScheduler, static_cast<std::size_t>(0), nbParts,
+            [this, nbRows, nbParts, total](std::size_t b)
+            {
+                Index* counts = m_rowCounts.data() + b * nbRows;
+                std::fill(counts, counts + nbRows, 0);
+                for (std::size_t k = total * b / nbParts; k < total * (b + 1) / nbParts; ++k)
+                    ++counts[m_colSortedRows[k]];
+            });
+        m_sortedRowBegin.resize(nbRows + 1);
+        exclusiveScan(taskScheduler, m_rowCounts, nbRows, nbParts, m_sortedRowBegin.data());
+
+        m_sortedIds.resize(total);
+        sofa::simulation::parallelForEach(taskScheduler, static_cast<std::size_t>(0), nbParts,
+            [this, nbRows, nbParts, total](std::size_t b)
+            {
+                Index* next = m_rowCounts.data() + b * nbRows;
+                for (std::size_t k = total * b / nbParts; k < total * (b + 1) / nbParts; ++k)
+                    m_sortedIds[next[m_colSortedRows[k]]++] = m_colSortedIds[k];
+            });
+
+        // 3. Sum of the duplicates. The unique blocks of the row r are written at the beginning of its range,
+        // and m_uniqueCounts[r] is their number.
+        m_sortedCols.resize(total);
+        m_sortedValues.resize(total);
+        m_uniqueCounts.resize(nbRows);
+        sofa::simulation::parallelForEachRange(taskScheduler, static_cast<std::size_t>(0), nbRows,
+            [this](const auto& range)
+            {
+                for (auto r = range.start; r != range.end; ++r)
+                {
+                    m_uniqueCounts[r] = reduceRow(m_sortedRowBegin[r], m_sortedRowBegin[r + 1]);
+                }
+            });
+
+        // 4. Compressed arrays of the matrix. Only the non-empty rows are stored in rowIndex.
+        matrix.resizeBlock(m_nbBlockRows, m_nbBlockCols);
+        matrix.rowIndex.clear();
+        matrix.rowBegin.clear();
+        m_nonEmptyRows.clear();
+        Index nnz = 0;
+        for (std::size_t r = 0; r < nbRows; ++r)
+        {
+            if (m_uniqueCounts[r] == 0)
+                continue;
+            m_nonEmptyRows.push_back(static_cast<Index>(r));
+            matrix.rowIndex.push_back(static_cast<Index>(r));
+            matrix.rowBegin.push_back(nnz);
+            nnz += m_uniqueCounts[r];
+        }
+        matrix.rowBegin.push_back(nnz);
+
+        matrix.colsIndex.resize(nnz);
+        matrix.colsValue.resize(nnz);
+        sofa::simulation::parallelForEachRange(taskScheduler, static_cast<std::size_t>(0), m_nonEmptyRows.size(),
+            [this, &matrix](const auto& range)
+            {
+                for (auto i = range.start; i != range.end; ++i)
+                {
+                    const Index r = m_nonEmptyRows[i];
+                    const Index src = m_sortedRowBegin[r];
+                    const Index dst = matrix.rowBegin[i];
+                    std::copy_n(m_sortedCols.begin() + src, m_uniqueCounts[r], matrix.colsIndex.begin() + dst);
+                    std::copy_n(m_sortedValues.begin() + src, m_uniqueCounts[r], matrix.colsValue.begin() + dst);
+                }
+            });
+
+        // resizeBlock() with an unchanged size only clears the values, and marks the matrix as not compressed if
+        // it had blocks: the arrays written above are the compressed form, so compress() has nothing left to do
+        matrix.compressed = true;
+    }
+
+private:
+    /// Identifier of the i-th block of the buffer b
+    using Id = std::uint64_t;
+    static Id makeId(std::size_t b, std::size_t i) { return (static_cast<Id>(b) << 32) | static_cast<Id>(i); }
+    const Buffer& getIdBuffer(Id id) const { return m_buffers[id >> 32]; }
+    static std::size_t getIdIndex(Id id) { return static_cast<std::size_t>(id & 0xffffffffu); }
+
+    /// counts[p * nbKeys + key] is the number of blocks of the part p with this key. The counts are replaced
+    /// by the first position of each pair in the output sorted by (key, part). If keyBegin is not null, it
+    /// receives the first position of each key, and the total at keyBegin[nbKeys]. Returns the total.
+    /// The keys are split in ranges processed in parallel, and each range reads the counts of a part
+    /// contiguously: the sum over the parts, a serial scan over the keys only, then the offsets of the parts.
+    Index exclusiveScan(sofa::simulation::TaskScheduler& taskScheduler, std::vector<Index>& counts, std::size_t nbKeys, std::size_t nbParts, Index* keyBegin)
+    {
+        m_keyOffsets.resize(nbKeys + 1);
+
+        // Number of blocks per key, all parts included
+        sofa::simulation::parallelForEachRange(taskScheduler, static_cast<std::size_t>(0), nbKeys,
+            [this, &counts, nbKeys, nbParts](const auto& range)
+            {
+                std::fill(m_keyOffsets.begin() + range.start, m_keyOffsets.begin() + range.end, 0);
+                for (std::size_t p = 0; p < nbParts; ++p)
+                {
+                    const Index* partCounts = counts.data() + p * nbKeys;
+                    for (auto key = range.start; key != range.end; ++key)
+                        m_keyOffsets[key] += partCounts[key];
+                }
+            });
+
+        // First position of each key
+        Index total = 0;
+        for (std::size_t key = 0; key < nbKeys; ++key)
+        {
+            const Index n = m_keyOffsets[key];
+            m_keyOffsets[key] = total;
+            total += n;
+        }
+        m_keyOffsets[nbKeys] = total;
+        if (keyBegin)
+            std::copy(m_keyOffsets.begin(), m_keyOffsets.end(), keyBegin);
+
+        // First position of each pair (key, part): the parts of a key follow each other in the output
+        sofa::simulation::parallelForEachRange(taskScheduler, static_cast<std::size_t>(0), nbKeys,
+            [this, &counts, nbKeys, nbParts](const auto& range)
+            {
+                for (std::size_t p = 0; p < nbParts; ++p)
+                {
+                    Index* partCounts = counts.data() + p * nbKeys;
+                    for (auto key = range.start; key != range.end; ++key)
+                    {
+                        const Index n = partCounts[key];
+                        partCounts[key] = m_keyOffsets[key];
+                        m_keyOffsets[key] += n;
+                    }
+                }
+            });
+        return total;
+    }
+
+    /// Sum of the consecutive blocks of [begin, end) with the same column. Returns the number of unique
+    /// blocks, written at the beginning of the range.
+    Index reduceRow(Index begin, Index end)
+    {
+        Index last = begin;
+        for (Index k = begin; k < end; ++k)
+        {
+            const Buffer& buffer = getIdBuffer(m_sortedIds[k]);
+            const std::size_t i = getIdIndex(m_sortedIds[k]);
+            const Index col = buffer.col(i);
+            if (last != begin && m_sortedCols[last - 1] == col)
+            {
+                m_sortedValues[last - 1] += buffer.value(i);
+            }
+            else
+            {
+                m_sortedCols[last] = col;
+                m_sortedValues[last] = buffer.value(i);
+                ++last;
+            }
+        }
+        return last - begin;
+    }
+
+    Index m_nbBlockRows { 0 };
+    Index m_nbBlockCols { 0 };
+    std::vector<Buffer> m_buffers;
+
+    // Work arrays of the merge, kept between two assemblies to avoid reallocations
+    std::vector<Index> m_colCounts;
+    std::vector<Index> m_rowCounts;
+    std::vector<Index> m_keyOffsets;
+    std::vector<Id> m_colSortedIds;
+    std::vector<Index> m_colSortedRows;
+    std::vector<Id> m_sortedIds;
+    std::vector<Index> m_sortedRowBegin;
+    std::vector<Index> m_sortedCols;
+    std::vector<Block> m_sortedValues;
+    std::vector<Index> m_uniqueCounts;
+    std::vector<Index> m_nonEmptyRows;
+};
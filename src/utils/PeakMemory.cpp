@@ -0,0 +1,136 @@
+#include <utils/PeakMemory.h>
+
+#if SOFABENCHMARK_COUNT_ALLOCATIONS
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#if defined(__APPLE__)
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+
+// Replacement of the global operator new and operator delete counting the allocations for PeakMemoryTracker.
+// The counters are only updated while a tracker lives: otherwise an allocation costs one relaxed load more
+// than malloc.
+
+namespace
+{
+
+std::size_t getBlockSize(void* p)
+{
+#if defined(__APPLE__)
+    return malloc_size(p);
+#else
+    return malloc_usable_size(p);
+#endif
+}
+
+void countAllocation(void* p)
+{
+    auto& counters = peakmemory::allocationCounters;
+    if (p == nullptr || !counters.enabled.load(std::memory_order_relaxed))
+        return;
+
+    const auto size = static_cast<std::int64_t>(getBlockSize(p));
+    const auto current = counters.current.fetch_add(size, std::memory_order_relaxed) + size;
+    auto peak = counters.peak.load(std::memory_order_relaxed);
+    while (current > peak && !counters.peak.compare_exchange_weak(peak, current, std::memory_order_relaxed))
+    {
+    }
+}
+
+void countDeallocation(void* p)
+{
+    auto& counters = peakmemory::allocationCounters;
+    if (p == nullptr || !counters.enabled.load(std::memory_order_relaxed))
+        return;
+
+    counters.current.fetch_sub(static_cast<std::int64_t>(getBlockSize(p)), std::memory_order_relaxed);
+}
+
+void* allocate(std::size_t size) noexcept
+{
+    void* p = std::malloc(size > 0 ? size : 1);
+    countAllocation(p);
+    return p;
+}
+
+void* allocate(std::size_t size, std::align_val_t alignment) noexcept
+{
+    void* p = nullptr;
+    const auto a = std::max(static_cast<std::size_t>(alignment), sizeof(void*));
+    if (posix_memalign(&p, a, size > 0 ? size : 1) != 0)
+        return nullptr;
+    countAllocation(p);
+    return p;
+}
+
+void deallocate(void* p) noexcept
+{
+    countDeallocation(p);
+    std::free(p);
+}
+
+}
+
+void* operator new(std::size_t size)
+{
+    if (void* p = allocate(size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    if (void* p = allocate(size, alignment))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocate(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocate(size, alignment);
+}
+
+void operator delete(void* p) noexcept { deallocate(p); }
+void operator delete[](void* p) noexcept { deallocate(p); }
+void operator delete(void* p, std::size_t) noexcept { deallocate(p); }
+void operator delete[](void* p, std::size_t) noexcept { deallocate(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { deallocate(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { deallocate(p); }
+void operator delete(void* p, std::align_val_t) noexcept { deallocate(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { deallocate(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { deallocate(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { deallocate(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { deallocate(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { deallocate(p); }
+
+#endif
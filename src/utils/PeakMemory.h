@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__GLIBC__) || defined(__APPLE__)
+#define SOFABENCHMARK_COUNT_ALLOCATIONS 1
+#else
+#define SOFABENCHMARK_COUNT_ALLOCATIONS 0
+#endif
+
+/**
+ * Peak memory allocated by an operation, to compare the memory used by several implementations of the same
+ * operation. The global operator new and operator delete are replaced (PeakMemory.cpp) to count the bytes
+ * allocated and freed while a PeakMemoryTracker lives: the measure of an operation does not depend on the
+ * operations run before it in the same process.
+ * The allocations which do not go through operator new are not counted, e.g. the outer index and the work
+ * vectors of Eigen::SparseMatrix (aligned malloc, O(rows)), while its values and inner indices (O(nnz)) are.
+ * The size of a block is the one given by the allocator (malloc_usable_size, malloc_size). On the other
+ * platforms, the operators are not replaced and all the values are 0.
+ *
+ * Usage:
+ *     PeakMemoryTracker tracker; // starts the counting
+ *     build();
+ *     const auto bytes = tracker.getPeakIncrease();
+ */
+namespace peakmemory
+{
+
+/// Bytes allocated minus bytes freed since the start of the counting, and their largest value
+struct AllocationCounters
+{
+    std::atomic<bool> enabled { false };
+    std::atomic<std::int64_t> current { 0 };
+    std::atomic<std::int64_t> peak { 0 };
+};
+
+inline AllocationCounters allocationCounters;
+
+}
+
+/// Only one tracker can live at a time. The allocations of all the threads are counted.
+class PeakMemoryTracker
+{
+public:
+    PeakMemoryTracker()
+    {
+        auto& counters = peakmemory::allocationCounters;
+        counters.current.store(0);
+        counters.peak.store(0);
+        counters.enabled.store(true);
+    }
+
+    ~PeakMemoryTracker()
+    {
+        peakmemory::allocationCounters.enabled.store(false);
+    }
+
+    PeakMemoryTracker(const PeakMemoryTracker&) = delete;
+    PeakMemoryTracker& operator=(const PeakMemoryTracker&) = delete;
+
+    bool isSupported() const { return SOFABENCHMARK_COUNT_ALLOCATIONS != 0; }
+
+    /// Largest amount of memory allocated and not yet freed since the construction of the tracker, in bytes.
+    /// The blocks allocated before the tracker and freed during its life do not decrease it below 0.
+    std::size_t getPeakIncrease() const
+    {
+        return static_cast<std::size_t>(peakmemory::allocationCounters.peak.load());
+    }
+};
@@ -0,0 +1,288 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#endif
+
+/// Allocator returning memory aligned on Alignment bytes (a cache line by default), so that the
+/// vectorized loops start on an aligned address
+template<typename T, std::size_t Alignment = 64>
+struct AlignedAllocator
+{
+    using value_type = T;
+
+    template<typename U>
+    struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+    AlignedAllocator() = default;
+    template<typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+    }
+
+    void deallocate(T* p, std::size_t)
+    {
+        ::operator delete(p, std::align_val_t(Alignment));
+    }
+
+    template<typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+    template<typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+};
+
+/**
+ * Coordinates of 3D points in a structure-of-arrays layout: all the x, then all the y, then all the z.
+ * The three components are stored in a single buffer. Each component is padded to a multiple of
+ * Padding values, so that all the components are aligned. The padding values are always 0.
+ */
+template<typename TReal>
+class SoAVec3
+{
+public:
+    using Real = TReal;
+    static constexpr std::size_t Padding = 64 / sizeof(Real);
+
+    SoAVec3() = default;
+    explicit SoAVec3(std::size_t size) { resize(size); }
+
+    void resize(std::size_t size)
+    {
+        m_size = size;
+        m_stride = (size + Padding - 1) / Padding * Padding;
+        m_data.assign(3 * m_stride, static_cast<Real>(0));
+    }
+
+    std::size_t size() const { return m_size; }
+
+    Real* component(std::size_t c) { return m_data.data() + c * m_stride; }
+    const Real* component(std::size_t c) const { return m_data.data() + c * m_stride; }
+
+    Real& operator()(std::size_t i, std::size_t c) { return m_data[c * m_stride + i]; }
+    Real operator()(std::size_t i, std::size_t c) const { return m_data[c * m_stride + i]; }
+
+    /// Contiguous buffer including the padding, for the operations which do not depend on the layout
+    Real* data() { return m_data.data(); }
+    const Real* data() const { return m_data.data(); }
+    std::size_t bufferSize() const { return m_data.size(); }
+
+private:
+    std::size_t m_size { 0 };
+    std::size_t m_stride { 0 };
+    std::vector<Real, AlignedAllocator<Real> > m_data;
+};
+
+/**
+ * Coordinates of 3D points in an array-of-structures-of-arrays layout: the points are grouped in blocks of
+ * BlockWidth points, and a block stores the BlockWidth x, then the BlockWidth y, then the BlockWidth z.
+ * A block fits in SIMD registers when BlockWidth is the number of SIMD lanes, while the three components of
+ * a point stay close in memory.
+ * The last block is padded with 0.
+ */
+template<typename TReal, std::size_t BlockWidth>
+class AoSoAVec3
+{
+public:
+    using Real = TReal;
+    static constexpr std::size_t Width = BlockWidth;
+
+    AoSoAVec3() = default;
+    explicit AoSoAVec3(std::size_t size) { resize(size); }
+
+    void resize(std::size_t size)
+    {
+        m_size = size;
+        m_nbBlocks = (size + BlockWidth - 1) / BlockWidth;
+        m_data.assign(3 * BlockWidth * m_nbBlocks, static_cast<Real>(0));
+    }
+
+    std::size_t size() const { return m_size; }
+    std::size_t nbBlocks() const { return m_nbBlocks; }
+
+    Real* block(std::size_t b) { return m_data.data() + 3 * BlockWidth * b; }
+    const Real* block(std::size_t b) const { return m_data.data() + 3 * BlockWidth * b; }
+
+    Real& operator()(std::size_t i, std::size_t c) { return m_data[3 * BlockWidth * (i / BlockWidth) + c * BlockWidth + i % BlockWidth]; }
+    Real operator()(std::size_t i, std::size_t c) const { return m_data[3 * BlockWidth * (i / BlockWidth) + c * BlockWidth + i % BlockWidth]; }
+
+    Real* data() { return m_data.data(); }
+    const Real* data() const { return m_data.data(); }
+    std::size_t bufferSize() const { return m_data.size(); }
+
+private:
+    std::size_t m_size { 0 };
+    std::size_t m_nbBlocks { 0 };
+    std::vector<Real, AlignedAllocator<Real> > m_data;
+};
+
+namespace soa
+{
+
+/// Kernels on flat buffers. The padding values are 0, so they do not change the results.
+
+/// y += a * x
+template<typename Real>
+void axpy(Real* __restrict y, Real a, const Real* __restrict x, std::size_t n)
+{
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        y[i] += a * x[i];
+    }
+}
+
+/// v += w
+template<typename Real>
+void peq(Real* __restrict v, const Real* __restrict w, std::size_t n)
+{
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        v[i] += w[i];
+    }
+}
+
+/// r = a + f * b
+template<typename Real>
+void scaledAdd(Real* __restrict r, const Real* __restrict a, const Real* __restrict b, Real f, std::size_t n)
+{
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        r[i] = a[i] + f * b[i];
+    }
+}
+
+/// The floating-point additions are not associative, so the compiler does not vectorize a reduction on its
+/// own. Several independent accumulators are used instead.
+template<typename Real>
+Real dot(const Real* __restrict a, const Real* __restrict b, std::size_t n)
+{
+    constexpr std::size_t NbAccumulators = 8;
+    Real acc[NbAccumulators] {};
+
+    std::size_t i = 0;
+    for (; i + NbAccumulators <= n; i += NbAccumulators)
+    {
+        for (std::size_t k = 0; k < NbAccumulators; ++k)
+        {
+            acc[k] += a[i + k] * b[i + k];
+        }
+    }
+    for (; i < n; ++i)
+    {
+        acc[0] += a[i] * b[i];
+    }
+
+    Real r {};
+    for (std::size_t k = 0; k < NbAccumulators; ++k)
+    {
+        r += acc[k];
+    }
+    return r;
+}
+
+#if defined(__AVX2__) && defined(__FMA__)
+template<>
+inline double dot<double>(const double* __restrict a, const double* __restrict b, std::size_t n)
+{
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    __m256d acc2 = _mm256_setzero_pd();
+    __m256d acc3 = _mm256_setzero_pd();
+
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), acc0);
+        acc1 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4), acc1);
+        acc2 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 8), _mm256_loadu_pd(b + i + 8), acc2);
+        acc3 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 12), _mm256_loadu_pd(b + i + 12), acc3);
+    }
+
+    const __m256d acc = _mm256_add_pd(_mm256_add_pd(acc0, acc1), _mm256_add_pd(acc2, acc3));
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, acc);
+    double r = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+    for (; i < n; ++i)
+    {
+        r += a[i] * b[i];
+    }
+    return r;
+}
+#endif
+
+/// Kernels on whole vectors of 3D points. Except pointNorms, they do not depend on the layout.
+
+template<typename Container>
+void axpy(Container& y, typename Container::Real a, const Container& x)
+{
+    soa::axpy(y.data(), a, x.data(), y.bufferSize());
+}
+
+template<typename Container>
+void peq(Container& v, const Container& w)
+{
+    soa::peq(v.data(), w.data(), v.bufferSize());
+}
+
+template<typename Container>
+void scaledAdd(Container& r, const Container& a, const Container& b, typename Container::Real f)
+{
+    soa::scaledAdd(r.data(), a.data(), b.data(), f, r.bufferSize());
+}
+
+template<typename Container>
+typename Container::Real dot(const Container& a, const Container& b)
+{
+    return soa::dot(a.data(), b.data(), a.bufferSize());
+}
+
+template<typename Container>
+typename Container::Real norm(const Container& a)
+{
+    return std::sqrt(dot(a, a));
+}
+
+/// Norm of each point: norms[i] = |a_i|
+template<typename Real>
+void pointNorms(const SoAVec3<Real>& a, Real* __restrict norms)
+{
+    const Real* __restrict x = a.component(0);
+    const Real* __restrict y = a.component(1);
+    const Real* __restrict z = a.component(2);
+    for (std::size_t i = 0; i < a.size(); ++i)
+    {
+        norms[i] = std::sqrt(x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+    }
+}
+
+template<typename Real, std::size_t BlockWidth>
+void pointNorms(const AoSoAVec3<Real, BlockWidth>& a, Real* __restrict norms)
+{
+    const std::size_t nbFullBlocks = a.size() / BlockWidth;
+    for (std::size_t b = 0; b < nbFullBlocks; ++b)
+    {
+        const Real* __restrict block = a.block(b);
+        Real* __restrict out = norms + b * BlockWidth;
+        for (std::size_t l = 0; l < BlockWidth; ++l)
+        {
+            const Real x = block[l];
+            const Real y = block[BlockWidth + l];
+            const Real z = block[2 * BlockWidth + l];
+            out[l] = std::sqrt(x * x + y * y + z * z);
+        }
+    }
+    for (std::size_t i = nbFullBlocks * BlockWidth; i < a.size(); ++i)
+    {
+        norms[i] = std::sqrt(a(i, 0) * a(i, 0) + a(i, 1) * a(i, 1) + a(i, 2) * a(i, 2));
+    }
+}
+
+}
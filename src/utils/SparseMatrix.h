@@ -2,6 +2,9 @@
 #include <Eigen/Sparse>
 #include <sofa/helper/random.h>
 #include <sofa/config.h>
+#include <sofa/linearalgebra/CompressedRowSparseMatrix.h>
+#include <utils/FEMSparsityPattern.h>
+#include <cmath>
 
 /// Sparsity is a ratio between 0 and 1
 template<typename _Scalar, int _Options, typename _StorageIndex>
@@ -22,3 +25,69 @@ static void generateRandomSparseMatrix(Eigen::SparseMatrix<_Scalar, _Options, _S
 
     eigenMatrix.setFromTriplets(triplets.begin(), triplets.end());
 }
+
+/// Entries of a symmetric positive definite matrix with the pattern of a stiffness matrix: a block of
+/// nbDofsPerNode x nbDofsPerNode for each pair of nodes coupled in the graph, random off-diagonal values and
+/// a strictly dominant diagonal
+template<typename _Scalar>
+static sofa::type::vector<Eigen::Triplet<_Scalar> > generateStiffnessTriplets(const fempattern::NodeGraph& graph, sofa::Size nbDofsPerNode)
+{
+    const auto d = static_cast<Eigen::Index>(nbDofsPerNode);
+    sofa::type::vector<Eigen::Triplet<_Scalar> > triplets;
+    triplets.reserve(graph.nbEntries() * nbDofsPerNode * nbDofsPerNode);
+    std::vector<_Scalar> rowSums(graph.nbNodes() * nbDofsPerNode, 0);
+
+    for (sofa::Index i = 0; i < graph.nbNodes(); ++i)
+    {
+        for (auto e = graph.rowBegin[i]; e < graph.rowBegin[i + 1]; ++e)
+        {
+            const sofa::Index j = graph.neighbors[e];
+            if (j < i)
+                continue;
+            for (Eigen::Index r = 0; r < d; ++r)
+            {
+                for (Eigen::Index c = (i == j ? r + 1 : 0); c < d; ++c)
+                {
+                    const auto value = static_cast<_Scalar>(sofa::helper::drand(1));
+                    const Eigen::Index row = i * d + r;
+                    const Eigen::Index col = j * d + c;
+                    triplets.emplace_back(row, col, value);
+                    triplets.emplace_back(col, row, value);
+                    rowSums[row] += std::abs(value);
+                    rowSums[col] += std::abs(value);
+                }
+            }
+        }
+    }
+
+    for (std::size_t row = 0; row < rowSums.size(); ++row)
+    {
+        triplets.emplace_back(row, row, 1 + rowSums[row]);
+    }
+    return triplets;
+}
+
+/// Stiffness-like matrix of the graph (see generateStiffnessTriplets), with nbDofsPerNode rows per node
+template<typename _Scalar, int _Options, typename _StorageIndex>
+static void generateStiffnessSparseMatrix(Eigen::SparseMatrix<_Scalar, _Options, _StorageIndex>& eigenMatrix, const fempattern::NodeGraph& graph, sofa::Size nbDofsPerNode)
+{
+    const auto n = static_cast<Eigen::Index>(graph.nbNodes() * nbDofsPerNode);
+    const auto triplets = generateStiffnessTriplets<_Scalar>(graph, nbDofsPerNode);
+    eigenMatrix.resize(n, n);
+    eigenMatrix.setFromTriplets(triplets.begin(), triplets.end());
+}
+
+/// Stiffness-like matrix of the graph (see generateStiffnessTriplets), with one block per pair of coupled nodes
+template<class TBlock>
+static void generateStiffnessBlockSparseMatrix(sofa::linearalgebra::CompressedRowSparseMatrix<TBlock>& matrix, const fempattern::NodeGraph& graph)
+{
+    static_assert(TBlock::nbLines == TBlock::nbCols, "the blocks of a stiffness matrix are square");
+    constexpr sofa::Size N = TBlock::nbLines;
+
+    matrix.resizeBlock(graph.nbNodes(), graph.nbNodes());
+    for (const auto& t : generateStiffnessTriplets<typename TBlock::Real>(graph, N))
+    {
+        (*matrix.wblock(t.row() / N, t.col() / N, true))[t.row() % N][t.col() % N] += t.value();
+    }
+    matrix.compress();
+}
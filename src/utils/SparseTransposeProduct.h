@@ -0,0 +1,260 @@
+#pragma once
+
+#include <Eigen/Sparse>
+
+#include <sofa/simulation/ParallelForEach.h>
+#include <sofa/simulation/TaskScheduler.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+/**
+ * Product C = A^T B of two row-major sparse matrices with the same number of rows, as the J^T J-like
+ * products computed at each time step by the constraint solvers, where the sparsity of A and B is constant.
+ *
+ * The product is split in two phases:
+ * - symbolic (once, as long as the sparsity does not change): structure of A^T with the permutation from the
+ *   entries of A to the entries of A^T, and structure of C, computed row by row with a marker array
+ *   (Gustavson's algorithm),
+ * - numeric (at each call): values of A^T gathered with the permutation, then each row i of C is
+ *   sum_k A^T(i,k) B(k,:), accumulated in a dense array and gathered on the structure of C.
+ * Both phases are parallel over the rows of C: each row is computed by a single thread, without any
+ * synchronization, and the result does not depend on the number of threads.
+ * The numeric phase splits the rows of C in one part per thread of the task scheduler given to the symbolic
+ * phase, each part having its own dense accumulator, allocated by the symbolic phase: the numeric phase does
+ * not allocate, and only resets the entries of the accumulator it touched.
+ */
+template<typename TReal, typename TStorageIndex = int>
+class SparseTransposeProduct
+{
+public:
+    using Real = TReal;
+    using StorageIndex = TStorageIndex;
+    using Matrix = Eigen::SparseMatrix<Real, Eigen::RowMajor, StorageIndex>;
+
+    bool hasSymbolic() const { return m_hasSymbolic; }
+
+    /// Structure of A^T and of C. A and B must be compressed.
+    void computeSymbolic(sofa::simulation::TaskScheduler& taskScheduler, const Matrix& A, const Matrix& B, Matrix& C)
+    {
+        assert(A.isCompressed() && B.isCompressed());
+        assert(A.rows() == B.rows());
+
+        const StorageIndex nbRows = static_cast<StorageIndex>(A.rows());
+        m_nbRowsC = static_cast<StorageIndex>(A.cols());
+        m_nbColsC = static_cast<StorageIndex>(B.cols());
+        m_nnzA = static_cast<StorageIndex>(A.nonZeros());
+        m_nnzB = static_cast<StorageIndex>(B.nonZeros());
+
+        transposeStructure(A, nbRows);
+
+        m_accumulators.resize(std::max(1u, taskScheduler.getThreadCount()));
+        for (auto& accumulator : m_accumulators)
+            accumulator.assign(m_nbColsC, 0);
+
+        // Number of entries of each row of C, then its columns
+        std::vector<StorageIndex> rowSizes(m_nbRowsC);
+        sofa::simulation::parallelForEachRange(taskScheduler, static_cast<StorageIndex>(0), m_nbRowsC,
+            [this, &B, &rowSizes](const auto& range)
+            {
+                std::vector<StorageIndex> marker(m_nbColsC, -1);
+                for (auto i = range.start; i != range.end; ++i)
+                {
+                    StorageIndex count = 0;
+                    forEachColumnOfRow(B, i, [&marker, &count, i](StorageIndex j)
+                    {
+                        if (marker[j] != i)
+                        {
+                            marker[j] = i;
+                            ++count;
+                        }
+                    });
+                    rowSizes[i] = count;
+                }
+            });
+
+        C.resize(m_nbRowsC, m_nbColsC);
+        StorageIndex nnzC = 0;
+        for (StorageIndex i = 0; i < m_nbRowsC; ++i)
+        {
+            nnzC += rowSizes[i];
+        }
+        C.resizeNonZeros(nnzC);
+        StorageIndex* outer = C.outerIndexPtr();
+        outer[0] = 0;
+        for (StorageIndex i = 0; i < m_nbRowsC; ++i)
+        {
+            outer[i + 1] = outer[i] + rowSizes[i];
+        }
+
+        StorageIndex* inner = C.innerIndexPtr();
+        sofa::simulation::parallelForEachRange(taskScheduler, static_cast<StorageIndex>(0), m_nbRowsC,
+            [this, &B, outer, inner](const auto& range)
+            {
+                std::vector<StorageIndex> marker(m_nbColsC, -1);
+                for (auto i = range.start; i != range.end; ++i)
+                {
+                    StorageIndex* cols = inner + outer[i];
+                    const StorageIndex count = outer[i + 1] - outer[i];
+                    if (isSortCheaperThanScan(count))
+                    {
+                        StorageIndex n = 0;
+                        forEachColumnOfRow(B, i, [&marker, cols, &n, i](StorageIndex j)
+                        {
+                            if (marker[j] != i)
+                            {
+                                marker[j] = i;
+                                cols[n++] = j;
+                            }
+                        });
+                        std::sort(cols, cols + count);
+                    }
+                    else
+                    {
+                        // Dense enough row: the marked columns are listed in order, without sort
+                        forEachColumnOfRow(B, i, [&marker, i](StorageIndex j) { marker[j] = i; });
+                        StorageIndex n = 0;
+                        for (StorageIndex j = 0; j < m_nbColsC && n < count; ++j)
+                        {
+                            // branchless: the column is always written, and kept only if marked
+                            cols[n] = j;
+                            n += (marker[j] == i);
+                        }
+                    }
+                }
+            });
+
+        m_hasSymbolic = true;
+    }
+
+    /// Values of C = A^T B. A, B and C must have the structure given to computeSymbolic.
+    void computeNumeric(sofa::simulation::TaskScheduler& taskScheduler, const Matrix& A, const Matrix& B, Matrix& C)
+    {
+        assert(m_hasSymbolic);
+        assert(A.nonZeros() == m_nnzA && B.nonZeros() == m_nnzB);
+        assert(C.rows() == m_nbRowsC && C.cols() == m_nbColsC);
+
+        const Real* aValues = A.valuePtr();
+        sofa::simulation::parallelForEachRange(taskScheduler, static_cast<std::size_t>(0), m_atValues.size(),
+            [this, aValues](const auto& range)
+            {
+                for (auto e = range.start; e != range.end; ++e)
+                    m_atValues[e] = aValues[m_atSource[e]];
+            });
+
+        const StorageIndex* outer = C.outerIndexPtr();
+        const StorageIndex* inner = C.innerIndexPtr();
+        Real* values = C.valuePtr();
+        const StorageIndex* bOuter = B.outerIndexPtr();
+        const StorageIndex* bInner = B.innerIndexPtr();
+        const Real* bValues = B.valuePtr();
+
+        const std::size_t nbParts = m_accumulators.size();
+        sofa::simulation::parallelForEach(taskScheduler, static_cast<std::size_t>(0), nbParts,
+            [&](std::size_t p)
+            {
+                // Zero outside of the entries of the row being computed
+                auto& accumulator = m_accumulators[p];
+                const auto firstRow = static_cast<StorageIndex>(m_nbRowsC * p / nbParts);
+                const auto lastRow = static_cast<StorageIndex>(m_nbRowsC * (p + 1) / nbParts);
+                for (auto i = firstRow; i != lastRow; ++i)
+                {
+                    for (auto e = m_atOuter[i]; e < m_atOuter[i + 1]; ++e)
+                    {
+                        const StorageIndex k = m_atInner[e];
+                        const Real a = m_atValues[e];
+                        for (auto f = bOuter[k]; f < bOuter[k + 1]; ++f)
+                        {
+                            accumulator[bInner[f]] += a * bValues[f];
+                        }
+                    }
+                    for (auto c = outer[i]; c < outer[i + 1]; ++c)
+                    {
+                        values[c] = accumulator[inner[c]];
+                        accumulator[inner[c]] = 0;
+                    }
+                }
+            });
+    }
+
+    /// Symbolic phase if not done yet, then numeric phase
+    void compute(sofa::simulation::TaskScheduler& taskScheduler, const Matrix& A, const Matrix& B, Matrix& C)
+    {
+        if (!m_hasSymbolic)
+            computeSymbolic(taskScheduler, A, B, C);
+        computeNumeric(taskScheduler, A, B, C);
+    }
+
+    /// To be called when the sparsity of A or B changes
+    void invalidate() { m_hasSymbolic = false; }
+
+private:
+    /// The columns of a row of C with n entries are either sorted, in ~n log2(n) comparisons, or found by a
+    /// branchless scan of the marker array, in one test per column of C, about twice cheaper than a comparison
+    /// of the sort
+    bool isSortCheaperThanScan(StorageIndex n) const
+    {
+        std::size_t log2n = 1;
+        while ((static_cast<std::size_t>(1) << log2n) < static_cast<std::size_t>(n))
+            ++log2n;
+        return 2 * static_cast<std::size_t>(n) * log2n < static_cast<std::size_t>(m_nbColsC);
+    }
+
+    /// Counting sort of the entries of A by column: CSR structure of A^T, and for each of its entries, the
+    /// position of the same entry in A
+    void transposeStructure(const Matrix& A, StorageIndex nbRows)
+    {
+        const StorageIndex* outer = A.outerIndexPtr();
+        const StorageIndex* inner = A.innerIndexPtr();
+
+        m_atOuter.assign(m_nbRowsC + 1, 0);
+        for (StorageIndex e = 0; e < m_nnzA; ++e)
+            ++m_atOuter[inner[e] + 1];
+        for (StorageIndex i = 0; i < m_nbRowsC; ++i)
+            m_atOuter[i + 1] += m_atOuter[i];
+
+        m_atInner.resize(m_nnzA);
+        m_atSource.resize(m_nnzA);
+        m_atValues.resize(m_nnzA);
+        std::vector<StorageIndex> next(m_atOuter.begin(), m_atOuter.end() - 1);
+        for (StorageIndex k = 0; k < nbRows; ++k)
+        {
+            for (auto e = outer[k]; e < outer[k + 1]; ++e)
+            {
+                const StorageIndex pos = next[inner[e]]++;
+                m_atInner[pos] = k;
+                m_atSource[pos] = e;
+            }
+        }
+    }
+
+    /// Calls f(j) for each column j of B in the rows k of B where A^T(i,k) is non-zero
+    template<class F>
+    void forEachColumnOfRow(const Matrix& B, StorageIndex i, F f) const
+    {
+        const StorageIndex* bOuter = B.outerIndexPtr();
+        const StorageIndex* bInner = B.innerIndexPtr();
+        for (auto e = m_atOuter[i]; e < m_atOuter[i + 1]; ++e)
+        {
+            const StorageIndex k = m_atInner[e];
+            for (auto f2 = bOuter[k]; f2 < bOuter[k + 1]; ++f2)
+                f(bInner[f2]);
+        }
+    }
+
+    bool m_hasSymbolic { false };
+    StorageIndex m_nbRowsC { 0 };
+    StorageIndex m_nbColsC { 0 };
+    StorageIndex m_nnzA { 0 };
+    StorageIndex m_nnzB { 0 };
+
+    std::vector<StorageIndex> m_atOuter;
+    std::vector<StorageIndex> m_atInner;
+    std::vector<StorageIndex> m_atSource;
+    std::vector<Real> m_atValues;
+
+    /// Dense row of C being computed, one per part of the rows of the numeric phase
+    std::vector<std::vector<Real> > m_accumulators;
+};
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <utils/CRSStructureCache.h>
+#include <sofa/core/behavior/BaseLocalForceFieldMatrix.h>
+#include <sofa/linearalgebra/CompressedRowSparseMatrix.h>
+
+#include <Eigen/Sparse>
+
+#include <vector>
+
+/**
+ * Implementations of StiffnessMatrixAccumulator, the interface given by the force fields to buildStiffnessMatrix,
+ * building a real matrix from the entries (one virtual call per scalar) or the 3x3 blocks (one virtual call per
+ * block) of the elements:
+ * - CRSStiffnessAccumulator: CompressedRowSparseMatrix of 3x3 blocks, as the system matrix of a linear solver
+ *   templated on CompressedRowSparseMatrixMat3x3
+ * - TripletStiffnessAccumulator: list of scalar triplets, for Eigen::SparseMatrix::setFromTriplets
+ */
+
+using StiffnessCRS = sofa::linearalgebra::CompressedRowSparseMatrix<sofa::type::Mat<3, 3, SReal> >;
+using StiffnessTriplet = Eigen::Triplet<SReal>;
+
+/**
+ * An assembly is between begin() and end(). The entries and the blocks are located in the matrix in one of the
+ * two ways:
+ * - StructureLookup::Cached: the positions of the insertions are recorded by a CRSStructureCache during the first
+ *   assembly, and the next assemblies accumulate at these positions (no search)
+ * - StructureLookup::Rebuilt: each assembly starts from an empty structure, inserts with wblock() and compresses
+ * The blocks which are not aligned on the 3x3 blocks of the matrix are added entry by entry.
+ */
+class CRSStiffnessAccumulator : public sofa::core::behavior::StiffnessMatrixAccumulator
+{
+public:
+    using sofa::core::behavior::StiffnessMatrixAccumulator::add;
+
+    enum class StructureLookup { Cached, Rebuilt };
+
+    explicit CRSStiffnessAccumulator(StiffnessCRS& matrix, StructureLookup lookup = StructureLookup::Cached)
+        : m_matrix(matrix), m_lookup(lookup)
+    {}
+
+    void begin()
+    {
+        if (m_lookup == StructureLookup::Cached)
+            m_structure.begin(m_matrix);
+        else
+            clearCRSStructure(m_matrix);
+    }
+
+    void end()
+    {
+        if (m_lookup == StructureLookup::Cached)
+            m_structure.end(m_matrix);
+        else
+            m_matrix.compress();
+    }
+
+    void add(sofa::SignedIndex row, sofa::SignedIndex col, double value) override
+    {
+        if (m_lookup == StructureLookup::Cached)
+            m_structure.addEntry(m_matrix, row / 3, col / 3, row % 3, col % 3, value);
+        else
+            (*m_matrix.wblock(row / 3, col / 3, true))[row % 3][col % 3] += value;
+    }
+
+    void add(sofa::SignedIndex row, sofa::SignedIndex col, const sofa::type::Mat<3, 3, double>& value) override
+    {
+        if (row % 3 != 0 || col % 3 != 0)
+        {
+            for (sofa::SignedIndex i = 0; i < 3; ++i)
+                for (sofa::SignedIndex j = 0; j < 3; ++j)
+                    add(row + i, col + j, value[i][j]);
+        }
+        else if (m_lookup == StructureLookup::Cached)
+        {
+            m_structure.add(m_matrix, row / 3, col / 3, value);
+        }
+        else
+        {
+            *m_matrix.wblock(row / 3, col / 3, true) += value;
+        }
+    }
+
+private:
+    StiffnessCRS& m_matrix;
+    StructureLookup m_lookup;
+    CRSStructureCache<StiffnessCRS> m_structure;
+};
+
+class TripletStiffnessAccumulator : public sofa::core::behavior::StiffnessMatrixAccumulator
+{
+public:
+    using sofa::core::behavior::StiffnessMatrixAccumulator::add;
+
+    explicit TripletStiffnessAccumulator(std::vector<StiffnessTriplet>& triplets) : m_triplets(triplets) {}
+
+    void add(sofa::SignedIndex row, sofa::SignedIndex col, double value) override
+    {
+        m_triplets.emplace_back(row, col, value);
+    }
+
+    void add(sofa::SignedIndex row, sofa::SignedIndex col, const sofa::type::Mat<3, 3, double>& value) override
+    {
+        for (sofa::SignedIndex i = 0; i < 3; ++i)
+            for (sofa::SignedIndex j = 0; j < 3; ++j)
+                m_triplets.emplace_back(row + i, col + j, value[i][j]);
+    }
+
+private:
+    std::vector<StiffnessTriplet>& m_triplets;
+};
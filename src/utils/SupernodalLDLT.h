@@ -0,0 +1,600 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <Eigen/OrderingMethods>
+#include <Eigen/Sparse>
+
+#include <sofa/simulation/ParallelForEach.h>
+#include <sofa/simulation/TaskScheduler.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+/**
+ * Supernodal LDL^T factorization of a sparse symmetric matrix, without pivoting (symmetric positive definite
+ * or quasi-definite matrices, as the ones factorized by SparseLDLSolver).
+ *
+ * Compared to a simplicial factorization, which updates the columns of L one by one with sparse operations
+ * (memory-bound), the columns of L with the same structure are grouped in supernodes, stored as dense panels,
+ * and factorized with dense kernels (multifrontal method):
+ * - analysis (once, as long as the sparsity does not change): AMD ordering, post-ordered elimination tree,
+ *   column counts, fundamental supernodes, row structure of each supernode and the relative indices used to
+ *   assemble the contributions of the children into their parent
+ * - factorization: each supernode assembles a dense frontal matrix with its entries of A and the update
+ *   matrices of its children, factorizes its columns (panel LDL^T), and computes its own update matrix with a
+ *   matrix-matrix product (BLAS-3). The supernodes are processed level by level from the leaves of the
+ *   elimination tree: the supernodes of a level are independent, and are factorized in parallel.
+ *   The frontal matrix is not allocated: its first columns are the panel of L, and its trailing block is the
+ *   update matrix. The panels and the update matrices of all the supernodes are allocated by the analysis, so
+ *   that a factorization does not allocate memory, at the cost of keeping all the update matrices.
+ * - solve: forward and backward substitutions on the dense panels, in work vectors allocated by the analysis.
+ * Only the lower triangular part of the matrix given to analyzePattern and factorize is read.
+ */
+template<typename TReal>
+class SupernodalLDLT
+{
+public:
+    using Real = TReal;
+    using Matrix = Eigen::SparseMatrix<Real, Eigen::ColMajor, int>;
+    using Vector = Eigen::Matrix<Real, Eigen::Dynamic, 1>;
+
+    bool hasSymbolic() const { return m_hasSymbolic; }
+
+    int getNbSupernodes() const { return static_cast<int>(m_superBegin.size()) - 1; }
+    int getNbLevels() const { return static_cast<int>(m_levelBegin.size()) - 1; }
+    std::size_t getNbNonZerosL() const { return m_nbNonZerosL; }
+
+    /// True if the sparsity of A differs from the one of the last matrix given to analyzePattern, i.e. the
+    /// analysis must be done again before factorizing A
+    bool hasPatternChanged(const Matrix& A) const
+    {
+        return static_cast<std::size_t>(A.outerSize() + 1) != m_patternOuter.size()
+            || static_cast<std::size_t>(A.nonZeros()) != m_patternInner.size()
+            || !std::equal(m_patternOuter.begin(), m_patternOuter.end(), A.outerIndexPtr())
+            || !std::equal(m_patternInner.begin(), m_patternInner.end(), A.innerIndexPtr());
+    }
+
+    void analyzePattern(const Matrix& A)
+    {
+        assert(A.rows() == A.cols());
+        assert(A.isCompressed());
+        m_n = static_cast<int>(A.rows());
+
+        // Fill-reducing ordering, then post-ordering of the elimination tree, so that the columns of a
+        // supernode and the supernodes of a subtree are contiguous
+        std::vector<int> permutation = computeAMDOrdering(A);
+        buildPermutedLowerPattern(A, permutation);
+        computeEliminationTree();
+        const auto postOrder = computePostOrder();
+        for (auto& p : permutation)
+            p = postOrder[p];
+        buildPermutedLowerPattern(A, permutation);
+        computeEliminationTree();
+        m_permutation = std::move(permutation);
+
+        computeColumnCounts();
+        computeSupernodes();
+        computeSupernodeStructures();
+        computeLevels();
+
+        m_patternOuter.assign(A.outerIndexPtr(), A.outerIndexPtr() + A.outerSize() + 1);
+        m_patternInner.assign(A.innerIndexPtr(), A.innerIndexPtr() + A.nonZeros());
+        m_hasSymbolic = true;
+    }
+
+    /// Returns false if a zero pivot is found
+    bool factorize(sofa::simulation::TaskScheduler& taskScheduler, const Matrix& A)
+    {
+        assert(m_hasSymbolic);
+        const Real* values = A.valuePtr();
+        for (std::size_t k = 0; k < m_cSource.size(); ++k)
+            m_cValues[k] = values[m_cSource[k]];
+
+        std::atomic<bool> success { true };
+        for (int level = 0; level < getNbLevels(); ++level)
+        {
+            sofa::simulation::parallelForEach(taskScheduler, m_levelBegin[level], m_levelBegin[level + 1],
+                [this, &success](const int i)
+                {
+                    if (!factorizeSupernode(m_levelSupernodes[i]))
+                        success = false;
+                });
+        }
+        return success;
+    }
+
+    /// Solve A x = b. x and b can be the same vector.
+    /// The work vectors are members allocated by the analysis: a solver cannot solve concurrently.
+    void solve(const Vector& b, Vector& x) const
+    {
+        auto& y = m_solveValues;
+        auto& gather = m_solveGather;
+        for (int i = 0; i < m_n; ++i)
+            y[m_permutation[i]] = b[i];
+
+        for (int s = 0; s < getNbSupernodes(); ++s)
+        {
+            const auto [m, w, first, rows] = supernodeInfo(s);
+            const auto panel = getPanel(s);
+            auto ys = y.segment(first, w);
+            panel.topRows(w).template triangularView<Eigen::UnitLower>().solveInPlace(ys);
+            if (m > w)
+            {
+                gather.head(m - w).noalias() = panel.bottomRows(m - w) * ys;
+                for (int r = w; r < m; ++r)
+                    y[rows[r]] -= gather[r - w];
+            }
+        }
+
+        y.array() /= m_diagonal.array();
+
+        for (int s = getNbSupernodes() - 1; s >= 0; --s)
+        {
+            const auto [m, w, first, rows] = supernodeInfo(s);
+            const auto panel = getPanel(s);
+            auto ys = y.segment(first, w);
+            if (m > w)
+            {
+                for (int r = w; r < m; ++r)
+                    gather[r - w] = y[rows[r]];
+                ys.noalias() -= panel.bottomRows(m - w).transpose() * gather.head(m - w);
+            }
+            panel.topRows(w).transpose().template triangularView<Eigen::UnitUpper>().solveInPlace(ys);
+        }
+
+        x.resize(m_n);
+        for (int i = 0; i < m_n; ++i)
+            x[i] = y[m_permutation[i]];
+    }
+
+private:
+    using DenseMatrix = Eigen::Matrix<Real, Eigen::Dynamic, Eigen::Dynamic>;
+    using PanelMap = Eigen::Map<DenseMatrix>;
+    using ConstPanelMap = Eigen::Map<const DenseMatrix>;
+
+    struct SupernodeInfo
+    {
+        int nbRows;
+        int width;
+        int firstColumn;
+        const int* rows;
+    };
+
+    SupernodeInfo supernodeInfo(int s) const
+    {
+        return { m_rowBegin[s + 1] - m_rowBegin[s], m_superBegin[s + 1] - m_superBegin[s], m_superBegin[s], m_rows.data() + m_rowBegin[s] };
+    }
+
+    ConstPanelMap getPanel(int s) const
+    {
+        const auto info = supernodeInfo(s);
+        return ConstPanelMap(m_panels.data() + m_panelBegin[s], info.nbRows, info.width);
+    }
+
+    /// permutation[old] = new
+    static std::vector<int> computeAMDOrdering(const Matrix& A)
+    {
+        Matrix symmetric;
+        symmetric = A.template selfadjointView<Eigen::Lower>();
+        Eigen::PermutationMatrix<Eigen::Dynamic, Eigen::Dynamic, int> inverse;
+        Eigen::AMDOrdering<int> ordering;
+        ordering(symmetric, inverse);
+
+        std::vector<int> permutation(A.rows());
+        for (int i = 0; i < static_cast<int>(A.rows()); ++i)
+            permutation[inverse.indices()[i]] = i;
+        return permutation;
+    }
+
+    /// Lower triangular pattern of P A P^T, stored by columns (m_cBegin, m_cRows) and by rows (m_uBegin, m_uCols),
+    /// with the index in A of each entry (m_cSource)
+    void buildPermutedLowerPattern(const Matrix& A, const std::vector<int>& permutation)
+    {
+        const int* outer = A.outerIndexPtr();
+        const int* inner = A.innerIndexPtr();
+
+        m_cBegin.assign(m_n + 1, 0);
+        m_uBegin.assign(m_n + 1, 0);
+        for (int j = 0; j < m_n; ++j)
+        {
+            for (int k = outer[j]; k < outer[j + 1]; ++k)
+            {
+                if (inner[k] < j)
+                    continue;
+                const auto [col, row] = std::minmax(permutation[inner[k]], permutation[j]);
+                ++m_cBegin[col + 1];
+                if (row != col)
+                    ++m_uBegin[row + 1];
+            }
+        }
+        for (int j = 0; j < m_n; ++j)
+        {
+            m_cBegin[j + 1] += m_cBegin[j];
+            m_uBegin[j + 1] += m_uBegin[j];
+        }
+
+        std::vector<std::pair<int, int> > entries(m_cBegin[m_n]);
+        m_uCols.resize(m_uBegin[m_n]);
+        std::vector<int> cNext(m_cBegin.begin(), m_cBegin.end() - 1);
+        std::vector<int> uNext(m_uBegin.begin(), m_uBegin.end() - 1);
+        for (int j = 0; j < m_n; ++j)
+        {
+            for (int k = outer[j]; k < outer[j + 1]; ++k)
+            {
+                if (inner[k] < j)
+                    continue;
+                // (col, row) with col <= row: entry of the column col of the lower part
+                const auto [col, row] = std::minmax(permutation[inner[k]], permutation[j]);
+                entries[cNext[col]++] = { row, k };
+                if (row != col)
+                    m_uCols[uNext[row]++] = col;
+            }
+        }
+
+        m_cRows.resize(entries.size());
+        m_cSource.resize(entries.size());
+        m_cValues.resize(entries.size());
+        for (int j = 0; j < m_n; ++j)
+        {
+            std::sort(entries.begin() + m_cBegin[j], entries.begin() + m_cBegin[j + 1]);
+            for (int k = m_cBegin[j]; k < m_cBegin[j + 1]; ++k)
+            {
+                m_cRows[k] = entries[k].first;
+                m_cSource[k] = entries[k].second;
+            }
+        }
+    }
+
+    /// Liu's algorithm with path compression, on the rows of the lower part
+    void computeEliminationTree()
+    {
+        m_parent.assign(m_n, -1);
+        std::vector<int> ancestor(m_n, -1);
+        for (int i = 0; i < m_n; ++i)
+        {
+            for (int k = m_uBegin[i]; k < m_uBegin[i + 1]; ++k)
+            {
+                int r = m_uCols[k];
+                while (ancestor[r] != -1 && ancestor[r] != i)
+                {
+                    const int next = ancestor[r];
+                    ancestor[r] = i;
+                    r = next;
+                }
+                if (ancestor[r] == -1)
+                {
+                    ancestor[r] = i;
+                    m_parent[r] = i;
+                }
+            }
+        }
+    }
+
+    /// postOrder[node] = position of the node in a depth-first post-ordering of the elimination tree
+    std::vector<int> computePostOrder() const
+    {
+        std::vector<int> childBegin(m_n + 1, 0);
+        for (int j = 0; j < m_n; ++j)
+            if (m_parent[j] != -1)
+                ++childBegin[m_parent[j] + 1];
+        for (int j = 0; j < m_n; ++j)
+            childBegin[j + 1] += childBegin[j];
+        std::vector<int> children(childBegin[m_n]);
+        std::vector<int> next(childBegin.begin(), childBegin.end() - 1);
+        for (int j = 0; j < m_n; ++j)
+            if (m_parent[j] != -1)
+                children[next[m_parent[j]]++] = j;
+
+        std::vector<int> postOrder(m_n);
+        std::vector<std::pair<int, int> > stack; // node, next child to visit
+        int position = 0;
+        for (int root = 0; root < m_n; ++root)
+        {
+            if (m_parent[root] != -1)
+                continue;
+            stack.emplace_back(root, childBegin[root]);
+            while (!stack.empty())
+            {
+                auto& [node, child] = stack.back();
+                if (child < childBegin[node + 1])
+                {
+                    const int c = children[child++];
+                    stack.emplace_back(c, childBegin[c]);
+                }
+                else
+                {
+                    postOrder[node] = position++;
+                    stack.pop_back();
+                }
+            }
+        }
+        return postOrder;
+    }
+
+    /// Number of non-zeros of each column of L (diagonal included), from the row subtrees
+    void computeColumnCounts()
+    {
+        m_columnCount.assign(m_n, 1);
+        std::vector<int> marker(m_n, -1);
+        for (int i = 0; i < m_n; ++i)
+        {
+            marker[i] = i;
+            for (int k = m_uBegin[i]; k < m_uBegin[i + 1]; ++k)
+            {
+                for (int j = m_uCols[k]; marker[j] != i; j = m_parent[j])
+                {
+                    marker[j] = i;
+                    ++m_columnCount[j];
+                }
+            }
+        }
+    }
+
+    /// Fundamental supernodes: a column is merged with the previous one if it is its only child in the
+    /// elimination tree, and if their structures are the same
+    void computeSupernodes()
+    {
+        std::vector<int> nbChildren(m_n, 0);
+        for (int j = 0; j < m_n; ++j)
+            if (m_parent[j] != -1)
+                ++nbChildren[m_parent[j]];
+
+        m_superBegin.assign(1, 0);
+        for (int j = 1; j < m_n; ++j)
+        {
+            const bool merge = m_parent[j - 1] == j && nbChildren[j] == 1 && m_columnCount[j - 1] == m_columnCount[j] + 1;
+            if (!merge)
+                m_superBegin.push_back(j);
+        }
+        m_superBegin.push_back(m_n);
+
+        const int nbSupernodes = getNbSupernodes();
+        m_columnSupernode.resize(m_n);
+        for (int s = 0; s < nbSupernodes; ++s)
+            std::fill(m_columnSupernode.begin() + m_superBegin[s], m_columnSupernode.begin() + m_superBegin[s + 1], s);
+
+        m_superParent.resize(nbSupernodes);
+        for (int s = 0; s < nbSupernodes; ++s)
+        {
+            const int parent = m_parent[m_superBegin[s + 1] - 1];
+            m_superParent[s] = parent == -1 ? -1 : m_columnSupernode[parent];
+        }
+
+        m_childBegin.assign(nbSupernodes + 1, 0);
+        for (int s = 0; s < nbSupernodes; ++s)
+            if (m_superParent[s] != -1)
+                ++m_childBegin[m_superParent[s] + 1];
+        for (int s = 0; s < nbSupernodes; ++s)
+            m_childBegin[s + 1] += m_childBegin[s];
+        m_children.resize(m_childBegin[nbSupernodes]);
+        std::vector<int> next(m_childBegin.begin(), m_childBegin.end() - 1);
+        for (int s = 0; s < nbSupernodes; ++s)
+            if (m_superParent[s] != -1)
+                m_children[next[m_superParent[s]]++] = s;
+    }
+
+    /// Rows of each supernode: its columns, then the rows below from its entries of A and from the structures of
+    /// its children. The children are numbered before their parent, so their structures are already known.
+    void computeSupernodeStructures()
+    {
+        const int nbSupernodes = getNbSupernodes();
+        m_rowBegin.assign(1, 0);
+        m_rows.clear();
+        m_panelBegin.assign(1, 0);
+        m_cLocal.resize(m_cRows.size());
+        m_relativeBegin.assign(nbSupernodes + 1, 0);
+        m_relativeIndices.clear();
+        m_updateBegin.assign(1, 0);
+        m_maxNbRows = 0;
+        m_maxWidth = 0;
+        m_nbNonZerosL = 0;
+
+        std::vector<int> marker(m_n, -1);
+        std::vector<int> localIndex(m_n, -1);
+        for (int s = 0; s < nbSupernodes; ++s)
+        {
+            const int first = m_superBegin[s];
+            const int last = m_superBegin[s + 1];
+            const auto begin = m_rows.size();
+
+            for (int j = first; j < last; ++j)
+            {
+                marker[j] = s;
+                m_rows.push_back(j);
+            }
+            const auto addRow = [&](int row)
+            {
+                if (marker[row] != s)
+                {
+                    marker[row] = s;
+                    m_rows.push_back(row);
+                }
+            };
+            for (int j = first; j < last; ++j)
+                for (int k = m_cBegin[j]; k < m_cBegin[j + 1]; ++k)
+                    addRow(m_cRows[k]);
+            for (int c = m_childBegin[s]; c < m_childBegin[s + 1]; ++c)
+            {
+                const int child = m_children[c];
+                const int childWidth = m_superBegin[child + 1] - m_superBegin[child];
+                for (int r = m_rowBegin[child] + childWidth; r < m_rowBegin[child + 1]; ++r)
+                    addRow(m_rows[r]);
+            }
+            std::sort(m_rows.begin() + begin + (last - first), m_rows.end());
+
+            const int nbRows = static_cast<int>(m_rows.size() - begin);
+            const int width = last - first;
+            assert(nbRows == m_columnCount[first]);
+            m_rowBegin.push_back(static_cast<int>(m_rows.size()));
+            m_panelBegin.push_back(m_panelBegin.back() + static_cast<std::size_t>(nbRows) * width);
+            m_updateBegin.push_back(m_updateBegin.back() + static_cast<std::size_t>(nbRows - width) * (nbRows - width));
+            m_maxNbRows = std::max(m_maxNbRows, nbRows);
+            m_maxWidth = std::max(m_maxWidth, width);
+            m_nbNonZerosL += static_cast<std::size_t>(nbRows) * width - static_cast<std::size_t>(width) * (width - 1) / 2;
+
+            for (int r = 0; r < nbRows; ++r)
+                localIndex[m_rows[begin + r]] = r;
+            for (int j = first; j < last; ++j)
+                for (int k = m_cBegin[j]; k < m_cBegin[j + 1]; ++k)
+                    m_cLocal[k] = localIndex[m_cRows[k]];
+            for (int c = m_childBegin[s]; c < m_childBegin[s + 1]; ++c)
+            {
+                const int child = m_children[c];
+                const int childWidth = m_superBegin[child + 1] - m_superBegin[child];
+                m_relativeBegin[child] = static_cast<int>(m_relativeIndices.size());
+                for (int r = m_rowBegin[child] + childWidth; r < m_rowBegin[child + 1]; ++r)
+                    m_relativeIndices.push_back(localIndex[m_rows[r]]);
+            }
+        }
+
+        m_panels.resize(m_panelBegin.back());
+        m_updateValues.resize(m_updateBegin.back());
+        m_diagonal.resize(m_n);
+        m_solveValues.resize(m_n);
+        m_solveGather.resize(m_maxNbRows);
+    }
+
+    /// Level of a supernode: 0 for the leaves, 1 + the maximum level of its children otherwise
+    void computeLevels()
+    {
+        const int nbSupernodes = getNbSupernodes();
+        std::vector<int> level(nbSupernodes, 0);
+        int nbLevels = 0;
+        for (int s = 0; s < nbSupernodes; ++s)
+        {
+            if (m_superParent[s] != -1)
+                level[m_superParent[s]] = std::max(level[m_superParent[s]], level[s] + 1);
+            nbLevels = std::max(nbLevels, level[s] + 1);
+        }
+
+        m_levelBegin.assign(nbLevels + 1, 0);
+        for (int s = 0; s < nbSupernodes; ++s)
+            ++m_levelBegin[level[s] + 1];
+        for (int l = 0; l < nbLevels; ++l)
+            m_levelBegin[l + 1] += m_levelBegin[l];
+        m_levelSupernodes.resize(nbSupernodes);
+        std::vector<int> next(m_levelBegin.begin(), m_levelBegin.end() - 1);
+        for (int s = 0; s < nbSupernodes; ++s)
+            m_levelSupernodes[next[level[s]]++] = s;
+    }
+
+    PanelMap getUpdate(int s)
+    {
+        const auto info = supernodeInfo(s);
+        const int size = info.nbRows - info.width;
+        return PanelMap(m_updateValues.data() + m_updateBegin[s], size, size);
+    }
+
+    bool factorizeSupernode(int s)
+    {
+        const auto [m, w, first, rows] = supernodeInfo(s);
+        const int size = m - w;
+
+        // Frontal matrix (lower part), split into the panel (m x w) and the update matrix (size x size):
+        // entries of A, then update matrices of the children (extend-add)
+        auto panel = PanelMap(m_panels.data() + m_panelBegin[s], m, w);
+        auto update = getUpdate(s);
+        panel.setZero();
+        update.template triangularView<Eigen::Lower>().setZero();
+        for (int j = first; j < first + w; ++j)
+            for (int k = m_cBegin[j]; k < m_cBegin[j + 1]; ++k)
+                panel(m_cLocal[k], j - first) += m_cValues[k];
+
+        for (int c = m_childBegin[s]; c < m_childBegin[s + 1]; ++c)
+        {
+            const int child = m_children[c];
+            const auto childUpdate = getUpdate(child);
+            const int childSize = static_cast<int>(childUpdate.rows());
+            const int* relative = m_relativeIndices.data() + m_relativeBegin[child];
+            // The relative indices are increasing: relative[ci] >= relative[cj] in the lower part
+            for (int cj = 0; cj < childSize; ++cj)
+            {
+                const int rj = relative[cj];
+                for (int ci = cj; ci < childSize; ++ci)
+                {
+                    const int ri = relative[ci];
+                    if (rj < w)
+                        panel(ri, rj) += childUpdate(ci, cj);
+                    else
+                        update(ri - w, rj - w) += childUpdate(ci, cj);
+                }
+            }
+        }
+
+        // Panel LDL^T of the w first columns
+        for (int k = 0; k < w; ++k)
+        {
+            const Real d = panel(k, k);
+            if (d == 0 || !std::isfinite(d))
+                return false;
+            m_diagonal[first + k] = d;
+            auto column = panel.col(k).tail(m - k - 1);
+            panel.block(k + 1, k + 1, m - k - 1, w - k - 1).noalias() -= (column / d) * column.head(w - k - 1).transpose();
+            column /= d;
+        }
+
+        // Update matrix of the supernode: F22 - L21 D L21^T, with L21 D in a workspace of the thread
+        if (size > 0)
+        {
+            static thread_local std::vector<Real> workspace;
+            if (workspace.size() < static_cast<std::size_t>(m_maxNbRows) * m_maxWidth)
+                workspace.resize(static_cast<std::size_t>(m_maxNbRows) * m_maxWidth);
+
+            const auto L21 = panel.bottomRows(size);
+            auto W = PanelMap(workspace.data(), size, w);
+            W.noalias() = L21 * m_diagonal.segment(first, w).asDiagonal();
+            update.template triangularView<Eigen::Lower>() -= L21 * W.transpose();
+        }
+        return true;
+    }
+
+    int m_n { 0 };
+    bool m_hasSymbolic { false };
+
+    /// Sparsity of the last analyzed matrix
+    std::vector<int> m_patternOuter, m_patternInner;
+
+    /// permutation[old] = new
+    std::vector<int> m_permutation;
+
+    /// Lower part of the permuted matrix, by columns, with the index of each entry in the input matrix
+    std::vector<int> m_cBegin, m_cRows, m_cSource;
+    std::vector<Real> m_cValues;
+    /// Position of each entry of the lower part in the frontal matrix of its supernode
+    std::vector<int> m_cLocal;
+    /// Strictly lower part of the permuted matrix, by rows
+    std::vector<int> m_uBegin, m_uCols;
+
+    std::vector<int> m_parent;
+    std::vector<int> m_columnCount;
+
+    /// Columns [m_superBegin[s], m_superBegin[s + 1]) of each supernode s
+    std::vector<int> m_superBegin;
+    std::vector<int> m_columnSupernode;
+    std::vector<int> m_superParent;
+    std::vector<int> m_childBegin, m_children;
+    /// Rows of each supernode: its columns first, then the rows below, sorted
+    std::vector<int> m_rowBegin, m_rows;
+    /// Positions of the rows of the update matrix of a supernode in the frontal matrix of its parent
+    std::vector<int> m_relativeBegin, m_relativeIndices;
+    std::vector<int> m_levelBegin, m_levelSupernodes;
+    int m_maxNbRows { 0 };
+    int m_maxWidth { 0 };
+    std::size_t m_nbNonZerosL { 0 };
+
+    /// Dense column-major panels of L (nbRows x width), with a unit diagonal which is not stored
+    std::vector<std::size_t> m_panelBegin;
+    std::vector<Real> m_panels;
+    Vector m_diagonal;
+    /// Dense column-major update matrices ((nbRows - width) x (nbRows - width), lower part), assembled in the
+    /// frontal matrix of the parent
+    std::vector<std::size_t> m_updateBegin;
+    std::vector<Real> m_updateValues;
+
+    /// Work vectors of solve: the permuted right-hand side, and the rows below the columns of a supernode
+    mutable Vector m_solveValues;
+    mutable Vector m_solveGather;
+};
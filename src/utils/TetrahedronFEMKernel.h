@@ -0,0 +1,248 @@
+#pragma once
+
+#include <sofa/config.h>
+#include <utils/FEMSparsityPattern.h>
+
+#include <Eigen/Dense>
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+/**
+ * Element stiffness of linear tetrahedra with the corotational formulation of TetrahedronFEMForceField (method
+ * "large"), outside of the scene graph: the element loop can be split between threads, and the blocks sent to
+ * any accumulator.
+ *
+ * The rotation R of an element is the frame of its first edge and of the plane of its first three nodes. At
+ * rest, the gradients g_a of the shape functions are computed in this frame. For an isotropic material of Lamé
+ * coefficients lambda and mu, the stiffness between the nodes a and b in the frame of the element is
+ *     K_ab = V (lambda g_a g_b^T + mu g_b g_a^T + mu (g_a . g_b) I)
+ * i.e. the block (a, b) of V J^T D J, and its stiffness in the world frame is R^T K_ab R.
+ * Only the gradients and the volume (13 values) are stored per element: the 12x12 matrix is never formed.
+ *
+ * The forces are computed from the displacement gradient H in the frame of the element:
+ *     f_a = -V R^T sigma(H) g_a, with sigma(H) = lambda tr(eps) I + 2 mu eps and eps = (H + H^T) / 2
+ * which is K u without the 12x12 product. As in TetrahedronFEMForceField, the rotations are updated by the
+ * computation of the forces and reused by the computation of the force differentials.
+ */
+namespace tetrafem
+{
+
+using Index = sofa::Index;
+using Tetrahedron = std::array<Index, 4>;
+
+template<class TReal>
+class CorotationalTetrahedra
+{
+public:
+    using Real = TReal;
+    using Vec3 = Eigen::Matrix<Real, 3, 1>;
+    using Mat3 = Eigen::Matrix<Real, 3, 3>;
+
+    template<class TVec3>
+    void init(const std::vector<TVec3>& restPositions, const std::vector<Tetrahedron>& tetrahedra, Real youngModulus, Real poissonRatio)
+    {
+        m_nbNodes = static_cast<Index>(restPositions.size());
+        m_tetrahedra = tetrahedra;
+        m_lambda = youngModulus * poissonRatio / ((1 + poissonRatio) * (1 - 2 * poissonRatio));
+        m_mu = youngModulus / (2 * (1 + poissonRatio));
+
+        m_gradients.resize(tetrahedra.size());
+        m_volumes.resize(tetrahedra.size());
+        m_restEdges.resize(tetrahedra.size());
+        m_rotations.resize(tetrahedra.size());
+        for (std::size_t e = 0; e < tetrahedra.size(); ++e)
+        {
+            const auto restEdges = computeEdges(restPositions, tetrahedra[e]);
+            const Mat3 R = computeRotation(restEdges[0], restEdges[1]);
+
+            // Edges from the first node, in the frame of the element. The gradients of the shape functions of
+            // the nodes 1, 2 and 3 are the rows of the inverse of the matrix of the edges.
+            Mat3 edges;
+            for (int i = 0; i < 3; ++i)
+                edges.col(i) = R * restEdges[i];
+            const Mat3 inverse = edges.inverse();
+            for (int i = 0; i < 3; ++i)
+                m_restEdges[e][i] = edges.col(i);
+            m_rotations[e] = R;
+
+            auto& g = m_gradients[e];
+            g[0].setZero();
+            for (int i = 0; i < 3; ++i)
+            {
+                g[i + 1] = inverse.row(i).transpose();
+                g[0] -= g[i + 1];
+            }
+            m_volumes[e] = std::abs(edges.determinant()) / 6;
+        }
+    }
+
+    Index getNbNodes() const { return m_nbNodes; }
+    std::size_t getNbElements() const { return m_tetrahedra.size(); }
+    const std::vector<Tetrahedron>& getTetrahedra() const { return m_tetrahedra; }
+
+    /// Rotation from the world frame to the frame of an element, given its edges from the first node to the
+    /// second and the third nodes: the rows are the axes of the frame
+    static Mat3 computeRotation(const Vec3& edge1, const Vec3& edge2)
+    {
+        const Vec3 x = edge1.normalized();
+        const Vec3 z = x.cross(edge2).normalized();
+        const Vec3 y = z.cross(x);
+
+        Mat3 R;
+        R.row(0) = x;
+        R.row(1) = y;
+        R.row(2) = z;
+        return R;
+    }
+
+    /**
+     * Call add(nodeA, nodeB, block) for the 16 blocks of the derivative of the force of the element e with
+     * respect to the positions, i.e. -R^T K_ab R, R being the rotation of the element for the given positions.
+     */
+    template<class TVec3, class AddBlock>
+    void computeElementStiffness(std::size_t e, const std::vector<TVec3>& positions, AddBlock&& add) const
+    {
+        const auto& t = m_tetrahedra[e];
+        const auto edges = computeEdges(positions, t);
+        const Mat3 R = computeRotation(edges[0], edges[1]);
+
+        // Gradients in the world frame: R^T K_ab R = V (lambda G_a G_b^T + mu G_b G_a^T + mu (G_a . G_b) I)
+        // with G = R^T g, since R is orthonormal
+        const auto& g = m_gradients[e];
+        std::array<Vec3, 4> G;
+        for (int a = 0; a < 4; ++a)
+            G[a] = R.transpose() * g[a];
+
+        const Real lambda = m_volumes[e] * m_lambda;
+        const Real mu = m_volumes[e] * m_mu;
+        for (int a = 0; a < 4; ++a)
+        {
+            for (int b = 0; b < 4; ++b)
+            {
+                Mat3 block = -lambda * G[a] * G[b].transpose() - mu * G[b] * G[a].transpose();
+                block.diagonal().array() -= mu * G[a].dot(G[b]);
+                add(t[a], t[b], block);
+            }
+        }
+    }
+
+    /**
+     * Call add(node, force) for the 4 nodes of the element e: elastic force of the displacement from the rest
+     * shape, in the frame of the element for the given positions. The rotation of the element is stored.
+     * Elements can be computed concurrently, but the forces of nodes shared by elements must not be
+     * accumulated concurrently.
+     */
+    template<class TVec3, class AddForce>
+    void computeElementForce(std::size_t e, const std::vector<TVec3>& positions, AddForce&& add)
+    {
+        const auto edges = computeEdges(positions, m_tetrahedra[e]);
+        const Mat3 R = computeRotation(edges[0], edges[1]);
+        m_rotations[e] = R;
+
+        const auto& g = m_gradients[e];
+        Mat3 H = Mat3::Zero();
+        for (int i = 0; i < 3; ++i)
+            H.noalias() += (R * edges[i] - m_restEdges[e][i]) * g[i + 1].transpose();
+
+        addNodalForces(e, R, H, 1, add);
+    }
+
+    /// Call add(node, df) for the 4 nodes of the element e: df = -kFactor K dx, with the rotation stored by the
+    /// last computeElementForce
+    template<class TVec3, class AddForce>
+    void computeElementDForce(std::size_t e, const std::vector<TVec3>& dx, Real kFactor, AddForce&& add) const
+    {
+        const auto& t = m_tetrahedra[e];
+        const Mat3& R = m_rotations[e];
+
+        const auto& g = m_gradients[e];
+        Mat3 H = Mat3::Zero();
+        for (int a = 0; a < 4; ++a)
+            H.noalias() += (R * dx[t[a]].template cast<Real>()) * g[a].transpose();
+
+        addNodalForces(e, R, H, kFactor, add);
+    }
+
+private:
+    /// Edges from the first node of an element. The differences are computed in the precision of the positions
+    /// before the conversion to Real: the positions are absolute, and their rounding to float would be of the
+    /// order of the displacements.
+    template<class TVec3>
+    static std::array<Vec3, 3> computeEdges(const std::vector<TVec3>& positions, const Tetrahedron& t)
+    {
+        std::array<Vec3, 3> edges;
+        for (int i = 0; i < 3; ++i)
+            edges[i] = (positions[t[i + 1]] - positions[t[0]]).template cast<Real>();
+        return edges;
+    }
+
+    template<class AddForce>
+    void addNodalForces(std::size_t e, const Mat3& R, const Mat3& H, Real factor, AddForce&& add) const
+    {
+        const Mat3 strain = (H + H.transpose()) / 2;
+        Mat3 stress = 2 * m_mu * strain;
+        stress.diagonal().array() += m_lambda * strain.trace();
+
+        // f_a = -V R^T sigma g_a
+        const Mat3 worldStress = (-factor * m_volumes[e]) * (R.transpose() * stress);
+        const auto& t = m_tetrahedra[e];
+        const auto& g = m_gradients[e];
+        for (int a = 0; a < 4; ++a)
+            add(t[a], (worldStress * g[a]).eval());
+    }
+
+    Index m_nbNodes { 0 };
+    std::vector<Tetrahedron> m_tetrahedra;
+    Real m_lambda { 0 };
+    Real m_mu { 0 };
+
+    /// Gradients of the 4 shape functions in the rest frame of each element
+    std::vector<std::array<Vec3, 4> > m_gradients;
+    std::vector<Real> m_volumes;
+
+    /// Edges from the first node at rest, in the rest frame of each element
+    std::vector<std::array<Vec3, 3> > m_restEdges;
+
+    /// Rotation of each element for the positions of the last computation of the forces
+    std::vector<Mat3> m_rotations;
+};
+
+/// Beam of nx * ny * nz nodes on the box [-9,-6]x[0,3]x[0,19] of the TetrahedronFEMForceField benchmarks, each
+/// cube split in 6 tetrahedra. The deformed positions are twisted around the axis of the beam (half a radian at
+/// the end), so that each element has its own rotation.
+struct TwistedBeam
+{
+    using Vec3 = Eigen::Matrix<SReal, 3, 1>;
+
+    std::vector<Vec3> restPositions;
+    std::vector<Vec3> positions;
+    std::vector<Tetrahedron> tetrahedra;
+};
+
+inline TwistedBeam createTwistedBeam(Index nx, Index ny, Index nz)
+{
+    using Vec3 = TwistedBeam::Vec3;
+    const Vec3 min(-9, 0, 0), max(-6, 3, 19);
+    const SReal cx = (min.x() + max.x()) / 2, cy = (min.y() + max.y()) / 2;
+
+    TwistedBeam beam;
+    beam.tetrahedra = fempattern::createGridTetrahedra(nx, ny, nz);
+    for (Index z = 0; z < nz; ++z)
+    for (Index y = 0; y < ny; ++y)
+    for (Index x = 0; x < nx; ++x)
+    {
+        const Vec3 t(SReal(x) / (nx - 1), SReal(y) / (ny - 1), SReal(z) / (nz - 1));
+        const Vec3 p = min + t.cwiseProduct(max - min);
+        beam.restPositions.push_back(p);
+
+        const SReal angle = t.z() / 2;
+        beam.positions.emplace_back(cx + std::cos(angle) * (p.x() - cx) - std::sin(angle) * (p.y() - cy),
+                                    cy + std::sin(angle) * (p.x() - cx) + std::cos(angle) * (p.y() - cy), p.z());
+    }
+    return beam;
+}
+
+}
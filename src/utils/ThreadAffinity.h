@@ -0,0 +1,413 @@
+#pragma once
+
+#include <utils/WorkStealingScheduler.h>
+
+#include <sofa/simulation/CpuTask.h>
+#include <sofa/simulation/TaskScheduler.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/**
+ * Placement of the threads of a task scheduler on the logical CPUs:
+ * - None: the operating system decides, and may migrate the threads
+ * - Compact: the threads fill a socket before the next one, and the SMT siblings of a core are used together
+ * - Scatter: the threads are distributed round-robin on the sockets, one per physical core first
+ * - NoSMT: one thread per physical core, as in Compact; the SMT siblings are only used when there are more
+ *   threads than physical cores
+ */
+enum class AffinityPolicy : int
+{
+    None = 0,
+    Compact,
+    Scatter,
+    NoSMT
+};
+
+inline const char* toString(AffinityPolicy policy)
+{
+    switch (policy)
+    {
+        case AffinityPolicy::Compact: return "compact";
+        case AffinityPolicy::Scatter: return "scatter";
+        case AffinityPolicy::NoSMT: return "nosmt";
+        default: return "none";
+    }
+}
+
+inline AffinityPolicy affinityPolicyFromString(const std::string& name)
+{
+    if (name == "compact") return AffinityPolicy::Compact;
+    if (name == "scatter") return AffinityPolicy::Scatter;
+    if (name == "nosmt") return AffinityPolicy::NoSMT;
+    return AffinityPolicy::None;
+}
+
+/// Policy given by the environment variable SOFABENCHMARK_AFFINITY (compact, scatter or nosmt)
+inline AffinityPolicy affinityPolicyFromEnvironment()
+{
+    const char* value = std::getenv("SOFABENCHMARK_AFFINITY");
+    return value ? affinityPolicyFromString(value) : AffinityPolicy::None;
+}
+
+/**
+ * Logical CPUs of the machine, with their physical core, socket and NUMA node.
+ * On Linux, the topology is read from sysfs. Elsewhere, or if sysfs is not readable, all the logical CPUs
+ * are assumed to be distinct cores of a single socket.
+ */
+class CpuTopology
+{
+public:
+    struct LogicalCpu
+    {
+        int id { 0 };
+        int core { 0 };
+        int package { 0 };
+        int numaNode { 0 };
+    };
+
+    static const CpuTopology& get()
+    {
+        static const CpuTopology topology;
+        return topology;
+    }
+
+    const std::vector<LogicalCpu>& getCpus() const { return m_cpus; }
+
+    std::size_t getNbPackages() const { return countDistinct([](const LogicalCpu& c) { return std::make_tuple(c.package, 0); }); }
+    std::size_t getNbCores() const { return countDistinct([](const LogicalCpu& c) { return std::make_tuple(c.package, c.core); }); }
+    std::size_t getNbNumaNodes() const { return countDistinct([](const LogicalCpu& c) { return std::make_tuple(c.numaNode, 0); }); }
+
+    /// Logical CPUs in the order the threads are placed with the policy. Empty for AffinityPolicy::None.
+    std::vector<int> getOrder(AffinityPolicy policy) const
+    {
+        if (policy == AffinityPolicy::None)
+            return {};
+
+        // rank of each logical CPU among the SMT siblings of its core, and of each core in its socket
+        std::map<std::tuple<int, int>, int> nbSiblings;
+        std::map<int, std::map<int, int> > coreRanks;
+        std::vector<std::tuple<int, int, int, int> > keys; // sort keys, then the id of the logical CPU
+        std::vector<LogicalCpu> sorted = m_cpus;
+        std::sort(sorted.begin(), sorted.end(), [](const LogicalCpu& a, const LogicalCpu& b)
+        {
+            return std::tie(a.package, a.core, a.id) < std::tie(b.package, b.core, b.id);
+        });
+        for (const auto& cpu : sorted)
+        {
+            const int smt = nbSiblings[{cpu.package, cpu.core}]++;
+            auto& ranks = coreRanks[cpu.package];
+            const int coreRank = ranks.emplace(cpu.core, static_cast<int>(ranks.size())).first->second;
+
+            switch (policy)
+            {
+                case AffinityPolicy::Compact:
+                    keys.emplace_back(cpu.package, coreRank, smt, cpu.id);
+                    break;
+                case AffinityPolicy::Scatter:
+                    keys.emplace_back(smt, coreRank, cpu.package, cpu.id);
+                    break;
+                case AffinityPolicy::NoSMT:
+                    keys.emplace_back(smt, cpu.package, coreRank, cpu.id);
+                    break;
+                default:
+                    break;
+            }
+        }
+        std::sort(keys.begin(), keys.end());
+
+        std::vector<int> order;
+        order.reserve(keys.size());
+        for (const auto& key : keys)
+            order.push_back(std::get<3>(key));
+        return order;
+    }
+
+    /// Short description, to be reported as a benchmark context
+    std::string toString() const
+    {
+        std::ostringstream oss;
+        oss << m_cpus.size() << " logical CPUs, " << getNbCores() << " cores, " << getNbPackages() << " sockets, "
+            << getNbNumaNodes() << " NUMA nodes";
+        return oss.str();
+    }
+
+private:
+    CpuTopology()
+    {
+#if defined(__linux__)
+        readSysfs();
+#endif
+        if (m_cpus.empty())
+        {
+            const unsigned int nbCpus = std::max(1u, std::thread::hardware_concurrency());
+            for (unsigned int i = 0; i < nbCpus; ++i)
+                m_cpus.push_back({static_cast<int>(i), static_cast<int>(i), 0, 0});
+        }
+    }
+
+    template<class Key>
+    std::size_t countDistinct(const Key& key) const
+    {
+        std::vector<decltype(key(m_cpus.front()))> keys;
+        for (const auto& cpu : m_cpus)
+            keys.push_back(key(cpu));
+        std::sort(keys.begin(), keys.end());
+        return static_cast<std::size_t>(std::unique(keys.begin(), keys.end()) - keys.begin());
+    }
+
+    /// Parse a list in the sysfs format, e.g. "0-3,8-11"
+    static std::vector<int> parseCpuList(const std::string& list)
+    {
+        std::vector<int> cpus;
+        std::stringstream ss(list);
+        std::string range;
+        while (std::getline(ss, range, ','))
+        {
+            if (range.empty())
+                continue;
+            const auto dash = range.find('-');
+            const int first = std::stoi(range.substr(0, dash));
+            const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int i = first; i <= last; ++i)
+                cpus.push_back(i);
+        }
+        return cpus;
+    }
+
+    static bool readFile(const std::string& path, std::string& content)
+    {
+        std::ifstream file(path);
+        return file && std::getline(file, content);
+    }
+
+    void readSysfs()
+    {
+        const std::string cpuRoot = "/sys/devices/system/cpu/";
+        std::string online;
+        if (!readFile(cpuRoot + "online", online))
+            return;
+
+        for (const int id : parseCpuList(online))
+        {
+            const std::string topology = cpuRoot + "cpu" + std::to_string(id) + "/topology/";
+            std::string core, package;
+            LogicalCpu cpu;
+            cpu.id = id;
+            cpu.core = readFile(topology + "core_id", core) ? std::stoi(core) : id;
+            cpu.package = readFile(topology + "physical_package_id", package) ? std::stoi(package) : 0;
+            m_cpus.push_back(cpu);
+        }
+
+        // The NUMA nodes are numbered contiguously, stop at the first missing one
+        for (int node = 0; ; ++node)
+        {
+            std::string list;
+            if (!readFile("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist", list))
+                break;
+            for (const int id : parseCpuList(list))
+            {
+                for (auto& cpu : m_cpus)
+                {
+                    if (cpu.id == id)
+                        cpu.numaNode = node;
+                }
+            }
+        }
+    }
+
+    std::vector<LogicalCpu> m_cpus;
+};
+
+/// Restrict the calling thread to a single logical CPU. Returns false if it is not supported on this platform.
+inline bool pinCurrentThread(int cpu)
+{
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+/// Allow the calling thread to run on all the logical CPUs again
+inline bool unpinCurrentThread()
+{
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const auto& cpu : CpuTopology::get().getCpus())
+        CPU_SET(cpu.id, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+/**
+ * The threads of a task scheduler cannot be accessed directly, so each thread is pinned from a task.
+ * Each of the nbThreads tasks blocks until all the tasks started, so that a thread cannot execute two of them:
+ * each thread of the scheduler, including the main thread, executes exactly one task.
+ * With an empty list of CPUs, the threads are unpinned.
+ */
+class ThreadPinningBarrier
+{
+public:
+    ThreadPinningBarrier(unsigned int nbThreads, std::vector<int> cpus)
+        : m_nbThreads(nbThreads), m_cpus(std::move(cpus)) {}
+
+    void arriveAndPin()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_cpus.empty())
+            unpinCurrentThread();
+        else
+            pinCurrentThread(m_cpus[m_nbArrived % m_cpus.size()]);
+        if (++m_nbArrived == m_nbThreads)
+            m_allArrived.notify_all();
+        else
+            m_allArrived.wait(lock, [this] { return m_nbArrived == m_nbThreads; });
+    }
+
+private:
+    const unsigned int m_nbThreads;
+    const std::vector<int> m_cpus;
+    unsigned int m_nbArrived { 0 };
+    std::mutex m_mutex;
+    std::condition_variable m_allArrived;
+};
+
+/// Pin the threads of a SOFA task scheduler according to the policy. AffinityPolicy::None unpins them.
+inline void pinTaskSchedulerThreads(sofa::simulation::TaskScheduler& taskScheduler, AffinityPolicy policy)
+{
+    const unsigned int nbThreads = std::max(1u, taskScheduler.getThreadCount());
+    ThreadPinningBarrier barrier(nbThreads, CpuTopology::get().getOrder(policy));
+
+    sofa::simulation::CpuTask::Status status;
+    for (unsigned int i = 0; i < nbThreads; ++i)
+    {
+        taskScheduler.addTask(status, [&barrier]() { barrier.arriveAndPin(); });
+    }
+    taskScheduler.workUntilDone(&status);
+}
+
+/**
+ * Pins threads for the lifetime of the object. The destructor unpins the threads of the task scheduler given at
+ * construction, and restores the affinity that the calling thread had at construction.
+ * A thread inherits the affinity of the thread which creates it: without this, the threads created while the
+ * calling thread is pinned (workers of a task scheduler initialized by a scene), or after (thread pools of the
+ * next benchmarks), would all stay restricted to the CPUs of this benchmark.
+ */
+class ScopedThreadAffinity
+{
+public:
+    explicit ScopedThreadAffinity(sofa::simulation::TaskScheduler* taskScheduler = nullptr)
+        : m_taskScheduler(taskScheduler)
+    {
+#if defined(__linux__)
+        CPU_ZERO(&m_initialAffinity);
+        m_hasInitialAffinity = pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &m_initialAffinity) == 0;
+#endif
+    }
+
+    ~ScopedThreadAffinity()
+    {
+        if (m_taskScheduler != nullptr && m_taskScheduler->getThreadCount() > 1)
+            pinTaskSchedulerThreads(*m_taskScheduler, AffinityPolicy::None);
+#if defined(__linux__)
+        if (m_hasInitialAffinity)
+            pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &m_initialAffinity);
+#endif
+    }
+
+    ScopedThreadAffinity(const ScopedThreadAffinity&) = delete;
+    ScopedThreadAffinity& operator=(const ScopedThreadAffinity&) = delete;
+
+private:
+    sofa::simulation::TaskScheduler* m_taskScheduler { nullptr };
+#if defined(__linux__)
+    cpu_set_t m_initialAffinity;
+    bool m_hasInitialAffinity { false };
+#endif
+};
+
+/// Pin the threads of a WorkStealingScheduler according to the policy. AffinityPolicy::None unpins them.
+inline void pinTaskSchedulerThreads(WorkStealingScheduler& taskScheduler, AffinityPolicy policy)
+{
+    class PinningTask final : public WorkStealingScheduler::Task
+    {
+    public:
+        PinningTask(WorkStealingScheduler::Status* status, ThreadPinningBarrier& barrier)
+            : WorkStealingScheduler::Task(status), m_barrier(barrier) {}
+        void run() override { m_barrier.arriveAndPin(); }
+    private:
+        ThreadPinningBarrier& m_barrier;
+    };
+
+    const unsigned int nbThreads = taskScheduler.getThreadCount();
+    ThreadPinningBarrier barrier(nbThreads, CpuTopology::get().getOrder(policy));
+
+    WorkStealingScheduler::Status status;
+    std::vector<PinningTask> tasks;
+    tasks.reserve(nbThreads);
+    for (unsigned int i = 0; i < nbThreads; ++i)
+    {
+        tasks.emplace_back(&status, barrier);
+        taskScheduler.addTask(&tasks.back());
+    }
+    taskScheduler.workUntilDone(&status);
+}
+
+/**
+ * Array whose memory is not touched at allocation, so that its pages are placed, by the first-touch policy of
+ * the operating system, on the NUMA node of the thread which writes them first. The elements are meant to be
+ * constructed in parallel, with the same partition as the computation which uses them.
+ */
+template<class T>
+class FirstTouchArray
+{
+    static_assert(std::is_trivially_destructible_v<T>, "the elements are never destroyed");
+
+public:
+    explicit FirstTouchArray(std::size_t size)
+        : m_data(static_cast<T*>(::operator new(size * sizeof(T), std::align_val_t(64))))
+        , m_size(size) {}
+
+    ~FirstTouchArray()
+    {
+        ::operator delete(m_data, std::align_val_t(64));
+    }
+
+    FirstTouchArray(const FirstTouchArray&) = delete;
+    FirstTouchArray& operator=(const FirstTouchArray&) = delete;
+
+    void construct(std::size_t i, const T& value) { new (m_data + i) T(value); }
+
+    T& operator[](std::size_t i) { return m_data[i]; }
+    const T& operator[](std::size_t i) const { return m_data[i]; }
+    std::size_t size() const { return m_size; }
+
+private:
+    T* m_data;
+    std::size_t m_size;
+};
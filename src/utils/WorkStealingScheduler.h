@@ -0,0 +1,482 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Chase-Lev work-stealing deque (Chase and Lev 2005, with the memory orders of Le et al. 2013).
+ * The owner thread pushes and pops at the bottom, the other threads steal at the top.
+ * The deque stores pointers to tasks owned by the caller, so that pushing a task never allocates. The ring
+ * buffer grows when it is full; the previous buffers are kept until the destruction of the deque, because
+ * a thief may still be reading them.
+ */
+template<class T>
+class WorkStealingDeque
+{
+public:
+    explicit WorkStealingDeque(std::size_t initialCapacity = 1024)
+    {
+        std::size_t capacity = 1;
+        while (capacity < initialCapacity)
+            capacity <<= 1;
+        m_buffers.push_back(std::make_unique<Buffer>(capacity));
+        m_buffer.store(m_buffers.back().get(), std::memory_order_relaxed);
+    }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    /// Owner only
+    void push(T* item)
+    {
+        const std::int64_t b = m_bottom.load(std::memory_order_relaxed);
+        const std::int64_t t = m_top.load(std::memory_order_acquire);
+        Buffer* buffer = m_buffer.load(std::memory_order_relaxed);
+        if (b - t > static_cast<std::int64_t>(buffer->capacity) - 1)
+        {
+            buffer = grow(buffer, b, t);
+        }
+        buffer->put(b, item);
+        m_bottom.store(b + 1, std::memory_order_release);
+    }
+
+    /// Owner only. Returns nullptr if the deque is empty.
+    T* pop()
+    {
+        const std::int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+        Buffer* buffer = m_buffer.load(std::memory_order_relaxed);
+        m_bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t t = m_top.load(std::memory_order_relaxed);
+
+        if (t > b)
+        {
+            // empty
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        T* item = buffer->get(b);
+        if (t == b)
+        {
+            // last item: race against the thieves
+            if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                item = nullptr;
+            }
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    /// Any thread. Returns nullptr if the deque is empty or if another thread won the race.
+    T* steal()
+    {
+        std::int64_t t = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const std::int64_t b = m_bottom.load(std::memory_order_acquire);
+
+        if (t >= b)
+        {
+            return nullptr;
+        }
+
+        Buffer* buffer = m_buffer.load(std::memory_order_acquire);
+        T* item = buffer->get(t);
+        if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            return nullptr;
+        }
+        return item;
+    }
+
+    bool empty() const
+    {
+        return m_bottom.load(std::memory_order_acquire) <= m_top.load(std::memory_order_acquire);
+    }
+
+private:
+    struct Buffer
+    {
+        explicit Buffer(std::size_t c) : capacity(c), mask(c - 1), items(new std::atomic<T*>[c]) {}
+
+        T* get(std::int64_t i) const { return items[static_cast<std::size_t>(i) & mask].load(std::memory_order_relaxed); }
+        void put(std::int64_t i, T* item) { items[static_cast<std::size_t>(i) & mask].store(item, std::memory_order_relaxed); }
+
+        const std::size_t capacity;
+        const std::size_t mask;
+        std::unique_ptr<std::atomic<T*>[]> items;
+    };
+
+    Buffer* grow(Buffer* buffer, std::int64_t b, std::int64_t t)
+    {
+        m_buffers.push_back(std::make_unique<Buffer>(2 * buffer->capacity));
+        Buffer* newBuffer = m_buffers.back().get();
+        for (std::int64_t i = t; i < b; ++i)
+        {
+            newBuffer->put(i, buffer->get(i));
+        }
+        m_buffer.store(newBuffer, std::memory_order_release);
+        return newBuffer;
+    }
+
+    alignas(64) std::atomic<std::int64_t> m_top { 0 };
+    alignas(64) std::atomic<std::int64_t> m_bottom { 0 };
+    alignas(64) std::atomic<Buffer*> m_buffer { nullptr };
+    std::vector<std::unique_ptr<Buffer> > m_buffers; // owner only
+};
+
+/**
+ * Task scheduler where each thread owns a work-stealing deque.
+ * A thread pushes its new tasks in its own deque and pops them in LIFO order; an idle thread steals the
+ * oldest tasks of a random victim. The tasks are owned by the caller (on the stack or in a container), as
+ * with sofa::simulation::CpuTask, so scheduling a task never allocates.
+ *
+ * The thread calling init() is the main thread: it owns the deque 0 and participates in the work while it
+ * waits in workUntilDone(). Tasks can be added only by the main thread or by a running task.
+ */
+class WorkStealingScheduler
+{
+public:
+    /// Number of tasks not finished yet, shared by a group of tasks
+    class Status
+    {
+    public:
+        bool isBusy() const { return m_busy.load(std::memory_order_acquire) > 0; }
+
+    private:
+        friend class WorkStealingScheduler;
+        std::atomic<int> m_busy { 0 };
+    };
+
+    class Task
+    {
+    public:
+        explicit Task(Status* status) : m_status(status) {}
+        virtual ~Task() = default;
+        virtual void run() = 0;
+
+        Status* getStatus() const { return m_status; }
+
+    private:
+        Status* m_status;
+    };
+
+    WorkStealingScheduler() = default;
+    explicit WorkStealingScheduler(unsigned int nbThreads) { init(nbThreads); }
+    ~WorkStealingScheduler() { stop(); }
+
+    WorkStealingScheduler(const WorkStealingScheduler&) = delete;
+    WorkStealingScheduler& operator=(const WorkStealingScheduler&) = delete;
+
+    /// Start nbThreads - 1 worker threads. 0 means the number of hardware threads.
+    void init(unsigned int nbThreads = 0)
+    {
+        stop();
+
+        if (nbThreads == 0)
+            nbThreads = std::max(1u, std::thread::hardware_concurrency());
+
+        m_workers.clear();
+        for (unsigned int i = 0; i < nbThreads; ++i)
+            m_workers.push_back(std::make_unique<Worker>(i));
+
+        s_currentScheduler = this;
+        s_currentWorker = m_workers.front().get();
+
+        m_isRunning.store(true, std::memory_order_release);
+        for (unsigned int i = 1; i < nbThreads; ++i)
+            m_workers[i]->thread = std::thread(&WorkStealingScheduler::workerLoop, this, m_workers[i].get());
+    }
+
+    void stop()
+    {
+        if (!m_isRunning.load(std::memory_order_acquire))
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+            m_isRunning.store(false, std::memory_order_release);
+            ++m_wakeUpEpoch;
+        }
+        m_wakeUp.notify_all();
+
+        for (auto& worker : m_workers)
+        {
+            if (worker->thread.joinable())
+                worker->thread.join();
+        }
+
+        if (s_currentScheduler == this)
+            s_currentScheduler = nullptr;
+    }
+
+    unsigned int getThreadCount() const { return static_cast<unsigned int>(m_workers.size()); }
+
+    /// Schedule a task. The task must stay alive until its status is not busy anymore.
+    void addTask(Task* task)
+    {
+        assert(s_currentScheduler == this && "tasks must be added by the main thread or by a task");
+        task->getStatus()->m_busy.fetch_add(1, std::memory_order_relaxed);
+        s_currentWorker->deque.push(task);
+
+        // Pairs with the increment of m_nbSleeping: either a sleeping worker is seen here, or the worker
+        // sees the new task before falling asleep
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_nbSleeping.load(std::memory_order_relaxed) > 0)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_sleepMutex);
+                ++m_wakeUpEpoch;
+            }
+            m_wakeUp.notify_all();
+        }
+    }
+
+    /// Execute tasks until all the tasks of status are finished
+    void workUntilDone(const Status* status)
+    {
+        Worker* self = s_currentWorker;
+        while (status->isBusy())
+        {
+            if (Task* task = findTask(self))
+                execute(task);
+            else
+                std::this_thread::yield();
+        }
+    }
+
+private:
+    struct alignas(64) Worker
+    {
+        explicit Worker(unsigned int i) : index(i), randomState(0x9E3779B9u * (i + 1)) {}
+
+        WorkStealingDeque<Task> deque;
+        std::thread thread;
+        const unsigned int index;
+        std::uint32_t randomState;
+    };
+
+    static void execute(Task* task)
+    {
+        Status* status = task->getStatus();
+        task->run();
+        status->m_busy.fetch_sub(1, std::memory_order_release);
+    }
+
+    Task* findTask(Worker* self)
+    {
+        if (Task* task = self->deque.pop())
+            return task;
+
+        // steal from the other workers, starting from a random one
+        const auto nbWorkers = static_cast<unsigned int>(m_workers.size());
+        if (nbWorkers < 2)
+            return nullptr;
+
+        std::uint32_t& x = self->randomState;
+        x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+        const unsigned int start = x % nbWorkers;
+        for (unsigned int i = 0; i < nbWorkers; ++i)
+        {
+            Worker* victim = m_workers[(start + i) % nbWorkers].get();
+            if (victim == self)
+                continue;
+            if (Task* task = victim->deque.steal())
+                return task;
+        }
+        return nullptr;
+    }
+
+    bool hasVisibleWork() const
+    {
+        for (const auto& worker : m_workers)
+        {
+            if (!worker->deque.empty())
+                return true;
+        }
+        return false;
+    }
+
+    void workerLoop(Worker* self)
+    {
+        s_currentScheduler = this;
+        s_currentWorker = self;
+
+        constexpr unsigned int nbSpinsBeforeSleep = 1 << 12;
+        unsigned int nbFailedAttempts = 0;
+
+        while (m_isRunning.load(std::memory_order_acquire))
+        {
+            if (Task* task = findTask(self))
+            {
+                execute(task);
+                nbFailedAttempts = 0;
+                continue;
+            }
+
+            if (++nbFailedAttempts < nbSpinsBeforeSleep)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_sleepMutex);
+            const std::uint64_t epoch = m_wakeUpEpoch;
+            m_nbSleeping.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!hasVisibleWork())
+            {
+                m_wakeUp.wait(lock, [this, epoch]
+                {
+                    return m_wakeUpEpoch != epoch || !m_isRunning.load(std::memory_order_acquire);
+                });
+            }
+            m_nbSleeping.fetch_sub(1, std::memory_order_relaxed);
+            nbFailedAttempts = 0;
+        }
+
+        s_currentScheduler = nullptr;
+        s_currentWorker = nullptr;
+    }
+
+    std::vector<std::unique_ptr<Worker> > m_workers;
+    std::atomic<bool> m_isRunning { false };
+
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wakeUp;
+    std::uint64_t m_wakeUpEpoch { 0 }; // protected by m_sleepMutex
+    std::atomic<int> m_nbSleeping { 0 };
+
+    static inline thread_local WorkStealingScheduler* s_currentScheduler { nullptr };
+    static inline thread_local Worker* s_currentWorker { nullptr };
+};
+
+namespace workstealing
+{
+
+/// Same members as sofa::simulation::Range, so that the same loop body can be given to both parallelForEachRange
+template<class InputIt>
+struct Range
+{
+    InputIt start;
+    InputIt end;
+};
+
+namespace detail
+{
+
+/// The ranges are either iterators or integers, as in sofa::simulation::parallelForEach
+template<class InputIt>
+std::int64_t distance(InputIt first, InputIt last)
+{
+    if constexpr (std::is_integral_v<InputIt>)
+        return static_cast<std::int64_t>(last - first);
+    else
+        return static_cast<std::int64_t>(std::distance(first, last));
+}
+
+template<class InputIt>
+InputIt next(InputIt it, std::int64_t n)
+{
+    if constexpr (std::is_integral_v<InputIt>)
+        return it + static_cast<InputIt>(n);
+    else
+        return std::next(it, n);
+}
+
+template<class InputIt, class RangeFunction>
+void forEachRange(WorkStealingScheduler& scheduler, InputIt first, InputIt last, std::int64_t grainSize, const RangeFunction& f);
+
+/// Right half of a split range. It lives on the stack of the task which split the range, and this task
+/// waits for its completion before returning.
+template<class InputIt, class RangeFunction>
+class SplitTask final : public WorkStealingScheduler::Task
+{
+public:
+    SplitTask(WorkStealingScheduler::Status* status, WorkStealingScheduler& scheduler, InputIt first, InputIt last, std::int64_t grainSize, const RangeFunction& f)
+        : WorkStealingScheduler::Task(status), m_scheduler(scheduler), m_first(first), m_last(last), m_grainSize(grainSize), m_function(f) {}
+
+    void run() override
+    {
+        forEachRange(m_scheduler, m_first, m_last, m_grainSize, m_function);
+    }
+
+private:
+    WorkStealingScheduler& m_scheduler;
+    InputIt m_first;
+    InputIt m_last;
+    std::int64_t m_grainSize;
+    const RangeFunction& m_function;
+};
+
+/// Recursive binary split until the grain size: the halves are stolen while the other threads are idle,
+/// and executed inline by the owner otherwise
+template<class InputIt, class RangeFunction>
+void forEachRange(WorkStealingScheduler& scheduler, InputIt first, InputIt last, std::int64_t grainSize, const RangeFunction& f)
+{
+    const std::int64_t size = detail::distance(first, last);
+    if (size <= grainSize)
+    {
+        f(Range<InputIt>{first, last});
+        return;
+    }
+
+    const InputIt middle = detail::next(first, size / 2);
+
+    WorkStealingScheduler::Status status;
+    SplitTask<InputIt, RangeFunction> right(&status, scheduler, middle, last, grainSize, f);
+    scheduler.addTask(&right);
+
+    forEachRange(scheduler, first, middle, grainSize, f);
+
+    scheduler.workUntilDone(&status);
+}
+
+}
+
+/// Default grain size: 8 chunks per thread, to leave room for load balancing
+inline std::int64_t defaultGrainSize(const WorkStealingScheduler& scheduler, std::int64_t size)
+{
+    return std::max<std::int64_t>(1, size / (8 * static_cast<std::int64_t>(scheduler.getThreadCount())));
+}
+
+/// Equivalent of sofa::simulation::parallelForEachRange: f is called on sub-ranges of [first, last[
+template<class InputIt, class RangeFunction>
+void parallelForEachRange(WorkStealingScheduler& scheduler, InputIt first, InputIt last, const RangeFunction& f, std::int64_t grainSize = 0)
+{
+    if (first == last)
+        return;
+    if (grainSize <= 0)
+        grainSize = defaultGrainSize(scheduler, detail::distance(first, last));
+    detail::forEachRange(scheduler, first, last, grainSize, f);
+}
+
+/// Equivalent of sofa::simulation::parallelForEach: f is called on each integer, or each dereferenced
+/// iterator, of [first, last[
+template<class InputIt, class UnaryFunction>
+void parallelForEach(WorkStealingScheduler& scheduler, InputIt first, InputIt last, const UnaryFunction& f, std::int64_t grainSize = 0)
+{
+    parallelForEachRange(scheduler, first, last, [&f](const Range<InputIt>& range)
+    {
+        for (auto it = range.start; it != range.end; ++it)
+        {
+            if constexpr (std::is_integral_v<InputIt>)
+                f(it);
+            else
+                f(*it);
+        }
+    }, grainSize);
+}
+
+}